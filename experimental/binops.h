@@ -1,6 +1,7 @@
 #pragma once
 
 #include "pconfig.hpp"
+#include "fmtspan.h"
 
 // Let compiler know we want to use some intrinsics
 //#pragma intrinsic (_byteswap_ushort, _byteswap_ulong, _byteswap_uint64)
@@ -26,9 +27,6 @@
     tohex
 */
 namespace pcore {
-    // Encodings of a nibble (4-bits) as a hex digit
-    static const char* hexdigits = "0123456789abcdef";
-
     // tohex32
     // Take a 32-bit number and return the hex representation of the same
     // The buffer passed in needs to be at least 8 bytes long
@@ -39,18 +37,10 @@ namespace pcore {
     //  Really the only error that can occur is if the buffLen is less than 8
     static INLINE int tohex32(uint32_t a, char* buff, size_t buffLen)
     {
-        if (buffLen < 8)
+        if (buffLen < FMT_HEX32_CHARS)
             return 0;
 
-        int i;
-        int n = 8;
-
-        for (i = n; --i >= 0;) {
-            buff[i] = hexdigits[a & 0x0f];
-            a >>= 4;
-        }
-
-        return n;
+        return fmt_hex32(buff, a);
     }
 
     // tobin
@@ -60,16 +50,13 @@ namespace pcore {
     // be similar to what you would see in the calculator app
     static INLINE int tobin32(uint32_t a, char* buff, size_t buffLen)
     {
-        if (buffLen < 33)
+        if (buffLen < FMT_BIN32_CHARS + 1)
             return 0;
 
-        for (int i = 0; i < 32; i++) {
-            buff[31 - i] = ((0x01 & a) > 0) ? '1' : '0';
-            a >>= 1;
-        }
-        buff[32] = 0;
+        fmt_bin32(buff, a);
+        buff[FMT_BIN32_CHARS] = 0;
 
-        return 33;
+        return FMT_BIN32_CHARS + 1;
     }
 
 
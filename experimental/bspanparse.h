@@ -2,6 +2,9 @@
 
 #include "pconfig.hpp"
 #include "bspan.h"
+#include "convspan.h"
+
+#include <vector>
 
 namespace pcore
 {
@@ -130,95 +133,19 @@ namespace pcore {
 		return s;
 	}
 
-	// Return a power of 10 using a lookup table
-	// works with exponents from 0 to 22
-	static inline double pow10(size_t n) noexcept
-	{
-		static const double p10[] = {
-			1e0, 1e1, 1e2, 1e3, 1e4,
-			1e5, 1e6, 1e7, 1e8, 1e9,
-			1e10, 1e11, 1e12, 1e13, 1e14,
-			1e15, 1e16, 1e17, 1e18, 1e19,
-			1e20, 1e21, 1e22
-		};
-
-		return p10[n];
-	}
-
 	// parse floating point number
 	// includes sign, exponent, and decimal point
-	// The input chunk is altered, with the fStart pointer moved to the end of the number
+	// The value is correctly rounded (see convfloat.h)
 	static inline double chunk_to_double(const ByteSpan& inChunk) noexcept
 	{
-		ByteSpan s = inChunk;
-
-		double sign = 1.0;
 		double res = 0.0;
-		long long intPart = 0;
-		uint64_t fracPart = 0;
-		bool hasIntPart = false;
-		bool hasFracPart = false;
-
-		// Parse optional sign
-		if (*s == '+') {
-			s++;
-		}
-		else if (*s == '-') {
-			sign = -1;
-			s++;
-		}
-
-		// Parse integer part
-		if (digitChars[*s]) {
-
-			intPart = chunk_to_u64(s);
-
-			res = (double)intPart;
-			hasIntPart = true;
-		}
-
-		// Parse fractional part.
-		if (*s == '.') {
-			s++; // Skip '.'
-			auto sentinel = s.fStart;
-
-			if (digitChars(*s)) {
-				fracPart = chunk_to_u64(s);
-				auto ending = s.fStart;
-
-				ptrdiff_t diff = ending - sentinel;
-				//res = res + ((double)fracPart) / (double)powd((double)10, double(diff));
-				res = res + ((double)fracPart) / (double)pow10(diff);
-				hasFracPart = true;
-			}
-		}
+		const unsigned char* endp = nullptr;
 
 		// A valid number should have integer or fractional part.
-		if (!hasIntPart && !hasFracPart)
+		if (conv_parse_double(inChunk.fStart, inChunk.fEnd, &res, &endp) != 0)
 			return 0.0;
 
-
-		// Parse optional exponent
-		if (*s == 'e' || *s == 'E') {
-			long long expPart = 0;
-			s++; // skip 'E'
-
-			double expSign = 1.0;
-			if (*s == '+') {
-				s++;
-			}
-			else if (*s == '-') {
-				expSign = -1.0;
-				s++;
-			}
-
-			if (digitChars[*s]) {
-				expPart = chunk_to_u64(s);
-				res = res * (1.0/pow10(expPart));
-			}
-		}
-
-		return res * sign;
+		return res;
 	}
 
 	// parseNextNumber
@@ -250,6 +177,41 @@ namespace pcore {
 		return true;
 	}
 
+	// parseNumberList
+	// parseNumberList(ByteSpan &s, std::vector<double> &outNumbers)
+	//
+	// Consume a whole list of numbers, separated by commas and whitespace,
+	// off the front of the chunk, appending them to outNumbers.  This is
+	// much faster than calling parseNextNumber() for each one.
+	// The chunk is left where the list ended.
+	// Return the number of numbers added
+	static inline size_t parseNumberList(ByteSpan& s, std::vector<double>& outNumbers)
+	{
+		static const size_t batchSize = 64;
+		const unsigned char* p = s.fStart;
+		size_t total = 0;
+
+		// Reserved once, for a number every other byte, which is as many
+		// as there can be, so the vector doesn't grow along the way.  The
+		// chunk is meant to be the list, like a 'd' or 'points' attribute.
+		outNumbers.reserve(outNumbers.size() + ((size_t)(s.fEnd - s.fStart) + 1) / 2);
+
+		double batch[batchSize];
+		while (true)
+		{
+			size_t n = conv_parse_list(&p, s.fEnd, batch, false, batchSize);
+			outNumbers.insert(outNumbers.end(), batch, batch + n);
+			total += n;
+
+			if (n < batchSize)
+				break;
+		}
+
+		s.fStart = p;
+
+		return total;
+	}
+
 	// toInteger()
     // Return a signed integer from a chunk
     //
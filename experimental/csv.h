@@ -2,17 +2,20 @@
 
 #include "charset.h"
 #include "bspanutil.h"
-#include "generator.h"
+#include "csvcolumns.h"
+#include "csvprojection.h"
+#include "csvcursor.h"
 
 
 #include <vector>
 #include <unordered_map>
 #include <map>
 #include <functional>
+#include <memory>
+#include <string>
 
 
 namespace pcore {
-	static charset csvln("\r\n\t");
 	static charset csvwsp("\r\n ");
 
 	
@@ -51,115 +54,43 @@ namespace pcore {
 	// line termination is either
 	// \r\n or \n
 	// but there can be quoted strings inside, that contain the line terminators
+	// The line end is found 64 bytes at a time, by csv_read_line()
 	// 
 	static ByteSpan readCsvLine(ByteSpan& s)
 	{
-		ByteSpan line = s;
-		line.fEnd = line.fStart;
-		bool inQuote = false;
-		
-		do {
-			// we've reached end of input
-			if (line.fEnd == s.fEnd) {
-				break;
-			}
-			
-			if (*s == '"') {
-				inQuote = !inQuote;
-			}
-
-			if (!inQuote) {
-				if (csvln.contains(*s)) {
-					s++;
-					break;
-				}
-			}
-
-			line.fEnd++;
-			s++;
-		} while (s );
-
-		if (*s == '\r') {
-			s++;
-		}
-		if (*s == '\n')
-			s++;
-
-		return line;
-
-	}
-	
-
-	
-	// generateColumnValues
-// Given an input that is a single line of CSV data
-// yield a single column's value each time around
-// This generator will work with a range-based for loop
-// Example:
-// for (auto col : generateColumnValues(line)) {
-//	printf("%.*s\n", (int)col.size(), col.data());
-// }
-	static Generator<ByteSpan> generateColumnValues(const ByteSpan& chunk, charset&& csvdlm)
-	{
-		// first trim leading whitespace characters
-		// BUGBUG - maybe not?
-		//ByteSpan s = chunk_ltrim(chunk, csvwsp);
-		ByteSpan s = chunk;
-
-		// look for a '"' character
-		// if that's found, then read until the end of that
-		// then look for delim
-		bool inQuote = false;
-
-
-		// Assume we're at the beginning of a column value
-		ByteSpan col = s;
-		col.fEnd = col.fStart;
-
-		// Expand the end of the value until we see a delimeter
-		while (s) {
-			if (*s == '"') {
-				inQuote = !inQuote;
-				s++;
-			}
-
-			if (inQuote) {
-				col.fEnd++;
-				s++;
-				continue;
-			}
+		bspan src;
+		bspan line;
+		bspan_init_from_pointers(&src, s.begin(), s.end());
 
-			if (csvdlm.contains(*s)) {
-				s++;
-				co_yield col;
-
-				// Reset for next column
-				col.fStart = s.fStart;
-				col.fEnd = s.fStart;
-			}
-			else {
-				col.fEnd++;
-				s++;
-			}
+		if (csv_read_line(&src, &line) != 0) {
+			s = ByteSpan(s.end(), s.end());
+			return ByteSpan();
 		}
 
-		if (col.size() > 0)
-			co_yield col;
+		s = ByteSpan(bspan_begin(&src), bspan_end(&src));
 
+		return ByteSpan(bspan_begin(&line), bspan_end(&line));
 	}
 	
 	// gatherColumnValues()
 	// Fill in a vector with ByteSpans that represent the column values
-	// This uses an implied ',' separator, and can NOT handle quoted
-	// delimeters
+	// This uses an implied ',' separator.  Delimiters inside of
+	// quotes do not split a value.  An empty line has no values.
 	//
-	static bool gatherColumnValues(const ByteSpan& inChunk, std::vector<ByteSpan>& values)
+	static bool gatherColumnValues(const ByteSpan& inChunk, std::vector<ByteSpan>& values, unsigned char delim = ',')
 	{
-		ByteSpan s = inChunk;
+		if (inChunk.size() == 0)
+			return true;
+
+		bspan line;
+		bspan_init_from_pointers(&line, inChunk.begin(), inChunk.end());
 
-		for (const auto& value : generateColumnValues(s, ","))
+		csvfielditer iter;
+		bspan field;
+		csv_field_iter_init(&iter, &line, delim);
+		while (csv_field_iter_next(&iter, &field) == 0)
 		{
-			values.push_back(chunk_ltrim(value, csvwsp));
+			values.push_back(chunk_ltrim(ByteSpan(bspan_begin(&field), bspan_end(&field)), csvwsp));
 		}
 
 		return true;
@@ -190,13 +121,59 @@ namespace pcore {
 		return true;
 	}
 	
-	static bool gatherColumnHeadings(const ByteSpan& chunk, std::vector<CSVColumn>& columns)
+	// CSVProjection
+	// A projection, compiled once, from the line of column headings, and
+	// a list of column names (see csvprojection.h).  Rows are then split
+	// only as far as they need to be, to get the named columns.
+	struct CSVProjection
 	{
-		ByteSpan s = chunk;
+		csvprojection fProjection;
+		std::vector<bspan> fValues;
+
+		CSVProjection(const ByteSpan& headingLine, const ByteSpan& columnNames, unsigned char delim = ',')
+		{
+			bspan headings;
+			bspan names;
+			bspan_init_from_pointers(&headings, headingLine.begin(), headingLine.end());
+			bspan_init_from_pointers(&names, columnNames.begin(), columnNames.end());
+
+			csvprojection_init(&fProjection);
+			csvprojection_compile(&fProjection, &headings, &names, delim);
+			fValues.resize(csvprojection_count(&fProjection));
+		}
+
+		CSVProjection(const CSVProjection&) = delete;
+		CSVProjection& operator=(const CSVProjection&) = delete;
+
+		~CSVProjection()
+		{
+			csvprojection_destroy(&fProjection);
+		}
+
+		size_t size() const { return fValues.size(); }
+	};
+
+	// gatherProjectedColumnValues()
+	// The values of the projected columns of a single line, in the
+	// order the projection named them
+	static bool gatherProjectedColumnValues(const ByteSpan& inChunk, CSVProjection& proj, std::vector<ByteSpan>& values, unsigned char delim = ',')
+	{
+		bspan line;
+		bspan_init_from_pointers(&line, inChunk.begin(), inChunk.end());
+
+		csvprojection_apply(&proj.fProjection, &line, delim, proj.fValues.data());
+		for (const bspan &v : proj.fValues)
+			values.push_back(chunk_ltrim(ByteSpan(bspan_begin(&v), bspan_end(&v)), csvwsp));
+
+		return true;
+	}
 
-		auto gen = generateColumnValues(s, ",");
+	static bool gatherColumnHeadings(const ByteSpan& chunk, std::vector<CSVColumn>& columns)
+	{
+		std::vector<ByteSpan> names{};
+		gatherColumnValues(chunk, names);
 
-		for (const auto& c : gen) {
+		for (const auto& c : names) {
 			ByteSpan value = chunk_trim(c, csvwsp);
 			columns.push_back({ value, (int)columns.size() });
 		}
@@ -210,13 +187,12 @@ namespace pcore {
 	
 	static bool gatherColumnHeadings(const ByteSpan& chunk, std::map<ByteSpan, CSVColumn>& columns)
 	{
-		ByteSpan s = chunk;
-
-		auto gen = generateColumnValues(s, ",");
+		std::vector<ByteSpan> names{};
+		gatherColumnValues(chunk, names);
 
 		size_t colPos{ 0 };
 		
-		for (const auto& c : gen) {
+		for (const auto& c : names) {
 			//printf("%.*s\n", (int)c.size(), c.data());
 			ByteSpan value = chunk_trim(c, csvwsp);
 			columns[value] = { value, (int)colPos };
@@ -256,11 +232,65 @@ namespace pcore {
 		}
 	};
 
+	//
+	// A CSVCursor goes through the rows of a table, one at a time, with
+	// a single array of fields, reused for every row (see csvcursor.h).
+	// Find the ordinals of the wanted columns once, then get the values
+	// of each row by ordinal.  The values of a row are good until next()
+	// is called again.
+	//
+	struct CSVCursor
+	{
+		csvcursor fCursor;
+
+		CSVCursor(const ByteSpan& src, bool namesInFirstLine = true, unsigned char delim = ',')
+		{
+			bspan s;
+			bspan_init_from_pointers(&s, src.begin(), src.end());
+			csvcursor_init(&fCursor, &s, delim);
+			if (namesInFirstLine)
+				csvcursor_read_headings(&fCursor);
+		}
+
+		CSVCursor(const CSVCursor&) = delete;
+		CSVCursor& operator=(const CSVCursor&) = delete;
+
+		~CSVCursor()
+		{
+			csvcursor_destroy(&fCursor);
+		}
+
+		// Move to the next row, false when there are no more
+		bool next() { return csvcursor_next(&fCursor) == 0; }
+
+		size_t size() const { return csvcursor_field_count(&fCursor); }
+
+		// The ordinal of a column, by name, or -1
+		int ordinal(const ByteSpan& columnName) const
+		{
+			bspan name;
+			bspan_init_from_pointers(&name, columnName.begin(), columnName.end());
+
+			return csvcursor_ordinal(&fCursor, &name);
+		}
+
+		ByteSpan operator[](size_t col) const
+		{
+			bspan value;
+			if (csvcursor_field(&fCursor, col, &value) != 0)
+				return ByteSpan();
+
+			return ByteSpan(bspan_begin(&value), bspan_end(&value));
+		}
+	};
+
 	struct CSVTable
 	{
 		ByteSpan fSourceSpan{};
 		ByteSpan fBOM{};
 		ByteSpan fDataSpan{};
+		ByteSpan fHeadingLine{};
+		bool fNamesInFirstLine{ true };
 		std::map<ByteSpan, CSVColumn> fColumnHeadings{};
 
 		
@@ -273,7 +303,7 @@ namespace pcore {
 		void reset(const ByteSpan& src, bool namesInFirstLine = true)
 		{
 			fSourceSpan = src;
-
+			fNamesInFirstLine = namesInFirstLine;
 			
 			// Read the Byte Order Mark (BOM) if there is one
 			fBOM = readBOM(fSourceSpan);
@@ -281,12 +311,29 @@ namespace pcore {
 			
 			if (namesInFirstLine) {
 				// Read the column headings
-				ByteSpan line = readCsvLine(fDataSpan);
-				gatherColumnHeadings(line, fColumnHeadings);
+				fHeadingLine = readCsvLine(fDataSpan);
+				gatherColumnHeadings(fHeadingLine, fColumnHeadings);
 			}
 
 		}
 
+		// loadColumns()
+		// Load the whole table, headings and all, into typed columns
+		// (see csvcolumns.h).  The columns refer to the source, which
+		// has to stay put for as long as they are used.
+		bool loadColumns(csvcolumns &columns, unsigned char delim = ',') const
+		{
+			bspan src;
+			bspan_init_from_pointers(&src, fSourceSpan.begin(), fSourceSpan.end());
+
+			csvindex idx;
+			csvindex_init(&idx);
+			bool success = (csvindex_build(&idx, &src, delim) == 0) && (csvcolumns_load(&columns, &idx, fNamesInFirstLine) == 0);
+			csvindex_destroy(&idx);
+
+			return success;
+		}
+
 		// valuesGenerator()
 		// create an iterator over the rows
 		//
@@ -295,22 +342,27 @@ namespace pcore {
 			// Return a function which will retrieve the next row
 			// allow the user to specify which columns they want to return
 			// if columnNames == nullptr, or "*", return all
-			return [this](std::vector<ByteSpan>& values, const char* columnNames = nullptr) {
+			// The projection is compiled the first time it is seen, and
+			// again only if different names are asked for.  The names are
+			// kept, as the caller's buffer may be reused for other names.
+			std::shared_ptr<CSVProjection> proj;
+			std::string compiledNames;
+
+			return [this, proj, compiledNames](std::vector<ByteSpan>& values, const char* columnNames = nullptr) mutable {
 				ByteSpan line = readCsvLine(fDataSpan);
 				
 				// if line isn't blank, then process it
 				if (line) {
-					// BUGBUG - this should happen only once and be passed in probably
-					// as part of the params
-					if (nullptr == columnNames) {
+					if ((nullptr == columnNames) || (0 == strcmp(columnNames, "*"))) {
 						gatherColumnValues(line, values);
 					}
 					else
 					{
-						// create a vector of the column names
-						std::vector<ByteSpan> projNamesVec{};
-						gatherColumnValues(columnNames, projNamesVec);
-						gatherProjectedColumnValues(line, projNamesVec, fColumnHeadings, values);
+						if (!proj || (compiledNames != columnNames)) {
+							proj = std::make_shared<CSVProjection>(fHeadingLine, ByteSpan(columnNames));
+							compiledNames = columnNames;
+						}
+						gatherProjectedColumnValues(line, *proj, values);
 					}
 				}
 				
@@ -318,6 +370,20 @@ namespace pcore {
 			};
 		}
 		
+		// cursor()
+		// A cursor over the rows, after the column headings, if
+		// the table has them
+		// Usage:
+		//		auto cur = tbl.cursor();
+		//		int col = cur.ordinal("Time");
+		//		while (cur.next())
+		//			ByteSpan value = cur[col];
+		//
+		CSVCursor cursor(unsigned char delim = ',') const
+		{
+			return CSVCursor(fSourceSpan, fNamesInFirstLine, delim);
+		}
+
 		// rowGenerator()
 		// Create an iterator over the rows
 		// Usage: 
@@ -327,7 +393,8 @@ namespace pcore {
 		{
 			ByteSpan rowSpans = fDataSpan;
 			
-			return [this, &rowSpans]() {
+			// The generator has its own copy of where it is
+			return [this, rowSpans]() mutable {
 				ByteSpan line = readCsvLine(rowSpans);
 				return CSVRow(fColumnHeadings, line);
 			};
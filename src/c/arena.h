@@ -0,0 +1,154 @@
+#ifndef ARENA_H_INCLUDED
+#define ARENA_H_INCLUDED
+
+//
+// arena
+// A bump allocator.  Memory is handed out from large blocks, by
+// moving a pointer forward, and is never freed one piece at a time.
+// Everything allocated from the arena is freed at once, when the
+// arena is reset, or destroyed.
+//
+// This suits things like decoded text, and DOM nodes, which are
+// made in large numbers, and all go away together.
+//
+// Typical usage:
+//   arena a;
+//   arena_init(&a, 0);
+//   unsigned char *p = (unsigned char *)arena_alloc(&a, 100);
+//   ...
+//   arena_destroy(&a);
+//
+
+#include <stdlib.h>     // malloc, free
+
+#include "pcoredef.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+// Each block has this header in front of its memory
+struct arena_block_t {
+    struct arena_block_t *fNext;
+    size_t fSize;               // bytes of memory after the header
+    size_t fUsed;
+};
+typedef struct arena_block_t arena_block;
+
+#define ARENA_HEADER_SIZE ((sizeof(arena_block) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+struct arena_t {
+    arena_block *fBlocks;       // the one being allocated from is first
+    size_t fBlockSize;
+    size_t fTotal;              // bytes handed out since the last reset
+};
+typedef struct arena_t arena;
+
+static int arena_init(arena *a, size_t blockSize) PC_NOEXCEPT_C;
+static int arena_destroy(arena *a) PC_NOEXCEPT_C;
+static int arena_reset(arena *a) PC_NOEXCEPT_C;
+static void * arena_alloc(arena *a, size_t n) PC_NOEXCEPT_C;
+static size_t arena_total(const arena *a) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+// arena_init()
+// A blockSize of 0 uses the default
+static int arena_init(arena *a, size_t blockSize) PC_NOEXCEPT_C
+{
+    a->fBlocks = nullptr;
+    a->fBlockSize = (blockSize == 0) ? ARENA_DEFAULT_BLOCK_SIZE : blockSize;
+    a->fTotal = 0;
+
+    return 0;
+}
+
+static int arena_destroy(arena *a) PC_NOEXCEPT_C
+{
+    arena_block *b = a->fBlocks;
+    while (b != nullptr) {
+        arena_block *next = b->fNext;
+        free(b);
+        b = next;
+    }
+
+    a->fBlocks = nullptr;
+    a->fTotal = 0;
+
+    return 0;
+}
+
+// arena_reset()
+// Free everything that was allocated.  The first block is kept,
+// so an arena that is used over and over does not go back to malloc()
+static int arena_reset(arena *a) PC_NOEXCEPT_C
+{
+    if (a->fBlocks == nullptr)
+        return 0;
+
+    arena_block *keep = a->fBlocks;
+    arena_block *b = keep->fNext;
+    while (b != nullptr) {
+        arena_block *next = b->fNext;
+        free(b);
+        b = next;
+    }
+
+    keep->fNext = nullptr;
+    keep->fUsed = 0;
+    a->fTotal = 0;
+
+    return 0;
+}
+
+static size_t arena_total(const arena *a) PC_NOEXCEPT_C { return a->fTotal; }
+
+// arena_alloc()
+// Allocate 'n' bytes, aligned to ARENA_ALIGNMENT
+// Returns nullptr if out of memory
+static void * arena_alloc(arena *a, size_t n) PC_NOEXCEPT_C
+{
+    size_t rounded = (n + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (rounded < n)
+        return nullptr;
+
+    arena_block *b = a->fBlocks;
+    if ((b == nullptr) || (b->fSize - b->fUsed < rounded))
+    {
+        // A new block, big enough for this allocation
+        size_t size = (rounded > a->fBlockSize) ? rounded : a->fBlockSize;
+        arena_block *newBlock = (arena_block *)malloc(ARENA_HEADER_SIZE + size);
+        if (newBlock == nullptr)
+            return nullptr;
+
+        newBlock->fSize = size;
+        newBlock->fUsed = 0;
+
+        // An oversized allocation gets a block of its own, which goes
+        // behind the current one, so what's left of that is not lost
+        if ((b != nullptr) && (rounded > a->fBlockSize)) {
+            newBlock->fNext = b->fNext;
+            b->fNext = newBlock;
+        } else {
+            newBlock->fNext = b;
+            a->fBlocks = newBlock;
+        }
+        b = newBlock;
+    }
+
+    void *p = (unsigned char *)b + ARENA_HEADER_SIZE + b->fUsed;
+    b->fUsed += rounded;
+    a->fTotal += rounded;
+
+    return p;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ARENA_H_INCLUDED
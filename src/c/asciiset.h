@@ -26,6 +26,7 @@
 
 #include <memory>
 #include "bithacks.h"
+#include "cpufeat.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +46,22 @@ extern "C" {
 // ASCII CONTROL	0x00 : 0x15
 // ASCII PRINTABLE 	0x16 : 0x7f
 // ASCII EXTENDED	0x80 : 0xff
+//
+// Layout of the bits
+// The 256 bits are not stored in the obvious 'byte c/8, bit c%8' order.  
+// Instead, they are arranged as two 16 byte tables, indexed by the low
+// nibble of the character.  The first table covers characters 0x00 - 0x7f,
+// the second 0x80 - 0xff, and the bit within the byte is the lower 3 bits
+// of the high nibble:
+//
+//   fBits[(c & 0x80 ? 16 : 0) + (c & 0x0f)] bit ((c >> 4) & 7)
+//
+// Testing a single character costs the same as it would with the
+// obvious layout, but the tables can be handed directly to a SIMD 
+// byte shuffle (pshufb), which classifies 16, 32, or 64 characters
+// at a time.  So, an asciiset is always ready to be used by the
+// asciiset_find_first_in/asciiset_find_first_not_in scanners
+// without any extra compilation step.
 
 #define ASCIISET_SIZE 32
 
@@ -53,6 +70,10 @@ struct asciiset_t {
 };
 typedef struct asciiset_t asciiset;
 
+// Where a character lives within the fBits table
+#define ASCIISET_INDEX(c) ((((c) >> 3) & 0x10) | ((c) & 0x0f))
+#define ASCIISET_BIT(c) ((unsigned char)(1u << (((c) >> 4) & 7)))
+
 static int is_control(unsigned char) PC_NOEXCEPT_C;
 static int is_digit(unsigned char) PC_NOEXCEPT_C;
 static int is_extended(unsigned char) PC_NOEXCEPT_C;
@@ -75,6 +96,9 @@ static int asciiset_remove_char(asciiset *cs, const unsigned char c) PC_NOEXCEPT
 static int asciiset_remove_chars(asciiset *cs, const char *cstr) PC_NOEXCEPT_C;
 static int asciiset_remove_set(asciiset *cs, const asciiset *b) PC_NOEXCEPT_C;
 
+static size_t asciiset_find_first_in(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C;
+static size_t asciiset_find_first_not_in(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C;
+
 
 // Implementation
 // convert a hex digit to a base 10 digit
@@ -118,22 +142,23 @@ static int asciiset_init_from_cstr(asciiset *cs, const char *cstr) PC_NOEXCEPT_C
 
 static int asciiset_contains_char(const asciiset *cs, const unsigned char c) PC_NOEXCEPT_C
 {
-	return bhak_get_bit_value(cs->fBits, ASCIISET_SIZE, c);
+	return (cs->fBits[ASCIISET_INDEX(c)] & ASCIISET_BIT(c)) != 0;
 }
 
 
 
 static int asciiset_remove_char(asciiset *cs, const unsigned char c) PC_NOEXCEPT_C
 {
-	return bhak_remove_bit_value(cs->fBits, ASCIISET_SIZE, c);
+	cs->fBits[ASCIISET_INDEX(c)] &= (unsigned char)~ASCIISET_BIT(c);
+	return 0;
 }
 
 static int asciiset_remove_chars(asciiset *cs, const char *cstr) PC_NOEXCEPT_C
 {
-    char *str = (char *)cstr;
+    const unsigned char *str = (const unsigned char *)cstr;
 	while (*str)
 	{
-		bhak_remove_bit_value(cs->fBits, ASCIISET_SIZE, *str);
+		asciiset_remove_char(cs, *str);
 		str++;
 	}
 
@@ -152,15 +177,16 @@ static int asciiset_remove_set(asciiset *cs, const asciiset *b) PC_NOEXCEPT_C
 
 static int asciiset_add_char(asciiset *cs, const unsigned char c) PC_NOEXCEPT_C
 {
-	return bhak_set_bit_value(cs->fBits, ASCIISET_SIZE, c);
+	cs->fBits[ASCIISET_INDEX(c)] |= ASCIISET_BIT(c);
+	return 0;
 }
 
 static int asciiset_add_cstr(asciiset *cs, const char *cstr) PC_NOEXCEPT_C
 {
-	char *str = (char *)cstr;
+	const unsigned char *str = (const unsigned char *)cstr;
 	while (*str)
 	{
-		bhak_set_bit_value(cs->fBits, ASCIISET_SIZE, *str);
+		asciiset_add_char(cs, *str);
 		str++;
 	}
     return 0;
@@ -170,6 +196,264 @@ static int asciiset_add_set(asciiset *a, const asciiset *b) PC_NOEXCEPT_C
 {
 	for (int i=0;i< ASCIISET_SIZE;i++)
 		a->fBits[i] |= b->fBits[i];
+
+	return 0;
+}
+
+
+//
+// Scanning
+// Find the first byte of a run of memory that is (or is not) in the set.
+// These are what the lexing routines use to skip whitespace, and
+// to find the end of tokens.
+//
+// The SIMD versions use the nibble layout of fBits directly as 
+// byte shuffle tables:
+//   rows = shuffle(fBits[0..15], c) | shuffle(fBits[16..31], c ^ 0x80)
+//   bit  = 1 << ((c >> 4) & 7)
+//   c is in the set if (rows & bit) != 0
+// The shuffle zeroes any byte whose index has the high bit set, which 
+// is what picks the right table for characters above 0x7f.
+//
+typedef size_t (*asciiset_scan_fn)(const asciiset *cs, const unsigned char *data, size_t n);
+
+struct asciiset_kernels_t {
+	asciiset_scan_fn fFindIn;
+	asciiset_scan_fn fFindNotIn;
+};
+typedef struct asciiset_kernels_t asciiset_kernels;
+
+// Portable versions
+static size_t asciiset_kern_find_in_scalar(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+	for (size_t i = 0; i < n; i++)
+		if (cs->fBits[ASCIISET_INDEX(data[i])] & ASCIISET_BIT(data[i]))
+			return i;
+	return n;
+}
+
+static size_t asciiset_kern_find_not_in_scalar(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+	for (size_t i = 0; i < n; i++)
+		if (!(cs->fBits[ASCIISET_INDEX(data[i])] & ASCIISET_BIT(data[i])))
+			return i;
+	return n;
+}
+
+#if defined(PC_ARCH_X86)
+// SSSE3 - 16 bytes at a time
+// Return a bitmask with a bit set for every byte that is in the set
+PC_TARGET_SSSE3
+static INLINE uint32_t asciiset_classify_ssse3(__m128i tbl0, __m128i tbl1, __m128i v) PC_NOEXCEPT_C
+{
+	const __m128i pow2 = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+	__m128i rows = _mm_or_si128(_mm_shuffle_epi8(tbl0, v), _mm_shuffle_epi8(tbl1, _mm_xor_si128(v, _mm_set1_epi8((char)0x80))));
+	__m128i bit = _mm_shuffle_epi8(pow2, hi);
+	__m128i hit = _mm_cmpeq_epi8(_mm_and_si128(rows, bit), bit);
+
+	return (uint32_t)_mm_movemask_epi8(hit);
+}
+
+PC_TARGET_SSSE3
+static size_t asciiset_kern_scan_ssse3(const asciiset *cs, const unsigned char *data, size_t n, uint32_t invert) PC_NOEXCEPT_C
+{
+	__m128i tbl0 = _mm_loadu_si128((const __m128i *)cs->fBits);
+	__m128i tbl1 = _mm_loadu_si128((const __m128i *)(cs->fBits + 16));
+	size_t i = 0;
+
+	while (i + 16 <= n) {
+		uint32_t m = (asciiset_classify_ssse3(tbl0, tbl1, _mm_loadu_si128((const __m128i *)(data + i))) ^ invert) & 0xffff;
+		if (m != 0)
+			return i + bhak_ctz32(m);
+		i += 16;
+	}
+
+	// The tail, by re-reading the last 16 bytes and ignoring 
+	// the ones we've already looked at
+	if ((i < n) && (n >= 16)) {
+		size_t base = n - 16;
+		uint32_t m = (asciiset_classify_ssse3(tbl0, tbl1, _mm_loadu_si128((const __m128i *)(data + base))) ^ invert) & 0xffff;
+		m &= 0xffffu << (i - base);
+		return (m != 0) ? base + bhak_ctz32(m) : n;
+	}
+
+	return i + (invert ? asciiset_kern_find_not_in_scalar(cs, data + i, n - i) : asciiset_kern_find_in_scalar(cs, data + i, n - i));
+}
+
+PC_TARGET_SSSE3
+static size_t asciiset_kern_find_in_ssse3(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+	return asciiset_kern_scan_ssse3(cs, data, n, 0);
+}
+
+PC_TARGET_SSSE3
+static size_t asciiset_kern_find_not_in_ssse3(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+	return asciiset_kern_scan_ssse3(cs, data, n, 0xffffffffu);
+}
+
+// AVX2 - 32 bytes at a time
+PC_TARGET_AVX2
+static INLINE uint32_t asciiset_classify_avx2(__m256i tbl0, __m256i tbl1, __m256i v) PC_NOEXCEPT_C
+{
+	const __m256i pow2 = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f));
+	__m256i rows = _mm256_or_si256(_mm256_shuffle_epi8(tbl0, v), _mm256_shuffle_epi8(tbl1, _mm256_xor_si256(v, _mm256_set1_epi8((char)0x80))));
+	__m256i bit = _mm256_shuffle_epi8(pow2, hi);
+	__m256i hit = _mm256_cmpeq_epi8(_mm256_and_si256(rows, bit), bit);
+
+	return (uint32_t)_mm256_movemask_epi8(hit);
+}
+
+PC_TARGET_AVX2
+static size_t asciiset_kern_scan_avx2(const asciiset *cs, const unsigned char *data, size_t n, uint32_t invert) PC_NOEXCEPT_C
+{
+	__m256i tbl0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)cs->fBits));
+	__m256i tbl1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(cs->fBits + 16)));
+	size_t i = 0;
+
+	while (i + 32 <= n) {
+		uint32_t m = asciiset_classify_avx2(tbl0, tbl1, _mm256_loadu_si256((const __m256i *)(data + i))) ^ invert;
+		if (m != 0)
+			return i + bhak_ctz32(m);
+		i += 32;
+	}
+
+	if ((i < n) && (n >= 32)) {
+		size_t base = n - 32;
+		uint32_t m = asciiset_classify_avx2(tbl0, tbl1, _mm256_loadu_si256((const __m256i *)(data + base))) ^ invert;
+		m &= 0xffffffffu << (i - base);
+		return (m != 0) ? base + bhak_ctz32(m) : n;
+	}
+
+	return i + asciiset_kern_scan_ssse3(cs, data + i, n - i, invert);
+}
+
+PC_TARGET_AVX2
+static size_t asciiset_kern_find_in_avx2(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+	return asciiset_kern_scan_avx2(cs, data, n, 0);
+}
+
+PC_TARGET_AVX2
+static size_t asciiset_kern_find_not_in_avx2(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+	return asciiset_kern_scan_avx2(cs, data, n, 0xffffffffu);
+}
+
+// AVX-512 - 64 bytes at a time, with masked loads for the tail
+PC_TARGET_AVX512BW
+static INLINE uint64_t asciiset_classify_avx512(__m512i tbl0, __m512i tbl1, __m512i v) PC_NOEXCEPT_C
+{
+	const __m512i pow2 = _mm512_broadcast_i32x4(_mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128));
+	__m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), _mm512_set1_epi8(0x0f));
+	__m512i rows = _mm512_or_si512(_mm512_shuffle_epi8(tbl0, v), _mm512_shuffle_epi8(tbl1, _mm512_xor_si512(v, _mm512_set1_epi8((char)0x80))));
+	__m512i bit = _mm512_shuffle_epi8(pow2, hi);
+
+	return _mm512_test_epi8_mask(rows, bit);
+}
+
+PC_TARGET_AVX512BW
+static size_t asciiset_kern_scan_avx512(const asciiset *cs, const unsigned char *data, size_t n, uint64_t invert) PC_NOEXCEPT_C
+{
+	__m512i tbl0 = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)cs->fBits));
+	__m512i tbl1 = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)(cs->fBits + 16)));
+	size_t i = 0;
+
+	while (i + 64 <= n) {
+		uint64_t m = asciiset_classify_avx512(tbl0, tbl1, _mm512_loadu_si512((const void *)(data + i))) ^ invert;
+		if (m != 0)
+			return i + bhak_ctz64(m);
+		i += 64;
+	}
+
+	if (i < n) {
+		uint64_t live = ((uint64_t)1 << (n - i)) - 1;
+		uint64_t m = (asciiset_classify_avx512(tbl0, tbl1, _mm512_maskz_loadu_epi8(live, data + i)) ^ invert) & live;
+		if (m != 0)
+			return i + bhak_ctz64(m);
+	}
+
+	return n;
+}
+
+PC_TARGET_AVX512BW
+static size_t asciiset_kern_find_in_avx512(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+	return asciiset_kern_scan_avx512(cs, data, n, 0);
+}
+
+PC_TARGET_AVX512BW
+static size_t asciiset_kern_find_not_in_avx512(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+	return asciiset_kern_scan_avx512(cs, data, n, ~(uint64_t)0);
+}
+#endif	// PC_ARCH_X86
+
+static asciiset_kernels asciiset_select_kernels() PC_NOEXCEPT_C
+{
+	asciiset_kernels k = { asciiset_kern_find_in_scalar, asciiset_kern_find_not_in_scalar };
+
+#if defined(PC_ARCH_X86)
+	if (pc_cpu_has(PC_CPU_AVX512BW)) {
+		k.fFindIn = asciiset_kern_find_in_avx512;
+		k.fFindNotIn = asciiset_kern_find_not_in_avx512;
+	} else if (pc_cpu_has(PC_CPU_AVX2)) {
+		k.fFindIn = asciiset_kern_find_in_avx2;
+		k.fFindNotIn = asciiset_kern_find_not_in_avx2;
+	} else if (pc_cpu_has(PC_CPU_SSSE3)) {
+		k.fFindIn = asciiset_kern_find_in_ssse3;
+		k.fFindNotIn = asciiset_kern_find_not_in_ssse3;
+	}
+#endif
+
+	return k;
+}
+
+static const asciiset_kernels * asciiset_get_kernels() PC_NOEXCEPT_C
+{
+	static const asciiset_kernels kernels = asciiset_select_kernels();
+
+	return &kernels;
+}
+
+// Runs shorter than this are checked a byte at a time.  Most 
+// whitespace runs are a single character, and it's not worth
+// setting up the vectors for that.
+#define ASCIISET_SMALL_SIZE 8
+
+// asciiset_find_first_in()
+// Return the offset of the first byte in 'data' that is
+// a member of the set, or 'n' if there is no such byte
+static size_t asciiset_find_first_in(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+	size_t i = 0;
+	for (; (i < n) && (i < ASCIISET_SMALL_SIZE); i++)
+		if (cs->fBits[ASCIISET_INDEX(data[i])] & ASCIISET_BIT(data[i]))
+			return i;
+
+	if (i == n)
+		return n;
+
+	return i + asciiset_get_kernels()->fFindIn(cs, data + i, n - i);
+}
+
+// asciiset_find_first_not_in()
+// Return the offset of the first byte in 'data' that is
+// NOT a member of the set, or 'n' if every byte is in the set
+static size_t asciiset_find_first_not_in(const asciiset *cs, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+	size_t i = 0;
+	for (; (i < n) && (i < ASCIISET_SMALL_SIZE); i++)
+		if (!(cs->fBits[ASCIISET_INDEX(data[i])] & ASCIISET_BIT(data[i])))
+			return i;
+
+	if (i == n)
+		return n;
+
+	return i + asciiset_get_kernels()->fFindNotIn(cs, data + i, n - i);
 }
 
 
@@ -1,6 +1,10 @@
 #ifndef BITHACKS_H_INCLUDED
 #define BITHACKS_H_INCLUDED
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -105,6 +109,84 @@ static int64_t bhak_sign_extend_u64(uint64_t val, int bit_count) PC_NOEXCEPT_C
     return ((int64_t)(val << (64 - bit_count))) >> (64 - bit_count);
 }
 
+// bhak_ctz32/bhak_ctz64
+// Count the trailing zero bits of a value.  This is how the
+// SIMD scanners turn a mask of matches into a byte offset.
+// The value must not be zero.
+static INLINE int bhak_ctz32(uint32_t x) PC_NOEXCEPT_C
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanForward(&idx, x);
+    return (int)idx;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+static INLINE int bhak_ctz64(uint64_t x) PC_NOEXCEPT_C
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanForward64(&idx, x);
+    return (int)idx;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// bhak_clz64
+// Count the leading zero bits of a value.
+// The value must not be zero.
+static INLINE int bhak_clz64(uint64_t x) PC_NOEXCEPT_C
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanReverse64(&idx, x);
+    return 63 - (int)idx;
+#else
+    return __builtin_clzll(x);
+#endif
+}
+
+// bhak_popcount64
+// Count the number of bits that are set
+static INLINE int bhak_popcount64(uint64_t x) PC_NOEXCEPT_C
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+
+// bhak_umul128
+// Full 64 x 64 bit multiply.  The low 64 bits of the product
+// are returned, and the high 64 bits are put in 'hi'
+static INLINE uint64_t bhak_umul128(uint64_t a, uint64_t b, uint64_t *hi) PC_NOEXCEPT_C
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128)a * b;
+    *hi = (uint64_t)(r >> 64);
+    return (uint64_t)r;
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return _umul128(a, b, hi);
+#else
+    uint64_t aLo = a & 0xffffffff, aHi = a >> 32;
+    uint64_t bLo = b & 0xffffffff, bHi = b >> 32;
+    uint64_t ll = aLo * bLo;
+    uint64_t lh = aLo * bHi;
+    uint64_t hl = aHi * bLo;
+    uint64_t hh = aHi * bHi;
+    uint64_t mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+    *hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    return (mid << 32) | (ll & 0xffffffff);
+#endif
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,6 +4,8 @@
 
 
 #include "pcoredef.h"
+#include "bithacks.h"
+#include "cpufeat.h"
 
 
 
@@ -81,6 +83,436 @@ extern "C" {
 	static int bspan_compare_span(const bspan * a, const bspan * b) PC_NOEXCEPT_C;
 
 
+	//
+	// Kernels
+	// The byte loops that sit underneath comparing, copying, and filling
+	// spans.  There is a portable version of each, plus versions for SSE2,
+	// AVX2, and AVX-512.  bspan_get_kernels() picks the best set the
+	// processor supports, once, the first time it is called.
+	//
+	// The copy kernels assume the source and destination do not overlap.
+	// Overlapping copies are handed to memmove() before we get here.
+	//
+	typedef int (*bspan_compare_fn)(const unsigned char *a, const unsigned char *b, size_t n);
+	typedef void (*bspan_copy_fn)(unsigned char *dst, const unsigned char *src, size_t n);
+	typedef void (*bspan_set_fn)(unsigned char *dst, unsigned char c, size_t n);
+
+	struct bspan_kernels_t {
+		bspan_compare_fn fCompare;
+		bspan_copy_fn fCopy;
+		bspan_set_fn fSet;
+	};
+	typedef struct bspan_kernels_t bspan_kernels;
+
+	// Copies larger than this bypass the cache with streaming stores,
+	// as the destination is not going to fit in the cache anyway.
+	#define BSPAN_STREAM_THRESHOLD ((size_t)1 << 22)
+
+	// Portable versions
+	// The C library versions of these are already as good as it gets
+	// when we don't know anything about the processor.
+	static int bspan_kern_compare_scalar(const unsigned char *a, const unsigned char *b, size_t n) PC_NOEXCEPT_C
+	{
+		int res = memcmp(a, b, n);
+		return (res < 0) ? -1 : ((res > 0) ? 1 : 0);
+	}
+
+	static void bspan_kern_copy_scalar(unsigned char *dst, const unsigned char *src, size_t n) PC_NOEXCEPT_C
+	{
+		memcpy(dst, src, n);
+	}
+
+	static void bspan_kern_set_scalar(unsigned char *dst, unsigned char c, size_t n) PC_NOEXCEPT_C
+	{
+		memset(dst, c, n);
+	}
+
+	// Copy less than 16 bytes, using overlapping
+	// loads and stores rather than a byte loop
+	static INLINE void bspan_kern_copy_small(unsigned char *dst, const unsigned char *src, size_t n) PC_NOEXCEPT_C
+	{
+		if (n >= 8) {
+			uint64_t head, tail;
+			memcpy(&head, src, 8);
+			memcpy(&tail, src + n - 8, 8);
+			memcpy(dst, &head, 8);
+			memcpy(dst + n - 8, &tail, 8);
+		} else if (n >= 4) {
+			uint32_t head, tail;
+			memcpy(&head, src, 4);
+			memcpy(&tail, src + n - 4, 4);
+			memcpy(dst, &head, 4);
+			memcpy(dst + n - 4, &tail, 4);
+		} else {
+			for (size_t i = 0; i < n; i++)
+				dst[i] = src[i];
+		}
+	}
+
+	static INLINE void bspan_kern_set_small(unsigned char *dst, unsigned char c, size_t n) PC_NOEXCEPT_C
+	{
+		if (n >= 8) {
+			uint64_t v = 0x0101010101010101ULL * c;
+			memcpy(dst, &v, 8);
+			memcpy(dst + n - 8, &v, 8);
+		} else {
+			for (size_t i = 0; i < n; i++)
+				dst[i] = c;
+		}
+	}
+
+	// Given the offset of the first byte that differs
+	// return the ordering of the two spans
+	static INLINE int bspan_kern_order_at(const unsigned char *a, const unsigned char *b, size_t i) PC_NOEXCEPT_C
+	{
+		return (a[i] < b[i]) ? -1 : 1;
+	}
+
+#if defined(PC_ARCH_X86)
+	//
+	// SSE2 - 16 bytes at a time
+	//
+	PC_TARGET_SSE2
+	static int bspan_kern_compare_sse2(const unsigned char *a, const unsigned char *b, size_t n) PC_NOEXCEPT_C
+	{
+		size_t i = 0;
+
+		// Check 64 bytes per turn, only looking for the exact
+		// position once we know there is a difference
+		while (i + 64 <= n) {
+			__m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+			__m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 16)), _mm_loadu_si128((const __m128i *)(b + i + 16)));
+			__m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 32)), _mm_loadu_si128((const __m128i *)(b + i + 32)));
+			__m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 48)), _mm_loadu_si128((const __m128i *)(b + i + 48)));
+			__m128i all = _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+			if (_mm_movemask_epi8(all) != 0xffff)
+				break;
+			i += 64;
+		}
+
+		while (i + 16 <= n) {
+			__m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+			uint32_t neq = ~(uint32_t)_mm_movemask_epi8(eq) & 0xffff;
+			if (neq != 0)
+				return bspan_kern_order_at(a, b, i + bhak_ctz32(neq));
+			i += 16;
+		}
+
+		for (; i < n; i++) {
+			if (a[i] != b[i])
+				return bspan_kern_order_at(a, b, i);
+		}
+
+		return 0;
+	}
+
+	PC_TARGET_SSE2
+	static void bspan_kern_copy_sse2(unsigned char *dst, const unsigned char *src, size_t n) PC_NOEXCEPT_C
+	{
+		if (n < 16) {
+			bspan_kern_copy_small(dst, src, n);
+			return;
+		}
+
+		size_t i = 0;
+		while (i + 64 <= n) {
+			__m128i v0 = _mm_loadu_si128((const __m128i *)(src + i));
+			__m128i v1 = _mm_loadu_si128((const __m128i *)(src + i + 16));
+			__m128i v2 = _mm_loadu_si128((const __m128i *)(src + i + 32));
+			__m128i v3 = _mm_loadu_si128((const __m128i *)(src + i + 48));
+			_mm_storeu_si128((__m128i *)(dst + i), v0);
+			_mm_storeu_si128((__m128i *)(dst + i + 16), v1);
+			_mm_storeu_si128((__m128i *)(dst + i + 32), v2);
+			_mm_storeu_si128((__m128i *)(dst + i + 48), v3);
+			i += 64;
+		}
+		while (i + 16 <= n) {
+			_mm_storeu_si128((__m128i *)(dst + i), _mm_loadu_si128((const __m128i *)(src + i)));
+			i += 16;
+		}
+
+		// The last 16 bytes, overlapping what has already been written
+		if (i < n)
+			_mm_storeu_si128((__m128i *)(dst + n - 16), _mm_loadu_si128((const __m128i *)(src + n - 16)));
+	}
+
+	PC_TARGET_SSE2
+	static void bspan_kern_set_sse2(unsigned char *dst, unsigned char c, size_t n) PC_NOEXCEPT_C
+	{
+		if (n < 16) {
+			bspan_kern_set_small(dst, c, n);
+			return;
+		}
+
+		__m128i v = _mm_set1_epi8((char)c);
+		size_t i = 0;
+		while (i + 64 <= n) {
+			_mm_storeu_si128((__m128i *)(dst + i), v);
+			_mm_storeu_si128((__m128i *)(dst + i + 16), v);
+			_mm_storeu_si128((__m128i *)(dst + i + 32), v);
+			_mm_storeu_si128((__m128i *)(dst + i + 48), v);
+			i += 64;
+		}
+		while (i + 16 <= n) {
+			_mm_storeu_si128((__m128i *)(dst + i), v);
+			i += 16;
+		}
+		if (i < n)
+			_mm_storeu_si128((__m128i *)(dst + n - 16), v);
+	}
+
+	//
+	// AVX2 - 32 bytes at a time
+	//
+	PC_TARGET_AVX2
+	static int bspan_kern_compare_avx2(const unsigned char *a, const unsigned char *b, size_t n) PC_NOEXCEPT_C
+	{
+		size_t i = 0;
+
+		while (i + 128 <= n) {
+			__m256i e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+			__m256i e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 32)), _mm256_loadu_si256((const __m256i *)(b + i + 32)));
+			__m256i e2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 64)), _mm256_loadu_si256((const __m256i *)(b + i + 64)));
+			__m256i e3 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 96)), _mm256_loadu_si256((const __m256i *)(b + i + 96)));
+			__m256i all = _mm256_and_si256(_mm256_and_si256(e0, e1), _mm256_and_si256(e2, e3));
+			if ((uint32_t)_mm256_movemask_epi8(all) != 0xffffffffu)
+				break;
+			i += 128;
+		}
+
+		while (i + 32 <= n) {
+			__m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+			uint32_t neq = ~(uint32_t)_mm256_movemask_epi8(eq);
+			if (neq != 0)
+				return bspan_kern_order_at(a, b, i + bhak_ctz32(neq));
+			i += 32;
+		}
+
+		return bspan_kern_compare_sse2(a + i, b + i, n - i);
+	}
+
+	PC_TARGET_AVX2
+	static void bspan_kern_copy_avx2(unsigned char *dst, const unsigned char *src, size_t n) PC_NOEXCEPT_C
+	{
+		if (n < 32) {
+			bspan_kern_copy_sse2(dst, src, n);
+			return;
+		}
+
+		size_t i = 0;
+
+		// Really big copies go around the cache.  Write one unaligned 
+		// vector, then continue from the first aligned destination address
+		if (n >= BSPAN_STREAM_THRESHOLD) {
+			_mm256_storeu_si256((__m256i *)dst, _mm256_loadu_si256((const __m256i *)src));
+			i = 32 - ((uintptr_t)dst & 31);
+			while (i + 128 <= n) {
+				__m256i v0 = _mm256_loadu_si256((const __m256i *)(src + i));
+				__m256i v1 = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+				__m256i v2 = _mm256_loadu_si256((const __m256i *)(src + i + 64));
+				__m256i v3 = _mm256_loadu_si256((const __m256i *)(src + i + 96));
+				_mm256_stream_si256((__m256i *)(dst + i), v0);
+				_mm256_stream_si256((__m256i *)(dst + i + 32), v1);
+				_mm256_stream_si256((__m256i *)(dst + i + 64), v2);
+				_mm256_stream_si256((__m256i *)(dst + i + 96), v3);
+				i += 128;
+			}
+			_mm_sfence();
+		}
+
+		while (i + 128 <= n) {
+			__m256i v0 = _mm256_loadu_si256((const __m256i *)(src + i));
+			__m256i v1 = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+			__m256i v2 = _mm256_loadu_si256((const __m256i *)(src + i + 64));
+			__m256i v3 = _mm256_loadu_si256((const __m256i *)(src + i + 96));
+			_mm256_storeu_si256((__m256i *)(dst + i), v0);
+			_mm256_storeu_si256((__m256i *)(dst + i + 32), v1);
+			_mm256_storeu_si256((__m256i *)(dst + i + 64), v2);
+			_mm256_storeu_si256((__m256i *)(dst + i + 96), v3);
+			i += 128;
+		}
+		while (i + 32 <= n) {
+			_mm256_storeu_si256((__m256i *)(dst + i), _mm256_loadu_si256((const __m256i *)(src + i)));
+			i += 32;
+		}
+		if (i < n)
+			_mm256_storeu_si256((__m256i *)(dst + n - 32), _mm256_loadu_si256((const __m256i *)(src + n - 32)));
+	}
+
+	PC_TARGET_AVX2
+	static void bspan_kern_set_avx2(unsigned char *dst, unsigned char c, size_t n) PC_NOEXCEPT_C
+	{
+		if (n < 32) {
+			bspan_kern_set_sse2(dst, c, n);
+			return;
+		}
+
+		__m256i v = _mm256_set1_epi8((char)c);
+		size_t i = 0;
+
+		if (n >= BSPAN_STREAM_THRESHOLD) {
+			_mm256_storeu_si256((__m256i *)dst, v);
+			i = 32 - ((uintptr_t)dst & 31);
+			while (i + 128 <= n) {
+				_mm256_stream_si256((__m256i *)(dst + i), v);
+				_mm256_stream_si256((__m256i *)(dst + i + 32), v);
+				_mm256_stream_si256((__m256i *)(dst + i + 64), v);
+				_mm256_stream_si256((__m256i *)(dst + i + 96), v);
+				i += 128;
+			}
+			_mm_sfence();
+		}
+
+		while (i + 128 <= n) {
+			_mm256_storeu_si256((__m256i *)(dst + i), v);
+			_mm256_storeu_si256((__m256i *)(dst + i + 32), v);
+			_mm256_storeu_si256((__m256i *)(dst + i + 64), v);
+			_mm256_storeu_si256((__m256i *)(dst + i + 96), v);
+			i += 128;
+		}
+		while (i + 32 <= n) {
+			_mm256_storeu_si256((__m256i *)(dst + i), v);
+			i += 32;
+		}
+		if (i < n)
+			_mm256_storeu_si256((__m256i *)(dst + n - 32), v);
+	}
+
+	//
+	// AVX-512 - 64 bytes at a time
+	// Masked loads and stores take care of the tails, so there
+	// is never a byte loop.
+	//
+	static INLINE uint64_t bspan_kern_tail_mask(size_t n) PC_NOEXCEPT_C
+	{
+		return (n >= 64) ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1);
+	}
+
+	PC_TARGET_AVX512BW
+	static int bspan_kern_compare_avx512(const unsigned char *a, const unsigned char *b, size_t n) PC_NOEXCEPT_C
+	{
+		size_t i = 0;
+
+		while (i + 64 <= n) {
+			uint64_t neq = _mm512_cmpneq_epu8_mask(_mm512_loadu_si512((const void *)(a + i)), _mm512_loadu_si512((const void *)(b + i)));
+			if (neq != 0)
+				return bspan_kern_order_at(a, b, i + bhak_ctz64(neq));
+			i += 64;
+		}
+
+		if (i < n) {
+			__mmask64 live = bspan_kern_tail_mask(n - i);
+			__m512i va = _mm512_maskz_loadu_epi8(live, a + i);
+			__m512i vb = _mm512_maskz_loadu_epi8(live, b + i);
+			uint64_t neq = _mm512_mask_cmpneq_epu8_mask(live, va, vb);
+			if (neq != 0)
+				return bspan_kern_order_at(a, b, i + bhak_ctz64(neq));
+		}
+
+		return 0;
+	}
+
+	PC_TARGET_AVX512BW
+	static void bspan_kern_copy_avx512(unsigned char *dst, const unsigned char *src, size_t n) PC_NOEXCEPT_C
+	{
+		size_t i = 0;
+
+		if (n >= BSPAN_STREAM_THRESHOLD) {
+			_mm512_storeu_si512((void *)dst, _mm512_loadu_si512((const void *)src));
+			i = 64 - ((uintptr_t)dst & 63);
+			while (i + 128 <= n) {
+				__m512i v0 = _mm512_loadu_si512((const void *)(src + i));
+				__m512i v1 = _mm512_loadu_si512((const void *)(src + i + 64));
+				_mm512_stream_si512((__m512i *)(dst + i), v0);
+				_mm512_stream_si512((__m512i *)(dst + i + 64), v1);
+				i += 128;
+			}
+			_mm_sfence();
+		}
+
+		while (i + 128 <= n) {
+			__m512i v0 = _mm512_loadu_si512((const void *)(src + i));
+			__m512i v1 = _mm512_loadu_si512((const void *)(src + i + 64));
+			_mm512_storeu_si512((void *)(dst + i), v0);
+			_mm512_storeu_si512((void *)(dst + i + 64), v1);
+			i += 128;
+		}
+		while (i < n) {
+			__mmask64 live = bspan_kern_tail_mask(n - i);
+			_mm512_mask_storeu_epi8(dst + i, live, _mm512_maskz_loadu_epi8(live, src + i));
+			i += 64;
+		}
+	}
+
+	PC_TARGET_AVX512BW
+	static void bspan_kern_set_avx512(unsigned char *dst, unsigned char c, size_t n) PC_NOEXCEPT_C
+	{
+		__m512i v = _mm512_set1_epi8((char)c);
+		size_t i = 0;
+
+		if (n >= BSPAN_STREAM_THRESHOLD) {
+			_mm512_storeu_si512((void *)dst, v);
+			i = 64 - ((uintptr_t)dst & 63);
+			while (i + 128 <= n) {
+				_mm512_stream_si512((__m512i *)(dst + i), v);
+				_mm512_stream_si512((__m512i *)(dst + i + 64), v);
+				i += 128;
+			}
+			_mm_sfence();
+		}
+
+		while (i + 128 <= n) {
+			_mm512_storeu_si512((void *)(dst + i), v);
+			_mm512_storeu_si512((void *)(dst + i + 64), v);
+			i += 128;
+		}
+		while (i < n) {
+			_mm512_mask_storeu_epi8(dst + i, bspan_kern_tail_mask(n - i), v);
+			i += 64;
+		}
+	}
+#endif	// PC_ARCH_X86
+
+	// bspan_select_kernels()
+	// Decide which set of kernels to use, based on
+	// what the processor can do
+	static bspan_kernels bspan_select_kernels() PC_NOEXCEPT_C
+	{
+		bspan_kernels k = { bspan_kern_compare_scalar, bspan_kern_copy_scalar, bspan_kern_set_scalar };
+
+#if defined(PC_ARCH_X86)
+		if (pc_cpu_has(PC_CPU_AVX512BW)) {
+			k.fCompare = bspan_kern_compare_avx512;
+			k.fCopy = bspan_kern_copy_avx512;
+			k.fSet = bspan_kern_set_avx512;
+		} else if (pc_cpu_has(PC_CPU_AVX2)) {
+			k.fCompare = bspan_kern_compare_avx2;
+			k.fCopy = bspan_kern_copy_avx2;
+			k.fSet = bspan_kern_set_avx2;
+		} else if (pc_cpu_has(PC_CPU_SSE2)) {
+			k.fCompare = bspan_kern_compare_sse2;
+			k.fCopy = bspan_kern_copy_sse2;
+			k.fSet = bspan_kern_set_sse2;
+		}
+#endif
+
+		return k;
+	}
+
+	// bspan_get_kernels()
+	// The kernels in use.  The selection happens once, and is
+	// safe to race on from multiple threads.
+	static const bspan_kernels * bspan_get_kernels() PC_NOEXCEPT_C
+	{
+		static const bspan_kernels kernels = bspan_select_kernels();
+
+		return &kernels;
+	}
+
+	// Small spans, like tokens and tag names, are not worth the indirect call
+	#define BSPAN_SMALL_SIZE 16
+
+
 	// Common functions
 	// bspan_reset()
 	// Set the span to an unused state
@@ -161,15 +593,17 @@ static int bspan_set_end(bspan *a, const void *pt) PC_NOEXCEPT_C
 	// set all bytes in the span to the specified value
 	static int bspan_set_all(bspan *bs, const unsigned char c) PC_NOEXCEPT_C
 	{
-
 		unsigned char *startAt = (unsigned char *)bs->fStart;
-		const unsigned char *endAt = bs->fEnd;
+		size_t sz = bspan_size(bs);
 
-		while (startAt < endAt)
-		{
-			*startAt = c;
-			startAt++;
+		if (sz < BSPAN_SMALL_SIZE) {
+			bspan_kern_set_small(startAt, c, sz);
+			return 0;
 		}
+
+		bspan_get_kernels()->fSet(startAt, c, sz);
+
+		return 0;
 	}
 
 	// bspan_size()
@@ -198,21 +632,34 @@ static int bspan_set_end(bspan *a, const void *pt) PC_NOEXCEPT_C
 	static unsigned char bspan_back(const bspan *bs) PC_NOEXCEPT_C {if (bspan_is_valid(bs) && (bs->fEnd > bs->fStart) ) return *(bs->fEnd-1); return 0;}
 	
 	// Byte Comparison operations
+	// bspan_compare_span()
+	// Lexicographic comparison of the bytes of two spans
+	// Return
+	//  -1  'a' is less than 'b'
+	//   0  the spans hold the same bytes
+	//   1  'a' is greater than 'b'
 	static int bspan_compare_span(const bspan * a, const bspan * b) PC_NOEXCEPT_C
 	{
 		const unsigned char *cs = bspan_begin(a);
 		const unsigned char *ct = bspan_begin(b);
 
-		ptrdiff_t maxN = bspan_size(a) < bspan_size(b) ? bspan_size(a) : bspan_size(b);
+		size_t maxN = bspan_size(a) < bspan_size(b) ? bspan_size(a) : bspan_size(b);
 
-		for (int i=0;i<maxN;i++,cs++,ct++)
-		{
-			if (*cs < *ct)
-				return -1;
-			if (*ct > *ct)
-				return 1;
+		int res = 0;
+		if (maxN < BSPAN_SMALL_SIZE) {
+			for (size_t i=0; i<maxN; i++) {
+				if (cs[i] != ct[i]) {
+					res = bspan_kern_order_at(cs, ct, i);
+					break;
+				}
+			}
+		} else {
+			res = bspan_get_kernels()->fCompare(cs, ct, maxN);
 		}
 
+		if (res != 0)
+			return res;
+
 		// We've gotten through the loop
 		// so thus far, all bytes are the same
 		// we can further constrain by seeing if we've
@@ -279,12 +726,20 @@ static int bspan_set_end(bspan *a, const void *pt) PC_NOEXCEPT_C
 		const unsigned char *srcAt = bspan_begin(b);
 		unsigned char *dstAt = (unsigned char *)bspan_begin(a);
 
-		for (int i=0;i<maxBytes;i++){
-			*dstAt = *srcAt;
-			dstAt++;
-			srcAt++;
+		if (maxBytes == 0)
+			return 0;
+
+		// The spans might be over the same memory
+		if ((dstAt < srcAt + maxBytes) && (srcAt < dstAt + maxBytes)) {
+			memmove(dstAt, srcAt, maxBytes);
+			return maxBytes;
 		}
 
+		if (maxBytes < BSPAN_SMALL_SIZE)
+			bspan_kern_copy_small(dstAt, srcAt, maxBytes);
+		else
+			bspan_get_kernels()->fCopy(dstAt, srcAt, maxBytes);
+
 		return maxBytes;
 	}
 #ifdef __cplusplus
@@ -0,0 +1,724 @@
+#ifndef CONVFLOAT_H_INCLUDED
+#define CONVFLOAT_H_INCLUDED
+
+//
+// convfloat
+// Turn decimal text into correctly rounded floating point numbers.
+// The result is always the floating point value nearest to the
+// decimal value of the text (ties go to even), exactly what strtod()
+// would give, only a lot faster.
+//
+// There are three ways a number can be converted, tried in order
+//   Clinger's fast path - if the digits fit in the mantissa, and the
+//     power of ten is exactly representable, a single multiply or divide
+//     is correctly rounded.
+//   Eisel-Lemire - the digits (up to 19 of them) are multiplied by a
+//     128-bit approximation of the power of ten (convpow5.h), which
+//     is always enough to determine the correct rounding.
+//   Exact comparison - when there are more than 19 digits, the first 19
+//     are converted, and if the digits that were left off could change
+//     the rounding, the whole decimal value is compared against the
+//     halfway point between the two candidates, using big integers.
+//     This is rare, it only happens when a number has more than 19
+//     significant digits, and is very close to a halfway point.
+//
+// "inf", "infinity" and "nan" (any case, with an optional sign) are
+// also accepted.
+//
+// The conversion is parameterized by a conv_float_format, so the same
+// code produces both double and float values.
+//
+// Reference: Daniel Lemire, "Number Parsing at a Gigabyte per Second"
+// Software: Practice and Experience 51 (8), 2021
+//
+
+#include <math.h>       // HUGE_VAL, HUGE_VALF, NAN
+
+#include "pcoredef.h"
+#include "bithacks.h"
+#include "convpow5.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The parameters of a binary floating point format
+struct conv_float_format_t {
+    int fMantissaBits;          // explicit bits of mantissa
+    int fMinimumExponent;       // minus the exponent bias
+    int fInfinitePower;         // biased exponent of infinity
+    int fSignBit;
+    int fSmallestPow10;         // anything with a smaller power of 10 is zero
+    int fLargestPow10;          // anything with a larger power of 10 is infinite
+    int fMinRoundToEven;        // powers of 10 where a product can be exactly
+    int fMaxRoundToEven;        // halfway, and must round to even
+    int fMaxFastPow10;          // largest exactly representable power of 10
+    uint64_t fMaxFastMantissa;  // largest exactly representable integer
+};
+typedef struct conv_float_format_t conv_float_format;
+
+static const conv_float_format conv_double_format = { 52, -1023, 0x7ff, 63, -342, 308, -4, 23, 22, (uint64_t)2 << 52 };
+static const conv_float_format conv_float32_format = { 23, -127, 0xff, 31, -64, 38, -17, 10, 10, (uint64_t)2 << 23 };
+
+// A decimal number, as it was found in the text
+struct conv_decimal_t {
+    uint64_t fMantissa;         // the first 19 significant digits
+    int64_t fExponent;          // power of 10 to go with fMantissa
+    int64_t fExplicitExponent;  // the number after the 'e'
+    bool fNegative;
+    bool fTooManyDigits;        // fMantissa does not hold all the digits
+
+    const unsigned char *fIntStart;
+    const unsigned char *fIntEnd;
+    const unsigned char *fFracStart;
+    const unsigned char *fFracEnd;
+};
+typedef struct conv_decimal_t conv_decimal;
+
+// A binary floating point value, before it's packed into bits
+// fPower2 is the biased exponent
+struct conv_adjusted_t {
+    uint64_t fMantissa;
+    int32_t fPower2;
+};
+typedef struct conv_adjusted_t conv_adjusted;
+
+static int conv_parse_decimal(const unsigned char *p, const unsigned char *pend, conv_decimal *d, const unsigned char **endp) PC_NOEXCEPT_C;
+static uint64_t conv_decimal_to_bits(const conv_float_format *f, const conv_decimal *d) PC_NOEXCEPT_C;
+static int conv_parse_double(const unsigned char *p, const unsigned char *pend, double *v, const unsigned char **endp) PC_NOEXCEPT_C;
+static int conv_parse_float(const unsigned char *p, const unsigned char *pend, float *v, const unsigned char **endp) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+static INLINE bool conv_is_digit(unsigned char c) PC_NOEXCEPT_C { return (unsigned char)(c - '0') < 10; }
+
+// conv_is_8digits()
+// Are all 8 bytes of the (little endian) word ASCII digits?
+static INLINE bool conv_is_8digits(uint64_t val) PC_NOEXCEPT_C
+{
+    return (((val & 0xF0F0F0F0F0F0F0F0ULL) | (((val + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL);
+}
+
+// conv_parse_8digits()
+// Turn 8 ASCII digits, loaded as a little endian word, into their value.
+// Pairs of digits are combined, then pairs of pairs, then the two halves.
+static INLINE uint32_t conv_parse_8digits(uint64_t val) PC_NOEXCEPT_C
+{
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t mul1 = 0x000F424000000064ULL;    // 100 + (1000000 << 32)
+    const uint64_t mul2 = 0x0000271000000001ULL;    // 1 + (10000 << 32)
+
+    val -= 0x3030303030303030ULL;
+    val = (val * 10) + (val >> 8);
+    val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+
+    return (uint32_t)val;
+}
+
+// conv_read_u64_le()
+// Load 8 bytes as a little endian word
+static INLINE uint64_t conv_read_u64_le(const unsigned char *p) PC_NOEXCEPT_C
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    if (bhak_isBE())
+        v = ((uint64_t)p[0]) | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+            ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+    return v;
+}
+
+// conv_accumulate_digits()
+// Add the digits at 'p' onto 'i'.  This can wrap around, in which case
+// the caller must not use 'i'.  Returns where the digits ended.
+static INLINE const unsigned char * conv_accumulate_digits(const unsigned char *p, const unsigned char *pend, uint64_t *i) PC_NOEXCEPT_C
+{
+    uint64_t v = *i;
+
+    while (pend - p >= 8)
+    {
+        uint64_t word = conv_read_u64_le(p);
+        if (!conv_is_8digits(word))
+            break;
+        v = (v * 100000000ULL) + conv_parse_8digits(word);
+        p += 8;
+    }
+
+    while ((p < pend) && conv_is_digit(*p)) {
+        v = (v * 10) + (uint64_t)(*p - '0');
+        p++;
+    }
+
+    *i = v;
+
+    return p;
+}
+
+// conv_parse_decimal()
+// Pick apart the text of a number:  [+-]digits[.digits][(e|E)[+-]digits]
+// Either the integer, or the fractional part, can be left out, but not
+// both.  If the 'e' is not followed by a number, the number ends before
+// the 'e', so units such as "12em" work.
+// Return
+//    0 - success, 'endp' is set to just past the number
+//   -1 - not a number
+static int conv_parse_decimal(const unsigned char *p, const unsigned char *pend, conv_decimal *d, const unsigned char **endp) PC_NOEXCEPT_C
+{
+    d->fNegative = false;
+    d->fTooManyDigits = false;
+    d->fExplicitExponent = 0;
+
+    if ((p < pend) && ((*p == '-') || (*p == '+'))) {
+        d->fNegative = (*p == '-');
+        p++;
+    }
+
+    uint64_t i = 0;
+    d->fIntStart = p;
+    p = conv_accumulate_digits(p, pend, &i);
+    d->fIntEnd = p;
+
+    int64_t digitCount = d->fIntEnd - d->fIntStart;
+    int64_t exponent = 0;
+
+    d->fFracStart = p;
+    d->fFracEnd = p;
+    if ((p < pend) && (*p == '.'))
+    {
+        p++;
+        d->fFracStart = p;
+        p = conv_accumulate_digits(p, pend, &i);
+        d->fFracEnd = p;
+
+        exponent = d->fFracStart - d->fFracEnd;
+        digitCount -= exponent;
+    }
+
+    if (digitCount == 0)
+        return -1;
+
+    if ((p < pend) && ((*p == 'e') || (*p == 'E')))
+    {
+        const unsigned char *locationOfE = p;
+        bool negExp = false;
+
+        p++;
+        if ((p < pend) && ((*p == '-') || (*p == '+'))) {
+            negExp = (*p == '-');
+            p++;
+        }
+
+        if ((p >= pend) || !conv_is_digit(*p)) {
+            p = locationOfE;
+        } else {
+            int64_t expNumber = 0;
+            while ((p < pend) && conv_is_digit(*p)) {
+                // Anything this large is zero or infinite anyway
+                if (expNumber < 0x10000000)
+                    expNumber = (expNumber * 10) + (*p - '0');
+                p++;
+            }
+            d->fExplicitExponent = negExp ? -expNumber : expNumber;
+            exponent += d->fExplicitExponent;
+        }
+    }
+
+    *endp = p;
+
+    // More than 19 digits might not fit, but leading zeros don't count
+    if (digitCount > 19)
+    {
+        const unsigned char *start = d->fIntStart;
+        while ((start != d->fFracEnd) && ((*start == '0') || (*start == '.'))) {
+            if (*start == '0')
+                digitCount--;
+            start++;
+        }
+
+        if (digitCount > 19)
+        {
+            // Keep just the first 19 significant digits
+            const uint64_t minimalNineteenDigits = 1000000000000000000ULL;
+            d->fTooManyDigits = true;
+            i = 0;
+
+            const unsigned char *q = d->fIntStart;
+            while ((i < minimalNineteenDigits) && (q != d->fIntEnd)) {
+                i = (i * 10) + (uint64_t)(*q - '0');
+                q++;
+            }
+
+            if (i >= minimalNineteenDigits) {
+                exponent = (d->fIntEnd - q) + d->fExplicitExponent;
+            } else {
+                q = d->fFracStart;
+                while ((i < minimalNineteenDigits) && (q != d->fFracEnd)) {
+                    i = (i * 10) + (uint64_t)(*q - '0');
+                    q++;
+                }
+                exponent = (d->fFracStart - q) + d->fExplicitExponent;
+            }
+        }
+    }
+
+    d->fMantissa = i;
+    d->fExponent = exponent;
+
+    return 0;
+}
+
+// conv_power()
+// floor(log2(10^q)) + 63, for the range of the table
+static INLINE int32_t conv_power(int32_t q) PC_NOEXCEPT_C
+{
+    return (((152170 + 65536) * q) >> 16) + 63;
+}
+
+// conv_compute_float()
+// Eisel-Lemire.  The correctly rounded binary value of w * 10^q.
+static conv_adjusted conv_compute_float(const conv_float_format *f, int64_t q, uint64_t w) PC_NOEXCEPT_C
+{
+    conv_adjusted answer;
+
+    if ((w == 0) || (q < f->fSmallestPow10)) {
+        answer.fPower2 = 0;
+        answer.fMantissa = 0;
+        return answer;
+    }
+
+    if (q > f->fLargestPow10) {
+        answer.fPower2 = f->fInfinitePower;
+        answer.fMantissa = 0;
+        return answer;
+    }
+
+    int lz = bhak_clz64(w);
+    w <<= lz;
+
+    // Multiply by the 128-bit power of five.  The second half of the
+    // product is only needed when the bits that will be shifted out
+    // of the first half are all ones.
+    size_t index = 2 * (size_t)(q - CONV_POW5_SMALLEST);
+    uint64_t hi = 0;
+    uint64_t lo = bhak_umul128(w, conv_pow5_128[index], &hi);
+    uint64_t precisionMask = 0xFFFFFFFFFFFFFFFFULL >> (f->fMantissaBits + 3);
+    if ((hi & precisionMask) == precisionMask)
+    {
+        uint64_t hi2 = 0;
+        bhak_umul128(w, conv_pow5_128[index + 1], &hi2);
+        lo += hi2;
+        if (hi2 > lo)
+            hi++;
+    }
+
+    int upperbit = (int)(hi >> 63);
+    int shift = upperbit + 64 - f->fMantissaBits - 3;
+
+    answer.fMantissa = hi >> shift;
+    answer.fPower2 = conv_power((int32_t)q) + upperbit - lz - f->fMinimumExponent;
+
+    // Subnormal
+    if (answer.fPower2 <= 0)
+    {
+        if (-answer.fPower2 + 1 >= 64) {
+            answer.fPower2 = 0;
+            answer.fMantissa = 0;
+            return answer;
+        }
+
+        answer.fMantissa >>= -answer.fPower2 + 1;
+        answer.fMantissa += (answer.fMantissa & 1);
+        answer.fMantissa >>= 1;
+
+        // Rounding up can turn it into the smallest normal number
+        answer.fPower2 = (answer.fMantissa < ((uint64_t)1 << f->fMantissaBits)) ? 0 : 1;
+        return answer;
+    }
+
+    // Exactly halfway between two values, round to even
+    if ((lo <= 1) && (q >= f->fMinRoundToEven) && (q <= f->fMaxRoundToEven) && ((answer.fMantissa & 3) == 1))
+    {
+        if ((answer.fMantissa << shift) == hi)
+            answer.fMantissa &= ~(uint64_t)1;
+    }
+
+    answer.fMantissa += (answer.fMantissa & 1);
+    answer.fMantissa >>= 1;
+    if (answer.fMantissa >= ((uint64_t)2 << f->fMantissaBits)) {
+        answer.fMantissa = (uint64_t)1 << f->fMantissaBits;
+        answer.fPower2++;
+    }
+
+    answer.fMantissa &= ~((uint64_t)1 << f->fMantissaBits);
+    if (answer.fPower2 >= f->fInfinitePower) {
+        answer.fPower2 = f->fInfinitePower;
+        answer.fMantissa = 0;
+    }
+
+    return answer;
+}
+
+//
+// Big integers, just enough for the exact comparison
+// Large enough for 800 decimal digits, scaled by the largest
+// powers of 2 and 10 that can come up.
+//
+#define CONV_BIGINT_LIMBS 160
+#define CONV_MAX_DIGITS 800
+
+struct conv_bigint_t {
+    uint32_t fLimbs[CONV_BIGINT_LIMBS];     // least significant first
+    int fCount;
+};
+typedef struct conv_bigint_t conv_bigint;
+
+static void conv_bigint_set_u64(conv_bigint *b, uint64_t v) PC_NOEXCEPT_C
+{
+    b->fCount = 0;
+    while (v != 0) {
+        b->fLimbs[b->fCount++] = (uint32_t)v;
+        v >>= 32;
+    }
+}
+
+// b = b * m + a
+static void conv_bigint_mul_add(conv_bigint *b, uint32_t m, uint32_t a) PC_NOEXCEPT_C
+{
+    uint64_t carry = a;
+    for (int i = 0; i < b->fCount; i++) {
+        uint64_t t = ((uint64_t)b->fLimbs[i] * m) + carry;
+        b->fLimbs[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+
+    if ((carry != 0) && (b->fCount < CONV_BIGINT_LIMBS))
+        b->fLimbs[b->fCount++] = (uint32_t)carry;
+}
+
+static void conv_bigint_mul_pow10(conv_bigint *b, int64_t n) PC_NOEXCEPT_C
+{
+    static const uint32_t pow10[10] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+    while (n >= 9) {
+        conv_bigint_mul_add(b, pow10[9], 0);
+        n -= 9;
+    }
+    if (n > 0)
+        conv_bigint_mul_add(b, pow10[n], 0);
+}
+
+static void conv_bigint_shl(conv_bigint *b, int64_t bits) PC_NOEXCEPT_C
+{
+    if ((b->fCount == 0) || (bits <= 0))
+        return;
+
+    int limbShift = (int)(bits / 32);
+    int bitShift = (int)(bits % 32);
+    int newCount = b->fCount + limbShift + 1;
+    if (newCount > CONV_BIGINT_LIMBS)
+        newCount = CONV_BIGINT_LIMBS;
+
+    for (int i = newCount - 1; i >= 0; i--)
+    {
+        int src = i - limbShift;
+        uint64_t hiPart = (src >= 0 && src < b->fCount) ? b->fLimbs[src] : 0;
+        uint64_t loPart = (src - 1 >= 0 && src - 1 < b->fCount) ? b->fLimbs[src - 1] : 0;
+        b->fLimbs[i] = (uint32_t)(((hiPart << 32 | loPart) << bitShift) >> 32);
+    }
+
+    b->fCount = newCount;
+    while ((b->fCount > 0) && (b->fLimbs[b->fCount - 1] == 0))
+        b->fCount--;
+}
+
+static int conv_bigint_compare(const conv_bigint *a, const conv_bigint *b) PC_NOEXCEPT_C
+{
+    if (a->fCount != b->fCount)
+        return (a->fCount > b->fCount) ? 1 : -1;
+
+    for (int i = a->fCount - 1; i >= 0; i--) {
+        if (a->fLimbs[i] != b->fLimbs[i])
+            return (a->fLimbs[i] > b->fLimbs[i]) ? 1 : -1;
+    }
+
+    return 0;
+}
+
+// conv_digits_to_bigint()
+// All the significant digits of the decimal, up to CONV_MAX_DIGITS, as
+// a big integer.  The decimal value is digits * 10^(returned value).
+// If digits were left off, and any of them were not zero, a final '1'
+// digit is added, which is enough to keep a value that is just above
+// a halfway point from being seen as exactly halfway.
+static int64_t conv_digits_to_bigint(const conv_decimal *d, conv_bigint *b) PC_NOEXCEPT_C
+{
+    int64_t exponent = d->fExplicitExponent - (d->fFracEnd - d->fFracStart);
+    int nDigits = 0;
+    uint32_t chunk = 0;
+    int chunkDigits = 0;
+    bool truncated = false;
+
+    conv_bigint_set_u64(b, 0);
+
+    for (int part = 0; part < 2; part++)
+    {
+        const unsigned char *p = (part == 0) ? d->fIntStart : d->fFracStart;
+        const unsigned char *pend = (part == 0) ? d->fIntEnd : d->fFracEnd;
+
+        for (; p < pend; p++)
+        {
+            if (nDigits >= CONV_MAX_DIGITS) {
+                // one fewer digit kept, so one more power of 10
+                exponent++;
+                if (*p != '0')
+                    truncated = true;
+                continue;
+            }
+
+            // Skip leading zeros
+            if ((nDigits == 0) && (*p == '0'))
+                continue;
+
+            chunk = (chunk * 10) + (uint32_t)(*p - '0');
+            chunkDigits++;
+            nDigits++;
+            if (chunkDigits == 9) {
+                conv_bigint_mul_add(b, 1000000000, chunk);
+                chunk = 0;
+                chunkDigits = 0;
+            }
+        }
+    }
+
+    if (chunkDigits > 0) {
+        static const uint32_t pow10[9] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+        conv_bigint_mul_add(b, pow10[chunkDigits], chunk);
+    }
+
+    if (truncated) {
+        conv_bigint_mul_add(b, 10, 1);
+        exponent--;
+    }
+
+    return exponent;
+}
+
+// conv_round_exact()
+// The true value is either 'am', or the next value up.  Decide which,
+// by comparing all the digits against the point halfway between them.
+static conv_adjusted conv_round_exact(const conv_float_format *f, const conv_decimal *d, conv_adjusted am) PC_NOEXCEPT_C
+{
+    // The exact value of 'am' is M * 2^E2, so the halfway point
+    // is (2M + 1) * 2^(E2 - 1)
+    uint64_t m = am.fMantissa;
+    int64_t e2 = 1 + f->fMinimumExponent - f->fMantissaBits;
+    if (am.fPower2 > 0) {
+        m |= (uint64_t)1 << f->fMantissaBits;
+        e2 = am.fPower2 + f->fMinimumExponent - f->fMantissaBits;
+    }
+    uint64_t halfM = (2 * m) + 1;
+    int64_t halfE = e2 - 1;
+
+    // Compare digits * 10^e10 against halfM * 2^halfE, scaling
+    // both sides so everything is an integer
+    conv_bigint digits;
+    conv_bigint half;
+    int64_t e10 = conv_digits_to_bigint(d, &digits);
+    conv_bigint_set_u64(&half, halfM);
+
+    if (e10 >= 0)
+        conv_bigint_mul_pow10(&digits, e10);
+    else
+        conv_bigint_mul_pow10(&half, -e10);
+
+    if (halfE >= 0)
+        conv_bigint_shl(&half, halfE);
+    else
+        conv_bigint_shl(&digits, -halfE);
+
+    int cmp = conv_bigint_compare(&digits, &half);
+    bool roundUp = (cmp > 0) || ((cmp == 0) && (m & 1));
+
+    if (roundUp)
+    {
+        am.fMantissa++;
+        if (am.fMantissa >= ((uint64_t)1 << f->fMantissaBits)) {
+            am.fMantissa = 0;
+            am.fPower2++;
+        }
+        if (am.fPower2 >= f->fInfinitePower) {
+            am.fPower2 = f->fInfinitePower;
+            am.fMantissa = 0;
+        }
+    }
+
+    return am;
+}
+
+// conv_decimal_to_bits()
+// The correctly rounded bit pattern of the decimal, for the given format
+static uint64_t conv_decimal_to_bits(const conv_float_format *f, const conv_decimal *d) PC_NOEXCEPT_C
+{
+    conv_adjusted am = conv_compute_float(f, d->fExponent, d->fMantissa);
+
+    // With the digits cut off, the true value is somewhere between
+    // mantissa and mantissa+1.  If both round the same way, that's the answer.
+    if (d->fTooManyDigits)
+    {
+        conv_adjusted am2 = conv_compute_float(f, d->fExponent, d->fMantissa + 1);
+        if ((am.fMantissa != am2.fMantissa) || (am.fPower2 != am2.fPower2))
+            am = conv_round_exact(f, d, am);
+    }
+
+    uint64_t bits = am.fMantissa | ((uint64_t)am.fPower2 << f->fMantissaBits);
+    if (d->fNegative)
+        bits |= (uint64_t)1 << f->fSignBit;
+
+    return bits;
+}
+
+// conv_parse_special()
+// "inf", "infinity", "nan", "nan(...)", in any case, with an optional sign
+// Return
+//    1 - infinity
+//    2 - nan
+//    0 - neither
+static int conv_parse_special(const unsigned char *p, const unsigned char *pend, bool *negative, const unsigned char **endp) PC_NOEXCEPT_C
+{
+    *negative = false;
+    if ((p < pend) && ((*p == '-') || (*p == '+'))) {
+        *negative = (*p == '-');
+        p++;
+    }
+
+    size_t avail = (size_t)(pend - p);
+    if ((avail >= 3) && ((p[0] | 0x20) == 'n') && ((p[1] | 0x20) == 'a') && ((p[2] | 0x20) == 'n'))
+    {
+        p += 3;
+
+        // nan(n-char-sequence)
+        if ((p < pend) && (*p == '(')) {
+            const unsigned char *q = p + 1;
+            while ((q < pend) && (conv_is_digit(*q) || (((*q | 0x20) >= 'a') && ((*q | 0x20) <= 'z')) || (*q == '_')))
+                q++;
+            if ((q < pend) && (*q == ')'))
+                p = q + 1;
+        }
+
+        *endp = p;
+        return 2;
+    }
+
+    if ((avail >= 3) && ((p[0] | 0x20) == 'i') && ((p[1] | 0x20) == 'n') && ((p[2] | 0x20) == 'f'))
+    {
+        p += 3;
+        static const char inity[] = "inity";
+        if (((size_t)(pend - p) >= 5)) {
+            int i = 0;
+            while ((i < 5) && ((p[i] | 0x20) == inity[i]))
+                i++;
+            if (i == 5)
+                p += 5;
+        }
+
+        *endp = p;
+        return 1;
+    }
+
+    return 0;
+}
+
+// conv_parse_double()
+// Parse a double from the text between 'p' and 'pend'.
+// Return
+//    0 - success, 'v' holds the value, and 'endp' is just past the number
+//   -1 - not a number
+static int conv_parse_double(const unsigned char *p, const unsigned char *pend, double *v, const unsigned char **endp) PC_NOEXCEPT_C
+{
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const conv_float_format *f = &conv_double_format;
+
+    conv_decimal d;
+    if (conv_parse_decimal(p, pend, &d, endp) != 0)
+    {
+        bool negative = false;
+        int special = conv_parse_special(p, pend, &negative, endp);
+        if (special == 0)
+            return -1;
+
+        double value = (special == 1) ? HUGE_VAL : NAN;
+        *v = negative ? -value : value;
+        return 0;
+    }
+
+    // Clinger's fast path
+    if (!d.fTooManyDigits && (d.fExponent >= -f->fMaxFastPow10) && (d.fExponent <= f->fMaxFastPow10) && (d.fMantissa <= f->fMaxFastMantissa))
+    {
+        double value = (double)d.fMantissa;
+        if (d.fExponent < 0)
+            value = value / pow10[-d.fExponent];
+        else
+            value = value * pow10[d.fExponent];
+
+        *v = d.fNegative ? -value : value;
+        return 0;
+    }
+
+    uint64_t bits = conv_decimal_to_bits(f, &d);
+    memcpy(v, &bits, sizeof(double));
+
+    return 0;
+}
+
+// conv_parse_float()
+// Parse a float from the text between 'p' and 'pend'.  The value is
+// rounded straight from the decimal, not by way of a double, which
+// would round twice.
+// Return
+//    0 - success, 'v' holds the value, and 'endp' is just past the number
+//   -1 - not a number
+static int conv_parse_float(const unsigned char *p, const unsigned char *pend, float *v, const unsigned char **endp) PC_NOEXCEPT_C
+{
+    static const float pow10[] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+    const conv_float_format *f = &conv_float32_format;
+
+    conv_decimal d;
+    if (conv_parse_decimal(p, pend, &d, endp) != 0)
+    {
+        bool negative = false;
+        int special = conv_parse_special(p, pend, &negative, endp);
+        if (special == 0)
+            return -1;
+
+        float value = (special == 1) ? HUGE_VALF : NAN;
+        *v = negative ? -value : value;
+        return 0;
+    }
+
+    // Clinger's fast path
+    if (!d.fTooManyDigits && (d.fExponent >= -f->fMaxFastPow10) && (d.fExponent <= f->fMaxFastPow10) && (d.fMantissa <= f->fMaxFastMantissa))
+    {
+        float value = (float)d.fMantissa;
+        if (d.fExponent < 0)
+            value = value / pow10[-d.fExponent];
+        else
+            value = value * pow10[d.fExponent];
+
+        *v = d.fNegative ? -value : value;
+        return 0;
+    }
+
+    uint32_t bits = (uint32_t)conv_decimal_to_bits(f, &d);
+    memcpy(v, &bits, sizeof(float));
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CONVFLOAT_H_INCLUDED
@@ -1,11 +1,13 @@
 #ifndef CONVSPAN_H_INCLUDED
 #define CONVSPAN_H_INCLUDED
 
-#include <cmath>
+#include <stdlib.h>     // realloc
 
 #include "pcoredef.h"
 #include "asciiset.h"
 #include "bspan.h"
+#include "cpufeat.h"
+#include "convfloat.h"
 
 //
 // Convert a bspan to various data types
@@ -32,8 +34,14 @@ static int  hexToDec(const unsigned char vIn, unsigned char *) PC_NOEXCEPT;
 
 static int bspan_conv_hex_to_u64(const bspan * inSpan, uint64_t *outValue, bspan *rest) PC_NOEXCEPT;
 static int bspan_conv_to_u64(const bspan * inChunk, uint64_t * v, bspan *rest) PC_NOEXCEPT;
-static int bspan_conv_to_i64(const bspan * inChunk, uint64_t * v, bspan *rest) PC_NOEXCEPT;
+static int bspan_conv_to_i64(const bspan * inChunk, int64_t * v, bspan *rest) PC_NOEXCEPT;
 static int bspan_conv_to_double(const bspan * inChunk, double * v, bspan *rest) PC_NOEXCEPT;
+static int bspan_conv_to_float(const bspan * inChunk, float * v, bspan *rest) PC_NOEXCEPT;
+
+static int bspan_conv_to_doubles(const bspan * inChunk, double *values, size_t capacity, size_t *count, bspan *rest) PC_NOEXCEPT;
+static int bspan_conv_to_floats(const bspan * inChunk, float *values, size_t capacity, size_t *count, bspan *rest) PC_NOEXCEPT;
+static int bspan_conv_to_doubles_grow(const bspan * inChunk, double **values, size_t *capacity, size_t *count, bspan *rest) PC_NOEXCEPT;
+static int bspan_conv_to_floats_grow(const bspan * inChunk, float **values, size_t *capacity, size_t *count, bspan *rest) PC_NOEXCEPT;
 
 //
 // IMPLEMENTATION
@@ -164,57 +172,149 @@ static  int bspan_conv_hex_to_u64(const bspan * inSpan, uint64_t *outValue, bspa
     return 0;
 }
 
+//
+// Decimal integers
+// The digits are consumed 8 at a time, by treating them as a single 
+// 64-bit word (SWAR - SIMD Within A Register), and 16 at a time with
+// SSSE3.  Up to 19 digits can never overflow a uint64_t, so those are
+// accumulated without any checks.  Only a 20th digit needs to be 
+// checked, and anything beyond that is always an overflow.
+//
+#define CONV_U64_SAFE_DIGITS 19
+#define CONV_U64_MAX_DIGITS 20
+
+#if defined(PC_ARCH_X86)
+// conv_parse_16digits_ssse3()
+// If the 16 bytes at 'p' are all digits, put their value in 'v' and
+// return true.  Otherwise, return false without changing 'v'.
+PC_TARGET_SSSE3
+static bool conv_parse_16digits_ssse3(const unsigned char *p, uint64_t *v) PC_NOEXCEPT
+{
+    __m128i digits = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)p), _mm_set1_epi8('0'));
+
+    // anything that was not '0'..'9' is now above 9 (as unsigned)
+    __m128i tooBig = _mm_cmpeq_epi8(_mm_max_epu8(digits, _mm_set1_epi8(9)), _mm_set1_epi8(9));
+    if (_mm_movemask_epi8(tooBig) != 0xffff)
+        return false;
+
+    __m128i pairs = _mm_maddubs_epi16(digits, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+    __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+    __m128i packed = _mm_packs_epi32(quads, quads);
+    __m128i eights = _mm_madd_epi16(packed, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+
+    uint64_t hi = (uint32_t)_mm_cvtsi128_si32(eights);
+    uint64_t lo = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(eights, 4));
+    *v = (hi * 100000000ULL) + lo;
+
+    return true;
+}
+#endif
+
+// conv_parse_digits_u64()
+// Parse the run of digits starting at 'p'.  The value is returned in 'v'
+// and 'p' is left on the first byte that is not a digit.
+// Return
+//    0 - success
+//   -1 - there were no digits, or the value does not fit in 64 bits
+static int conv_parse_digits_u64(const unsigned char **pp, const unsigned char *sEnd, uint64_t *v) PC_NOEXCEPT
+{
+#if defined(PC_ARCH_X86)
+    static const bool useSSSE3 = pc_cpu_has(PC_CPU_SSSE3);
+#endif
+    const unsigned char *p = *pp;
+
+    if ((p >= sEnd) || !is_digit(*p))
+        return -1;
+
+    // Leading zeros do not count against the limit
+    while ((p < sEnd) && (*p == '0'))
+        p++;
+
+    const unsigned char *digitsStart = p;
+    uint64_t value = 0;
+
+#if defined(PC_ARCH_X86)
+    if (useSSSE3 && (sEnd - p >= 16) && conv_parse_16digits_ssse3(p, &value))
+        p += 16;
+#endif
+
+    while ((sEnd - p >= 8) && ((size_t)(p - digitsStart) + 8 <= CONV_U64_SAFE_DIGITS))
+    {
+        uint64_t word = as_u64_le(p);
+        if (!conv_is_8digits(word))
+            break;
+
+        value = (value * 100000000ULL) + conv_parse_8digits(word);
+        p += 8;
+    }
+
+    while ((p < sEnd) && is_digit(*p))
+    {
+        uint64_t d = (uint64_t)(*p - '0');
+        size_t nDigits = (size_t)(p - digitsStart);
+
+        if (nDigits >= CONV_U64_SAFE_DIGITS) {
+            if ((nDigits >= CONV_U64_MAX_DIGITS) || (value > (UINT64_MAX - d) / 10))
+                return -1;
+        }
+
+        value = (value * 10) + d;
+        p++;
+    }
+
+    *v = value;
+    *pp = p;
+
+    return 0;
+}
+
 // bspan_conv_to_u64
 //
 // If successful, the value is stored in the out parameter
+// Return
+//    0 - success, 'rest' is what follows the digits
+//   -1 - not a number, or too large to fit
 //
 static int bspan_conv_to_u64(const bspan * inChunk, uint64_t * v, bspan *rest) PC_NOEXCEPT
 {
-    bspan s;
-    bspan_weak_assign(&s, inChunk);
-    
-    if (!bspan_is_valid(&s))
+    if (!bspan_is_valid(inChunk))
         return -1;
 
-    const unsigned char* sStart = bspan_begin(&s);
-    const unsigned char* sEnd = bspan_end(&s);
+    const unsigned char* sStart = bspan_begin(inChunk);
+    const unsigned char* sEnd = bspan_end(inChunk);
 
-    // Return early if the next thing is not a digit
-    if (!is_digit(*sStart))
+    uint64_t value = 0;
+    if (conv_parse_digits_u64(&sStart, sEnd, &value) != 0)
         return -1;
 
-    // Initialize the value
-    *v = 0;
-
-    // While we still have input to consume
-    while ((sStart < sEnd) && is_digit(*sStart))
-    {
-        *v = (*v * 10) + (uint64_t)(*sStart - '0');
-        sStart++;
-    }
+    *v = value;
 
     if (rest != nullptr){
-        bspan_init_from_pointers(rest, sStart, s.fEnd);
+        bspan_init_from_pointers(rest, sStart, sEnd);
     }
 
     return 0;
 }
 
-static int bspan_conv_to_i64(const bspan * inChunk, uint64_t * v, bspan *rest) PC_NOEXCEPT
+// bspan_conv_to_i64
+//
+// An optional sign, followed by digits.  The whole range of 
+// int64_t is accepted, including INT64_MIN.
+// Return
+//    0 - success, 'rest' is what follows the digits
+//   -1 - not a number, or out of range
+static int bspan_conv_to_i64(const bspan * inChunk, int64_t * v, bspan *rest) PC_NOEXCEPT
 {
     if (!bspan_is_valid(inChunk))
         return -1;
     
-    bspan s;
-    bspan_weak_assign(&s, inChunk);
-
-    const unsigned char* sStart = s.fStart;
-    const unsigned char* sEnd = s.fEnd;
+    const unsigned char* sStart = bspan_begin(inChunk);
+    const unsigned char* sEnd = bspan_end(inChunk);
 
     // Check for a sign if it's there
-    int sign = 1;
+    bool negative = false;
     if (*sStart == '-') {
-        sign = -1;
+        negative = true;
         sStart++;
     }
     else if (*sStart == '+') {
@@ -222,128 +322,224 @@ static int bspan_conv_to_i64(const bspan * inChunk, uint64_t * v, bspan *rest) P
     }
 
     uint64_t uvalue{ 0 };
-    s.fStart = sStart;
-    int err = bspan_conv_to_u64(&s, &uvalue, rest);
-    if (err!=0)
-        return err;
+    if (conv_parse_digits_u64(&sStart, sEnd, &uvalue) != 0)
+        return -1;
 
+    if (negative) {
+        if (uvalue > (uint64_t)INT64_MAX + 1)
+            return -1;
+        *v = (int64_t)(0 - uvalue);
+    } else {
+        if (uvalue > (uint64_t)INT64_MAX)
+            return -1;
+        *v = (int64_t)uvalue;
+    }
 
-    if (sign < 0)
-            *v = -(int64_t)uvalue;
-    else
-            *v = (int64_t)uvalue;
+    if (rest != nullptr){
+        bspan_init_from_pointers(rest, sStart, sEnd);
+    }
 
-    return true;
+    return 0;
 }
 
-    // Parse a double number from the given ByteSpan, advancing the start
-    // of the ByteSpan to beyond where we found the last character of the number.
-    // Assumption:  We're sitting at beginning of a number, all whitespace handling
-    // has already occured.
+// bspan_conv_to_double()
+// Parse a double from the front of the span, which must be sitting at
+// the beginning of a number, all whitespace handling has already occured.
+// The value is correctly rounded (see convfloat.h).  'rest' is
+// set to what follows the number.
 static int bspan_conv_to_double(const bspan * inChunk, double * v, bspan *rest) PC_NOEXCEPT
 {
     if (!bspan_is_valid(inChunk))
         return -1;
 
-    bspan s;
-    bspan_weak_assign(&s, inChunk);
+    const unsigned char *endp = nullptr;
+    if (conv_parse_double(bspan_begin(inChunk), bspan_end(inChunk), v, &endp) != 0)
+        return -1;
 
-    const unsigned char* startAt = bspan_begin(&s);
-    const unsigned char* endAt = bspan_end(&s);
+    if (rest != nullptr)
+        bspan_init_from_pointers(rest, endp, bspan_end(inChunk));
 
-    double sign = 1.0;
-    double res = 0.0;
+    return 0;
+}
 
-    // integer part
-    uint64_t intPart = 0;
 
-    // fractional part
-    uint64_t fracPart = 0;
-    uint64_t fracBase = 1;
+// bspan_conv_to_float()
+// The same as bspan_conv_to_double(), but rounded to a float
+static int bspan_conv_to_float(const bspan * inChunk, float * v, bspan *rest) PC_NOEXCEPT
+{
+    if (!bspan_is_valid(inChunk))
+        return -1;
 
+    const unsigned char *endp = nullptr;
+    if (conv_parse_float(bspan_begin(inChunk), bspan_end(inChunk), v, &endp) != 0)
+        return -1;
 
-    bool hasIntPart = false;
-    bool hasFracPart = false;
-    bspan remains;
+    if (rest != nullptr)
+        bspan_init_from_pointers(rest, endp, bspan_end(inChunk));
 
-    // Parse optional sign
-    if (*startAt == '+') {
-        startAt++;
-    }
-    else if (*startAt == '-') {
-        sign = -1;
-        startAt++;
-    }
+    return 0;
+}
 
-    // Parse integer part
-    if (is_digit(*startAt))
-    {
-        hasIntPart = true;
-        s.fStart = startAt;
-        bspan_conv_to_u64(&s, &intPart, &remains);
+//
+// Lists of numbers
+// Numbers separated by commas and whitespace, as found in SVG path
+// data and point lists:  "10,20 30.5 -4e2,,7"
+// A number does not need a separator in front of it when it can't
+// be mistaken for part of the previous one: "10-20.5.5" is 10, -20.5, .5
+//
+// Parsing stops at the end of the span, at anything that is not a
+// number, or when the array is full.  'rest' is set to where it
+// stopped, so the caller can see what's there (an SVG path command,
+// for instance), and carry on from there.
+//
 
-        startAt = remains.fStart;
-        res = static_cast<double>(intPart);
-    }
+// conv_numlist_chars()
+// The characters that separate the numbers of a list, ",\t\n\f\r ",
+// as a constant table, laid out the way asciiset.h lays them out,
+// so there's nothing to set up the first time, from whichever thread.
+static const asciiset * conv_numlist_chars() PC_NOEXCEPT
+{
+    static const asciiset chars = { {
+        0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // ' '
+        0x00, 0x01, 0x01, 0x00, 0x05, 0x01, 0x00, 0x00,     // '\t' '\n' ',' '\f' '\r'
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    } };
+
+    return &chars;
+}
 
-    // Parse fractional part.
-    if ((startAt < endAt) && (*startAt == '.'))
+// conv_parse_list()
+// Parse up to 'capacity' numbers, into either a float or double array
+// Returns the number parsed, and sets 'pp' to where it stopped
+static size_t conv_parse_list(const unsigned char **pp, const unsigned char *pend, void *values, bool isFloat, size_t capacity) PC_NOEXCEPT
+{
+    const asciiset *seps = conv_numlist_chars();
+    const unsigned char *p = *pp;
+    size_t count = 0;
+
+    while (count < capacity)
     {
-        hasFracPart = true;
-        startAt++; // Skip '.'
+        p += asciiset_find_first_not_in(seps, p, (size_t)(pend - p));
+        if (p >= pend)
+            break;
+
+        const unsigned char *endp = nullptr;
+        int err = isFloat ? conv_parse_float(p, pend, ((float *)values) + count, &endp)
+                          : conv_parse_double(p, pend, ((double *)values) + count, &endp);
+        if (err != 0)
+            break;
+
+        count++;
+        p = endp;
+    }
 
-        fracBase = 1;
+    // Leave off after any trailing separators
+    if (count < capacity)
+        p += asciiset_find_first_not_in(seps, p, (size_t)(pend - p));
 
-        // Add the fraction portion without calling out to powd
-        while ((startAt < endAt) && is_digit(*startAt)) {
-            fracPart = fracPart * 10 + static_cast<uint64_t>(*startAt - '0');
-            fracBase *= 10;
-            startAt++;
-        }
-        res += (static_cast<double>(fracPart) / static_cast<double>(fracBase));
+    *pp = p;
 
-    }
+    return count;
+}
 
-    // If we don't have an integer or fractional
-    // part, then just return false
-    if (!hasIntPart && !hasFracPart)
+// conv_parse_list_grow()
+// Append numbers to an array that is grown with realloc() as needed
+static int conv_parse_list_grow(const bspan * inChunk, void **values, size_t elemSize, size_t *capacity, size_t *count, bspan *rest) PC_NOEXCEPT
+{
+    if (!bspan_is_valid(inChunk))
         return -1;
 
-    // Parse optional exponent
-    // mostly we don't see this, so we won't bother trying
-    // to optimize it beyond using powd
-    if ((startAt < endAt) && 
-        (((*startAt == 'e') || (*startAt == 'E')) && 
-        ((startAt[1] != 'm') && (startAt[1] != 'x'))))
-    {
-        // exponent parts
-        uint64_t expPart = 0;
-        double expSign = 1.0;
+    const unsigned char *p = bspan_begin(inChunk);
+    const unsigned char *pend = bspan_end(inChunk);
+    int result = 0;
 
-        startAt++; // skip 'E'
-        if (*startAt == '+') {
-            startAt++;
-        }
-        else if (*startAt == '-') {
-            expSign = -1.0;
-            startAt++;
+    while (true)
+    {
+        if (*count == *capacity)
+        {
+            size_t newCapacity = (*capacity < 16) ? 16 : *capacity * 2;
+            void *newValues = realloc(*values, newCapacity * elemSize);
+            if (newValues == nullptr) {
+                result = -1;
+                break;
+            }
+            *values = newValues;
+            *capacity = newCapacity;
         }
 
+        size_t room = *capacity - *count;
+        size_t n = conv_parse_list(&p, pend, (unsigned char *)*values + (*count * elemSize), elemSize == sizeof(float), room);
+        *count += n;
 
-        if (is_digit(*startAt)) {
-            s.fStart = startAt;
-            bspan_conv_to_u64(&s, &expPart, &remains);
-            startAt = bspan_begin(&remains);
-            res = res * std::pow(10, double(expSign * double(expPart)));
-        }
+        // Stopped for some reason other than running out of room
+        if (n < room)
+            break;
     }
-    s.fStart = startAt;
 
-    *v = res * sign;
+    if (rest != nullptr)
+        bspan_init_from_pointers(rest, p, pend);
+
+    return result;
+}
+
+// bspan_conv_to_doubles()
+// Parse a list of numbers into the 'values' array, which has room for
+// 'capacity' of them.  'count' is set to how many were parsed.
+// Return
+//    0 - success, 'rest' is where parsing stopped
+//   -1 - the span is not valid
+static int bspan_conv_to_doubles(const bspan * inChunk, double *values, size_t capacity, size_t *count, bspan *rest) PC_NOEXCEPT
+{
+    if (!bspan_is_valid(inChunk))
+        return -1;
+
+    const unsigned char *p = bspan_begin(inChunk);
+    *count = conv_parse_list(&p, bspan_end(inChunk), values, false, capacity);
+
+    if (rest != nullptr)
+        bspan_init_from_pointers(rest, p, bspan_end(inChunk));
+
+    return 0;
+}
+
+// bspan_conv_to_floats()
+// The same as bspan_conv_to_doubles(), for floats
+static int bspan_conv_to_floats(const bspan * inChunk, float *values, size_t capacity, size_t *count, bspan *rest) PC_NOEXCEPT
+{
+    if (!bspan_is_valid(inChunk))
+        return -1;
+
+    const unsigned char *p = bspan_begin(inChunk);
+    *count = conv_parse_list(&p, bspan_end(inChunk), values, true, capacity);
+
+    if (rest != nullptr)
+        bspan_init_from_pointers(rest, p, bspan_end(inChunk));
 
     return 0;
 }
 
+// bspan_conv_to_doubles_grow()
+// Parse a list of numbers, appending them to the array in 'values',
+// after the first 'count' that are already there.  The array is grown
+// with realloc() as needed, and 'capacity' and 'count' updated.  The
+// caller frees the array with free().  Start with a nullptr array, and
+// zero capacity and count.
+// Return
+//    0 - success, 'rest' is where parsing stopped
+//   -1 - the span is not valid, or out of memory
+static int bspan_conv_to_doubles_grow(const bspan * inChunk, double **values, size_t *capacity, size_t *count, bspan *rest) PC_NOEXCEPT
+{
+    return conv_parse_list_grow(inChunk, (void **)values, sizeof(double), capacity, count, rest);
+}
+
+// bspan_conv_to_floats_grow()
+// The same as bspan_conv_to_doubles_grow(), for floats
+static int bspan_conv_to_floats_grow(const bspan * inChunk, float **values, size_t *capacity, size_t *count, bspan *rest) PC_NOEXCEPT
+{
+    return conv_parse_list_grow(inChunk, (void **)values, sizeof(float), capacity, count, rest);
+}
+
 
 #ifdef __cplusplus
 }
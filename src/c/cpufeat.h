@@ -0,0 +1,174 @@
+#ifndef CPUFEAT_H_INCLUDED
+#define CPUFEAT_H_INCLUDED
+
+//
+// cpufeat
+// Runtime detection of the SIMD instruction sets the current
+// processor supports.  The kernels in bspan.h, and the scanners built
+// on top of them, are compiled for several instruction sets at once,
+// and one of them is picked the first time it is needed, based on
+// what is reported here.
+//
+// Typical usage:
+//   if (pc_cpu_has(PC_CPU_AVX2))
+//       use the AVX2 version of a routine
+//
+// Functions that use a particular instruction set are marked with
+// one of the PC_TARGET_xxx macros, so the compiler will generate that
+// code without the whole program being compiled with -mavx2 or the like.
+//
+
+#include "pcoredef.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #define PC_ARCH_X86 1
+  #include <immintrin.h>
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+  #else
+    #include <cpuid.h>
+  #endif
+#endif
+
+// MSVC will emit any intrinsic without needing a function attribute.
+// gcc and clang need to be told which instruction sets a function uses.
+#if defined(PC_ARCH_X86) && !(defined(_MSC_VER) && !defined(__clang__))
+  #define PC_TARGET_SSE2        __attribute__((target("sse2")))
+  #define PC_TARGET_SSSE3       __attribute__((target("ssse3")))
+  #define PC_TARGET_PCLMUL      __attribute__((target("ssse3,sse4.1,pclmul")))
+  #define PC_TARGET_AVX2        __attribute__((target("avx2,bmi,bmi2,popcnt")))
+  #define PC_TARGET_AVX512BW    __attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2,popcnt")))
+  #define PC_TARGET_AVX2_PCLMUL     __attribute__((target("avx2,bmi,bmi2,popcnt,pclmul")))
+  #define PC_TARGET_AVX512BW_PCLMUL __attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2,popcnt,pclmul")))
+#else
+  #define PC_TARGET_SSE2
+  #define PC_TARGET_SSSE3
+  #define PC_TARGET_PCLMUL
+  #define PC_TARGET_AVX2
+  #define PC_TARGET_AVX512BW
+  #define PC_TARGET_AVX2_PCLMUL
+  #define PC_TARGET_AVX512BW_PCLMUL
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The instruction sets we care about
+// These are bit flags, so they can be combined and tested
+// together with pc_cpu_has()
+enum PC_CPU_FEATURE {
+    PC_CPU_SSE2         = 0x0001
+    , PC_CPU_SSSE3      = 0x0002
+    , PC_CPU_SSE41      = 0x0004
+    , PC_CPU_PCLMUL     = 0x0008
+    , PC_CPU_AVX2       = 0x0010
+    , PC_CPU_BMI2       = 0x0020
+    , PC_CPU_AVX512BW   = 0x0040
+};
+
+static uint32_t pc_cpu_detect() PC_NOEXCEPT_C;
+static uint32_t pc_cpu_features() PC_NOEXCEPT_C;
+static bool pc_cpu_has(uint32_t features) PC_NOEXCEPT_C;
+
+
+// Implementation
+#if defined(PC_ARCH_X86)
+static void pc_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) PC_NOEXCEPT_C
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, (int)leaf, (int)subleaf);
+    regs[0] = info[0]; regs[1] = info[1]; regs[2] = info[2]; regs[3] = info[3];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Read the extended control register, which tells us which
+// register files the operating system is saving for us.
+static uint64_t pc_xgetbv() PC_NOEXCEPT_C
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+#endif
+
+// pc_cpu_detect()
+// Query the processor directly.  Use pc_cpu_features() instead
+// which only does this once.
+static uint32_t pc_cpu_detect() PC_NOEXCEPT_C
+{
+    uint32_t features = 0;
+
+#if defined(PC_ARCH_X86)
+    uint32_t regs[4] = { 0,0,0,0 };
+
+    pc_cpuid(0, 0, regs);
+    uint32_t maxLeaf = regs[0];
+    if (maxLeaf < 1)
+        return 0;
+
+    pc_cpuid(1, 0, regs);
+    uint32_t ecx1 = regs[2];
+    uint32_t edx1 = regs[3];
+
+    if (edx1 & (1u << 26)) features |= PC_CPU_SSE2;
+    if (ecx1 & (1u << 9)) features |= PC_CPU_SSSE3;
+    if (ecx1 & (1u << 19)) features |= PC_CPU_SSE41;
+    if (ecx1 & (1u << 1)) features |= PC_CPU_PCLMUL;
+
+    // The AVX family is only usable if the operating system
+    // saves the wider registers on a context switch
+    bool osxsave = (ecx1 & (1u << 27)) != 0;
+    uint64_t xcr0 = osxsave ? pc_xgetbv() : 0;
+    bool osYmm = (xcr0 & 0x06) == 0x06;
+    bool osZmm = (xcr0 & 0xe6) == 0xe6;
+
+    if (maxLeaf >= 7)
+    {
+        pc_cpuid(7, 0, regs);
+        uint32_t ebx7 = regs[1];
+
+        bool bmi1 = (ebx7 & (1u << 3)) != 0;
+        bool bmi2 = (ebx7 & (1u << 8)) != 0;
+
+        if (bmi2) features |= PC_CPU_BMI2;
+        if (osYmm && bmi1 && bmi2 && (ebx7 & (1u << 5)))
+            features |= PC_CPU_AVX2;
+        if (osZmm && (features & PC_CPU_AVX2) && (ebx7 & (1u << 16)) && (ebx7 & (1u << 30)))
+            features |= PC_CPU_AVX512BW;
+    }
+#endif
+
+    return features;
+}
+
+// pc_cpu_features()
+// The features of the current processor.  The detection is
+// done once, the first time this is called.
+static uint32_t pc_cpu_features() PC_NOEXCEPT_C
+{
+    static const uint32_t features = pc_cpu_detect();
+
+    return features;
+}
+
+// pc_cpu_has()
+// Return true if all the requested features are supported
+static bool pc_cpu_has(uint32_t features) PC_NOEXCEPT_C
+{
+    return (pc_cpu_features() & features) == features;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CPUFEAT_H_INCLUDED
@@ -0,0 +1,584 @@
+#ifndef CSVCOLUMNS_H_INCLUDED
+#define CSVCOLUMNS_H_INCLUDED
+
+//
+// csvcolumns
+// Loading an indexed CSV source (csvscan.h) into typed columns.
+//
+// Each column is a single array of values of one type, so going over a
+// column is a tight loop over, for instance, a double[], with nothing
+// parsed along the way.  The types are:
+//   CSV_COLUMN_TYPE_INT64      - int64_t, in fInts
+//   CSV_COLUMN_TYPE_DOUBLE     - double, in fDoubles
+//   CSV_COLUMN_TYPE_TIMESTAMP  - microseconds since 1970, UTC, in fInts
+//   CSV_COLUMN_TYPE_CATEGORY   - a string from a small set of them.  Each
+//                                distinct value is interned once, in
+//                                fCategories, and fCodes holds the
+//                                id of each row's value.
+//   CSV_COLUMN_TYPE_STRING     - any other string.  fOffsets holds the
+//                                start and end of each value, as offsets
+//                                into the source, which is not copied.
+//
+// The type of each column is guessed from a sample of its rows, spread
+// over the whole table.  A column is the narrowest type every sampled
+// value fits in.  Strings are categories when the sampled values repeat
+// a lot.  If a value that wasn't sampled doesn't fit, the column is loaded
+// again as the next wider type (int64 to double, anything to string).
+//
+// An empty field, or one past the end of a short row, is null.  The
+// exception is a quoted empty string (""), in a string column.  Nulls
+// are marked in a bitmap, one bit per row, with the bit set for a null.
+// The value in the array, for a null, is 0.
+//
+// Spaces and tabs around a field are not part of its value, and neither
+// are the quotes of a quoted field.  Doubled quotes inside of a string
+// stay doubled.
+//
+// Timestamps are a date, with an optional time and time zone:
+//   2023-05-10
+//   2023/05/10 02:00:00.000000 +00:00
+//   2023-05-10T02:00:00Z
+//
+// Typical usage:
+//   csvindex idx;
+//   csvindex_init(&idx);
+//   csvindex_build(&idx, &src, ',');
+//
+//   csvcolumns cols;
+//   csvcolumns_init(&cols);
+//   csvcolumns_load(&cols, &idx, true);
+//
+//   int c = csvcolumns_find_cstr(&cols, "Download (b/s)");
+//   const csvcolumn *download = &cols.fColumns[c];
+//   double total = 0;
+//   for (size_t row = 0; row < cols.fRowCount; row++)
+//       total += download->fDoubles[row];
+//
+//   csvcolumns_destroy(&cols);
+//   csvindex_destroy(&idx);
+//
+
+#include <stdlib.h>     // malloc, calloc, free
+
+#include "pcoredef.h"
+#include "bspan.h"
+#include "convspan.h"
+#include "interntable.h"
+#include "csvscan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum CSV_COLUMN_TYPE {
+    CSV_COLUMN_TYPE_INT64 = 1
+    , CSV_COLUMN_TYPE_DOUBLE
+    , CSV_COLUMN_TYPE_TIMESTAMP
+    , CSV_COLUMN_TYPE_CATEGORY
+    , CSV_COLUMN_TYPE_STRING
+};
+
+#define CSVCOLUMNS_SAMPLE_ROWS 1024
+#define CSVCOLUMNS_MAX_CATEGORIES 65536
+
+struct csvcolumn_t {
+    bspan fName;
+    int fType;                  // CSV_COLUMN_TYPE
+
+    int64_t *fInts;             // INT64, TIMESTAMP
+    double *fDoubles;           // DOUBLE
+    uint32_t *fCodes;           // CATEGORY, id in fCategories
+    uint32_t *fOffsets;         // STRING, start and end of each value
+
+    interntable fCategories;    // the distinct values of a CATEGORY
+
+    uint64_t *fNulls;           // bit set for each null
+    size_t fNullCount;
+};
+typedef struct csvcolumn_t csvcolumn;
+
+struct csvcolumns_t {
+    const unsigned char *fBase;     // start of the source
+    size_t fRowCount;
+    size_t fColumnCount;
+    csvcolumn *fColumns;
+};
+typedef struct csvcolumns_t csvcolumns;
+
+static int csvcolumns_init(csvcolumns *t) PC_NOEXCEPT_C;
+static int csvcolumns_destroy(csvcolumns *t) PC_NOEXCEPT_C;
+static int csvcolumns_load(csvcolumns *t, const csvindex *idx, bool header) PC_NOEXCEPT_C;
+static int csvcolumns_find(const csvcolumns *t, const bspan *name) PC_NOEXCEPT_C;
+static int csvcolumns_find_cstr(const csvcolumns *t, const char *name) PC_NOEXCEPT_C;
+static bool csvcolumn_is_null(const csvcolumn *c, size_t row) PC_NOEXCEPT_C;
+static int csvcolumn_string(const csvcolumns *t, const csvcolumn *c, size_t row, bspan *value) PC_NOEXCEPT_C;
+
+static int csv_parse_timestamp(const bspan *s, int64_t *micros) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+//
+// Timestamps
+//
+
+// csv_parse_ndigits()
+// Exactly 'n' digits, as a number
+static int csv_parse_ndigits(const unsigned char **pp, const unsigned char *end, int n, int *v) PC_NOEXCEPT_C
+{
+    const unsigned char *p = *pp;
+    if (end - p < n)
+        return -1;
+
+    int value = 0;
+    for (int i = 0; i < n; i++) {
+        if (!conv_is_digit(p[i]))
+            return -1;
+        value = (value * 10) + (p[i] - '0');
+    }
+
+    *v = value;
+    *pp = p + n;
+
+    return 0;
+}
+
+// csv_days_from_civil()
+// The number of days from 1970-01-01 to the given date,
+// of the proleptic Gregorian calendar
+static int64_t csv_days_from_civil(int64_t y, int m, int d) PC_NOEXCEPT_C
+{
+    y -= (m <= 2);
+    int64_t era = ((y >= 0) ? y : y - 399) / 400;
+    int64_t yoe = y - (era * 400);
+    int64_t doy = ((153 * (m + ((m > 2) ? -3 : 9))) + 2) / 5 + d - 1;
+    int64_t doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+
+    return (era * 146097) + doe - 719468;
+}
+
+// csv_parse_timestamp()
+// A date, 'YYYY-MM-DD', or 'YYYY/MM/DD', with an optional time after a
+// 'T' or a space, 'HH:MM', 'HH:MM:SS', or 'HH:MM:SS.ffffff', and an
+// optional time zone, 'Z', '+HH:MM', or '+HHMM'.  All of the span has
+// to be the timestamp.
+// Return
+//    0 - success, 'micros' is microseconds since 1970, UTC
+//   -1 - not a timestamp
+static int csv_parse_timestamp(const bspan *s, int64_t *micros) PC_NOEXCEPT_C
+{
+    const unsigned char *p = bspan_begin(s);
+    const unsigned char *end = bspan_end(s);
+
+    int year = 0, month = 0, day = 0;
+    if ((csv_parse_ndigits(&p, end, 4, &year) != 0) || (p >= end) || ((*p != '-') && (*p != '/')))
+        return -1;
+
+    unsigned char sep = *p++;
+    if ((csv_parse_ndigits(&p, end, 2, &month) != 0) || (p >= end) || (*p++ != sep) ||
+        (csv_parse_ndigits(&p, end, 2, &day) != 0))
+        return -1;
+
+    if ((month < 1) || (month > 12) || (day < 1) || (day > 31))
+        return -1;
+
+    int hour = 0, minute = 0, second = 0;
+    int64_t fraction = 0;
+    int zone = 0;
+    if ((p < end) && ((*p == 'T') || (*p == ' ')))
+    {
+        p++;
+        if ((csv_parse_ndigits(&p, end, 2, &hour) != 0) || (p >= end) || (*p++ != ':') ||
+            (csv_parse_ndigits(&p, end, 2, &minute) != 0))
+            return -1;
+
+        if ((p < end) && (*p == ':')) {
+            p++;
+            if (csv_parse_ndigits(&p, end, 2, &second) != 0)
+                return -1;
+
+            // Up to microseconds, and anything finer is dropped
+            if ((p < end) && (*p == '.')) {
+                p++;
+                int digits = 0;
+                for (; (p < end) && conv_is_digit(*p); p++, digits++)
+                    if (digits < 6)
+                        fraction = (fraction * 10) + (*p - '0');
+                if (digits == 0)
+                    return -1;
+                for (; digits < 6; digits++)
+                    fraction *= 10;
+            }
+        }
+
+        if ((hour > 23) || (minute > 59) || (second > 60))
+            return -1;
+
+        while ((p < end) && (*p == ' '))
+            p++;
+
+        if ((p < end) && (*p == 'Z')) {
+            p++;
+        }
+        else if ((p < end) && ((*p == '+') || (*p == '-'))) {
+            int sign = (*p++ == '-') ? -1 : 1;
+            int zh = 0, zm = 0;
+            if (csv_parse_ndigits(&p, end, 2, &zh) != 0)
+                return -1;
+            if ((p < end) && (*p == ':'))
+                p++;
+            if ((csv_parse_ndigits(&p, end, 2, &zm) != 0) || (zh > 23) || (zm > 59))
+                return -1;
+            zone = sign * ((zh * 60) + zm);
+        }
+    }
+
+    if (p != end)
+        return -1;
+
+    int64_t seconds = (csv_days_from_civil(year, month, day) * 86400) + (hour * 3600) + (minute * 60) + second - (zone * 60);
+    *micros = (seconds * 1000000) + fraction;
+
+    return 0;
+}
+
+//
+// Values
+//
+
+// csvcolumns_value()
+// The value of a field, without the spaces around it, or its
+// quotes.  A field past the end of the row is empty.
+// Return
+//    1 - the field was quoted
+//    0 - it wasn't
+static int csvcolumns_value(const csvindex *idx, size_t row, size_t col, bspan *value) PC_NOEXCEPT_C
+{
+    if (csvindex_field(idx, row, col, value) != 0) {
+        bspan_init_from_pointers(value, idx->fBase, idx->fBase);
+        return 0;
+    }
+
+    return csv_field_trim(value);
+}
+
+static bool csvcolumns_is_int64(const bspan *v, int64_t *i) PC_NOEXCEPT_C
+{
+    bspan rest;
+    return (bspan_conv_to_i64(v, i, &rest) == 0) && (bspan_size(&rest) == 0);
+}
+
+// csvcolumns_is_double()
+// Whether a value is a number, written out with digits.  The parser
+// also takes 'nan' and 'inf', which in a CSV are far more likely to be
+// words, or names, than numbers, so only digits, signs, '.', and the
+// exponent are allowed, and there has to be a digit.
+static bool csvcolumns_is_double(const bspan *v, double *d) PC_NOEXCEPT_C
+{
+    bool digits = false;
+    for (const unsigned char *p = bspan_begin(v); p < bspan_end(v); p++) {
+        unsigned char c = *p;
+        if ((c >= '0') && (c <= '9'))
+            digits = true;
+        else if ((c != '+') && (c != '-') && (c != '.') && (c != 'e') && (c != 'E'))
+            return false;
+    }
+
+    const unsigned char *endp = nullptr;
+    return digits && (conv_parse_double(bspan_begin(v), bspan_end(v), d, &endp) == 0) && (endp == bspan_end(v));
+}
+
+//
+// Categories
+// The distinct values of a column, interned, with their ids as the codes
+//
+
+// csvcolumns_category_code()
+// The code of a value, adding it if it's new
+// Return
+//    0 - success
+//   -1 - there are too many categories, or out of memory
+static int csvcolumns_category_code(csvcolumn *c, const bspan *value, uint32_t *code) PC_NOEXCEPT_C
+{
+    uint32_t id = interntable_intern(&c->fCategories, value);
+    if ((id == INTERNTABLE_NONE) || (id >= CSVCOLUMNS_MAX_CATEGORIES))
+        return -1;
+    *code = id;
+
+    return 0;
+}
+
+// Let go of the values of a column, but not its name
+static void csvcolumns_clear_column(csvcolumn *c) PC_NOEXCEPT_C
+{
+    free(c->fInts);
+    free(c->fDoubles);
+    free(c->fCodes);
+    free(c->fOffsets);
+    interntable_destroy(&c->fCategories);
+    free(c->fNulls);
+
+    bspan name = c->fName;
+    int type = c->fType;
+    memset(c, 0, sizeof(csvcolumn));
+    c->fName = name;
+    c->fType = type;
+}
+
+//
+// Loading
+//
+
+// csvcolumns_infer_type()
+// The type of a column, from a sample of its rows
+static int csvcolumns_infer_type(const csvindex *idx, size_t first, size_t rows, size_t col) PC_NOEXCEPT_C
+{
+    size_t stride = (rows > CSVCOLUMNS_SAMPLE_ROWS) ? rows / CSVCOLUMNS_SAMPLE_ROWS : 1;
+    bool allInt = true;
+    bool allDouble = true;
+    bool allTimestamp = true;
+    size_t sampled = 0;
+
+    csvcolumn distinct;
+    memset(&distinct, 0, sizeof(distinct));
+    bool categories = true;
+
+    for (size_t row = 0; row < rows; row += stride)
+    {
+        bspan v;
+        csvcolumns_value(idx, first + row, col, &v);
+        if (bspan_size(&v) == 0)
+            continue;
+        sampled++;
+
+        int64_t i;
+        double d;
+        if (allInt && !csvcolumns_is_int64(&v, &i))
+            allInt = false;
+        if (allDouble && !allInt && !csvcolumns_is_double(&v, &d))
+            allDouble = false;
+        if (allTimestamp && (csv_parse_timestamp(&v, &i) != 0))
+            allTimestamp = false;
+
+        uint32_t code;
+        if (categories && (csvcolumns_category_code(&distinct, &v, &code) != 0))
+            categories = false;
+    }
+
+    // Strings that repeat, on average, are categories
+    categories = categories && (interntable_count(&distinct.fCategories) * 2 <= sampled);
+    csvcolumns_clear_column(&distinct);
+
+    if (sampled == 0)
+        return CSV_COLUMN_TYPE_STRING;
+    if (allInt)
+        return CSV_COLUMN_TYPE_INT64;
+    if (allDouble)
+        return CSV_COLUMN_TYPE_DOUBLE;
+    if (allTimestamp)
+        return CSV_COLUMN_TYPE_TIMESTAMP;
+
+    return categories ? CSV_COLUMN_TYPE_CATEGORY : CSV_COLUMN_TYPE_STRING;
+}
+
+// csvcolumns_fill()
+// Fill in the values of a column, as its type
+// Return
+//    0 - success
+//    1 - a value did not fit the type
+//   -1 - out of memory
+static int csvcolumns_fill(csvcolumn *c, const csvindex *idx, size_t first, size_t rows, size_t col) PC_NOEXCEPT_C
+{
+    size_t n = (rows > 0) ? rows : 1;
+    c->fNulls = (uint64_t *)calloc((n + 63) / 64, sizeof(uint64_t));
+    if (c->fNulls == nullptr)
+        return -1;
+
+    switch (c->fType) {
+        case CSV_COLUMN_TYPE_INT64:
+        case CSV_COLUMN_TYPE_TIMESTAMP:
+            c->fInts = (int64_t *)malloc(n * sizeof(int64_t));
+            if (c->fInts == nullptr)
+                return -1;
+            break;
+        case CSV_COLUMN_TYPE_DOUBLE:
+            c->fDoubles = (double *)malloc(n * sizeof(double));
+            if (c->fDoubles == nullptr)
+                return -1;
+            break;
+        case CSV_COLUMN_TYPE_CATEGORY:
+            c->fCodes = (uint32_t *)malloc(n * sizeof(uint32_t));
+            if (c->fCodes == nullptr)
+                return -1;
+            break;
+        default:
+            c->fOffsets = (uint32_t *)malloc(n * 2 * sizeof(uint32_t));
+            if (c->fOffsets == nullptr)
+                return -1;
+            break;
+    }
+
+    for (size_t row = 0; row < rows; row++)
+    {
+        bspan v;
+        bool quoted = csvcolumns_value(idx, first + row, col, &v) == 1;
+        bool text = (c->fType == CSV_COLUMN_TYPE_CATEGORY) || (c->fType == CSV_COLUMN_TYPE_STRING);
+
+        bool isNull = (bspan_size(&v) == 0) && !(quoted && text);
+        if (isNull) {
+            c->fNulls[row / 64] |= (uint64_t)1 << (row % 64);
+            c->fNullCount++;
+        }
+
+        switch (c->fType) {
+            case CSV_COLUMN_TYPE_INT64:
+                c->fInts[row] = 0;
+                if (!isNull && !csvcolumns_is_int64(&v, &c->fInts[row]))
+                    return 1;
+                break;
+            case CSV_COLUMN_TYPE_TIMESTAMP:
+                c->fInts[row] = 0;
+                if (!isNull && (csv_parse_timestamp(&v, &c->fInts[row]) != 0))
+                    return 1;
+                break;
+            case CSV_COLUMN_TYPE_DOUBLE:
+                c->fDoubles[row] = 0;
+                if (!isNull && !csvcolumns_is_double(&v, &c->fDoubles[row]))
+                    return 1;
+                break;
+            case CSV_COLUMN_TYPE_CATEGORY:
+                c->fCodes[row] = 0;
+                if (!isNull && (csvcolumns_category_code(c, &v, &c->fCodes[row]) != 0))
+                    return (interntable_count(&c->fCategories) >= CSVCOLUMNS_MAX_CATEGORIES) ? 1 : -1;
+                break;
+            default:
+                c->fOffsets[row * 2] = (uint32_t)(bspan_begin(&v) - idx->fBase);
+                c->fOffsets[(row * 2) + 1] = (uint32_t)(bspan_end(&v) - idx->fBase);
+                break;
+        }
+    }
+
+    return 0;
+}
+
+static int csvcolumns_init(csvcolumns *t) PC_NOEXCEPT_C
+{
+    memset(t, 0, sizeof(csvcolumns));
+
+    return 0;
+}
+
+static int csvcolumns_destroy(csvcolumns *t) PC_NOEXCEPT_C
+{
+    for (size_t i = 0; i < t->fColumnCount; i++)
+        csvcolumns_clear_column(&t->fColumns[i]);
+    free(t->fColumns);
+    memset(t, 0, sizeof(csvcolumns));
+
+    return 0;
+}
+
+// csvcolumns_load()
+// Load the rows of the index into columns, with the names of the
+// columns in the first row, if there is a 'header'.  The number of
+// columns is the number of fields in the first row.
+// Return
+//    0 - success
+//   -1 - out of memory
+static int csvcolumns_load(csvcolumns *t, const csvindex *idx, bool header) PC_NOEXCEPT_C
+{
+    csvcolumns_destroy(t);
+
+    size_t first = header ? 1 : 0;
+    size_t count = csvindex_field_count(idx, 0);
+    t->fBase = idx->fBase;
+    t->fRowCount = (csvindex_row_count(idx) > first) ? csvindex_row_count(idx) - first : 0;
+    if (count == 0)
+        return 0;
+
+    t->fColumns = (csvcolumn *)calloc(count, sizeof(csvcolumn));
+    if (t->fColumns == nullptr)
+        return -1;
+    t->fColumnCount = count;
+
+    for (size_t col = 0; col < count; col++)
+    {
+        csvcolumn *c = &t->fColumns[col];
+        if (header)
+            csvcolumns_value(idx, 0, col, &c->fName);
+        else
+            bspan_init_from_pointers(&c->fName, idx->fBase, idx->fBase);
+
+        // When a value doesn't fit, go to the next wider type
+        c->fType = csvcolumns_infer_type(idx, first, t->fRowCount, col);
+        while (true)
+        {
+            int result = csvcolumns_fill(c, idx, first, t->fRowCount, col);
+            if (result == 0)
+                break;
+
+            csvcolumns_clear_column(c);
+            if (result < 0) {
+                csvcolumns_destroy(t);
+                return -1;
+            }
+            c->fType = (c->fType == CSV_COLUMN_TYPE_INT64) ? CSV_COLUMN_TYPE_DOUBLE : CSV_COLUMN_TYPE_STRING;
+        }
+    }
+
+    return 0;
+}
+
+// csvcolumns_find()
+// The index of the column with the given name
+// Return
+//   -1 - there is no such column
+static int csvcolumns_find(const csvcolumns *t, const bspan *name) PC_NOEXCEPT_C
+{
+    size_t n = bspan_size(name);
+    for (size_t i = 0; i < t->fColumnCount; i++) {
+        const bspan *s = &t->fColumns[i].fName;
+        if ((bspan_size(s) == n) && ((n == 0) || (memcmp(bspan_begin(s), bspan_begin(name), n) == 0)))
+            return (int)i;
+    }
+
+    return -1;
+}
+
+static int csvcolumns_find_cstr(const csvcolumns *t, const char *name) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, name);
+
+    return csvcolumns_find(t, &s);
+}
+
+static bool csvcolumn_is_null(const csvcolumn *c, size_t row) PC_NOEXCEPT_C
+{
+    return ((c->fNulls[row / 64] >> (row % 64)) & 1) != 0;
+}
+
+// csvcolumn_string()
+// The value of a row of a STRING or CATEGORY column
+// Return
+//    0 - success
+//   -1 - the column holds some other type
+static int csvcolumn_string(const csvcolumns *t, const csvcolumn *c, size_t row, bspan *value) PC_NOEXCEPT_C
+{
+    if (c->fType == CSV_COLUMN_TYPE_CATEGORY) {
+        if (csvcolumn_is_null(c, row))
+            return bspan_init_from_pointers(value, t->fBase, t->fBase);
+        return interntable_span(&c->fCategories, c->fCodes[row], value);
+    }
+
+    if (c->fType == CSV_COLUMN_TYPE_STRING)
+        return bspan_init_from_pointers(value, t->fBase + c->fOffsets[row * 2], t->fBase + c->fOffsets[(row * 2) + 1]);
+
+    return -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CSVCOLUMNS_H_INCLUDED
@@ -0,0 +1,266 @@
+#ifndef CSVCURSOR_H_INCLUDED
+#define CSVCURSOR_H_INCLUDED
+
+//
+// csvcursor
+// Going through the rows of a CSV source, one at a time, without
+// allocating anything per row.
+//
+// The cursor holds a single array of fields, which is filled in again
+// for each row.  It only grows when a row has more fields than any row
+// before it, so after the first few rows, there is no heap traffic at
+// all.  The fields are spans of the source, quotes and all, and are only
+// good until the next row is read.
+//
+// Rows are found with the same 64 byte block scan as csvscan.h.  The
+// cursor keeps the masks of the block it is in, so each block of the
+// source is classified once, however many rows are in it.
+//
+// The first row can be taken as the column headings.  The names are
+// interned (interntable.h), so finding the ordinal of a column by name
+// is a hash and a compare, and is meant to be done once,
+// before going through the rows, not for every row.  Names are looked
+// up without the spaces around them, or their quotes.
+//
+// Typical usage:
+//   csvcursor cur;
+//   csvcursor_init(&cur, &src, ',');
+//   csvcursor_read_headings(&cur);
+//   int time = csvcursor_ordinal_cstr(&cur, "Time");
+//
+//   while (csvcursor_next(&cur) == 0) {
+//       bspan value;
+//       csvcursor_field(&cur, time, &value);
+//   }
+//
+//   csvcursor_destroy(&cur);
+//
+
+#include <stdlib.h>     // realloc, malloc, free
+
+#include "pcoredef.h"
+#include "bithacks.h"
+#include "bspan.h"
+#include "interntable.h"
+#include "csvscan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct csvcursor_t {
+    const unsigned char *fBase;     // the source
+    size_t fLength;
+    unsigned char fDelimiter;
+    size_t fRowStart;               // where the next row starts
+
+    // The block the scan is in
+    size_t fBlock;
+    uint64_t fBits;                 // unquoted delimiters and newlines, not yet used
+    uint64_t fNewlines;
+    uint64_t fCarry;
+    bool fBlockReady;
+
+    // The fields of the current row
+    bspan *fFields;
+    size_t fFieldCount;
+    size_t fFieldCapacity;
+
+    // The column headings
+    interntable fNames;
+    uint32_t *fOrdinals;            // the column of each name, by name id
+};
+typedef struct csvcursor_t csvcursor;
+
+static int csvcursor_init(csvcursor *c, const bspan *src, unsigned char delim) PC_NOEXCEPT_C;
+static int csvcursor_destroy(csvcursor *c) PC_NOEXCEPT_C;
+static int csvcursor_next(csvcursor *c) PC_NOEXCEPT_C;
+static int csvcursor_read_headings(csvcursor *c) PC_NOEXCEPT_C;
+static size_t csvcursor_field_count(const csvcursor *c) PC_NOEXCEPT_C;
+static int csvcursor_field(const csvcursor *c, size_t col, bspan *value) PC_NOEXCEPT_C;
+static int csvcursor_ordinal(const csvcursor *c, const bspan *name) PC_NOEXCEPT_C;
+static int csvcursor_ordinal_cstr(const csvcursor *c, const char *name) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+static int csvcursor_init(csvcursor *c, const bspan *src, unsigned char delim) PC_NOEXCEPT_C
+{
+    memset(c, 0, sizeof(csvcursor));
+    c->fBase = bspan_begin(src);
+    c->fLength = bspan_size(src);
+    c->fDelimiter = delim;
+
+    return 0;
+}
+
+static int csvcursor_destroy(csvcursor *c) PC_NOEXCEPT_C
+{
+    free(c->fFields);
+    interntable_destroy(&c->fNames);
+    free(c->fOrdinals);
+    memset(c, 0, sizeof(csvcursor));
+
+    return 0;
+}
+
+static size_t csvcursor_field_count(const csvcursor *c) PC_NOEXCEPT_C { return c->fFieldCount; }
+
+// csvcursor_add_field()
+// Add a field to the current row, growing the array if this
+// row is wider than any before it
+static int csvcursor_add_field(csvcursor *c, size_t start, size_t end) PC_NOEXCEPT_C
+{
+    if (c->fFieldCount == c->fFieldCapacity)
+    {
+        size_t cap = (c->fFieldCapacity < 16) ? 16 : c->fFieldCapacity * 2;
+        bspan *fields = (bspan *)realloc(c->fFields, cap * sizeof(bspan));
+        if (fields == nullptr)
+            return -1;
+        c->fFields = fields;
+        c->fFieldCapacity = cap;
+    }
+
+    return bspan_init_from_pointers(&c->fFields[c->fFieldCount++], c->fBase + start, c->fBase + end);
+}
+
+// csvcursor_next()
+// Read the next row.  A '\n' inside of quotes does not end the row, and
+// the '\r' of a '\r\n' is not part of the last field.
+// Return
+//    0 - success
+//   -1 - there are no more rows, or out of memory
+static int csvcursor_next(csvcursor *c) PC_NOEXCEPT_C
+{
+    c->fFieldCount = 0;
+    if (c->fRowStart >= c->fLength)
+        return -1;
+
+    size_t fieldStart = c->fRowStart;
+    while (true)
+    {
+        // The source ran out before a '\n'
+        if (!c->fBlockReady && (c->fBlock >= c->fLength)) {
+            c->fRowStart = c->fLength;
+            return csvcursor_add_field(c, fieldStart, c->fLength);
+        }
+
+        if (!c->fBlockReady)
+        {
+            csvindex_masks m;
+            size_t avail = c->fLength - c->fBlock;
+            csvindex_classify(c->fBase + c->fBlock, (avail < CSVINDEX_BLOCK_SIZE) ? avail : CSVINDEX_BLOCK_SIZE, c->fDelimiter, &m);
+
+            uint64_t inside = csvindex_prefix_xor(m.fQuote) ^ c->fCarry;
+            c->fCarry = CSVINDEX_CARRY(inside);
+            c->fNewlines = m.fNewline & ~inside;
+            c->fBits = (m.fDelimiter & ~inside) | c->fNewlines;
+            c->fBlockReady = true;
+        }
+
+        while (c->fBits != 0)
+        {
+            int bit = bhak_ctz64(c->fBits);
+            size_t end = c->fBlock + (size_t)bit;
+            c->fBits &= c->fBits - 1;
+
+            if ((c->fNewlines >> bit) & 1) {
+                if ((end > fieldStart) && (c->fBase[end - 1] == '\r'))
+                    end--;
+                c->fRowStart = c->fBlock + (size_t)bit + 1;
+                return csvcursor_add_field(c, fieldStart, end);
+            }
+
+            if (csvcursor_add_field(c, fieldStart, end) != 0)
+                return -1;
+            fieldStart = end + 1;
+        }
+
+        c->fBlock += CSVINDEX_BLOCK_SIZE;
+        c->fBlockReady = false;
+    }
+}
+
+// csvcursor_field()
+// A field of the current row
+// Return
+//    0 - success
+//   -1 - the row has no such field
+static int csvcursor_field(const csvcursor *c, size_t col, bspan *value) PC_NOEXCEPT_C
+{
+    if (col >= c->fFieldCount)
+        return -1;
+
+    *value = c->fFields[col];
+
+    return 0;
+}
+
+//
+// Column headings
+//
+
+// csvcursor_read_headings()
+// Read the next row, which is usually the first, as the names of the
+// columns.  When a name is there more than once, the first one is the
+// one found by name.
+// Return
+//    0 - success
+//   -1 - there are no more rows, or out of memory
+static int csvcursor_read_headings(csvcursor *c) PC_NOEXCEPT_C
+{
+    if (csvcursor_next(c) != 0)
+        return -1;
+
+    size_t n = c->fFieldCount;
+    interntable_destroy(&c->fNames);
+    free(c->fOrdinals);
+    c->fOrdinals = (uint32_t *)malloc(n * sizeof(uint32_t));
+    if (c->fOrdinals == nullptr)
+        return -1;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        bspan name = c->fFields[i];
+        csv_field_trim(&name);
+
+        // A new name gets the next id
+        size_t count = interntable_count(&c->fNames);
+        uint32_t id = interntable_intern(&c->fNames, &name);
+        if (id == INTERNTABLE_NONE) {
+            interntable_destroy(&c->fNames);
+            return -1;
+        }
+        if (id == count)
+            c->fOrdinals[id] = (uint32_t)i;
+    }
+
+    return 0;
+}
+
+// csvcursor_ordinal()
+// The ordinal of the column with the given name
+// Return
+//   -1 - there is no such column
+static int csvcursor_ordinal(const csvcursor *c, const bspan *name) PC_NOEXCEPT_C
+{
+    bspan s = *name;
+    csv_field_trim(&s);
+    uint32_t id = interntable_find(&c->fNames, &s);
+
+    return (id == INTERNTABLE_NONE) ? -1 : (int)c->fOrdinals[id];
+}
+
+static int csvcursor_ordinal_cstr(const csvcursor *c, const char *name) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, name);
+
+    return csvcursor_ordinal(c, &s);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CSVCURSOR_H_INCLUDED
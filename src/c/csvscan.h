@@ -0,0 +1,807 @@
+#ifndef CSVSCAN_H_INCLUDED
+#define CSVSCAN_H_INCLUDED
+
+//
+// csvscan
+// Splitting CSV into rows and fields, 64 bytes at a time.
+//
+// Each block of the source is classified into bitmasks, one bit per
+// byte, for the quote, delimiter, and newline characters.  Which bytes
+// are inside of quotes is the prefix-XOR of the quote mask: bit 'i' is
+// the XOR of quote bits 0 through 'i', which is one carry-less multiply
+// (PCLMULQDQ) of the quote mask by all ones.  The state at the end of
+// one block carries into the next.  Delimiters and newlines inside of
+// quotes are dropped, and the positions of the rest are written to the
+// index, in order.  So a quoted field can hold delimiters, newlines,
+// and doubled quotes ("") without anything special being done for them.
+//
+// The index is two lists:
+//   fFieldEnds  - the offset of the byte that ends each field, which is
+//                 the delimiter or '\n' after it
+//   fRowEnds    - for each row, the number of fields up to, and
+//                 including, its last one
+// Field 'i' starts just past the end of field 'i-1', so no starts
+// are kept.  Rows end at '\n'.  The '\r' of a '\r\n' is left on the
+// last field of the row, and csvindex_field() takes it off.
+//
+// Fields are spans of the source, quotes and all.  csv_field_unquote()
+// takes off the outer quotes, but doubled quotes stay doubled.
+//
+// Like the xml index, offsets are 32 bits, so a source of 4GB or more
+// has to be indexed in pieces.  csvindex_build_part() indexes one piece,
+// and, since a piece might start inside of quotes, can index it both ways
+// in the same pass (see csvparallel.h).
+//
+// For going through a source a line at a time, without an index,
+// csv_read_line() finds the end of a line with the same block scan, and
+// a csvfielditer splits the line at the delimiters that aren't quoted.
+//
+// Typical usage:
+//   csvindex idx;
+//   csvindex_init(&idx);
+//   csv_skip_bom(&src);
+//   csvindex_build(&idx, &src, ',');
+//
+//   for (size_t row = 0; row < csvindex_row_count(&idx); row++)
+//       for (size_t col = 0; col < csvindex_field_count(&idx, row); col++) {
+//           bspan value;
+//           csvindex_field(&idx, row, col, &value);
+//       }
+//
+//   csvindex_destroy(&idx);
+//
+
+#include <stdlib.h>     // realloc, free
+
+#include "pcoredef.h"
+#include "bithacks.h"
+#include "cpufeat.h"
+#include "bspan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSVINDEX_BLOCK_SIZE 64
+#define CSVINDEX_MAX_SIZE ((size_t)0xffffffffu)
+
+// The classification of a 64 byte block
+struct csvindex_masks_t {
+    uint64_t fQuote;        // '"'
+    uint64_t fDelimiter;    // usually ','
+    uint64_t fNewline;      // '\n'
+};
+typedef struct csvindex_masks_t csvindex_masks;
+
+struct csvindex_t {
+    const unsigned char *fBase;     // start of the source that was indexed
+    size_t fLength;
+    unsigned char fDelimiter;
+
+    uint32_t *fFieldEnds;           // offset of the delimiter or '\n' after each field
+    size_t fFieldCount;
+    size_t fFieldCapacity;
+
+    uint32_t *fRowEnds;             // fields up to the end of each row
+    size_t fRowCount;
+    size_t fRowCapacity;
+
+    bool fEndsInQuote;              // the source ended inside of a quoted field
+};
+typedef struct csvindex_t csvindex;
+
+// The whole blocks from 'offset' up to 'end', with 'carry' being
+// all ones when the first block starts inside of quotes.  When 'alt'
+// is not null, it gets the index for the opposite starting state.
+typedef int (*csvindex_scan_fn)(csvindex *x, csvindex *alt, size_t offset, size_t end, uint64_t *carry);
+
+// Splitting a single line into fields
+struct csvfielditer_t {
+    bspan fLine;
+    unsigned char fDelimiter;
+    bool fDone;
+};
+typedef struct csvfielditer_t csvfielditer;
+
+static int csvindex_init(csvindex *x) PC_NOEXCEPT_C;
+static int csvindex_destroy(csvindex *x) PC_NOEXCEPT_C;
+static int csvindex_build(csvindex *x, const bspan *src, unsigned char delim) PC_NOEXCEPT_C;
+static int csvindex_build_part(csvindex *x, csvindex *alt, const bspan *src, unsigned char delim) PC_NOEXCEPT_C;
+static size_t csvindex_row_count(const csvindex *x) PC_NOEXCEPT_C;
+static size_t csvindex_field_count(const csvindex *x, size_t row) PC_NOEXCEPT_C;
+static int csvindex_field(const csvindex *x, size_t row, size_t col, bspan *value) PC_NOEXCEPT_C;
+static int csvindex_row(const csvindex *x, size_t row, bspan *line) PC_NOEXCEPT_C;
+static int csvindex_classify(const unsigned char *data, size_t n, unsigned char delim, csvindex_masks *m) PC_NOEXCEPT_C;
+static uint64_t csvindex_prefix_xor(uint64_t bits) PC_NOEXCEPT_C;
+
+static int csv_skip_bom(bspan *src) PC_NOEXCEPT_C;
+static int csv_read_line(bspan *src, bspan *line) PC_NOEXCEPT_C;
+static int csv_field_unquote(bspan *field) PC_NOEXCEPT_C;
+static int csv_field_trim(bspan *field) PC_NOEXCEPT_C;
+static int csv_field_iter_init(csvfielditer *iter, const bspan *line, unsigned char delim) PC_NOEXCEPT_C;
+static int csv_field_iter_next(csvfielditer *iter, bspan *field) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+//
+// Kernels
+//
+static void csvindex_kern_classify_scalar(const unsigned char *block, unsigned char delim, csvindex_masks *m) PC_NOEXCEPT_C
+{
+    memset(m, 0, sizeof(csvindex_masks));
+
+    for (int i = 0; i < CSVINDEX_BLOCK_SIZE; i++)
+    {
+        uint64_t bit = (uint64_t)1 << i;
+        unsigned char c = block[i];
+        if (c == '"') m->fQuote |= bit;
+        else if (c == delim) m->fDelimiter |= bit;
+        else if (c == '\n') m->fNewline |= bit;
+    }
+}
+
+// Bit 'i' of the result is the XOR of bits 0 through 'i'
+static uint64_t csvindex_kern_prefix_xor_scalar(uint64_t bits) PC_NOEXCEPT_C
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+
+    return bits;
+}
+
+// csvindex_emit()
+// Take the quoted parts out of a block's masks, and write the
+// positions of what's left into the index.  There is always
+// room for a whole block, from csvindex_reserve().
+static INLINE void csvindex_emit(csvindex *x, size_t offset, const csvindex_masks *m, uint64_t inside) PC_NOEXCEPT_C
+{
+    uint64_t newlines = m->fNewline & ~inside;
+    uint64_t bits = (m->fDelimiter & ~inside) | newlines;
+
+    uint32_t *out = x->fFieldEnds + x->fFieldCount;
+    uint32_t blockBase = (uint32_t)offset;
+
+    if (newlines == 0) {
+        while (bits != 0) {
+            *out++ = blockBase + (uint32_t)bhak_ctz64(bits);
+            bits &= bits - 1;
+        }
+    }
+    else {
+        uint32_t *rows = x->fRowEnds + x->fRowCount;
+        while (bits != 0) {
+            int bit = bhak_ctz64(bits);
+            *out++ = blockBase + (uint32_t)bit;
+            if ((newlines >> bit) & 1)
+                *rows++ = (uint32_t)(out - x->fFieldEnds);
+            bits &= bits - 1;
+        }
+        x->fRowCount = (size_t)(rows - x->fRowEnds);
+    }
+
+    x->fFieldCount = (size_t)(out - x->fFieldEnds);
+}
+
+// csvindex_reserve()
+// Make sure there's room for another whole block of positions
+static int csvindex_reserve(csvindex *x) PC_NOEXCEPT_C
+{
+    if (x->fFieldCapacity - x->fFieldCount < CSVINDEX_BLOCK_SIZE)
+    {
+        size_t newCapacity = (x->fFieldCapacity < 1024) ? 1024 : x->fFieldCapacity * 2;
+        uint32_t *newEnds = (uint32_t *)realloc(x->fFieldEnds, newCapacity * sizeof(uint32_t));
+        if (newEnds == nullptr)
+            return -1;
+        x->fFieldEnds = newEnds;
+        x->fFieldCapacity = newCapacity;
+    }
+
+    if (x->fRowCapacity - x->fRowCount < CSVINDEX_BLOCK_SIZE)
+    {
+        size_t newCapacity = (x->fRowCapacity < 1024) ? 1024 : x->fRowCapacity * 2;
+        uint32_t *newEnds = (uint32_t *)realloc(x->fRowEnds, newCapacity * sizeof(uint32_t));
+        if (newEnds == nullptr)
+            return -1;
+        x->fRowEnds = newEnds;
+        x->fRowCapacity = newCapacity;
+    }
+
+    return 0;
+}
+
+// The carry for the next block, all ones if this one ended inside of quotes
+#define CSVINDEX_CARRY(inside) ((uint64_t)((int64_t)(inside) >> 63))
+
+static int csvindex_kern_scan_scalar(csvindex *x, csvindex *alt, size_t offset, size_t end, uint64_t *carry) PC_NOEXCEPT_C
+{
+    csvindex_masks m;
+    uint64_t c = *carry;
+
+    for (; offset < end; offset += CSVINDEX_BLOCK_SIZE)
+    {
+        if ((csvindex_reserve(x) != 0) || ((alt != nullptr) && (csvindex_reserve(alt) != 0)))
+            return -1;
+
+        csvindex_kern_classify_scalar(x->fBase + offset, x->fDelimiter, &m);
+        uint64_t inside = csvindex_kern_prefix_xor_scalar(m.fQuote) ^ c;
+        c = CSVINDEX_CARRY(inside);
+        csvindex_emit(x, offset, &m, inside);
+        if (alt != nullptr)
+            csvindex_emit(alt, offset, &m, ~inside);
+    }
+    *carry = c;
+
+    return 0;
+}
+
+#if defined(PC_ARCH_X86)
+// SSE2 - four 16 byte pieces
+PC_TARGET_SSE2
+static void csvindex_kern_classify_sse2(const unsigned char *block, unsigned char delim, csvindex_masks *m) PC_NOEXCEPT_C
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i dlm = _mm_set1_epi8((char)delim);
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    memset(m, 0, sizeof(csvindex_masks));
+
+    for (int i = 0; i < 4; i++)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + (16 * i)));
+        int shift = 16 * i;
+
+        m->fQuote |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << shift;
+        m->fDelimiter |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, dlm)) << shift;
+        m->fNewline |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf)) << shift;
+    }
+}
+
+PC_TARGET_SSE2
+static int csvindex_kern_scan_sse2(csvindex *x, csvindex *alt, size_t offset, size_t end, uint64_t *carry) PC_NOEXCEPT_C
+{
+    csvindex_masks m;
+    uint64_t c = *carry;
+
+    for (; offset < end; offset += CSVINDEX_BLOCK_SIZE)
+    {
+        if ((csvindex_reserve(x) != 0) || ((alt != nullptr) && (csvindex_reserve(alt) != 0)))
+            return -1;
+
+        csvindex_kern_classify_sse2(x->fBase + offset, x->fDelimiter, &m);
+        uint64_t inside = csvindex_kern_prefix_xor_scalar(m.fQuote) ^ c;
+        c = CSVINDEX_CARRY(inside);
+        csvindex_emit(x, offset, &m, inside);
+        if (alt != nullptr)
+            csvindex_emit(alt, offset, &m, ~inside);
+    }
+    *carry = c;
+
+    return 0;
+}
+
+// The prefix-XOR as a carry-less multiply by all ones
+#define CSVINDEX_CLMUL_PREFIX_XOR(bits) \
+    ((uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_cvtsi64_si128((long long)(bits)), _mm_set1_epi8((char)0xff), 0)))
+
+PC_TARGET_PCLMUL
+static uint64_t csvindex_kern_prefix_xor_pclmul(uint64_t bits) PC_NOEXCEPT_C
+{
+    return CSVINDEX_CLMUL_PREFIX_XOR(bits);
+}
+
+// SSE2 compares, with the prefix-XOR from PCLMULQDQ
+PC_TARGET_PCLMUL
+static int csvindex_kern_scan_pclmul(csvindex *x, csvindex *alt, size_t offset, size_t end, uint64_t *carry) PC_NOEXCEPT_C
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i dlm = _mm_set1_epi8((char)x->fDelimiter);
+    const __m128i lf = _mm_set1_epi8('\n');
+    csvindex_masks m;
+    uint64_t c = *carry;
+
+    for (; offset < end; offset += CSVINDEX_BLOCK_SIZE)
+    {
+        if ((csvindex_reserve(x) != 0) || ((alt != nullptr) && (csvindex_reserve(alt) != 0)))
+            return -1;
+
+        memset(&m, 0, sizeof(m));
+        for (int i = 0; i < 4; i++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(x->fBase + offset + (16 * i)));
+            int shift = 16 * i;
+
+            m.fQuote |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << shift;
+            m.fDelimiter |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, dlm)) << shift;
+            m.fNewline |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf)) << shift;
+        }
+
+        uint64_t inside = CSVINDEX_CLMUL_PREFIX_XOR(m.fQuote) ^ c;
+        c = CSVINDEX_CARRY(inside);
+        csvindex_emit(x, offset, &m, inside);
+        if (alt != nullptr)
+            csvindex_emit(alt, offset, &m, ~inside);
+    }
+    *carry = c;
+
+    return 0;
+}
+
+// AVX2 - two 32 byte halves
+PC_TARGET_AVX2
+static void csvindex_kern_classify_avx2(const unsigned char *block, unsigned char delim, csvindex_masks *m) PC_NOEXCEPT_C
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i dlm = _mm256_set1_epi8((char)delim);
+    const __m256i lf = _mm256_set1_epi8('\n');
+
+    __m256i lo = _mm256_loadu_si256((const __m256i *)block);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+
+#define CSVINDEX_MASK64(v) \
+    ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v)) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v)) << 32))
+
+    m->fQuote = CSVINDEX_MASK64(quote);
+    m->fDelimiter = CSVINDEX_MASK64(dlm);
+    m->fNewline = CSVINDEX_MASK64(lf);
+
+#undef CSVINDEX_MASK64
+}
+
+PC_TARGET_AVX2_PCLMUL
+static int csvindex_kern_scan_avx2(csvindex *x, csvindex *alt, size_t offset, size_t end, uint64_t *carry) PC_NOEXCEPT_C
+{
+    csvindex_masks m;
+    uint64_t c = *carry;
+
+    for (; offset < end; offset += CSVINDEX_BLOCK_SIZE)
+    {
+        if ((csvindex_reserve(x) != 0) || ((alt != nullptr) && (csvindex_reserve(alt) != 0)))
+            return -1;
+
+        csvindex_kern_classify_avx2(x->fBase + offset, x->fDelimiter, &m);
+        uint64_t inside = CSVINDEX_CLMUL_PREFIX_XOR(m.fQuote) ^ c;
+        c = CSVINDEX_CARRY(inside);
+        csvindex_emit(x, offset, &m, inside);
+        if (alt != nullptr)
+            csvindex_emit(alt, offset, &m, ~inside);
+    }
+    *carry = c;
+
+    return 0;
+}
+
+// AVX-512 - the whole block at once, straight into mask registers
+PC_TARGET_AVX512BW
+static void csvindex_kern_classify_avx512(const unsigned char *block, unsigned char delim, csvindex_masks *m) PC_NOEXCEPT_C
+{
+    __m512i v = _mm512_loadu_si512((const void *)block);
+
+    m->fQuote = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('"'));
+    m->fDelimiter = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8((char)delim));
+    m->fNewline = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'));
+}
+
+PC_TARGET_AVX512BW_PCLMUL
+static int csvindex_kern_scan_avx512(csvindex *x, csvindex *alt, size_t offset, size_t end, uint64_t *carry) PC_NOEXCEPT_C
+{
+    csvindex_masks m;
+    uint64_t c = *carry;
+
+    for (; offset < end; offset += CSVINDEX_BLOCK_SIZE)
+    {
+        if ((csvindex_reserve(x) != 0) || ((alt != nullptr) && (csvindex_reserve(alt) != 0)))
+            return -1;
+
+        csvindex_kern_classify_avx512(x->fBase + offset, x->fDelimiter, &m);
+        uint64_t inside = CSVINDEX_CLMUL_PREFIX_XOR(m.fQuote) ^ c;
+        c = CSVINDEX_CARRY(inside);
+        csvindex_emit(x, offset, &m, inside);
+        if (alt != nullptr)
+            csvindex_emit(alt, offset, &m, ~inside);
+    }
+    *carry = c;
+
+    return 0;
+}
+#endif  // PC_ARCH_X86
+
+typedef void (*csvindex_classify_fn)(const unsigned char *block, unsigned char delim, csvindex_masks *m);
+typedef uint64_t (*csvindex_prefix_xor_fn)(uint64_t bits);
+
+struct csvindex_kernels_t {
+    csvindex_classify_fn fClassify;
+    csvindex_prefix_xor_fn fPrefixXor;
+    csvindex_scan_fn fScan;
+};
+typedef struct csvindex_kernels_t csvindex_kernels;
+
+static csvindex_kernels csvindex_select_kernels() PC_NOEXCEPT_C
+{
+    csvindex_kernels k = { csvindex_kern_classify_scalar, csvindex_kern_prefix_xor_scalar, csvindex_kern_scan_scalar };
+
+#if defined(PC_ARCH_X86)
+    bool pclmul = pc_cpu_has(PC_CPU_PCLMUL);
+
+    if (pc_cpu_has(PC_CPU_SSE2)) {
+        k.fClassify = csvindex_kern_classify_sse2;
+        k.fScan = csvindex_kern_scan_sse2;
+    }
+    if (pclmul && pc_cpu_has(PC_CPU_SSE41)) {
+        k.fPrefixXor = csvindex_kern_prefix_xor_pclmul;
+        k.fScan = csvindex_kern_scan_pclmul;
+    }
+    if (pc_cpu_has(PC_CPU_AVX2)) {
+        k.fClassify = csvindex_kern_classify_avx2;
+        if (pclmul)
+            k.fScan = csvindex_kern_scan_avx2;
+    }
+    if (pc_cpu_has(PC_CPU_AVX512BW)) {
+        k.fClassify = csvindex_kern_classify_avx512;
+        if (pclmul)
+            k.fScan = csvindex_kern_scan_avx512;
+    }
+#endif
+
+    return k;
+}
+
+static const csvindex_kernels * csvindex_get_kernels() PC_NOEXCEPT_C
+{
+    static const csvindex_kernels kernels = csvindex_select_kernels();
+
+    return &kernels;
+}
+
+// csvindex_classify()
+// Classify up to 64 bytes.  When there are fewer than 64, the
+// bits past the end are all zero.
+static int csvindex_classify(const unsigned char *data, size_t n, unsigned char delim, csvindex_masks *m) PC_NOEXCEPT_C
+{
+    if (n >= CSVINDEX_BLOCK_SIZE) {
+        csvindex_get_kernels()->fClassify(data, delim, m);
+        return 0;
+    }
+
+    // Zero bytes are not in any of the classes, unless
+    // zero is the delimiter, so take those bits back off
+    unsigned char block[CSVINDEX_BLOCK_SIZE] = { 0 };
+    memcpy(block, data, n);
+    csvindex_get_kernels()->fClassify(block, delim, m);
+    if (n < CSVINDEX_BLOCK_SIZE)
+        m->fDelimiter &= ((uint64_t)1 << n) - 1;
+
+    return 0;
+}
+
+// csvindex_prefix_xor()
+// Bit 'i' of the result is the XOR of bits 0 through 'i' of 'bits'
+static uint64_t csvindex_prefix_xor(uint64_t bits) PC_NOEXCEPT_C
+{
+    return csvindex_get_kernels()->fPrefixXor(bits);
+}
+
+static int csvindex_init(csvindex *x) PC_NOEXCEPT_C
+{
+    memset(x, 0, sizeof(csvindex));
+    x->fDelimiter = ',';
+
+    return 0;
+}
+
+static int csvindex_destroy(csvindex *x) PC_NOEXCEPT_C
+{
+    free(x->fFieldEnds);
+    free(x->fRowEnds);
+    memset(x, 0, sizeof(csvindex));
+
+    return 0;
+}
+
+static size_t csvindex_row_count(const csvindex *x) PC_NOEXCEPT_C { return x->fRowCount; }
+
+// csvindex_start()
+// Ready the index for a build over the source
+static void csvindex_start(csvindex *x, const unsigned char *base, size_t n, unsigned char delim) PC_NOEXCEPT_C
+{
+    x->fBase = base;
+    x->fLength = n;
+    x->fDelimiter = delim;
+    x->fFieldCount = 0;
+    x->fRowCount = 0;
+    x->fEndsInQuote = false;
+}
+
+// csvindex_build_part()
+// Index a piece of a larger source, which might start inside of
+// quotes.  'x' gets the index as if the piece starts outside of quotes,
+// and 'alt', when it isn't null, as if it starts inside of them.  Both
+// come from the one pass over the source.  Whatever follows the last
+// '\n' is left out of the rows, as it is the start of a row which
+// ends in the next piece.
+// Return
+//    0 - success
+//   -1 - the source is too large, or out of memory
+static int csvindex_build_part(csvindex *x, csvindex *alt, const bspan *src, unsigned char delim) PC_NOEXCEPT_C
+{
+    const unsigned char *base = bspan_begin(src);
+    size_t n = bspan_size(src);
+
+    csvindex_start(x, base, n, delim);
+    if (alt != nullptr)
+        csvindex_start(alt, base, n, delim);
+
+    if (n > CSVINDEX_MAX_SIZE)
+        return -1;
+
+    // The whole blocks, then what's left over
+    uint64_t carry = 0;
+    size_t whole = n - (n % CSVINDEX_BLOCK_SIZE);
+    if (csvindex_get_kernels()->fScan(x, alt, 0, whole, &carry) != 0)
+        return -1;
+
+    if (whole < n)
+    {
+        if ((csvindex_reserve(x) != 0) || ((alt != nullptr) && (csvindex_reserve(alt) != 0)))
+            return -1;
+
+        csvindex_masks m;
+        csvindex_classify(base + whole, n - whole, delim, &m);
+        uint64_t inside = csvindex_prefix_xor(m.fQuote) ^ carry;
+        carry = CSVINDEX_CARRY(inside);
+        csvindex_emit(x, whole, &m, inside);
+        if (alt != nullptr)
+            csvindex_emit(alt, whole, &m, ~inside);
+    }
+    x->fEndsInQuote = (carry != 0);
+    if (alt != nullptr)
+        alt->fEndsInQuote = (carry == 0);
+
+    return 0;
+}
+
+// csvindex_build()
+// Index the fields and rows of the source.  The index refers to the
+// source memory, which must stay put for as long as it is used.
+// Return
+//    0 - success
+//   -1 - the source is too large, or out of memory
+static int csvindex_build(csvindex *x, const bspan *src, unsigned char delim) PC_NOEXCEPT_C
+{
+    if (csvindex_build_part(x, nullptr, src, delim) != 0)
+        return -1;
+
+    // A last row without a '\n' at the end of it
+    size_t n = x->fLength;
+    size_t rowStart = (x->fRowCount > 0) ? (size_t)x->fFieldEnds[x->fRowEnds[x->fRowCount - 1] - 1] + 1 : 0;
+    if (rowStart < n)
+    {
+        if (csvindex_reserve(x) != 0)
+            return -1;
+
+        x->fFieldEnds[x->fFieldCount++] = (uint32_t)n;
+        x->fRowEnds[x->fRowCount++] = (uint32_t)x->fFieldCount;
+    }
+
+    return 0;
+}
+
+// csvindex_field_count()
+// The number of fields in a row
+static size_t csvindex_field_count(const csvindex *x, size_t row) PC_NOEXCEPT_C
+{
+    if (row >= x->fRowCount)
+        return 0;
+
+    uint32_t first = (row > 0) ? x->fRowEnds[row - 1] : 0;
+
+    return x->fRowEnds[row] - first;
+}
+
+// csvindex_field()
+// A field of a row, as it is in the source.  The '\r' of a
+// '\r\n' line ending is not part of the last field.
+// Return
+//    0 - success
+//   -1 - there is no such row, or field
+static int csvindex_field(const csvindex *x, size_t row, size_t col, bspan *value) PC_NOEXCEPT_C
+{
+    if (col >= csvindex_field_count(x, row))
+        return -1;
+
+    size_t i = ((row > 0) ? x->fRowEnds[row - 1] : 0) + col;
+    size_t start = (i > 0) ? (size_t)x->fFieldEnds[i - 1] + 1 : 0;
+    size_t end = x->fFieldEnds[i];
+
+    if ((end > start) && (end < x->fLength) && (x->fBase[end] == '\n') && (x->fBase[end - 1] == '\r'))
+        end--;
+
+    return bspan_init_from_pointers(value, x->fBase + start, x->fBase + end);
+}
+
+// csvindex_row()
+// The whole of a row, without its line ending
+static int csvindex_row(const csvindex *x, size_t row, bspan *line) PC_NOEXCEPT_C
+{
+    if (row >= x->fRowCount)
+        return -1;
+
+    size_t first = (row > 0) ? x->fRowEnds[row - 1] : 0;
+    size_t start = (first > 0) ? (size_t)x->fFieldEnds[first - 1] + 1 : 0;
+    size_t end = x->fFieldEnds[x->fRowEnds[row] - 1];
+
+    if ((end > start) && (end < x->fLength) && (x->fBase[end - 1] == '\r'))
+        end--;
+
+    return bspan_init_from_pointers(line, x->fBase + start, x->fBase + end);
+}
+
+// csv_skip_bom()
+// Step over a UTF-8 Byte Order Mark, if there is one
+// Return
+//    1 - there was a BOM
+//    0 - there wasn't
+static int csv_skip_bom(bspan *src) PC_NOEXCEPT_C
+{
+    const unsigned char *p = bspan_begin(src);
+    if ((bspan_size(src) >= 3) && (p[0] == 0xEF) && (p[1] == 0xBB) && (p[2] == 0xBF)) {
+        bspan_advance(src, 3);
+        return 1;
+    }
+
+    return 0;
+}
+
+// csv_read_line()
+// Take the next line from the source, without its line ending.  A
+// '\n' inside of quotes does not end the line.  The source is moved
+// to the start of the line after.
+// Return
+//    0 - success
+//   -1 - there is nothing left in the source
+static int csv_read_line(bspan *src, bspan *line) PC_NOEXCEPT_C
+{
+    const unsigned char *start = bspan_begin(src);
+    const unsigned char *end = bspan_end(src);
+    if (start >= end)
+        return -1;
+
+    size_t n = (size_t)(end - start);
+    const unsigned char *lineEnd = end;
+    uint64_t carry = 0;
+    csvindex_masks m;
+
+    for (size_t offset = 0; offset < n; offset += CSVINDEX_BLOCK_SIZE)
+    {
+        size_t avail = n - offset;
+        csvindex_classify(start + offset, (avail < CSVINDEX_BLOCK_SIZE) ? avail : CSVINDEX_BLOCK_SIZE, ',', &m);
+
+        // Don't bother with the quotes until there's a newline to check
+        if (m.fNewline == 0) {
+            carry ^= (uint64_t)0 - (uint64_t)(bhak_popcount64(m.fQuote) & 1);
+            continue;
+        }
+
+        uint64_t inside = csvindex_prefix_xor(m.fQuote) ^ carry;
+        uint64_t newlines = m.fNewline & ~inside;
+        if (newlines != 0) {
+            lineEnd = start + offset + bhak_ctz64(newlines);
+            break;
+        }
+        carry = CSVINDEX_CARRY(inside);
+    }
+
+    const unsigned char *next = (lineEnd < end) ? lineEnd + 1 : end;
+    if ((lineEnd > start) && (lineEnd < end) && (lineEnd[-1] == '\r'))
+        lineEnd--;
+
+    bspan_init_from_pointers(line, start, lineEnd);
+    bspan_set_begin(src, next);
+
+    return 0;
+}
+
+// csv_field_unquote()
+// Take the quotes off of a quoted field.  Doubled
+// quotes inside of it are left as they are.
+// Return
+//    1 - the field was quoted
+//    0 - it wasn't
+static int csv_field_unquote(bspan *field) PC_NOEXCEPT_C
+{
+    const unsigned char *p = bspan_begin(field);
+    size_t n = bspan_size(field);
+
+    if ((n >= 2) && (p[0] == '"') && (p[n - 1] == '"')) {
+        bspan_init_from_pointers(field, p + 1, p + n - 1);
+        return 1;
+    }
+
+    return 0;
+}
+
+// csv_field_trim()
+// Take the white space (space, tab, '\r' and '\n') from around
+// a field, and then its quotes.  The white space inside of
+// the quotes is kept.
+// Return
+//    1 - the field was quoted
+//    0 - it wasn't
+static int csv_field_trim(bspan *field) PC_NOEXCEPT_C
+{
+    const unsigned char *p = bspan_begin(field);
+    const unsigned char *end = bspan_end(field);
+    while ((p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n')))
+        p++;
+    while ((end > p) && ((end[-1] == ' ') || (end[-1] == '\t') || (end[-1] == '\r') || (end[-1] == '\n')))
+        end--;
+
+    bspan_init_from_pointers(field, p, end);
+
+    return csv_field_unquote(field);
+}
+
+static int csv_field_iter_init(csvfielditer *iter, const bspan *line, unsigned char delim) PC_NOEXCEPT_C
+{
+    bspan_weak_assign(&iter->fLine, line);
+    iter->fDelimiter = delim;
+    iter->fDone = false;
+
+    return 0;
+}
+
+// csv_field_iter_next()
+// The next field of the line, up to a delimiter that isn't quoted.
+// A line always has at least one field, even if it is empty, and
+// a delimiter at the end of the line is followed by an empty field.
+// Return
+//    0 - success
+//   -1 - there are no more fields
+static int csv_field_iter_next(csvfielditer *iter, bspan *field) PC_NOEXCEPT_C
+{
+    if (iter->fDone)
+        return -1;
+
+    const unsigned char *start = bspan_begin(&iter->fLine);
+    const unsigned char *end = bspan_end(&iter->fLine);
+    const unsigned char *p = start;
+    const unsigned char *fieldEnd = end;
+
+    // Hop from quote to quote, looking for the delimiter
+    // in between the quoted parts
+    while (p < end)
+    {
+        const unsigned char *dlm = (const unsigned char *)memchr(p, iter->fDelimiter, (size_t)(end - p));
+        const unsigned char *limit = (dlm != nullptr) ? dlm : end;
+        const unsigned char *quote = (const unsigned char *)memchr(p, '"', (size_t)(limit - p));
+        if (quote == nullptr) {
+            fieldEnd = limit;
+            break;
+        }
+
+        const unsigned char *closing = (const unsigned char *)memchr(quote + 1, '"', (size_t)(end - quote - 1));
+        if (closing == nullptr) {
+            fieldEnd = end;
+            break;
+        }
+        p = closing + 1;
+    }
+
+    bspan_init_from_pointers(field, start, fieldEnd);
+    if (fieldEnd < end)
+        bspan_set_begin(&iter->fLine, fieldEnd + 1);
+    else
+        iter->fDone = true;
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CSVSCAN_H_INCLUDED
@@ -0,0 +1,526 @@
+#ifndef FMTSPAN_H_INCLUDED
+#define FMTSPAN_H_INCLUDED
+
+//
+// fmtspan
+// Turn numbers into text, the write side counterpart of convspan.h
+//
+// Nothing here uses printf(), or the locale, so the output is always
+// the same, and a lot faster.
+//   Integers are written two digits at a time, from a table of digit pairs.
+//   Hex and binary are written 8 characters at a time, by spreading the
+//     nibbles (or bits) of the value across the bytes of a 64-bit word.
+//   Doubles are written with the fewest digits that read back as exactly
+//     the same double (Ryu), in the same layout JavaScript uses:
+//     "0.1", "123", "1.5e-7", "1e+21"
+//
+// There are two forms of each routine.  The fmt_xxx() routines write into
+// a plain character buffer, which must be large enough for the largest
+// output (see the FMT_xxx_MAX_CHARS values), and return how many
+// characters were written.  The buffer is not null terminated.  The
+// fmt_put_xxx() routines append to an obuff.
+//
+// Reference: Ulf Adams, "Ryu: Fast Float-to-String Conversion", PLDI 2018
+//
+
+#include <math.h>       // signbit
+
+#include "pcoredef.h"
+#include "bithacks.h"
+#include "obuff.h"
+#include "fmtpow5.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FMT_U64_MAX_CHARS 20
+#define FMT_I64_MAX_CHARS 20
+#define FMT_HEX32_CHARS 8
+#define FMT_HEX64_CHARS 16
+#define FMT_BIN32_CHARS 32
+#define FMT_DOUBLE_MAX_CHARS 32
+
+static int fmt_u64_length(uint64_t v) PC_NOEXCEPT_C;
+static int fmt_u64(char *buff, uint64_t v) PC_NOEXCEPT_C;
+static int fmt_i64(char *buff, int64_t v) PC_NOEXCEPT_C;
+static int fmt_hex32(char *buff, uint32_t v) PC_NOEXCEPT_C;
+static int fmt_hex64(char *buff, uint64_t v) PC_NOEXCEPT_C;
+static int fmt_bin32(char *buff, uint32_t v) PC_NOEXCEPT_C;
+static int fmt_shortest_decimal(double v, uint64_t *digits, int32_t *exponent) PC_NOEXCEPT_C;
+static int fmt_double(char *buff, double v) PC_NOEXCEPT_C;
+
+static int fmt_put_u64(obuff *o, uint64_t v) PC_NOEXCEPT_C;
+static int fmt_put_i64(obuff *o, int64_t v) PC_NOEXCEPT_C;
+static int fmt_put_hex32(obuff *o, uint32_t v) PC_NOEXCEPT_C;
+static int fmt_put_hex64(obuff *o, uint64_t v) PC_NOEXCEPT_C;
+static int fmt_put_bin32(obuff *o, uint32_t v) PC_NOEXCEPT_C;
+static int fmt_put_double(obuff *o, double v) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+static const char fmt_digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint64_t fmt_pow10_u64[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL };
+
+// fmt_u64_length()
+// The number of decimal digits in the value.  The number of bits
+// gives a close estimate (1233/4096 ~= log10(2)), which is then
+// corrected with a single comparison.
+static int fmt_u64_length(uint64_t v) PC_NOEXCEPT_C
+{
+    if (v == 0)
+        return 1;
+
+    int t = ((64 - bhak_clz64(v)) * 1233) >> 12;
+
+    return t + 1 - (v < fmt_pow10_u64[t]);
+}
+
+// fmt_u64()
+// Write the decimal digits of the value, back to front, two at a time
+static int fmt_u64(char *buff, uint64_t v) PC_NOEXCEPT_C
+{
+    int len = fmt_u64_length(v);
+    char *p = buff + len;
+
+    while (v >= 100) {
+        uint64_t q = v / 100;
+        uint32_t r = (uint32_t)(v - (q * 100));
+        v = q;
+        p -= 2;
+        memcpy(p, fmt_digit_pairs + (2 * r), 2);
+    }
+
+    if (v >= 10) {
+        p -= 2;
+        memcpy(p, fmt_digit_pairs + (2 * v), 2);
+    } else {
+        *--p = (char)('0' + v);
+    }
+
+    return len;
+}
+
+static int fmt_i64(char *buff, int64_t v) PC_NOEXCEPT_C
+{
+    if (v < 0) {
+        *buff = '-';
+        // negate as unsigned, so INT64_MIN works
+        return 1 + fmt_u64(buff + 1, (uint64_t)0 - (uint64_t)v);
+    }
+
+    return fmt_u64(buff, (uint64_t)v);
+}
+
+// fmt_store_be()
+// Store the bytes of the word, most significant first
+static INLINE void fmt_store_be(char *buff, uint64_t x) PC_NOEXCEPT_C
+{
+    for (int i = 0; i < 8; i++)
+        buff[i] = (char)(x >> (56 - (8 * i)));
+}
+
+// fmt_hex32()
+// Each nibble is moved into a byte of its own, then all 8 are turned
+// into hex digits at once.  Bytes with a nibble above 9 get the extra
+// offset that takes them from '9'+1 to 'a'.
+static int fmt_hex32(char *buff, uint32_t v) PC_NOEXCEPT_C
+{
+    uint64_t x = v;
+    x = ((x & 0xFFFF0000ULL) << 16) | (x & 0x0000FFFFULL);
+    x = ((x & 0x0000FF000000FF00ULL) << 8) | (x & 0x000000FF000000FFULL);
+    x = ((x & 0x00F000F000F000F0ULL) << 4) | (x & 0x000F000F000F000FULL);
+
+    uint64_t alpha = ((x + 0x0606060606060606ULL) >> 4) & 0x0101010101010101ULL;
+    x = x + 0x3030303030303030ULL + (alpha * ('a' - '0' - 10));
+
+    fmt_store_be(buff, x);
+
+    return FMT_HEX32_CHARS;
+}
+
+static int fmt_hex64(char *buff, uint64_t v) PC_NOEXCEPT_C
+{
+    fmt_hex32(buff, (uint32_t)(v >> 32));
+    fmt_hex32(buff + 8, (uint32_t)v);
+
+    return FMT_HEX64_CHARS;
+}
+
+// fmt_bin32()
+// The most significant bit comes first.  The bits of each byte are
+// spread across a 64-bit word with a multiply, one bit per byte.
+static int fmt_bin32(char *buff, uint32_t v) PC_NOEXCEPT_C
+{
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t b = (v >> (24 - (8 * i))) & 0xff;
+        uint64_t x = (b * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+        x = ((x + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL;
+        fmt_store_be(buff + (8 * i), x + 0x3030303030303030ULL);
+    }
+
+    return FMT_BIN32_CHARS;
+}
+
+//
+// Ryu
+// Find the shortest decimal that is within the interval of values that
+// round to the double, by computing the decimal values of the bottom,
+// middle, and top of the interval, then removing digits for as long as
+// the bottom and top are still different.
+//
+static INLINE int32_t fmt_pow5bits(int32_t e) PC_NOEXCEPT_C { return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1; }
+static INLINE uint32_t fmt_log10_pow2(int32_t e) PC_NOEXCEPT_C { return ((uint32_t)e * 78913) >> 18; }
+static INLINE uint32_t fmt_log10_pow5(int32_t e) PC_NOEXCEPT_C { return ((uint32_t)e * 732923) >> 20; }
+
+static INLINE uint32_t fmt_pow5_factor(uint64_t value) PC_NOEXCEPT_C
+{
+    uint32_t count = 0;
+    while ((value % 5) == 0) {
+        value /= 5;
+        count++;
+    }
+
+    return count;
+}
+
+static INLINE bool fmt_multiple_of_pow5(uint64_t value, uint32_t p) PC_NOEXCEPT_C { return fmt_pow5_factor(value) >= p; }
+static INLINE bool fmt_multiple_of_pow2(uint64_t value, uint32_t p) PC_NOEXCEPT_C { return (value & ((1ULL << p) - 1)) == 0; }
+
+// (m * mul) >> j, where mul is 128 bits, low word first, and j >= 64
+static INLINE uint64_t fmt_mul_shift64(uint64_t m, const uint64_t *mul, int32_t j) PC_NOEXCEPT_C
+{
+    uint64_t high1 = 0;
+    uint64_t low1 = bhak_umul128(m, mul[1], &high1);
+    uint64_t high0 = 0;
+    bhak_umul128(m, mul[0], &high0);
+
+    uint64_t sum = high0 + low1;
+    if (sum < high0)
+        high1++;
+
+    int32_t dist = j - 64;
+
+    return (high1 << (64 - dist)) | (sum >> dist);
+}
+
+// fmt_shortest_decimal()
+// The shortest decimal that reads back as 'v', as digits * 10^exponent.
+// When there is more than one with the fewest digits, the one closest to
+// 'v' is chosen.  The sign is ignored.
+// Return
+//    0 - success
+//   -1 - 'v' is infinite, or not a number
+static int fmt_shortest_decimal(double v, uint64_t *digits, int32_t *exponent) PC_NOEXCEPT_C
+{
+    const int mantissaBits = 52;
+    const int bias = 1023;
+
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(double));
+
+    uint64_t ieeeMantissa = bits & ((1ULL << mantissaBits) - 1);
+    uint32_t ieeeExponent = (uint32_t)((bits >> mantissaBits) & 0x7ff);
+
+    if (ieeeExponent == 0x7ff)
+        return -1;
+
+    if ((ieeeExponent == 0) && (ieeeMantissa == 0)) {
+        *digits = 0;
+        *exponent = 0;
+        return 0;
+    }
+
+    // The value is m2 * 2^e2, with two extra bits, so the
+    // bounds of the interval are integers too
+    int32_t e2;
+    uint64_t m2;
+    if (ieeeExponent == 0) {
+        e2 = 1 - bias - mantissaBits - 2;
+        m2 = ieeeMantissa;
+    } else {
+        e2 = (int32_t)ieeeExponent - bias - mantissaBits - 2;
+        m2 = (1ULL << mantissaBits) | ieeeMantissa;
+    }
+
+    // Round to even means the bounds belong to the interval
+    // when the mantissa is even
+    bool acceptBounds = (m2 & 1) == 0;
+
+    // The bottom of the interval is closer at a power of two
+    uint64_t mv = 4 * m2;
+    uint32_t mmShift = (ieeeMantissa != 0) || (ieeeExponent <= 1);
+
+    // Convert the middle (vr), top (vp) and bottom (vm)
+    // of the interval to decimal
+    uint64_t vr, vp, vm;
+    int32_t e10;
+    bool vmIsTrailingZeros = false;
+    bool vrIsTrailingZeros = false;
+
+    if (e2 >= 0)
+    {
+        uint32_t q = fmt_log10_pow2(e2) - (e2 > 3);
+        e10 = (int32_t)q;
+        int32_t k = FMT_POW5_INV_BITCOUNT + fmt_pow5bits((int32_t)q) - 1;
+        int32_t i = -e2 + (int32_t)q + k;
+
+        vr = fmt_mul_shift64(4 * m2, fmt_pow5_inv_split[q], i);
+        vp = fmt_mul_shift64((4 * m2) + 2, fmt_pow5_inv_split[q], i);
+        vm = fmt_mul_shift64((4 * m2) - 1 - mmShift, fmt_pow5_inv_split[q], i);
+
+        // Only small powers of 5 can divide the values exactly
+        if (q <= 21)
+        {
+            if ((mv % 5) == 0)
+                vrIsTrailingZeros = fmt_multiple_of_pow5(mv, q);
+            else if (acceptBounds)
+                vmIsTrailingZeros = fmt_multiple_of_pow5(mv - 1 - mmShift, q);
+            else
+                vp -= fmt_multiple_of_pow5(mv + 2, q);
+        }
+    }
+    else
+    {
+        uint32_t q = fmt_log10_pow5(-e2) - (-e2 > 1);
+        e10 = (int32_t)q + e2;
+        int32_t i = -e2 - (int32_t)q;
+        int32_t k = fmt_pow5bits(i) - FMT_POW5_BITCOUNT;
+        int32_t j = (int32_t)q - k;
+
+        vr = fmt_mul_shift64(4 * m2, fmt_pow5_split[i], j);
+        vp = fmt_mul_shift64((4 * m2) + 2, fmt_pow5_split[i], j);
+        vm = fmt_mul_shift64((4 * m2) - 1 - mmShift, fmt_pow5_split[i], j);
+
+        if (q <= 1)
+        {
+            // mv has at least 2 trailing zero bits, so vr is exact
+            vrIsTrailingZeros = true;
+            if (acceptBounds)
+                vmIsTrailingZeros = (mmShift == 1);
+            else
+                --vp;
+        }
+        else if (q < 63)
+        {
+            vrIsTrailingZeros = fmt_multiple_of_pow2(mv, q);
+        }
+    }
+
+    // Remove digits while the top and bottom are still different
+    int32_t removed = 0;
+    uint64_t output;
+
+    if (vmIsTrailingZeros || vrIsTrailingZeros)
+    {
+        // The rare, general case, where the exact value of the
+        // bounds, and of the middle, matter for rounding
+        uint8_t lastRemovedDigit = 0;
+
+        while ((vp / 10) > (vm / 10)) {
+            vmIsTrailingZeros &= (vm % 10) == 0;
+            vrIsTrailingZeros &= (lastRemovedDigit == 0);
+            lastRemovedDigit = (uint8_t)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+
+        if (vmIsTrailingZeros) {
+            while ((vm % 10) == 0) {
+                vrIsTrailingZeros &= (lastRemovedDigit == 0);
+                lastRemovedDigit = (uint8_t)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+
+        // Exactly halfway, round to even
+        if (vrIsTrailingZeros && (lastRemovedDigit == 5) && ((vr % 2) == 0))
+            lastRemovedDigit = 4;
+
+        output = vr + (((vr == vm) && (!acceptBounds || !vmIsTrailingZeros)) || (lastRemovedDigit >= 5));
+    }
+    else
+    {
+        // The common case
+        bool roundUp = false;
+
+        // Two digits at a time, most of the time
+        if ((vp / 100) > (vm / 100)) {
+            roundUp = (vr % 100) >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+
+        while ((vp / 10) > (vm / 10)) {
+            roundUp = (vr % 10) >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+
+        output = vr + ((vr == vm) || roundUp);
+    }
+
+    *digits = output;
+    *exponent = e10 + removed;
+
+    return 0;
+}
+
+// fmt_double()
+// The shortest text that reads back as exactly 'v'.  Values from
+// 1e-7 up to 1e21 are written out in full, the rest with an exponent,
+// the same as JavaScript.
+static int fmt_double(char *buff, double v) PC_NOEXCEPT_C
+{
+    char *p = buff;
+
+    if (v != v) {
+        memcpy(p, "nan", 3);
+        return 3;
+    }
+
+    if (signbit(v))
+        *p++ = '-';
+
+    uint64_t output = 0;
+    int32_t exponent = 0;
+    if (fmt_shortest_decimal(v, &output, &exponent) != 0) {
+        memcpy(p, "inf", 3);
+        return (int)(p - buff) + 3;
+    }
+
+    char digits[FMT_U64_MAX_CHARS];
+    int32_t olength = fmt_u64(digits, output);
+
+    // Where the decimal point goes, relative to the digits
+    int32_t n = olength + exponent;
+
+    if ((olength <= n) && (n <= 21))
+    {
+        // An integer, with zeros on the end
+        memcpy(p, digits, (size_t)olength);
+        p += olength;
+        memset(p, '0', (size_t)(n - olength));
+        p += n - olength;
+    }
+    else if ((0 < n) && (n <= 21))
+    {
+        // The decimal point is in between the digits
+        memcpy(p, digits, (size_t)n);
+        p += n;
+        *p++ = '.';
+        memcpy(p, digits + n, (size_t)(olength - n));
+        p += olength - n;
+    }
+    else if ((-6 < n) && (n <= 0))
+    {
+        // A small fraction, "0.000ddd"
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', (size_t)-n);
+        p += -n;
+        memcpy(p, digits, (size_t)olength);
+        p += olength;
+    }
+    else
+    {
+        // d.ddde+xx
+        *p++ = digits[0];
+        if (olength > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, (size_t)(olength - 1));
+            p += olength - 1;
+        }
+        *p++ = 'e';
+        int32_t e = n - 1;
+        *p++ = (e < 0) ? '-' : '+';
+        p += fmt_u64(p, (uint64_t)((e < 0) ? -e : e));
+    }
+
+    return (int)(p - buff);
+}
+
+//
+// Writing to an obuff
+// Reserve room for the largest output, then commit what was used
+//
+static int fmt_put_u64(obuff *o, uint64_t v) PC_NOEXCEPT_C
+{
+    char *p = (char *)obuff_reserve(o, FMT_U64_MAX_CHARS);
+    if (p == nullptr)
+        return -1;
+
+    return obuff_commit(o, (size_t)fmt_u64(p, v));
+}
+
+static int fmt_put_i64(obuff *o, int64_t v) PC_NOEXCEPT_C
+{
+    char *p = (char *)obuff_reserve(o, FMT_I64_MAX_CHARS);
+    if (p == nullptr)
+        return -1;
+
+    return obuff_commit(o, (size_t)fmt_i64(p, v));
+}
+
+static int fmt_put_hex32(obuff *o, uint32_t v) PC_NOEXCEPT_C
+{
+    char *p = (char *)obuff_reserve(o, FMT_HEX32_CHARS);
+    if (p == nullptr)
+        return -1;
+
+    return obuff_commit(o, (size_t)fmt_hex32(p, v));
+}
+
+static int fmt_put_hex64(obuff *o, uint64_t v) PC_NOEXCEPT_C
+{
+    char *p = (char *)obuff_reserve(o, FMT_HEX64_CHARS);
+    if (p == nullptr)
+        return -1;
+
+    return obuff_commit(o, (size_t)fmt_hex64(p, v));
+}
+
+static int fmt_put_bin32(obuff *o, uint32_t v) PC_NOEXCEPT_C
+{
+    char *p = (char *)obuff_reserve(o, FMT_BIN32_CHARS);
+    if (p == nullptr)
+        return -1;
+
+    return obuff_commit(o, (size_t)fmt_bin32(p, v));
+}
+
+static int fmt_put_double(obuff *o, double v) PC_NOEXCEPT_C
+{
+    char *p = (char *)obuff_reserve(o, FMT_DOUBLE_MAX_CHARS);
+    if (p == nullptr)
+        return -1;
+
+    return obuff_commit(o, (size_t)fmt_double(p, v));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // FMTSPAN_H_INCLUDED
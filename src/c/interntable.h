@@ -0,0 +1,202 @@
+#ifndef INTERNTABLE_H_INCLUDED
+#define INTERNTABLE_H_INCLUDED
+
+//
+// interntable
+// A table of distinct strings, each with a small id.
+//
+// Entering a string gives back its id.  The first distinct string is
+// id 0, the next is 1, and so on, so ids can index arrays of whatever
+// goes along with the strings.  Entering a string that is already there
+// gives back the id it already has.
+//
+// The strings are found through a hash table (FNV-1a), with open
+// addressing, that holds id + 1 in each slot, and 0 in an empty one.  It
+// is kept no more than half full, so a lookup is a hash, and usually a
+// single compare.
+//
+// The table holds spans, not copies, so whatever the strings are in has
+// to stay put for as long as the table is used.
+//
+// Typical usage:
+//   interntable t;
+//   interntable_init(&t);
+//   uint32_t id = interntable_intern(&t, &name);
+//   ...
+//   if (interntable_find(&t, &name) != INTERNTABLE_NONE)
+//       ...
+//   interntable_destroy(&t);
+//
+
+#include <stdlib.h>     // realloc, calloc, free
+
+#include "pcoredef.h"
+#include "bspan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INTERNTABLE_NONE ((uint32_t)0xffffffffu)
+
+struct interntable_t {
+    bspan *fSpans;              // indexed by id
+    size_t fCount;
+    size_t fCapacity;
+    uint32_t *fHash;            // open addressing, holds id + 1, 0 when empty
+    size_t fHashSize;           // a power of two
+};
+typedef struct interntable_t interntable;
+
+static uint32_t intern_hash(const unsigned char *data, size_t n) PC_NOEXCEPT_C;
+
+static int interntable_init(interntable *t) PC_NOEXCEPT_C;
+static int interntable_destroy(interntable *t) PC_NOEXCEPT_C;
+static size_t interntable_count(const interntable *t) PC_NOEXCEPT_C;
+static size_t interntable_memory(const interntable *t) PC_NOEXCEPT_C;
+static uint32_t interntable_intern(interntable *t, const bspan *s) PC_NOEXCEPT_C;
+static uint32_t interntable_find(const interntable *t, const bspan *s) PC_NOEXCEPT_C;
+static int interntable_span(const interntable *t, uint32_t id, bspan *s) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+// intern_hash()
+// FNV-1a
+static uint32_t intern_hash(const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+static int interntable_init(interntable *t) PC_NOEXCEPT_C
+{
+    memset(t, 0, sizeof(interntable));
+
+    return 0;
+}
+
+static int interntable_destroy(interntable *t) PC_NOEXCEPT_C
+{
+    free(t->fSpans);
+    free(t->fHash);
+    memset(t, 0, sizeof(interntable));
+
+    return 0;
+}
+
+static size_t interntable_count(const interntable *t) PC_NOEXCEPT_C { return t->fCount; }
+
+// interntable_memory()
+// How many bytes the table is using
+static size_t interntable_memory(const interntable *t) PC_NOEXCEPT_C
+{
+    return (t->fCapacity * sizeof(bspan)) + (t->fHashSize * sizeof(uint32_t));
+}
+
+// The hash slot for a string, either the one holding it, or the empty one where it would go
+static uint32_t * interntable_slot(const interntable *t, const unsigned char *s, size_t n) PC_NOEXCEPT_C
+{
+    size_t mask = t->fHashSize - 1;
+    size_t i = intern_hash(s, n) & mask;
+
+    while (true) {
+        uint32_t *slot = &t->fHash[i];
+        if (*slot == 0)
+            return slot;
+
+        const bspan *span = &t->fSpans[*slot - 1];
+        if ((bspan_size(span) == n) && ((n == 0) || (memcmp(bspan_begin(span), s, n) == 0)))
+            return slot;
+
+        i = (i + 1) & mask;
+    }
+}
+
+// Make room for one more, keeping the hash no more than half full
+static int interntable_grow(interntable *t) PC_NOEXCEPT_C
+{
+    if (t->fCount == t->fCapacity) {
+        size_t cap = (t->fCapacity < 16) ? 16 : t->fCapacity * 2;
+        bspan *spans = (bspan *)realloc(t->fSpans, cap * sizeof(bspan));
+        if (spans == nullptr)
+            return -1;
+        t->fSpans = spans;
+        t->fCapacity = cap;
+    }
+
+    if ((t->fCount + 1) * 2 > t->fHashSize) {
+        size_t size = (t->fHashSize < 32) ? 32 : t->fHashSize * 2;
+        uint32_t *hash = (uint32_t *)calloc(size, sizeof(uint32_t));
+        if (hash == nullptr)
+            return -1;
+
+        free(t->fHash);
+        t->fHash = hash;
+        t->fHashSize = size;
+        for (size_t id = 0; id < t->fCount; id++) {
+            const bspan *s = &t->fSpans[id];
+            *interntable_slot(t, bspan_begin(s), bspan_size(s)) = (uint32_t)(id + 1);
+        }
+    }
+
+    return 0;
+}
+
+// interntable_intern()
+// The id of a string, adding it if it's new.  A new string
+// always gets the id interntable_count() had before.
+// Returns INTERNTABLE_NONE when out of memory
+static uint32_t interntable_intern(interntable *t, const bspan *s) PC_NOEXCEPT_C
+{
+    if (interntable_grow(t) != 0)
+        return INTERNTABLE_NONE;
+
+    uint32_t *slot = interntable_slot(t, bspan_begin(s), bspan_size(s));
+    if (*slot != 0)
+        return *slot - 1;
+
+    uint32_t id = (uint32_t)t->fCount++;
+    bspan_weak_assign(&t->fSpans[id], s);
+    *slot = id + 1;
+
+    return id;
+}
+
+// interntable_find()
+// The id of a string, or INTERNTABLE_NONE if it isn't there
+static uint32_t interntable_find(const interntable *t, const bspan *s) PC_NOEXCEPT_C
+{
+    if (t->fCount == 0)
+        return INTERNTABLE_NONE;
+
+    uint32_t slot = *interntable_slot(t, bspan_begin(s), bspan_size(s));
+
+    return (slot == 0) ? INTERNTABLE_NONE : slot - 1;
+}
+
+// interntable_span()
+// The string with the given id
+// Return
+//    0 - success
+//   -1 - there is no such id
+static int interntable_span(const interntable *t, uint32_t id, bspan *s) PC_NOEXCEPT_C
+{
+    if (id >= t->fCount)
+        return -1;
+
+    bspan_weak_assign(s, &t->fSpans[id]);
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // INTERNTABLE_H_INCLUDED
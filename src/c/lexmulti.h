@@ -0,0 +1,552 @@
+#ifndef LEXMULTI_H_INCLUDED
+#define LEXMULTI_H_INCLUDED
+
+//
+// lexmulti
+// Find the first occurence of any one of a set of literal strings
+// within a span.
+//
+// The matcher is compiled once from a list of patterns, and then
+// run against any number of spans.  The pattern memory is NOT copied,
+// so it must stay alive as long as the matcher is in use.
+//
+// Typical usage:
+//   static const char *keywords[] = {"if", "else", "while"};
+//   lexmulti m;
+//   lexmulti_init(&m, keywords, 3);
+//
+//   bspan match;
+//   int id = lexmulti_find(&m, src, &match);
+//   if (id >= 0)
+//       // keywords[id] was found, and 'match' covers it
+//
+//   lexmulti_destroy(&m);
+//
+// Matching is 'leftmost-first'.  The match that starts earliest in the
+// span wins, and if several patterns match at that same position, the
+// one that was listed first wins.  So for the patterns {"?xml", "?"},
+// "?xml" is reported whenever it is there.
+//
+// There are two search strategies.
+//   Teddy - for small sets (LEXMULTI_TEDDY_MAX patterns or fewer).  The
+//     low and high nibbles of the first few bytes of each pattern are
+//     turned into shuffle tables, so 16 or 32 positions can be tested
+//     against all the patterns at once.  Only positions that pass are
+//     compared in full.
+//   Aho-Corasick - for larger sets.  A DFA over classes of bytes, that
+//     looks at each byte of the span exactly once.
+//
+// lexmulti_match_prefix() answers the simpler question of which
+// pattern the span begins with, by walking the trie that is under
+// the Aho-Corasick automaton.
+//
+
+#include <stdlib.h>     // malloc, free
+
+#include "pcoredef.h"
+#include "bithacks.h"
+#include "cpufeat.h"
+#include "bspan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LEXMULTI_TEDDY_MAX 8
+#define LEXMULTI_TEDDY_BYTES 3
+
+struct lexmulti_pattern_t {
+    const unsigned char *fData;
+    size_t fLength;
+};
+typedef struct lexmulti_pattern_t lexmulti_pattern;
+
+struct lexmulti_t {
+    lexmulti_pattern *fPatterns;
+    int fCount;
+    size_t fMinLength;
+    size_t fMaxLength;
+
+    // Aho-Corasick automaton
+    // Transitions are over byte classes rather than bytes.  Every byte
+    // that does not appear in any pattern shares class 0.
+    unsigned char fClassOf[256];
+    int fNumClasses;
+    int fNumNodes;
+    int32_t *fNext;         // fNumNodes * fNumClasses transitions
+    int32_t *fOutput;       // lowest pattern id ending at the node, or -1
+    int32_t *fDictLink;     // next node along the suffix chain that has an output, or -1
+    int32_t *fDepth;        // distance of the node from the root
+
+    // Teddy tables
+    bool fUseTeddy;
+    int fTeddyBytes;
+    unsigned char fTeddyLo[LEXMULTI_TEDDY_BYTES][16];
+    unsigned char fTeddyHi[LEXMULTI_TEDDY_BYTES][16];
+};
+typedef struct lexmulti_t lexmulti;
+
+static int lexmulti_init(lexmulti *m, const char * const *cstrs, int count) PC_NOEXCEPT_C;
+static int lexmulti_destroy(lexmulti *m) PC_NOEXCEPT_C;
+
+static int lexmulti_find_at(const lexmulti *m, const unsigned char *data, size_t n, size_t *matchAt) PC_NOEXCEPT_C;
+static int lexmulti_find(const lexmulti *m, const bspan *a, bspan *match) PC_NOEXCEPT_C;
+static int lexmulti_match_prefix(const lexmulti *m, const bspan *a, bspan *match) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+// lexmulti_build_automaton()
+// Build the trie of all the patterns, then turn it into a DFA by
+// filling in the missing transitions from the failure links.
+static int lexmulti_build_automaton(lexmulti *m) PC_NOEXCEPT_C
+{
+    // Byte classes
+    memset(m->fClassOf, 0, sizeof(m->fClassOf));
+    m->fNumClasses = 1;
+    size_t maxNodes = 1;
+    for (int p = 0; p < m->fCount; p++)
+    {
+        for (size_t i = 0; i < m->fPatterns[p].fLength; i++) {
+            unsigned char c = m->fPatterns[p].fData[i];
+            if (m->fClassOf[c] == 0 && m->fNumClasses < 256)
+                m->fClassOf[c] = (unsigned char)m->fNumClasses++;
+        }
+        maxNodes += m->fPatterns[p].fLength;
+    }
+
+    // If all 256 byte values are used, the last one
+    // shares class 0, which is then a real class
+    const int nc = m->fNumClasses;
+
+    m->fNext = (int32_t *)malloc(maxNodes * nc * sizeof(int32_t));
+    m->fOutput = (int32_t *)malloc(maxNodes * sizeof(int32_t));
+    m->fDictLink = (int32_t *)malloc(maxNodes * sizeof(int32_t));
+    m->fDepth = (int32_t *)malloc(maxNodes * sizeof(int32_t));
+    int32_t *fail = (int32_t *)malloc(maxNodes * sizeof(int32_t));
+    int32_t *queue = (int32_t *)malloc(maxNodes * sizeof(int32_t));
+
+    if (!m->fNext || !m->fOutput || !m->fDictLink || !m->fDepth || !fail || !queue) {
+        free(fail);
+        free(queue);
+        return -1;
+    }
+
+    for (size_t i = 0; i < maxNodes * nc; i++)
+        m->fNext[i] = -1;
+
+    // The trie
+    m->fNumNodes = 1;
+    m->fOutput[0] = -1;
+    m->fDepth[0] = 0;
+    for (int p = 0; p < m->fCount; p++)
+    {
+        int32_t node = 0;
+        for (size_t i = 0; i < m->fPatterns[p].fLength; i++)
+        {
+            int32_t *slot = &m->fNext[node * nc + m->fClassOf[m->fPatterns[p].fData[i]]];
+            if (*slot < 0) {
+                int32_t created = m->fNumNodes++;
+                m->fOutput[created] = -1;
+                m->fDepth[created] = m->fDepth[node] + 1;
+                *slot = created;
+            }
+            node = *slot;
+        }
+
+        // Duplicates keep the first id
+        if (m->fOutput[node] < 0)
+            m->fOutput[node] = p;
+    }
+
+    // Breadth first, fill in failure links, and the missing transitions
+    int head = 0;
+    int tail = 0;
+    m->fDictLink[0] = -1;
+    fail[0] = 0;
+    for (int c = 0; c < nc; c++)
+    {
+        int32_t v = m->fNext[c];
+        if (v < 0) {
+            m->fNext[c] = 0;
+        } else {
+            fail[v] = 0;
+            queue[tail++] = v;
+        }
+    }
+
+    while (head < tail)
+    {
+        int32_t u = queue[head++];
+        int32_t f = fail[u];
+        m->fDictLink[u] = (m->fOutput[f] >= 0) ? f : m->fDictLink[f];
+
+        for (int c = 0; c < nc; c++)
+        {
+            int32_t v = m->fNext[u * nc + c];
+            if (v < 0) {
+                m->fNext[u * nc + c] = m->fNext[f * nc + c];
+            } else {
+                fail[v] = m->fNext[f * nc + c];
+                queue[tail++] = v;
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+
+    return 0;
+}
+
+// lexmulti_build_teddy()
+// For each of the first few bytes of the patterns, a bit is set
+// for the pattern in the entry for the low nibble, and in the entry
+// for the high nibble.  A position can only be the start of pattern 'p'
+// if bit 'p' survives the AND of all those lookups.
+static void lexmulti_build_teddy(lexmulti *m) PC_NOEXCEPT_C
+{
+    memset(m->fTeddyLo, 0, sizeof(m->fTeddyLo));
+    memset(m->fTeddyHi, 0, sizeof(m->fTeddyHi));
+
+    m->fTeddyBytes = (m->fMinLength < LEXMULTI_TEDDY_BYTES) ? (int)m->fMinLength : LEXMULTI_TEDDY_BYTES;
+    for (int p = 0; p < m->fCount; p++)
+    {
+        for (int i = 0; i < m->fTeddyBytes; i++) {
+            unsigned char c = m->fPatterns[p].fData[i];
+            m->fTeddyLo[i][c & 0x0f] |= (unsigned char)(1u << p);
+            m->fTeddyHi[i][c >> 4] |= (unsigned char)(1u << p);
+        }
+    }
+}
+
+// lexmulti_init()
+// Compile a matcher from a list of c-strings.  Empty patterns
+// are not allowed.
+// Return
+//    0 - success
+//   -1 - bad patterns, or out of memory
+static int lexmulti_init(lexmulti *m, const char * const *cstrs, int count) PC_NOEXCEPT_C
+{
+    memset(m, 0, sizeof(lexmulti));
+
+    if ((cstrs == nullptr) || (count <= 0))
+        return -1;
+
+    m->fPatterns = (lexmulti_pattern *)malloc(count * sizeof(lexmulti_pattern));
+    if (m->fPatterns == nullptr)
+        return -1;
+
+    m->fCount = count;
+    m->fMinLength = (size_t)-1;
+    for (int p = 0; p < count; p++)
+    {
+        size_t len = strlen(cstrs[p]);
+        if (len == 0) {
+            lexmulti_destroy(m);
+            return -1;
+        }
+
+        m->fPatterns[p].fData = (const unsigned char *)cstrs[p];
+        m->fPatterns[p].fLength = len;
+        if (len < m->fMinLength) m->fMinLength = len;
+        if (len > m->fMaxLength) m->fMaxLength = len;
+    }
+
+    if (lexmulti_build_automaton(m) != 0) {
+        lexmulti_destroy(m);
+        return -1;
+    }
+
+    m->fUseTeddy = count <= LEXMULTI_TEDDY_MAX;
+    if (m->fUseTeddy)
+        lexmulti_build_teddy(m);
+
+    return 0;
+}
+
+static int lexmulti_destroy(lexmulti *m) PC_NOEXCEPT_C
+{
+    free(m->fPatterns);
+    free(m->fNext);
+    free(m->fOutput);
+    free(m->fDictLink);
+    free(m->fDepth);
+    memset(m, 0, sizeof(lexmulti));
+
+    return 0;
+}
+
+// lexmulti_verify()
+// Of the patterns in 'candidates' (a bit per pattern), return the lowest
+// numbered one that fully matches at 'at', or -1
+static INLINE int lexmulti_verify(const lexmulti *m, uint32_t candidates, const unsigned char *at, size_t avail) PC_NOEXCEPT_C
+{
+    while (candidates != 0)
+    {
+        int p = bhak_ctz32(candidates);
+        const lexmulti_pattern *pat = &m->fPatterns[p];
+        if ((pat->fLength <= avail) && (memcmp(at, pat->fData, pat->fLength) == 0))
+            return p;
+        candidates &= candidates - 1;
+    }
+
+    return -1;
+}
+
+typedef int (*lexmulti_teddy_fn)(const lexmulti *m, const unsigned char *y, size_t n, size_t *matchAt);
+
+// lexmulti_teddy_scalar()
+// The Teddy filter, one position at a time.  Also used for
+// the tail end of the SIMD versions.
+static int lexmulti_teddy_scalar(const lexmulti *m, const unsigned char *y, size_t n, size_t *matchAt) PC_NOEXCEPT_C
+{
+    const size_t k = (size_t)m->fTeddyBytes;
+
+    for (size_t j = 0; j + m->fMinLength <= n; j++)
+    {
+        uint32_t bits = 0xff;
+        for (size_t i = 0; i < k; i++) {
+            unsigned char c = y[j + i];
+            bits &= m->fTeddyLo[i][c & 0x0f] & m->fTeddyHi[i][c >> 4];
+        }
+
+        if (bits != 0) {
+            int p = lexmulti_verify(m, bits, y + j, n - j);
+            if (p >= 0) {
+                *matchAt = j;
+                return p;
+            }
+        }
+    }
+
+    return -1;
+}
+
+#if defined(PC_ARCH_X86)
+// SSSE3 - 16 positions at a time
+PC_TARGET_SSSE3
+static int lexmulti_teddy_ssse3(const lexmulti *m, const unsigned char *y, size_t n, size_t *matchAt) PC_NOEXCEPT_C
+{
+    const size_t k = (size_t)m->fTeddyBytes;
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i lo[LEXMULTI_TEDDY_BYTES];
+    __m128i hi[LEXMULTI_TEDDY_BYTES];
+    for (size_t i = 0; i < k; i++) {
+        lo[i] = _mm_loadu_si128((const __m128i *)m->fTeddyLo[i]);
+        hi[i] = _mm_loadu_si128((const __m128i *)m->fTeddyHi[i]);
+    }
+
+    size_t j = 0;
+    for (; j + k - 1 + 16 <= n; j += 16)
+    {
+        __m128i res = _mm_set1_epi8((char)0xff);
+        for (size_t i = 0; i < k; i++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(y + j + i));
+            __m128i l = _mm_shuffle_epi8(lo[i], _mm_and_si128(v, nibble));
+            __m128i h = _mm_shuffle_epi8(hi[i], _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+            res = _mm_and_si128(res, _mm_and_si128(l, h));
+        }
+
+        uint32_t mask = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(res, _mm_setzero_si128())) & 0xffff;
+        if (mask == 0)
+            continue;
+
+        unsigned char bits[16];
+        _mm_storeu_si128((__m128i *)bits, res);
+        while (mask != 0)
+        {
+            size_t b = (size_t)bhak_ctz32(mask);
+            int p = lexmulti_verify(m, bits[b], y + j + b, n - j - b);
+            if (p >= 0) {
+                *matchAt = j + b;
+                return p;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    int p = lexmulti_teddy_scalar(m, y + j, n - j, matchAt);
+    if (p >= 0)
+        *matchAt += j;
+
+    return p;
+}
+
+// AVX2 - 32 positions at a time
+PC_TARGET_AVX2
+static int lexmulti_teddy_avx2(const lexmulti *m, const unsigned char *y, size_t n, size_t *matchAt) PC_NOEXCEPT_C
+{
+    const size_t k = (size_t)m->fTeddyBytes;
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i lo[LEXMULTI_TEDDY_BYTES];
+    __m256i hi[LEXMULTI_TEDDY_BYTES];
+    for (size_t i = 0; i < k; i++) {
+        lo[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)m->fTeddyLo[i]));
+        hi[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)m->fTeddyHi[i]));
+    }
+
+    size_t j = 0;
+    for (; j + k - 1 + 32 <= n; j += 32)
+    {
+        __m256i res = _mm256_set1_epi8((char)0xff);
+        for (size_t i = 0; i < k; i++) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(y + j + i));
+            __m256i l = _mm256_shuffle_epi8(lo[i], _mm256_and_si256(v, nibble));
+            __m256i h = _mm256_shuffle_epi8(hi[i], _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+            res = _mm256_and_si256(res, _mm256_and_si256(l, h));
+        }
+
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(res, _mm256_setzero_si256()));
+        if (mask == 0)
+            continue;
+
+        unsigned char bits[32];
+        _mm256_storeu_si256((__m256i *)bits, res);
+        while (mask != 0)
+        {
+            size_t b = (size_t)bhak_ctz32(mask);
+            int p = lexmulti_verify(m, bits[b], y + j + b, n - j - b);
+            if (p >= 0) {
+                *matchAt = j + b;
+                return p;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    int p = lexmulti_teddy_ssse3(m, y + j, n - j, matchAt);
+    if (p >= 0)
+        *matchAt += j;
+
+    return p;
+}
+#endif  // PC_ARCH_X86
+
+static lexmulti_teddy_fn lexmulti_select_teddy() PC_NOEXCEPT_C
+{
+#if defined(PC_ARCH_X86)
+    if (pc_cpu_has(PC_CPU_AVX2))
+        return lexmulti_teddy_avx2;
+    if (pc_cpu_has(PC_CPU_SSSE3))
+        return lexmulti_teddy_ssse3;
+#endif
+
+    return lexmulti_teddy_scalar;
+}
+
+// lexmulti_aho_corasick()
+// Run the automaton across the data.  Matches are reported by where
+// they end, so once one is seen, we keep going long enough to be sure
+// nothing that starts earlier is still in progress.
+static int lexmulti_aho_corasick(const lexmulti *m, const unsigned char *y, size_t n, size_t *matchAt) PC_NOEXCEPT_C
+{
+    const int nc = m->fNumClasses;
+    int32_t state = 0;
+    int bestId = -1;
+    size_t bestStart = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if ((bestId >= 0) && (i >= bestStart + m->fMaxLength))
+            break;
+
+        state = m->fNext[state * nc + m->fClassOf[y[i]]];
+
+        int32_t t = (m->fOutput[state] >= 0) ? state : m->fDictLink[state];
+        for (; t >= 0; t = m->fDictLink[t])
+        {
+            int id = m->fOutput[t];
+            size_t start = i + 1 - m->fPatterns[id].fLength;
+            if ((bestId < 0) || (start < bestStart) || ((start == bestStart) && (id < bestId))) {
+                bestId = id;
+                bestStart = start;
+            }
+        }
+    }
+
+    if (bestId >= 0)
+        *matchAt = bestStart;
+
+    return bestId;
+}
+
+// lexmulti_find_at()
+// Search 'n' bytes of 'data' for the first of the patterns.
+// Return the id of the pattern (its index in the list given to
+// lexmulti_init()) and where it starts in 'matchAt', or -1 if
+// none of the patterns is found.
+static int lexmulti_find_at(const lexmulti *m, const unsigned char *data, size_t n, size_t *matchAt) PC_NOEXCEPT_C
+{
+    static const lexmulti_teddy_fn teddyFn = lexmulti_select_teddy();
+
+    if ((m->fCount == 0) || (n < m->fMinLength))
+        return -1;
+
+    if (m->fUseTeddy)
+        return teddyFn(m, data, n, matchAt);
+
+    return lexmulti_aho_corasick(m, data, n, matchAt);
+}
+
+// lexmulti_find()
+// Search the span for the first of the patterns.
+// Return the id of the pattern found, with 'match' covering
+// the matched bytes, or -1 if nothing was found
+static int lexmulti_find(const lexmulti *m, const bspan *a, bspan *match) PC_NOEXCEPT_C
+{
+    size_t at = 0;
+    int id = lexmulti_find_at(m, bspan_begin(a), bspan_size(a), &at);
+
+    if (id < 0) {
+        bspan_init_from_pointers(match, bspan_end(a), bspan_end(a));
+        return -1;
+    }
+
+    bspan_init_from_data(match, bspan_begin(a) + at, m->fPatterns[id].fLength);
+
+    return id;
+}
+
+// lexmulti_match_prefix()
+// Which of the patterns does the span begin with?  When more than one
+// does, the lowest id wins, as if they were each tried in order.
+// Return the id of the pattern, with 'match' covering the matched
+// bytes, or -1 if the span does not begin with any of them.
+static int lexmulti_match_prefix(const lexmulti *m, const bspan *a, bspan *match) PC_NOEXCEPT_C
+{
+    const unsigned char *y = bspan_begin(a);
+    size_t n = bspan_size(a);
+    size_t limit = (n < m->fMaxLength) ? n : m->fMaxLength;
+    const int nc = m->fNumClasses;
+    int32_t node = 0;
+    int bestId = -1;
+
+    // Only follow edges of the trie, which are the transitions
+    // that go exactly one level deeper
+    for (size_t i = 0; i < limit; i++)
+    {
+        int32_t next = m->fNext[node * nc + m->fClassOf[y[i]]];
+        if (m->fDepth[next] != m->fDepth[node] + 1)
+            break;
+
+        node = next;
+        if ((m->fOutput[node] >= 0) && ((bestId < 0) || (m->fOutput[node] < bestId)))
+            bestId = m->fOutput[node];
+    }
+
+    if (bestId < 0) {
+        bspan_init_from_pointers(match, y, y);
+        return -1;
+    }
+
+    bspan_init_from_data(match, y, m->fPatterns[bestId].fLength);
+
+    return bestId;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LEXMULTI_H_INCLUDED
@@ -0,0 +1,391 @@
+#ifndef LEXSEARCH_H_INCLUDED
+#define LEXSEARCH_H_INCLUDED
+
+//
+// lexsearch
+// Find a substring (the 'needle') within a span of bytes.
+//
+// The searcher is compiled once from the needle, and can then be run
+// against any number of spans.  The needle memory is NOT copied, so it
+// must stay alive as long as the searcher is in use.  String literals
+// are the typical case.
+//
+// Typical usage:
+//   lexsearch srch;
+//   lexsearch_init_from_cstr(&srch, "-->");
+//
+//   bspan found;
+//   if (lexsearch_find_span(&srch, src, &found) == 0)
+//       // 'found' begins at the "-->"
+//
+// The search is done in two parts.  A SIMD filter looks for positions
+// where both the first and the last byte of the needle match, and only
+// those positions are compared in full.  For most needles and most text,
+// this skips along 16 or 32 bytes at a time.  Needles such as "aaab"
+// against "aaaaaaaa..." defeat the filter, because every position is a
+// candidate, so when too many candidates fail we switch over to the
+// Two-Way algorithm (Crochemore & Perrin), which is linear in the
+// worst case, and uses constant space.
+//
+
+#include "pcoredef.h"
+#include "bithacks.h"
+#include "cpufeat.h"
+#include "bspan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct lexsearch_t {
+    const unsigned char *fNeedle;
+    size_t fLength;
+
+    // The Two-Way critical factorization
+    size_t fCritPos;        // where the right half of the needle starts
+    size_t fPeriod;         // the period of the needle (or a shift that is safe)
+    bool fPeriodic;         // whether the left half repeats within the period
+};
+typedef struct lexsearch_t lexsearch;
+
+static int lexsearch_init(lexsearch *s, const void *needle, size_t len) PC_NOEXCEPT_C;
+static int lexsearch_init_from_cstr(lexsearch *s, const char *cstr) PC_NOEXCEPT_C;
+static int lexsearch_init_from_span(lexsearch *s, const bspan *needle) PC_NOEXCEPT_C;
+
+static size_t lexsearch_find(const lexsearch *s, const unsigned char *data, size_t n) PC_NOEXCEPT_C;
+static int lexsearch_find_span(const lexsearch *s, const bspan *a, bspan *rest) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+// lexsearch_max_suffix()
+// Compute the maximal suffix of the needle, according to either
+// the normal byte ordering, or the reversed ordering.  The return
+// value is the position just before the suffix (it can be (size_t)-1)
+// and the period of that suffix is returned in 'period'
+static size_t lexsearch_max_suffix(const unsigned char *x, size_t m, bool reversed, size_t *period) PC_NOEXCEPT_C
+{
+    size_t ms = (size_t)-1;     // all arithmetic on 'ms' wraps
+    size_t j = 0;
+    size_t k = 1;
+    size_t p = 1;
+
+    while (j + k < m)
+    {
+        unsigned char a = x[j + k];
+        unsigned char b = x[ms + k];
+
+        if (reversed ? (a > b) : (a < b)) {
+            j += k;
+            k = 1;
+            p = j - ms;
+        } else if (a == b) {
+            if (k != p) {
+                k++;
+            } else {
+                j += p;
+                k = 1;
+            }
+        } else {
+            ms = j;
+            j = ms + 1;
+            k = p = 1;
+        }
+    }
+
+    *period = p;
+
+    return ms;
+}
+
+// lexsearch_init()
+// Compile a searcher for the needle.  The needle is not copied.
+static int lexsearch_init(lexsearch *s, const void *needle, size_t len) PC_NOEXCEPT_C
+{
+    const unsigned char *x = (const unsigned char *)needle;
+
+    s->fNeedle = x;
+    s->fLength = len;
+    s->fCritPos = 0;
+    s->fPeriod = 1;
+    s->fPeriodic = false;
+
+    if (len < 2)
+        return 0;
+
+    // The critical position is the later of the two maximal suffixes
+    size_t p1 = 0;
+    size_t p2 = 0;
+    size_t ms1 = lexsearch_max_suffix(x, len, false, &p1);
+    size_t ms2 = lexsearch_max_suffix(x, len, true, &p2);
+
+    size_t crit = ms1 + 1;
+    size_t period = p1;
+    if (ms2 + 1 > ms1 + 1) {
+        crit = ms2 + 1;
+        period = p2;
+    }
+
+    // If the left half is repeated within the period, then after a match of
+    // the right half we can remember how much of the needle already
+    // matched, otherwise, the largest safe shift is used instead.
+    if ((period + crit <= len) && (memcmp(x, x + period, crit) == 0)) {
+        s->fPeriodic = true;
+    } else {
+        s->fPeriodic = false;
+        period = ((crit > len - crit) ? crit : len - crit) + 1;
+    }
+
+    s->fCritPos = crit;
+    s->fPeriod = period;
+
+    return 0;
+}
+
+static int lexsearch_init_from_cstr(lexsearch *s, const char *cstr) PC_NOEXCEPT_C
+{
+    return lexsearch_init(s, cstr, strlen(cstr));
+}
+
+static int lexsearch_init_from_span(lexsearch *s, const bspan *needle) PC_NOEXCEPT_C
+{
+    return lexsearch_init(s, bspan_begin(needle), bspan_size(needle));
+}
+
+// lexsearch_two_way()
+// The Two-Way search.  Linear time, no matter the input.
+// Returns the offset of the first match, or 'n' if there is none
+static size_t lexsearch_two_way(const lexsearch *s, const unsigned char *y, size_t n) PC_NOEXCEPT_C
+{
+    const unsigned char *x = s->fNeedle;
+    const size_t m = s->fLength;
+    const size_t crit = s->fCritPos;
+    const size_t period = s->fPeriod;
+    size_t j = 0;
+
+    if (m > n)
+        return n;
+
+    if (s->fPeriodic)
+    {
+        size_t memory = 0;
+        while (j <= n - m)
+        {
+            // Match the right half
+            size_t i = (crit > memory) ? crit : memory;
+            while ((i < m) && (x[i] == y[i + j]))
+                i++;
+
+            if (i < m) {
+                j += i - crit + 1;
+                memory = 0;
+                continue;
+            }
+
+            // Match the left half, but not the part we already know
+            i = crit;
+            while ((i > memory) && (x[i - 1] == y[i - 1 + j]))
+                i--;
+            if (i <= memory)
+                return j;
+
+            j += period;
+            memory = m - period;
+        }
+    }
+    else
+    {
+        while (j <= n - m)
+        {
+            size_t i = crit;
+            while ((i < m) && (x[i] == y[i + j]))
+                i++;
+
+            if (i < m) {
+                j += i - crit + 1;
+                continue;
+            }
+
+            i = crit;
+            while ((i > 0) && (x[i - 1] == y[i - 1 + j]))
+                i--;
+            if (i == 0)
+                return j;
+
+            j += period;
+        }
+    }
+
+    return n;
+}
+
+// lexsearch_verify()
+// Compare the bytes of the needle between the first and last, which
+// the filter has already checked
+static INLINE bool lexsearch_verify(const lexsearch *s, const unsigned char *at) PC_NOEXCEPT_C
+{
+    return (s->fLength <= 2) || (memcmp(at + 1, s->fNeedle + 1, s->fLength - 2) == 0);
+}
+
+// When the candidates that fail to verify have cost more than the
+// bytes scanned so far, plus this, the filter is not working for
+// this input, and the Two-Way search takes over
+#define LEXSEARCH_FILTER_SLACK 256
+
+typedef size_t (*lexsearch_find_fn)(const lexsearch *s, const unsigned char *y, size_t n);
+
+// lexsearch_kern_find_scalar()
+// Portable version of the filter
+static size_t lexsearch_kern_find_scalar(const lexsearch *s, const unsigned char *y, size_t n) PC_NOEXCEPT_C
+{
+    const size_t m = s->fLength;
+    const unsigned char first = s->fNeedle[0];
+    const unsigned char last = s->fNeedle[m - 1];
+    size_t wasted = 0;
+
+    for (size_t j = 0; j + m <= n; j++)
+    {
+        if ((y[j] != first) || (y[j + m - 1] != last))
+            continue;
+
+        if (lexsearch_verify(s, y + j))
+            return j;
+
+        wasted += m;
+        if (wasted > j + LEXSEARCH_FILTER_SLACK)
+            return j + lexsearch_two_way(s, y + j, n - j);
+    }
+
+    return n;
+}
+
+#if defined(PC_ARCH_X86)
+// SSE2 - 16 candidate positions at a time
+PC_TARGET_SSE2
+static size_t lexsearch_kern_find_sse2(const lexsearch *s, const unsigned char *y, size_t n) PC_NOEXCEPT_C
+{
+    const size_t m = s->fLength;
+    const __m128i first = _mm_set1_epi8((char)s->fNeedle[0]);
+    const __m128i last = _mm_set1_epi8((char)s->fNeedle[m - 1]);
+    size_t wasted = 0;
+    size_t j = 0;
+
+    for (; j + m - 1 + 16 <= n; j += 16)
+    {
+        __m128i f = _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *)(y + j)));
+        __m128i l = _mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i *)(y + j + m - 1)));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(f, l));
+
+        while (mask != 0)
+        {
+            size_t at = j + bhak_ctz32(mask);
+            if (lexsearch_verify(s, y + at))
+                return at;
+
+            wasted += m;
+            if (wasted > at + LEXSEARCH_FILTER_SLACK)
+                return at + lexsearch_two_way(s, y + at, n - at);
+
+            mask &= mask - 1;
+        }
+    }
+
+    return j + lexsearch_two_way(s, y + j, n - j);
+}
+
+// AVX2 - 32 candidate positions at a time
+PC_TARGET_AVX2
+static size_t lexsearch_kern_find_avx2(const lexsearch *s, const unsigned char *y, size_t n) PC_NOEXCEPT_C
+{
+    const size_t m = s->fLength;
+    const __m256i first = _mm256_set1_epi8((char)s->fNeedle[0]);
+    const __m256i last = _mm256_set1_epi8((char)s->fNeedle[m - 1]);
+    size_t wasted = 0;
+    size_t j = 0;
+
+    for (; j + m - 1 + 32 <= n; j += 32)
+    {
+        __m256i f = _mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i *)(y + j)));
+        __m256i l = _mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i *)(y + j + m - 1)));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(f, l));
+
+        while (mask != 0)
+        {
+            size_t at = j + bhak_ctz32(mask);
+            if (lexsearch_verify(s, y + at))
+                return at;
+
+            wasted += m;
+            if (wasted > at + LEXSEARCH_FILTER_SLACK)
+                return at + lexsearch_two_way(s, y + at, n - at);
+
+            mask &= mask - 1;
+        }
+    }
+
+    return j + lexsearch_kern_find_sse2(s, y + j, n - j);
+}
+#endif  // PC_ARCH_X86
+
+static lexsearch_find_fn lexsearch_select_kernel() PC_NOEXCEPT_C
+{
+#if defined(PC_ARCH_X86)
+    if (pc_cpu_has(PC_CPU_AVX2))
+        return lexsearch_kern_find_avx2;
+    if (pc_cpu_has(PC_CPU_SSE2))
+        return lexsearch_kern_find_sse2;
+#endif
+
+    return lexsearch_kern_find_scalar;
+}
+
+// lexsearch_find()
+// Return the offset of the first occurence of the needle within
+// 'data', or 'n' if it is not found.  An empty needle is found
+// at offset 0.
+static size_t lexsearch_find(const lexsearch *s, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+    static const lexsearch_find_fn findFn = lexsearch_select_kernel();
+
+    if (s->fLength == 0)
+        return 0;
+
+    if (s->fLength > n)
+        return n;
+
+    if (s->fLength == 1) {
+        const void *at = memchr(data, s->fNeedle[0], n);
+        return (at != nullptr) ? (size_t)((const unsigned char *)at - data) : n;
+    }
+
+    return findFn(s, data, n);
+}
+
+// lexsearch_find_span()
+// Search the span 'a' for the needle.
+// Return
+//    0 - found, 'rest' begins where the needle was found, and
+//        runs to the end of 'a'
+//   -1 - not found, 'rest' is the empty span at the end of 'a'
+static int lexsearch_find_span(const lexsearch *s, const bspan *a, bspan *rest) PC_NOEXCEPT_C
+{
+    const unsigned char *start = bspan_begin(a);
+    const unsigned char *end = bspan_end(a);
+    size_t n = bspan_size(a);
+    size_t at = lexsearch_find(s, start, n);
+
+    if ((at == n) && (s->fLength > 0)) {
+        bspan_init_from_pointers(rest, end, end);
+        return -1;
+    }
+
+    bspan_init_from_pointers(rest, start + at, end);
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LEXSEARCH_H_INCLUDED
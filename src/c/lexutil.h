@@ -4,6 +4,7 @@
 #include "pcoredef.h"
 #include "bspan.h"
 #include "asciiset.h"
+#include "lexsearch.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,22 +27,38 @@ static bool lex_begins_with_cstr(const bspan * a, const char *) PC_NOEXCEPT_C;
 
 static int lex_read_quoted(const bspan *src, bspan *dataChunk, bspan *rest) PC_NOEXCEPT_C;
 
+static size_t lex_span_find_first_in(const bspan *a, const asciiset *cs) PC_NOEXCEPT_C;
+static size_t lex_span_find_first_not_in(const bspan *a, const asciiset *cs) PC_NOEXCEPT_C;
+
 
 // Implementation
+
+// lex_span_find_first_in()
+// Return the index of the first byte of the span that is in the set
+// If there is no such byte, the size of the span is returned
+static size_t lex_span_find_first_in(const bspan *a, const asciiset *cs) PC_NOEXCEPT_C
+{
+    return asciiset_find_first_in(cs, bspan_begin(a), bspan_size(a));
+}
+
+// lex_span_find_first_not_in()
+// Return the index of the first byte of the span that is not in the set
+// If every byte is in the set, the size of the span is returned
+static size_t lex_span_find_first_not_in(const bspan *a, const asciiset *cs) PC_NOEXCEPT_C
+{
+    return asciiset_find_first_not_in(cs, bspan_begin(a), bspan_size(a));
+}
+
 // lex_skip_leading_charset
 // Skip any characters if they are on the front of the span
 static int lex_skip_leading_charset(const bspan* a, const asciiset *skippable, bspan *b) PC_NOEXCEPT_C
 {
     bspan_weak_assign(b, a);
-    unsigned char *startAt = (unsigned char *)b->fStart;
-    while (startAt < b->fEnd){
-        if (asciiset_contains_char(skippable, *startAt))
-            startAt++;
-        else
-            break;
-    }
-    if (startAt != b->fEnd)
-        b->fStart = startAt;
+    size_t sz = bspan_size(b);
+    size_t skipped = lex_span_find_first_not_in(b, skippable);
+
+    if (skipped != sz)
+        b->fStart += skipped;
 
     return 0;
 }
@@ -54,19 +71,12 @@ static int lex_skip_trailing_charset(const bspan* a, const asciiset *skippable,
     bspan_weak_assign(b, a);
     const unsigned char *endAt = bspan_end(b);
 
-    while (endAt > b->fStart){
+    // Back up over the skippable characters.  If they all
+    // are, the span ends up empty.
+    while ((endAt > b->fStart) && asciiset_contains_char(skippable, *(endAt - 1)))
         endAt--;
-        if (asciiset_contains_char(skippable, *endAt))
-            continue;
-
-        if (endAt > b->fStart) {
-            endAt++;
-        }
 
-        bspan_set_end(b, endAt);    
-        
-        return 0;
-    }
+    bspan_set_end(b, endAt);
 
     return 0;
 }
@@ -99,13 +109,7 @@ static int lex_skip_until_charset(const bspan* a, const asciiset *skippable, bsp
     bspan_weak_assign(tok, a);
     bspan_weak_assign(rest, a);
 
-    unsigned char *endAt = (unsigned char *)tok->fStart;
-    while (endAt < tok->fEnd){
-        if (asciiset_contains_char(skippable, *endAt))
-            break;
-        else
-            endAt++;
-    }
+    const unsigned char *endAt = tok->fStart + lex_span_find_first_in(tok, skippable);
     
     if (endAt != tok->fEnd)
     {
@@ -131,13 +135,7 @@ static int lex_front_token(const bspan* a, const asciiset *skipleading, const as
     bspan_weak_assign(tok, rest);
 
     // Now figure out where the token delimeter is
-    unsigned char *endAt = (unsigned char *)tok->fStart;
-    while (endAt < tok->fEnd){
-        if (asciiset_contains_char(delim, *endAt))
-            break;
-        else
-            endAt++;
-    }
+    const unsigned char *endAt = tok->fStart + lex_span_find_first_in(tok, delim);
     
     // If we ran into a delimeter character, then endAt
     // will not equal the end, so mark the token end
@@ -198,10 +196,11 @@ static bool lex_begins_with_cstr(const bspan *a, const char *cstr) PC_NOEXCEPT_C
 	{
 		const unsigned char * start = bspan_begin(a);
 		const unsigned char * end = bspan_end(a);
-		while (start < end && *start != c)
-			++start;
 
-        bspan_init_from_pointers(rest, start, end);
+		// memchr() is vectorized by the C library
+		const unsigned char * found = (start < end) ? (const unsigned char *)memchr(start, c, (size_t)(end - start)) : nullptr;
+
+        bspan_init_from_pointers(rest, (found != nullptr) ? found : end, end);
 
         return 0;
 
@@ -210,33 +209,20 @@ static bool lex_begins_with_cstr(const bspan *a, const char *cstr) PC_NOEXCEPT_C
 // lex_find_cstr
 // Find the location of a c-string within the source span
 // Return
-//   0 - no error
+//    0 - found
+//   -1 - not found
 // rest - begin will be where the search string was found
-//        end will be the end of the search string that was found
-
+//        end will be the end of the source span
+//        if not found, rest is the empty span at the end of the source
+//
+// This compiles a new searcher on every call.  If the same string is
+// going to be searched for repeatedly, keep a lexsearch instead.
 static int lex_find_cstr(const bspan* a, const char* cstr, bspan *rest) PC_NOEXCEPT_C
 {
-		const uint8_t* start = bspan_begin(a);
-		const uint8_t* end = bspan_end(a);
-		const uint8_t* cstart = (const unsigned char*)cstr;
-		const uint8_t* cend = cstart + strlen(cstr);
-
-        bspan cspan;
-        bspan_init_from_pointers(&cspan, cstart, cend);
-
-        bspan sspan;
-
-        while (start < end)
-        {
-            bspan_init_from_pointers(&sspan, start, end);
-            if (!lex_begins_with_span(&sspan, &cspan))
-                ++start;
-        }
-
-        bspan_init_from_pointers(rest, start, end);
-
-        return 0;
+    lexsearch srch;
+    lexsearch_init_from_cstr(&srch, cstr);
 
+    return lexsearch_find_span(&srch, a, rest);
 }
 
 //
@@ -0,0 +1,335 @@
+#ifndef OBUFF_H_INCLUDED
+#define OBUFF_H_INCLUDED
+
+//
+// obuff
+// An output buffer, the write side counterpart of a bspan.
+//
+// Bytes are appended to the end of the buffer.  With no sink, the buffer
+// simply grows to hold everything that is written, and the result is
+// taken with obuff_span() at the end.  With a sink, such as a file
+// descriptor, the buffer is handed to the sink whenever it fills up,
+// so it stays the same size no matter how much is written.
+//
+// Writers that know the most they will need (formatting a number, for
+// instance) call obuff_reserve() to get a pointer to write at directly,
+// then obuff_commit() with how much they actually wrote.  This avoids
+// a copy through a temporary buffer.
+//
+// Typical usage:
+//   obuff out;
+//   obuff_init_from_fd(&out, fd, 64*1024);
+//
+//   obuff_put_cstr(&out, "hello, ");
+//   obuff_put_span(&out, &name);
+//
+//   obuff_flush(&out);
+//   obuff_destroy(&out);
+//
+// Errors are sticky.  Once a write fails (out of memory, or the sink
+// failed), later writes are ignored, and obuff_has_error() is true.
+//
+
+#include <stdlib.h>     // malloc, realloc, free
+#include <errno.h>
+
+#if defined(_WIN32)
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+#include "pcoredef.h"
+#include "bspan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OBUFF_DEFAULT_CAPACITY (64*1024)
+
+// The destination of the bytes.  Write all 'sz' bytes from 'data'
+// Return the number of bytes written, or -1 if there was an error
+typedef ptrdiff_t (*obuff_write_fn)(void *ctx, const unsigned char *data, size_t sz);
+
+struct obuff_t {
+    unsigned char *fBuffer;
+    size_t fCapacity;
+    size_t fSize;               // bytes in the buffer, not yet flushed
+
+    obuff_write_fn fWrite;      // nullptr for a memory only buffer
+    void *fContext;
+    uint64_t fFlushed;          // bytes already handed to the sink
+    bool fError;
+};
+typedef struct obuff_t obuff;
+
+static int obuff_init(obuff *o, size_t initialCapacity) PC_NOEXCEPT_C;
+static int obuff_init_with_sink(obuff *o, obuff_write_fn writeFn, void *ctx, size_t capacity) PC_NOEXCEPT_C;
+static int obuff_init_from_fd(obuff *o, int fd, size_t capacity) PC_NOEXCEPT_C;
+static int obuff_destroy(obuff *o) PC_NOEXCEPT_C;
+
+static int obuff_span(const obuff *o, bspan *s) PC_NOEXCEPT_C;
+static size_t obuff_size(const obuff *o) PC_NOEXCEPT_C;
+static uint64_t obuff_total(const obuff *o) PC_NOEXCEPT_C;
+static bool obuff_has_error(const obuff *o) PC_NOEXCEPT_C;
+static int obuff_reset(obuff *o) PC_NOEXCEPT_C;
+static int obuff_flush(obuff *o) PC_NOEXCEPT_C;
+
+static unsigned char * obuff_reserve(obuff *o, size_t n) PC_NOEXCEPT_C;
+static int obuff_commit(obuff *o, size_t n) PC_NOEXCEPT_C;
+
+static int obuff_put_byte(obuff *o, unsigned char c) PC_NOEXCEPT_C;
+static int obuff_put_data(obuff *o, const void *data, size_t sz) PC_NOEXCEPT_C;
+static int obuff_put_span(obuff *o, const bspan *s) PC_NOEXCEPT_C;
+static int obuff_put_cstr(obuff *o, const char *cstr) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+// Write to a file descriptor
+static ptrdiff_t obuff_fd_write(void *ctx, const unsigned char *data, size_t sz) PC_NOEXCEPT_C
+{
+    int fd = (int)(intptr_t)ctx;
+    size_t written = 0;
+
+    while (written < sz)
+    {
+#if defined(_WIN32)
+        size_t chunk = sz - written;
+        unsigned int n32 = (chunk > 0x40000000) ? 0x40000000 : (unsigned int)chunk;
+        ptrdiff_t n = (ptrdiff_t)_write(fd, data + written, n32);
+#else
+        ptrdiff_t n = (ptrdiff_t)write(fd, data + written, sz - written);
+        if ((n < 0) && (errno == EINTR))
+            continue;
+#endif
+        if (n <= 0)
+            return -1;
+        written += (size_t)n;
+    }
+
+    return (ptrdiff_t)written;
+}
+
+// obuff_init()
+// A buffer that grows to hold everything written to it
+static int obuff_init(obuff *o, size_t initialCapacity) PC_NOEXCEPT_C
+{
+    memset(o, 0, sizeof(obuff));
+
+    if (initialCapacity > 0) {
+        o->fBuffer = (unsigned char *)malloc(initialCapacity);
+        if (o->fBuffer == nullptr) {
+            o->fError = true;
+            return -1;
+        }
+        o->fCapacity = initialCapacity;
+    }
+
+    return 0;
+}
+
+// obuff_init_with_sink()
+// A buffer of a fixed size, which is handed to 'writeFn' as it fills up
+static int obuff_init_with_sink(obuff *o, obuff_write_fn writeFn, void *ctx, size_t capacity) PC_NOEXCEPT_C
+{
+    if (obuff_init(o, (capacity > 0) ? capacity : OBUFF_DEFAULT_CAPACITY) != 0)
+        return -1;
+
+    o->fWrite = writeFn;
+    o->fContext = ctx;
+
+    return 0;
+}
+
+// obuff_init_from_fd()
+// The buffer does not take ownership of the file descriptor
+static int obuff_init_from_fd(obuff *o, int fd, size_t capacity) PC_NOEXCEPT_C
+{
+    if (fd < 0)
+        return -1;
+
+    return obuff_init_with_sink(o, obuff_fd_write, (void *)(intptr_t)fd, capacity);
+}
+
+// obuff_destroy()
+// Release the memory.  Anything not yet flushed is lost.
+static int obuff_destroy(obuff *o) PC_NOEXCEPT_C
+{
+    free(o->fBuffer);
+    memset(o, 0, sizeof(obuff));
+
+    return 0;
+}
+
+// obuff_span()
+// The bytes that are in the buffer, which for a buffer without a
+// sink, is everything that has been written.
+static int obuff_span(const obuff *o, bspan *s) PC_NOEXCEPT_C
+{
+    return bspan_init_from_data(s, o->fBuffer, o->fSize);
+}
+
+static size_t obuff_size(const obuff *o) PC_NOEXCEPT_C { return o->fSize; }
+
+// obuff_total()
+// Everything written, including what has already been flushed
+static uint64_t obuff_total(const obuff *o) PC_NOEXCEPT_C { return o->fFlushed + o->fSize; }
+
+static bool obuff_has_error(const obuff *o) PC_NOEXCEPT_C { return o->fError; }
+
+// obuff_reset()
+// Throw away what's in the buffer, keeping the memory
+static int obuff_reset(obuff *o) PC_NOEXCEPT_C
+{
+    o->fSize = 0;
+    o->fFlushed = 0;
+    o->fError = false;
+
+    return 0;
+}
+
+// obuff_flush()
+// Hand what's in the buffer to the sink.  Without a sink, this does nothing.
+static int obuff_flush(obuff *o) PC_NOEXCEPT_C
+{
+    if (o->fError)
+        return -1;
+
+    if ((o->fWrite == nullptr) || (o->fSize == 0))
+        return 0;
+
+    if (o->fWrite(o->fContext, o->fBuffer, o->fSize) != (ptrdiff_t)o->fSize) {
+        o->fError = true;
+        return -1;
+    }
+
+    o->fFlushed += o->fSize;
+    o->fSize = 0;
+
+    return 0;
+}
+
+// obuff_grow()
+// Make room for 'n' more bytes
+static int obuff_grow(obuff *o, size_t n) PC_NOEXCEPT_C
+{
+    size_t needed = o->fSize + n;
+    size_t newCapacity = (o->fCapacity < 64) ? 64 : o->fCapacity;
+    while (newCapacity < needed)
+        newCapacity *= 2;
+
+    unsigned char *newBuffer = (unsigned char *)realloc(o->fBuffer, newCapacity);
+    if (newBuffer == nullptr) {
+        o->fError = true;
+        return -1;
+    }
+
+    o->fBuffer = newBuffer;
+    o->fCapacity = newCapacity;
+
+    return 0;
+}
+
+// obuff_reserve()
+// Get a pointer to where at least 'n' bytes can be written.  Nothing is
+// added to the buffer until obuff_commit() is called.
+// Returns nullptr if there is an error
+static unsigned char * obuff_reserve(obuff *o, size_t n) PC_NOEXCEPT_C
+{
+    if (o->fError)
+        return nullptr;
+
+    if (o->fCapacity - o->fSize < n)
+    {
+        // Make room by flushing first, and only grow when a
+        // single write is larger than the whole buffer
+        if (o->fWrite != nullptr) {
+            if (obuff_flush(o) != 0)
+                return nullptr;
+        }
+
+        if ((o->fCapacity - o->fSize < n) && (obuff_grow(o, n) != 0))
+            return nullptr;
+    }
+
+    return o->fBuffer + o->fSize;
+}
+
+// obuff_commit()
+// Add 'n' bytes, written at the pointer from obuff_reserve(), to the buffer
+static int obuff_commit(obuff *o, size_t n) PC_NOEXCEPT_C
+{
+    if (o->fError || (n > o->fCapacity - o->fSize))
+        return -1;
+
+    o->fSize += n;
+
+    return 0;
+}
+
+static int obuff_put_byte(obuff *o, unsigned char c) PC_NOEXCEPT_C
+{
+    if ((o->fSize < o->fCapacity) && !o->fError) {
+        o->fBuffer[o->fSize++] = c;
+        return 0;
+    }
+
+    unsigned char *p = obuff_reserve(o, 1);
+    if (p == nullptr)
+        return -1;
+
+    *p = c;
+    o->fSize++;
+
+    return 0;
+}
+
+// obuff_put_data()
+// Large writes go straight to the sink, without a copy
+static int obuff_put_data(obuff *o, const void *data, size_t sz) PC_NOEXCEPT_C
+{
+    if (o->fError)
+        return -1;
+
+    if ((o->fWrite != nullptr) && (sz >= o->fCapacity))
+    {
+        if (obuff_flush(o) != 0)
+            return -1;
+
+        if (o->fWrite(o->fContext, (const unsigned char *)data, sz) != (ptrdiff_t)sz) {
+            o->fError = true;
+            return -1;
+        }
+        o->fFlushed += sz;
+
+        return 0;
+    }
+
+    unsigned char *p = obuff_reserve(o, sz);
+    if (p == nullptr)
+        return -1;
+
+    if (sz > 0)
+        memcpy(p, data, sz);
+    o->fSize += sz;
+
+    return 0;
+}
+
+static int obuff_put_span(obuff *o, const bspan *s) PC_NOEXCEPT_C
+{
+    return obuff_put_data(o, bspan_begin(s), bspan_size(s));
+}
+
+static int obuff_put_cstr(obuff *o, const char *cstr) PC_NOEXCEPT_C
+{
+    return obuff_put_data(o, cstr, strlen(cstr));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // OBUFF_H_INCLUDED
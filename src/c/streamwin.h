@@ -0,0 +1,341 @@
+#ifndef STREAMWIN_H_INCLUDED
+#define STREAMWIN_H_INCLUDED
+
+//
+// streamwin
+// A sliding window over a stream of bytes, for when the input is too
+// large to have in memory all at once (or is coming from a pipe).
+//
+// The window holds the bytes that have been read, but not yet consumed.
+// Scanners work on the window as an ordinary bspan, and tell the window
+// how much they have used up with streamwin_consume().  When they run
+// off the end of the window, streamwin_refill() or streamwin_require()
+// reads more.
+//
+// Refilling keeps the unconsumed bytes, so a token that straddles the
+// end of one block and the beginning of the next stays in one piece.
+// To make room, the unconsumed bytes are moved to the front of the
+// buffer, and the buffer only grows when a single token is larger
+// than the whole buffer.
+//
+// IMPORTANT: a refill can move the bytes, so any bspan taken from
+// the window before the refill is no longer valid after it.
+//
+// Typical usage:
+//   streamwin win;
+//   streamwin_init_from_fd(&win, fd, 1024*1024);
+//
+//   bspan line;
+//   int result;
+//   while ((result = streamwin_next_token(&win, linechars, &line)) == 0)
+//       // do something with line, which is valid until the next call
+//   if (result == -2)
+//       // the stream failed
+//
+//   streamwin_destroy(&win);
+//
+
+#include <stdlib.h>     // malloc, realloc, free
+#include <errno.h>
+
+#if defined(_WIN32)
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+#include "pcoredef.h"
+#include "bspan.h"
+#include "asciiset.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STREAMWIN_DEFAULT_BLOCK_SIZE (1024*1024)
+
+// The source of the bytes.  Read up to 'sz' bytes into 'buff'
+// Return the number of bytes read, 0 at the end of the stream,
+// or -1 if there was an error
+typedef ptrdiff_t (*streamwin_read_fn)(void *ctx, unsigned char *buff, size_t sz);
+
+struct streamwin_t {
+    unsigned char *fBuffer;
+    size_t fCapacity;
+    size_t fBlockSize;          // how much to read at a time
+    size_t fMaxCapacity;        // the buffer will not grow past this
+
+    bspan fWindow;              // read, but not yet consumed
+
+    streamwin_read_fn fRead;
+    void *fContext;
+    uint64_t fStreamOffset;     // position in the stream of the start of the window
+    bool fAtEnd;
+    bool fError;
+};
+typedef struct streamwin_t streamwin;
+
+static int streamwin_init_from_callback(streamwin *w, streamwin_read_fn readFn, void *ctx, size_t blockSize) PC_NOEXCEPT_C;
+static int streamwin_init_from_fd(streamwin *w, int fd, size_t blockSize) PC_NOEXCEPT_C;
+static int streamwin_destroy(streamwin *w) PC_NOEXCEPT_C;
+static int streamwin_set_max_size(streamwin *w, size_t maxSize) PC_NOEXCEPT_C;
+
+static int streamwin_span(const streamwin *w, bspan *s) PC_NOEXCEPT_C;
+static size_t streamwin_size(const streamwin *w) PC_NOEXCEPT_C;
+static bool streamwin_is_done(const streamwin *w) PC_NOEXCEPT_C;
+static uint64_t streamwin_offset(const streamwin *w) PC_NOEXCEPT_C;
+
+static int streamwin_consume(streamwin *w, size_t n) PC_NOEXCEPT_C;
+static int streamwin_consume_to(streamwin *w, const unsigned char *p) PC_NOEXCEPT_C;
+static ptrdiff_t streamwin_refill(streamwin *w) PC_NOEXCEPT_C;
+static int streamwin_require(streamwin *w, size_t n) PC_NOEXCEPT_C;
+static int streamwin_next_token(streamwin *w, const asciiset *delims, bspan *tok) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+// Read from a file descriptor
+static ptrdiff_t streamwin_fd_read(void *ctx, unsigned char *buff, size_t sz) PC_NOEXCEPT_C
+{
+    int fd = (int)(intptr_t)ctx;
+
+#if defined(_WIN32)
+    unsigned int chunk = (sz > 0x40000000) ? 0x40000000 : (unsigned int)sz;
+    return (ptrdiff_t)_read(fd, buff, chunk);
+#else
+    ptrdiff_t n;
+    do {
+        n = (ptrdiff_t)read(fd, buff, sz);
+    } while ((n < 0) && (errno == EINTR));
+
+    return n;
+#endif
+}
+
+static int streamwin_init_from_callback(streamwin *w, streamwin_read_fn readFn, void *ctx, size_t blockSize) PC_NOEXCEPT_C
+{
+    memset(w, 0, sizeof(streamwin));
+
+    if (readFn == nullptr)
+        return -1;
+
+    w->fBlockSize = (blockSize > 0) ? blockSize : STREAMWIN_DEFAULT_BLOCK_SIZE;
+    w->fMaxCapacity = (size_t)-1;
+    w->fRead = readFn;
+    w->fContext = ctx;
+    bspan_init(&w->fWindow);
+
+    return 0;
+}
+
+// streamwin_init_from_fd()
+// The window does not take ownership of the file descriptor
+static int streamwin_init_from_fd(streamwin *w, int fd, size_t blockSize) PC_NOEXCEPT_C
+{
+    if (fd < 0)
+        return -1;
+
+    return streamwin_init_from_callback(w, streamwin_fd_read, (void *)(intptr_t)fd, blockSize);
+}
+
+static int streamwin_destroy(streamwin *w) PC_NOEXCEPT_C
+{
+    free(w->fBuffer);
+    memset(w, 0, sizeof(streamwin));
+
+    return 0;
+}
+
+// streamwin_set_max_size()
+// Limit how large the buffer can grow.  If a single token is larger than
+// this, it can not be held in the window, and the refill fails.
+static int streamwin_set_max_size(streamwin *w, size_t maxSize) PC_NOEXCEPT_C
+{
+    if (maxSize < w->fBlockSize)
+        return -1;
+
+    w->fMaxCapacity = maxSize;
+
+    return 0;
+}
+
+// streamwin_span()
+// The bytes that are currently available.  This is only valid
+// until the next refill.
+static int streamwin_span(const streamwin *w, bspan *s) PC_NOEXCEPT_C
+{
+    return bspan_weak_assign(s, &w->fWindow);
+}
+
+static size_t streamwin_size(const streamwin *w) PC_NOEXCEPT_C { return bspan_size(&w->fWindow); }
+
+// streamwin_is_done()
+// Everything has been read, and consumed
+static bool streamwin_is_done(const streamwin *w) PC_NOEXCEPT_C { return (w->fAtEnd || w->fError) && bspan_is_empty(&w->fWindow); }
+
+// streamwin_offset()
+// The position within the whole stream of the front of the window
+static uint64_t streamwin_offset(const streamwin *w) PC_NOEXCEPT_C { return w->fStreamOffset; }
+
+// streamwin_consume()
+// Mark 'n' bytes at the front of the window as used
+static int streamwin_consume(streamwin *w, size_t n) PC_NOEXCEPT_C
+{
+    if (n > bspan_size(&w->fWindow))
+        return -1;
+
+    w->fWindow.fStart += n;
+    w->fStreamOffset += n;
+
+    return 0;
+}
+
+// streamwin_consume_to()
+// Mark everything in front of 'p' as used.  'p' is typically
+// where a scanner left off within streamwin_span()
+static int streamwin_consume_to(streamwin *w, const unsigned char *p) PC_NOEXCEPT_C
+{
+    if ((p < w->fWindow.fStart) || (p > w->fWindow.fEnd))
+        return -1;
+
+    return streamwin_consume(w, (size_t)(p - w->fWindow.fStart));
+}
+
+// streamwin_refill()
+// Read another block into the window, keeping whatever has not
+// been consumed.
+// Return
+//   >0 - the number of bytes added to the window
+//    0 - the end of the stream has been reached
+//   -1 - read error, or the window would have to grow too large
+static ptrdiff_t streamwin_refill(streamwin *w) PC_NOEXCEPT_C
+{
+    if (w->fError)
+        return -1;
+    if (w->fAtEnd)
+        return 0;
+
+    size_t live = bspan_size(&w->fWindow);
+    size_t consumed = (w->fBuffer != nullptr) ? (size_t)(w->fWindow.fStart - w->fBuffer) : 0;
+    size_t tailRoom = w->fCapacity - consumed - live;
+
+    // Slide the unconsumed bytes to the front, but only when
+    // there's not a block's worth of room after them.  That way, the
+    // bytes are moved at most once per block read.
+    if ((tailRoom < w->fBlockSize) && (consumed > 0))
+    {
+        if (live > 0)
+            memmove(w->fBuffer, w->fWindow.fStart, live);
+        consumed = 0;
+        tailRoom = w->fCapacity - live;
+    }
+
+    // Grow, when the unconsumed bytes take up the whole buffer
+    if (tailRoom < w->fBlockSize)
+    {
+        size_t newCapacity = (w->fCapacity * 2 > live + w->fBlockSize) ? w->fCapacity * 2 : live + w->fBlockSize;
+        if (newCapacity > w->fMaxCapacity)
+            newCapacity = w->fMaxCapacity;
+        if (newCapacity <= live) {
+            w->fError = true;
+            return -1;
+        }
+
+        unsigned char *newBuffer = (unsigned char *)realloc(w->fBuffer, newCapacity);
+        if (newBuffer == nullptr) {
+            w->fError = true;
+            return -1;
+        }
+
+        w->fBuffer = newBuffer;
+        w->fCapacity = newCapacity;
+        tailRoom = newCapacity - live;
+    }
+
+    unsigned char *readAt = w->fBuffer + consumed + live;
+    size_t toRead = (tailRoom < w->fBlockSize) ? tailRoom : w->fBlockSize;
+    ptrdiff_t nRead = w->fRead(w->fContext, readAt, toRead);
+
+    bspan_init_from_pointers(&w->fWindow, w->fBuffer + consumed, readAt + ((nRead > 0) ? nRead : 0));
+
+    if (nRead < 0) {
+        w->fError = true;
+        return -1;
+    }
+
+    if (nRead == 0)
+        w->fAtEnd = true;
+
+    return nRead;
+}
+
+// streamwin_require()
+// Make sure there are at least 'n' bytes in the window
+// Return
+//    0 - there are
+//   -1 - the stream ended, or failed, before there were
+static int streamwin_require(streamwin *w, size_t n) PC_NOEXCEPT_C
+{
+    while (bspan_size(&w->fWindow) < n)
+    {
+        if (streamwin_refill(w) <= 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+// streamwin_next_token()
+// Return the bytes up to the next delimiter, reading more of the stream
+// as needed.  The token, and the delimiter after it, are consumed.  The
+// last token of the stream does not need a delimiter after it.  When the
+// stream fails before a delimiter is found, the bytes read so far are not
+// a token, and are left in the window.
+// Return
+//    0 - 'tok' holds the token, which is valid until the next call
+//   -1 - there are no more tokens
+//   -2 - read error, or the token is larger than the window can grow
+static int streamwin_next_token(streamwin *w, const asciiset *delims, bspan *tok) PC_NOEXCEPT_C
+{
+    size_t scanned = 0;
+
+    while (true)
+    {
+        size_t live = bspan_size(&w->fWindow);
+        size_t at = scanned + asciiset_find_first_in(delims, w->fWindow.fStart + scanned, live - scanned);
+
+        if (at < live) {
+            bspan_init_from_data(tok, w->fWindow.fStart, at);
+            streamwin_consume(w, at + 1);
+            return 0;
+        }
+
+        // Don't look at these bytes again, after the refill
+        scanned = live;
+
+        if (streamwin_refill(w) <= 0)
+            break;
+    }
+
+    if (w->fError) {
+        bspan_init_from_pointers(tok, w->fWindow.fStart, w->fWindow.fStart);
+        return -2;
+    }
+
+    // Whatever is left is the last token
+    if (bspan_is_empty(&w->fWindow)) {
+        bspan_init_from_pointers(tok, w->fWindow.fEnd, w->fWindow.fEnd);
+        return -1;
+    }
+
+    bspan_weak_assign(tok, &w->fWindow);
+    streamwin_consume(w, bspan_size(&w->fWindow));
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // STREAMWIN_H_INCLUDED
@@ -1,9 +1,12 @@
 #ifndef XMLCORE_H_INCLUDED
 #define XMLCORE_H_INCLUDED
 
+#include <stdlib.h>     // realloc, free
+
 #include "pcoredef.h"
 #include "bspan.h"
 #include "lexutil.h"
+#include "xmlvocab.h"
 
 
 #ifdef __cplusplus
@@ -44,6 +47,7 @@ static int xml_name_namespace(const xmlname *a, bspan *nspace) PC_NOEXCEPT_C;
 struct xmlelement_t
 {
     int fElementKind;
+    uint32_t fNameId;           // from xmliterparams.fVocab, or XMLVOCAB_UNKNOWN
     bspan fData;
     bspan fNameSpan;
     xmlname fXmlName;
@@ -62,6 +66,81 @@ static int xml_element_set_kind(xmlelement *e, int kind) PC_NOEXCEPT_C;
 
 static int xml_element_get_data(const xmlelement *e, bspan *d) PC_NOEXCEPT_C;
 
+//============================================================
+// Attributes
+//============================================================
+//
+// After the name of a tag is scanned, the attributes are left
+// sitting in the element's fData, unparsed.  An attribute iterator
+// reads them one at a time, only when asked, without copying or
+// allocating anything.  The name and value are spans of the original
+// source, and the value does not include the quotes.
+//
+// Typical usage:
+//   xmlattriter iter;
+//   xmlattr attr;
+//   xml_attr_iter_init(&iter, &elem);
+//   while (xml_attr_iter_next(&iter, &attr) == 0)
+//       ...
+//
+// When only one or two attributes are wanted, xml_element_find_attribute()
+// stops at the first one with the name, and never looks at the rest of the tag.
+//
+struct xmlattr_t {
+    bspan fName;        // qualified name, like 'xlink:href'
+    bspan fValue;       // without the quotes
+};
+typedef struct xmlattr_t xmlattr;
+
+struct xmlattriter_t {
+    bspan fSource;      // what's left of the attributes
+};
+typedef struct xmlattriter_t xmlattriter;
+
+static int xml_attr_iter_init(xmlattriter *iter, const xmlelement *e) PC_NOEXCEPT_C;
+static int xml_attr_iter_next(xmlattriter *iter, xmlattr *attr) PC_NOEXCEPT_C;
+static int xml_element_find_attribute(const xmlelement *e, const bspan *name, bspan *value) PC_NOEXCEPT_C;
+static int xml_element_find_attribute_cstr(const xmlelement *e, const char *name, bspan *value) PC_NOEXCEPT_C;
+
+//============================================================
+// Open elements
+//============================================================
+//
+// The elements that are open, while going through the elements of a
+// document, with the name of each, so end tags can be matched to them.
+// An end tag closes the nearest open element with the same name, and
+// all the ones left open inside of it.  An end tag that matches nothing
+// is ignored.  xmldom, xmlpath and xmlns all close elements this way.
+//
+// Along with each name, the stack keeps a fixed size piece of data, for
+// whatever the user of the stack needs to know about the element.
+//
+// Typical usage:
+//   xmlopenstack open;
+//   xml_open_stack_init(&open, sizeof(mylevel));
+//
+//   mylevel *level = (mylevel *)xml_open_stack_push(&open, &elem.fNameSpan);
+//   ...
+//   xml_open_stack_close(&open, &elem.fNameSpan);
+//
+//   xml_open_stack_destroy(&open);
+//
+struct xmlopenstack_t {
+    unsigned char *fEntries;    // for each open element, its name, then its data
+    size_t fEntrySize;
+    size_t fDepth;              // how many are open
+    size_t fCapacity;
+};
+typedef struct xmlopenstack_t xmlopenstack;
+
+static int xml_open_stack_init(xmlopenstack *s, size_t dataSize) PC_NOEXCEPT_C;
+static int xml_open_stack_destroy(xmlopenstack *s) PC_NOEXCEPT_C;
+static void * xml_open_stack_push(xmlopenstack *s, const bspan *name) PC_NOEXCEPT_C;
+static void * xml_open_stack_data(const xmlopenstack *s, size_t depth) PC_NOEXCEPT_C;
+static const bspan * xml_open_stack_name(const xmlopenstack *s, size_t depth) PC_NOEXCEPT_C;
+static int xml_open_stack_find(const xmlopenstack *s, const bspan *name, size_t *depth) PC_NOEXCEPT_C;
+static int xml_open_stack_close(xmlopenstack *s, const bspan *name) PC_NOEXCEPT_C;
+
 
 
 
@@ -94,6 +173,20 @@ static asciiset * xmlcolonchar() PC_NOEXCEPT_C
     return &chars;
 }
 
+// The characters that end an attribute name
+static asciiset * xmlattrnameend() PC_NOEXCEPT_C
+{
+    static asciiset chars;
+    static bool initialized=false;
+
+    if (!initialized){
+        asciiset_init_from_cstr(&chars, "= \r\n\t/>");
+        initialized = true;
+    }
+
+    return &chars;
+}
+
 // xmlname
 //
 static int xml_name_init(xmlname *a) PC_NOEXCEPT_C
@@ -145,6 +238,7 @@ static int xml_name_namespace(const xmlname *a, bspan *nspace) PC_NOEXCEPT_C
 static int xml_element_init(xmlelement *e) PC_NOEXCEPT_C
 {
     e->fElementKind = XML_ELEMENT_TYPE_INVALID;
+    e->fNameId = XMLVOCAB_UNKNOWN;
     bspan_init(&e->fData);
     bspan_init(&e->fNameSpan);
     xml_name_init(&e->fXmlName);
@@ -156,6 +250,7 @@ static int xml_element_init(xmlelement *e) PC_NOEXCEPT_C
 int xml_element_init_from_element(xmlelement *a, const xmlelement *b) PC_NOEXCEPT_C
 {
     a->fElementKind = b->fElementKind;
+    a->fNameId = b->fNameId;
     bspan_weak_assign(&a->fNameSpan, &b->fNameSpan);
     bspan_weak_assign(&a->fData, &b->fData);
     xml_name_weak_assign(&a->fXmlName, &b->fXmlName);
@@ -214,6 +309,15 @@ static int xml_element_scanNameSpan(xmlelement *e) PC_NOEXCEPT_C
     //e->fNameSpan.fEnd = s.fStart;
 
     lex_skip_until_charset(&s, xmlwspchars(), &e->fNameSpan, &s);
+
+    // '<br/>' has the '/' at the end of the name.  It is left
+    // in the data, where the attributes would be.
+    if ((e->fElementKind == XML_ELEMENT_TYPE_SELF_CLOSING) &&
+        (bspan_size(&e->fNameSpan) > 0) && (bspan_back(&e->fNameSpan) == '/'))
+    {
+        bspan_set_end(&e->fNameSpan, bspan_end(&e->fNameSpan) - 1);
+        bspan_set_begin(&s, bspan_end(&e->fNameSpan));
+    }
     xml_name_reset(&e->fXmlName,&e->fNameSpan);
 
     // Modify the data chunk to point to the next attribute
@@ -252,6 +356,218 @@ static int xml_element_get_data(const xmlelement *e, bspan *d) PC_NOEXCEPT_C {
 }
 
 
+
+//
+// Attributes
+//
+
+// xml_attr_iter_init()
+// Start iterating over the attributes of an element.  The element
+// must have had its name scanned, which the xml scanner does for
+// start tags, and self closing tags.
+static int xml_attr_iter_init(xmlattriter *iter, const xmlelement *e) PC_NOEXCEPT_C
+{
+    bspan_weak_assign(&iter->fSource, &e->fData);
+
+    return 0;
+}
+
+// xml_attr_iter_next()
+// Read the next attribute.
+// Return
+//    0 - an attribute was read
+//   -1 - there are no more attributes
+//
+// An attribute without a value ('<option selected>') has an empty value.
+// A value without quotes runs to the next whitespace.
+// A value with no closing quote runs to the end of the tag, and is the last.
+static int xml_attr_iter_next(xmlattriter *iter, xmlattr *attr) PC_NOEXCEPT_C
+{
+    const unsigned char *p = bspan_begin(&iter->fSource);
+    const unsigned char *end = bspan_end(&iter->fSource);
+
+    if (p >= end)
+        return -1;
+
+    // Skip whitespace, and stop at the '/' of a self closing
+    // tag, or the '?' of a processing instruction
+    p += asciiset_find_first_not_in(xmlwspchars(), p, (size_t)(end - p));
+    if ((p >= end) || (*p == '/') || (*p == '?') || (*p == '>')) {
+        bspan_set_begin(&iter->fSource, end);
+        return -1;
+    }
+
+    // The name goes up to the '=', or whitespace
+    const unsigned char *nameStart = p;
+    p += asciiset_find_first_in(xmlattrnameend(), p, (size_t)(end - p));
+    if (p == nameStart)
+        p++;
+    bspan_init_from_pointers(&attr->fName, nameStart, p);
+
+    p += asciiset_find_first_not_in(xmlwspchars(), p, (size_t)(end - p));
+    if ((p >= end) || (*p != '=')) {
+        // No value
+        bspan_init_from_pointers(&attr->fValue, p, p);
+        bspan_set_begin(&iter->fSource, p);
+        return 0;
+    }
+
+    // Skip the '=', and any whitespace after it
+    p++;
+    p += asciiset_find_first_not_in(xmlwspchars(), p, (size_t)(end - p));
+
+    if ((p < end) && ((*p == '"') || (*p == '\''))) {
+        const unsigned char *valueStart = p + 1;
+        const unsigned char *closePtr = (const unsigned char *)memchr(valueStart, *p, (size_t)(end - valueStart));
+        if (closePtr == nullptr) {
+            bspan_init_from_pointers(&attr->fValue, valueStart, end);
+            bspan_set_begin(&iter->fSource, end);
+            return 0;
+        }
+
+        bspan_init_from_pointers(&attr->fValue, valueStart, closePtr);
+        bspan_set_begin(&iter->fSource, closePtr + 1);
+        return 0;
+    }
+
+    // No quotes
+    const unsigned char *valueStart = p;
+    p += asciiset_find_first_in(xmlwspchars(), p, (size_t)(end - p));
+    bspan_init_from_pointers(&attr->fValue, valueStart, p);
+    bspan_set_begin(&iter->fSource, p);
+
+    return 0;
+}
+
+// xml_element_find_attribute()
+// Find the value of the first attribute with the given (qualified) name
+// Return
+//    0 - found
+//   -1 - not found, and value is empty
+static int xml_element_find_attribute(const xmlelement *e, const bspan *name, bspan *value) PC_NOEXCEPT_C
+{
+    size_t nameSize = bspan_size(name);
+    xmlattriter iter;
+    xmlattr attr;
+
+    xml_attr_iter_init(&iter, e);
+    while (xml_attr_iter_next(&iter, &attr) == 0)
+    {
+        if ((bspan_size(&attr.fName) == nameSize) && (memcmp(bspan_begin(&attr.fName), bspan_begin(name), nameSize) == 0)) {
+            bspan_weak_assign(value, &attr.fValue);
+            return 0;
+        }
+    }
+
+    bspan_init(value);
+
+    return -1;
+}
+
+static int xml_element_find_attribute_cstr(const xmlelement *e, const char *name, bspan *value) PC_NOEXCEPT_C
+{
+    bspan nameSpan;
+    bspan_init_from_cstr(&nameSpan, name);
+
+    return xml_element_find_attribute(e, &nameSpan, value);
+}
+
+//
+// Open elements
+//
+static int xml_open_stack_init(xmlopenstack *s, size_t dataSize) PC_NOEXCEPT_C
+{
+    memset(s, 0, sizeof(xmlopenstack));
+
+    // The data is kept aligned, right after the name
+    s->fEntrySize = (sizeof(bspan) + dataSize + 7) & ~(size_t)7;
+
+    return 0;
+}
+
+static int xml_open_stack_destroy(xmlopenstack *s) PC_NOEXCEPT_C
+{
+    free(s->fEntries);
+    s->fEntries = nullptr;
+    s->fDepth = 0;
+    s->fCapacity = 0;
+
+    return 0;
+}
+
+// xml_open_stack_push()
+// Open an element
+// Returns where its data goes, or nullptr when out of memory
+static void * xml_open_stack_push(xmlopenstack *s, const bspan *name) PC_NOEXCEPT_C
+{
+    if (s->fDepth == s->fCapacity)
+    {
+        size_t cap = (s->fCapacity < 64) ? 64 : s->fCapacity * 2;
+        unsigned char *entries = (unsigned char *)realloc(s->fEntries, cap * s->fEntrySize);
+        if (entries == nullptr)
+            return nullptr;
+        s->fEntries = entries;
+        s->fCapacity = cap;
+    }
+
+    unsigned char *entry = s->fEntries + (s->fDepth * s->fEntrySize);
+    bspan_weak_assign((bspan *)entry, name);
+    s->fDepth++;
+
+    return entry + sizeof(bspan);
+}
+
+// xml_open_stack_data()
+// The data of the open element at 'depth', where 0 is the outermost
+static void * xml_open_stack_data(const xmlopenstack *s, size_t depth) PC_NOEXCEPT_C
+{
+    return s->fEntries + (depth * s->fEntrySize) + sizeof(bspan);
+}
+
+static const bspan * xml_open_stack_name(const xmlopenstack *s, size_t depth) PC_NOEXCEPT_C
+{
+    return (const bspan *)(s->fEntries + (depth * s->fEntrySize));
+}
+
+// xml_open_stack_find()
+// The depth of the nearest open element with the name, which
+// is the element an end tag with that name closes
+// Return
+//    0 - found
+//   -1 - no open element has that name
+static int xml_open_stack_find(const xmlopenstack *s, const bspan *name, size_t *depth) PC_NOEXCEPT_C
+{
+    size_t n = bspan_size(name);
+
+    for (size_t d = s->fDepth; d > 0; d--)
+    {
+        const bspan *open = xml_open_stack_name(s, d - 1);
+        if ((bspan_size(open) == n) && ((n == 0) || (memcmp(bspan_begin(open), bspan_begin(name), n) == 0))) {
+            *depth = d - 1;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+// xml_open_stack_close()
+// Close the nearest open element with the name, and all the ones
+// inside of it
+// Return
+//    0 - the element was closed
+//   -1 - no open element has that name, and nothing was closed
+static int xml_open_stack_close(xmlopenstack *s, const bspan *name) PC_NOEXCEPT_C
+{
+    size_t depth;
+    if (xml_open_stack_find(s, name, &depth) != 0)
+        return -1;
+
+    s->fDepth = depth;
+
+    return 0;
+}
+
 		
 bool xml_element_isXmlDecl(const xmlelement *e) PC_NOEXCEPT_C { return xml_element_is_kind(e, XML_ELEMENT_TYPE_XMLDECL); }
 bool xml_element_isStart(const xmlelement *e) PC_NOEXCEPT_C { return xml_element_is_kind(e, XML_ELEMENT_TYPE_START_TAG); }
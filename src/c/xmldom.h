@@ -0,0 +1,403 @@
+#ifndef XMLDOM_H_INCLUDED
+#define XMLDOM_H_INCLUDED
+
+//
+// xmldom
+// A compact, read only, document object model, built from the
+// elements of the xml scanner in a single pass.
+//
+// The nodes are not objects with pointers to each other.  They are
+// numbered, and each of their fields is held in an array of its own
+// (struct of arrays):
+//   fKinds        - the XML_ELEMENT_TYPE of the node
+//   fNames        - the id of the tag name, from the name table
+//   fParents      - index of the parent node
+//   fFirstChild   - index of the first child
+//   fNextSibling  - index of the next sibling
+//   fDataOffset   - the attributes of a tag, or the text of content,
+//   fDataSize       comments, and the like, as a span of the source
+// While the dom is being built, the arrays grow as needed.  When it's
+// done, they are copied, at their exact size, into a single arena, and
+// all of it is freed at once.  A node takes 25 bytes,
+// where a node with pointers, a name, and a vector of children, each of
+// them allocated from the heap, takes over 100.
+//
+// Nodes are numbered in the order they appear in the document, which
+// is also depth first order.  Walking the whole tree depth first is
+// walking the arrays from front to back.  Node 0 is the document itself,
+// and the elements at the top of the document are its children.
+//
+// Tag names are interned (interntable.h).  Each distinct name gets a small
+// id, so finding children with a given name compares integers, not strings.
+//
+// The dom does not copy the source.  Names and data point into it, so
+// the source must stay put for as long as the dom is used.  Data is held
+// as 32-bit offsets, so the source has to be smaller than 4GB.
+//
+// Typical usage:
+//   xmldom dom;
+//   xmldom_init(&dom);
+//   xmldom_build_from_source(&dom, &xmlsrc);
+//
+//   uint32_t svgName = xmldom_find_name_cstr(&dom, "svg");
+//   uint32_t svg = xmldom_first_child_named(&dom, XMLDOM_ROOT, svgName);
+//   for (uint32_t n = xmldom_first_child(&dom, svg); n != XMLDOM_NONE; n = xmldom_next_sibling(&dom, n))
+//       ...
+//
+//   xmldom_destroy(&dom);
+//
+
+#include <stdlib.h>     // realloc, free
+
+#include "pcoredef.h"
+#include "bspan.h"
+#include "arena.h"
+#include "interntable.h"
+#include "xmlscan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XMLDOM_NONE INTERNTABLE_NONE
+#define XMLDOM_ROOT ((uint32_t)0)
+
+struct xmldom_t {
+    arena fArena;
+    const unsigned char *fBase;     // start of the source
+
+    // The nodes
+    uint8_t *fKinds;
+    uint32_t *fNames;
+    uint32_t *fParents;
+    uint32_t *fFirstChild;
+    uint32_t *fNextSibling;
+    uint32_t *fDataOffset;
+    uint32_t *fDataSize;
+    size_t fCount;
+    size_t fCapacity;
+
+    interntable fNameTable;     // tag names, by name id
+};
+typedef struct xmldom_t xmldom;
+
+static int xmldom_init(xmldom *dom) PC_NOEXCEPT_C;
+static int xmldom_destroy(xmldom *dom) PC_NOEXCEPT_C;
+static int xmldom_build(xmldom *dom, const xmliterparams *params, xmliteratorstate *st) PC_NOEXCEPT_C;
+static int xmldom_build_from_source(xmldom *dom, bspan *src) PC_NOEXCEPT_C;
+
+static size_t xmldom_count(const xmldom *dom) PC_NOEXCEPT_C;
+static size_t xmldom_memory(const xmldom *dom) PC_NOEXCEPT_C;
+
+static int xmldom_kind(const xmldom *dom, uint32_t node) PC_NOEXCEPT_C;
+static uint32_t xmldom_name_id(const xmldom *dom, uint32_t node) PC_NOEXCEPT_C;
+static int xmldom_name(const xmldom *dom, uint32_t node, bspan *name) PC_NOEXCEPT_C;
+static int xmldom_data(const xmldom *dom, uint32_t node, bspan *data) PC_NOEXCEPT_C;
+static uint32_t xmldom_parent(const xmldom *dom, uint32_t node) PC_NOEXCEPT_C;
+static uint32_t xmldom_first_child(const xmldom *dom, uint32_t node) PC_NOEXCEPT_C;
+static uint32_t xmldom_next_sibling(const xmldom *dom, uint32_t node) PC_NOEXCEPT_C;
+static int xmldom_attr_iter_init(const xmldom *dom, uint32_t node, xmlattriter *iter) PC_NOEXCEPT_C;
+
+static uint32_t xmldom_find_name(const xmldom *dom, const bspan *name) PC_NOEXCEPT_C;
+static uint32_t xmldom_find_name_cstr(const xmldom *dom, const char *name) PC_NOEXCEPT_C;
+static uint32_t xmldom_first_child_named(const xmldom *dom, uint32_t node, uint32_t nameId) PC_NOEXCEPT_C;
+static uint32_t xmldom_next_sibling_named(const xmldom *dom, uint32_t node, uint32_t nameId) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+static int xmldom_init(xmldom *dom) PC_NOEXCEPT_C
+{
+    memset(dom, 0, sizeof(xmldom));
+    arena_init(&dom->fArena, 0);
+    interntable_init(&dom->fNameTable);
+
+    return 0;
+}
+
+static int xmldom_destroy(xmldom *dom) PC_NOEXCEPT_C
+{
+    arena_destroy(&dom->fArena);
+    interntable_destroy(&dom->fNameTable);
+    memset(dom, 0, sizeof(xmldom));
+
+    return 0;
+}
+
+static size_t xmldom_count(const xmldom *dom) PC_NOEXCEPT_C { return dom->fCount; }
+
+// xmldom_memory()
+// How many bytes the dom is using
+static size_t xmldom_memory(const xmldom *dom) PC_NOEXCEPT_C { return arena_total(&dom->fArena) + interntable_memory(&dom->fNameTable); }
+
+// Make room for at least one more node.  While building, the node
+// arrays are on the heap, so they can grow without leaving the old
+// copies behind in the arena.
+static int xmldom_reserve_node(xmldom *dom) PC_NOEXCEPT_C
+{
+    if (dom->fCount < dom->fCapacity)
+        return 0;
+
+    size_t cap = (dom->fCapacity < 256) ? 256 : dom->fCapacity * 2;
+    if (cap > XMLDOM_NONE)
+        return -1;
+
+    uint32_t **columns[] = { &dom->fNames, &dom->fParents, &dom->fFirstChild, &dom->fNextSibling, &dom->fDataOffset, &dom->fDataSize };
+    for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); i++) {
+        uint32_t *p = (uint32_t *)realloc(*columns[i], cap * sizeof(uint32_t));
+        if (p == nullptr)
+            return -1;
+        *columns[i] = p;
+    }
+
+    uint8_t *kinds = (uint8_t *)realloc(dom->fKinds, cap);
+    if (kinds == nullptr)
+        return -1;
+    dom->fKinds = kinds;
+    dom->fCapacity = cap;
+
+    return 0;
+}
+
+// Move the node arrays from the heap into the arena, at their exact size
+// When 'keep' is false, they are only freed, as when building failed
+static int xmldom_finish_nodes(xmldom *dom, bool keep) PC_NOEXCEPT_C
+{
+    size_t n = dom->fCount;
+    int result = 0;
+
+    void **columns[] = { (void **)&dom->fKinds, (void **)&dom->fNames, (void **)&dom->fParents, (void **)&dom->fFirstChild,
+        (void **)&dom->fNextSibling, (void **)&dom->fDataOffset, (void **)&dom->fDataSize };
+    for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); i++)
+    {
+        size_t bytes = (i == 0) ? n : n * sizeof(uint32_t);
+        void *p = keep ? arena_alloc(&dom->fArena, bytes) : nullptr;
+        if (p != nullptr)
+            memcpy(p, *columns[i], bytes);
+        else
+            result = -1;
+
+        free(*columns[i]);
+        *columns[i] = p;
+    }
+
+    if (result != 0)
+        dom->fCount = 0;
+    dom->fCapacity = dom->fCount;
+
+    return result;
+}
+
+//
+// Name table
+//
+
+// xmldom_find_name()
+// The id of a tag name, or XMLDOM_NONE if no tag has that name
+static uint32_t xmldom_find_name(const xmldom *dom, const bspan *name) PC_NOEXCEPT_C
+{
+    return interntable_find(&dom->fNameTable, name);
+}
+
+static uint32_t xmldom_find_name_cstr(const xmldom *dom, const char *name) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, name);
+
+    return xmldom_find_name(dom, &s);
+}
+
+//
+// Building
+//
+
+// Add a node as the last child of 'parent'.  'lastChild' is the
+// current last child of the parent, and is updated.
+static uint32_t xmldom_add_node(xmldom *dom, int kind, uint32_t nameId, const bspan *data, uint32_t parent, uint32_t *lastChild) PC_NOEXCEPT_C
+{
+    if (xmldom_reserve_node(dom) != 0)
+        return XMLDOM_NONE;
+
+    uint32_t n = (uint32_t)dom->fCount++;
+    dom->fKinds[n] = (uint8_t)kind;
+    dom->fNames[n] = nameId;
+    dom->fParents[n] = parent;
+    dom->fFirstChild[n] = XMLDOM_NONE;
+    dom->fNextSibling[n] = XMLDOM_NONE;
+    dom->fDataOffset[n] = (bspan_size(data) > 0) ? (uint32_t)(bspan_begin(data) - dom->fBase) : 0;
+    dom->fDataSize[n] = (uint32_t)bspan_size(data);
+
+    if (parent != XMLDOM_NONE) {
+        if (*lastChild == XMLDOM_NONE)
+            dom->fFirstChild[parent] = n;
+        else
+            dom->fNextSibling[*lastChild] = n;
+        *lastChild = n;
+    }
+
+    return n;
+}
+
+// What's kept for each open element, while building
+struct xmldom_open_t {
+    uint32_t fNode;
+    uint32_t fLastChild;
+};
+typedef struct xmldom_open_t xmldom_open;
+
+// xmldom_build()
+// Build the dom from the elements of an iterator, which can be using an
+// xmlindex.  The dom should be freshly initialized.
+// End tags close the nearest open element with the same name.  An end
+// tag with no matching open element is ignored, and elements that are
+// still open at the end of the document are closed.
+// Return
+//    0 - success
+//   -1 - out of memory, or the source is 4GB or larger
+static int xmldom_build(xmldom *dom, const xmliterparams *params, xmliteratorstate *st) PC_NOEXCEPT_C
+{
+    if (bspan_size(&st->fSource) > XMLDOM_NONE)
+        return -1;
+    dom->fBase = bspan_begin(&st->fSource);
+
+    xmlopenstack open;
+    xml_open_stack_init(&open, sizeof(xmldom_open));
+    int result = 0;
+
+    // The document node, which is outside of all the open elements
+    bspan empty;
+    bspan_init(&empty);
+    xmldom_open root;
+    root.fNode = XMLDOM_ROOT;
+    root.fLastChild = XMLDOM_NONE;
+    uint32_t none = XMLDOM_NONE;
+    xmldom_add_node(dom, XML_ELEMENT_TYPE_INVALID, XMLDOM_NONE, &empty, XMLDOM_NONE, &none);
+
+    xmlelement elem;
+    while ((result == 0) && (xml_iter_next_element(params, st, &elem) == 0))
+    {
+        int kind = elem.fElementKind;
+
+        if (kind == XML_ELEMENT_TYPE_END_TAG) {
+            xml_open_stack_close(&open, &elem.fNameSpan);
+            continue;
+        }
+
+        uint32_t nameId = XMLDOM_NONE;
+        if ((kind == XML_ELEMENT_TYPE_START_TAG) || (kind == XML_ELEMENT_TYPE_SELF_CLOSING))
+        {
+            nameId = interntable_intern(&dom->fNameTable, &elem.fNameSpan);
+            if (nameId == XMLDOM_NONE) {
+                result = -1;
+                break;
+            }
+        }
+
+        xmldom_open *top = (open.fDepth == 0) ? &root : (xmldom_open *)xml_open_stack_data(&open, open.fDepth - 1);
+        uint32_t n = xmldom_add_node(dom, kind, nameId, &elem.fData, top->fNode, &top->fLastChild);
+        if (n == XMLDOM_NONE) {
+            result = -1;
+            break;
+        }
+
+        if (kind == XML_ELEMENT_TYPE_START_TAG)
+        {
+            xmldom_open *level = (xmldom_open *)xml_open_stack_push(&open, &elem.fNameSpan);
+            if (level == nullptr) {
+                result = -1;
+                break;
+            }
+            level->fNode = n;
+            level->fLastChild = XMLDOM_NONE;
+        }
+    }
+
+    xml_open_stack_destroy(&open);
+
+    if (xmldom_finish_nodes(dom, result == 0) != 0)
+        result = -1;
+
+    return result;
+}
+
+// xmldom_build_from_source()
+// Build the dom with the default iterator parameters
+static int xmldom_build_from_source(xmldom *dom, bspan *src) PC_NOEXCEPT_C
+{
+    xmliterparams params;
+    xmliteratorstate st;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, src);
+
+    return xmldom_build(dom, &params, &st);
+}
+
+//
+// Traversal
+//
+static int xmldom_kind(const xmldom *dom, uint32_t node) PC_NOEXCEPT_C { return dom->fKinds[node]; }
+static uint32_t xmldom_name_id(const xmldom *dom, uint32_t node) PC_NOEXCEPT_C { return dom->fNames[node]; }
+static uint32_t xmldom_parent(const xmldom *dom, uint32_t node) PC_NOEXCEPT_C { return dom->fParents[node]; }
+static uint32_t xmldom_first_child(const xmldom *dom, uint32_t node) PC_NOEXCEPT_C { return dom->fFirstChild[node]; }
+static uint32_t xmldom_next_sibling(const xmldom *dom, uint32_t node) PC_NOEXCEPT_C { return dom->fNextSibling[node]; }
+
+// xmldom_name()
+// The tag name of a node.  Nodes that are not tags have an empty name.
+static int xmldom_name(const xmldom *dom, uint32_t node, bspan *name) PC_NOEXCEPT_C
+{
+    uint32_t id = dom->fNames[node];
+    if (id == XMLDOM_NONE) {
+        bspan_init(name);
+        return -1;
+    }
+
+    return interntable_span(&dom->fNameTable, id, name);
+}
+
+static int xmldom_data(const xmldom *dom, uint32_t node, bspan *data) PC_NOEXCEPT_C
+{
+    bspan_init_from_data(data, dom->fBase + dom->fDataOffset[node], dom->fDataSize[node]);
+
+    return 0;
+}
+
+// xmldom_attr_iter_init()
+// Iterate over the attributes of a tag node
+static int xmldom_attr_iter_init(const xmldom *dom, uint32_t node, xmlattriter *iter) PC_NOEXCEPT_C
+{
+    return xmldom_data(dom, node, &iter->fSource);
+}
+
+// xmldom_first_child_named()
+// The first child of 'node' with the given name id, or XMLDOM_NONE
+static uint32_t xmldom_first_child_named(const xmldom *dom, uint32_t node, uint32_t nameId) PC_NOEXCEPT_C
+{
+    if (nameId == XMLDOM_NONE)
+        return XMLDOM_NONE;
+
+    uint32_t n = dom->fFirstChild[node];
+    while ((n != XMLDOM_NONE) && (dom->fNames[n] != nameId))
+        n = dom->fNextSibling[n];
+
+    return n;
+}
+
+// xmldom_next_sibling_named()
+// The next sibling after 'node' with the given name id, or XMLDOM_NONE
+static uint32_t xmldom_next_sibling_named(const xmldom *dom, uint32_t node, uint32_t nameId) PC_NOEXCEPT_C
+{
+    if (nameId == XMLDOM_NONE)
+        return XMLDOM_NONE;
+
+    uint32_t n = dom->fNextSibling[node];
+    while ((n != XMLDOM_NONE) && (dom->fNames[n] != nameId))
+        n = dom->fNextSibling[n];
+
+    return n;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // XMLDOM_H_INCLUDED
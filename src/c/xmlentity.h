@@ -0,0 +1,411 @@
+#ifndef XMLENTITY_H_INCLUDED
+#define XMLENTITY_H_INCLUDED
+
+//
+// xmlentity
+// Decoding of entity and character references in xml text.
+//
+// The scanner hands back content, and attribute values, exactly as they
+// are in the source, with '&amp;', '&#x41;' and the like still in them.
+// xml_decode_span() turns those into the characters they stand for.
+//
+// Most text has no references at all, so the first thing that's done
+// is to look for a '&'.  When there isn't one, the decoded span is the
+// original span, and nothing is copied.  Only when there is a reference
+// is the text decoded, into memory from an arena, which the caller owns.
+//
+// The references that are understood:
+//   &lt; &gt; &amp; &apos; &quot;   - the predefined entities
+//   &#65; &#x41;                    - character references, written as UTF-8
+//   &name;                          - entities declared with <!ENTITY name "value">
+//
+// Declared entities are held in an xmlentitytable, which is filled in from
+// the ENTITY elements the scanner produces, either directly, or from the
+// internal subset of a DOCTYPE.  The replacement text of a declared entity
+// is used as is, and not decoded again, so one entity can not be used to
+// expand into another (the 'billion laughs').
+//
+// A reference that is not understood is left in the text, as it was.
+//
+// Typical usage:
+//   arena a;
+//   arena_init(&a, 0);
+//
+//   bspan text;
+//   xml_decode_span(&elem.fData, &entities, &a, &text);
+//   ...
+//   arena_destroy(&a);
+//
+
+#include <stdlib.h>     // realloc, free
+#include <string.h>     // memchr, memcpy
+
+#include "pcoredef.h"
+#include "bspan.h"
+#include "arena.h"
+#include "interntable.h"
+#include "xmlscan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest name of a reference between the '&' and the ';'
+#define XML_ENTITY_MAX_NAME 64
+
+// The declared entities.  The names are interned, and the value of
+// each is at the index of its name id.  The names and values point
+// into the source the declarations came from.
+struct xmlentitytable_t {
+    interntable fNames;
+    bspan *fValues;         // indexed by name id
+    size_t fValueCapacity;
+};
+typedef struct xmlentitytable_t xmlentitytable;
+
+static int xml_entity_table_init(xmlentitytable *t) PC_NOEXCEPT_C;
+static int xml_entity_table_destroy(xmlentitytable *t) PC_NOEXCEPT_C;
+static int xml_entity_table_add(xmlentitytable *t, const bspan *name, const bspan *value) PC_NOEXCEPT_C;
+static int xml_entity_table_add_element(xmlentitytable *t, const xmlelement *e) PC_NOEXCEPT_C;
+static int xml_entity_table_find(const xmlentitytable *t, const bspan *name, bspan *value) PC_NOEXCEPT_C;
+static size_t xml_entity_table_count(const xmlentitytable *t) PC_NOEXCEPT_C;
+
+static int xml_decode_has_references(const bspan *src) PC_NOEXCEPT_C;
+static int xml_decode_span(const bspan *src, const xmlentitytable *t, arena *a, bspan *out) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+//
+// Entity table
+//
+static int xml_entity_table_init(xmlentitytable *t) PC_NOEXCEPT_C
+{
+    interntable_init(&t->fNames);
+    t->fValues = nullptr;
+    t->fValueCapacity = 0;
+
+    return 0;
+}
+
+static int xml_entity_table_destroy(xmlentitytable *t) PC_NOEXCEPT_C
+{
+    interntable_destroy(&t->fNames);
+    free(t->fValues);
+    xml_entity_table_init(t);
+
+    return 0;
+}
+
+static size_t xml_entity_table_count(const xmlentitytable *t) PC_NOEXCEPT_C { return interntable_count(&t->fNames); }
+
+// xml_entity_table_add()
+// Add a declared entity.  As in xml, when an entity is declared more
+// than once, the first declaration is the one that counts.
+// Return
+//    0 - success
+//   -1 - out of memory, or an empty name
+static int xml_entity_table_add(xmlentitytable *t, const bspan *name, const bspan *value) PC_NOEXCEPT_C
+{
+    if (!bspan_is_valid(name))
+        return -1;
+
+    // Room for the value, before there's a name without one
+    size_t count = interntable_count(&t->fNames);
+    if (count == t->fValueCapacity) {
+        size_t cap = (t->fValueCapacity < 16) ? 16 : t->fValueCapacity * 2;
+        bspan *values = (bspan *)realloc(t->fValues, cap * sizeof(bspan));
+        if (values == nullptr)
+            return -1;
+        t->fValues = values;
+        t->fValueCapacity = cap;
+    }
+
+    uint32_t id = interntable_intern(&t->fNames, name);
+    if (id == INTERNTABLE_NONE)
+        return -1;
+    if (id < count)
+        return 0;
+
+    bspan_weak_assign(&t->fValues[id], value);
+
+    return 0;
+}
+
+// Add the entity from the data of an ENTITY element
+//   name "value"
+//   name 'value'
+// Parameter entities (% name) and external entities (SYSTEM, PUBLIC)
+// have no replacement text, and are skipped.
+static int xml_entity_table_add_declaration(xmlentitytable *t, const bspan *data) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan name;
+    bspan value;
+
+    lex_front_token(data, xmlwspchars(), xmlwspchars(), &name, &s);
+    if (!bspan_is_valid(&name) || (bspan_front(&name) == '%'))
+        return -1;
+
+    lex_ltrim(&s, xmlwspchars());
+    if (!bspan_is_valid(&s) || ((bspan_front(&s) != '"') && (bspan_front(&s) != '\'')))
+        return -1;
+
+    // An unterminated value has no start
+    if ((lex_read_quoted(&s, &value, &s) != 0) || (value.fStart == nullptr))
+        return -1;
+
+    return xml_entity_table_add(t, &name, &value);
+}
+
+// xml_entity_table_add_element()
+// Add the entities declared by an element.  Either an ENTITY element,
+// or a DOCTYPE with an internal subset, which can declare any number.
+// Other elements are ignored.
+static int xml_entity_table_add_element(xmlentitytable *t, const xmlelement *e) PC_NOEXCEPT_C
+{
+    if (e->fElementKind == XML_ELEMENT_TYPE_ENTITY)
+        return xml_entity_table_add_declaration(t, &e->fData);
+
+    if (e->fElementKind != XML_ELEMENT_TYPE_DOCTYPE)
+        return 0;
+
+    // The internal subset is more markup, so scan it for the declarations
+    bspan subset;
+    bspan_weak_assign(&subset, &e->fData);
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement decl;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, &subset);
+
+    while (xml_iter_next_element(&params, &st, &decl) == 0) {
+        if (decl.fElementKind == XML_ELEMENT_TYPE_ENTITY)
+            xml_entity_table_add_declaration(t, &decl.fData);
+    }
+
+    return 0;
+}
+
+// xml_entity_table_find()
+// Return
+//    0 - found, and value is the replacement text
+//   -1 - not found
+static int xml_entity_table_find(const xmlentitytable *t, const bspan *name, bspan *value) PC_NOEXCEPT_C
+{
+    uint32_t id = interntable_find(&t->fNames, name);
+    if (id == INTERNTABLE_NONE)
+        return -1;
+
+    bspan_weak_assign(value, &t->fValues[id]);
+
+    return 0;
+}
+
+//
+// Decoding
+//
+
+// Write a code point as UTF-8, returning the number of bytes
+static size_t xml_decode_utf8(uint32_t cp, unsigned char *out) PC_NOEXCEPT_C
+{
+    if (cp < 0x80) {
+        out[0] = (unsigned char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (unsigned char)(0xc0 | (cp >> 6));
+        out[1] = (unsigned char)(0x80 | (cp & 0x3f));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (unsigned char)(0xe0 | (cp >> 12));
+        out[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3f));
+        out[2] = (unsigned char)(0x80 | (cp & 0x3f));
+        return 3;
+    }
+
+    out[0] = (unsigned char)(0xf0 | (cp >> 18));
+    out[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3f));
+    out[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3f));
+    out[3] = (unsigned char)(0x80 | (cp & 0x3f));
+    return 4;
+}
+
+// The code point of a character reference, between the '#' and the ';'
+// Returns 0 if it's not a valid character
+static uint32_t xml_decode_char_ref(const unsigned char *p, const unsigned char *end) PC_NOEXCEPT_C
+{
+    uint32_t cp = 0;
+    bool hex = false;
+
+    if ((p < end) && (*p == 'x')) {
+        hex = true;
+        p++;
+    }
+    if (p == end)
+        return 0;
+
+    for (; p < end; p++)
+    {
+        unsigned char c = *p;
+        uint32_t digit;
+        if ((c >= '0') && (c <= '9'))
+            digit = c - '0';
+        else if (hex && ((c | 0x20) >= 'a') && ((c | 0x20) <= 'f'))
+            digit = (c | 0x20) - 'a' + 10;
+        else
+            return 0;
+
+        cp = cp * (hex ? 16 : 10) + digit;
+        if (cp > 0x10ffff)
+            return 0;
+    }
+
+    // Surrogates are not characters
+    if ((cp >= 0xd800) && (cp <= 0xdfff))
+        return 0;
+
+    return cp;
+}
+
+// Resolve the reference that starts at the '&' at 'p'
+// Returns the number of bytes of the reference, or 0 if it's not
+// one that's understood.  The replacement is either in 'value', or
+// for a character reference, written into 'buff'
+static size_t xml_decode_reference(const unsigned char *p, const unsigned char *end, const xmlentitytable *t,
+    unsigned char *buff, const unsigned char **value, size_t *valueSize) PC_NOEXCEPT_C
+{
+    // Find the ';', not looking too far
+    const unsigned char *nameStart = p + 1;
+    size_t limit = (size_t)(end - nameStart);
+    if (limit > XML_ENTITY_MAX_NAME + 1)
+        limit = XML_ENTITY_MAX_NAME + 1;
+
+    const unsigned char *semi = (const unsigned char *)memchr(nameStart, ';', limit);
+    if ((semi == nullptr) || (semi == nameStart))
+        return 0;
+
+    size_t nameSize = (size_t)(semi - nameStart);
+    size_t refSize = nameSize + 2;
+
+    if (*nameStart == '#') {
+        uint32_t cp = xml_decode_char_ref(nameStart + 1, semi);
+        if (cp == 0)
+            return 0;
+        *value = buff;
+        *valueSize = xml_decode_utf8(cp, buff);
+        return refSize;
+    }
+
+    // The predefined entities
+    static const struct { const char *name; size_t size; const char *value; } predefined[] = {
+        { "lt", 2, "<" }, { "gt", 2, ">" }, { "amp", 3, "&" }, { "apos", 4, "'" }, { "quot", 4, "\"" },
+    };
+    for (size_t i = 0; i < sizeof(predefined) / sizeof(predefined[0]); i++) {
+        if ((nameSize == predefined[i].size) && (memcmp(nameStart, predefined[i].name, nameSize) == 0)) {
+            *value = (const unsigned char *)predefined[i].value;
+            *valueSize = 1;
+            return refSize;
+        }
+    }
+
+    if (t != nullptr) {
+        bspan name;
+        bspan found;
+        bspan_init_from_pointers(&name, nameStart, semi);
+        if (xml_entity_table_find(t, &name, &found) == 0) {
+            *value = bspan_begin(&found);
+            *valueSize = bspan_size(&found);
+            return refSize;
+        }
+    }
+
+    return 0;
+}
+
+// Decode from 'p' to 'end'.  With no 'out', only count how many
+// bytes the decoded text will take.
+static size_t xml_decode_run(const unsigned char *p, const unsigned char *end, const xmlentitytable *t, unsigned char *out) PC_NOEXCEPT_C
+{
+    size_t total = 0;
+    unsigned char buff[4];
+
+    while (p < end)
+    {
+        const unsigned char *amp = (const unsigned char *)memchr(p, '&', (size_t)(end - p));
+        const unsigned char *runEnd = (amp != nullptr) ? amp : end;
+
+        // The plain text up to the '&'
+        size_t runSize = (size_t)(runEnd - p);
+        if (out != nullptr)
+            memcpy(out + total, p, runSize);
+        total += runSize;
+
+        if (amp == nullptr)
+            break;
+
+        const unsigned char *value = amp;
+        size_t valueSize = 1;
+        size_t refSize = xml_decode_reference(amp, end, t, buff, &value, &valueSize);
+        if (refSize == 0)
+            refSize = 1;    // not a reference, keep the '&'
+
+        if (out != nullptr)
+            memcpy(out + total, value, valueSize);
+        total += valueSize;
+
+        p = amp + refSize;
+    }
+
+    return total;
+}
+
+// xml_decode_has_references()
+// Whether there is a '&' anywhere in the span
+static int xml_decode_has_references(const bspan *src) PC_NOEXCEPT_C
+{
+    // memchr() is vectorized by the C library
+    return (bspan_size(src) > 0) && (memchr(bspan_begin(src), '&', bspan_size(src)) != nullptr);
+}
+
+// xml_decode_span()
+// Decode the references in a span of xml text.  If there aren't any,
+// 'out' is the same as 'src'.  Otherwise, 'out' is the decoded text,
+// in memory allocated from the arena.
+// 't' is the table of declared entities, and can be nullptr
+// Return
+//    0 - success
+//   -1 - out of memory
+static int xml_decode_span(const bspan *src, const xmlentitytable *t, arena *a, bspan *out) PC_NOEXCEPT_C
+{
+    const unsigned char *begin = bspan_begin(src);
+    const unsigned char *end = bspan_end(src);
+    const unsigned char *amp = (begin < end) ? (const unsigned char *)memchr(begin, '&', (size_t)(end - begin)) : nullptr;
+
+    if (amp == nullptr) {
+        bspan_weak_assign(out, src);
+        return 0;
+    }
+
+    // Everything before the first '&' is copied as is
+    size_t prefix = (size_t)(amp - begin);
+    size_t size = prefix + xml_decode_run(amp, end, t, nullptr);
+
+    unsigned char *dst = (unsigned char *)arena_alloc(a, size);
+    if (dst == nullptr)
+        return -1;
+
+    memcpy(dst, begin, prefix);
+    xml_decode_run(amp, end, t, dst + prefix);
+    bspan_init_from_data(out, dst, size);
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // XMLENTITY_H_INCLUDED
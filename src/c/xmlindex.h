@@ -0,0 +1,324 @@
+#ifndef XMLINDEX_H_INCLUDED
+#define XMLINDEX_H_INCLUDED
+
+//
+// xmlindex
+// A structural index of an xml document, so the scanner can hop from
+// one piece of markup to the next, instead of looking at every byte.
+//
+// Building the index is a single pass over the document, 64 bytes at a
+// time.  Each block is classified into two bitmasks, with one bit per
+// byte, for the '<' and '>' characters, where markup begins and ends.
+// Their positions are then written out, in order, as 32-bit offsets from
+// the start of the document.  That list is the index.
+//
+// The scanner (xmlscan.h) takes an optional index.  Every time it needs
+// the next '<' or '>', it takes the next position from the index,
+// skipping any that fall inside of comments, CDATA, and the like,
+// which it has already stepped over.
+//
+// The index only holds 32-bit offsets, so documents of 4GB and larger
+// can not be indexed.  An index that could not be built, for that or
+// for lack of memory, is left empty, and the scanner, given it, scans
+// without one.
+//
+// Typical usage:
+//   xmlindex idx;
+//   xmlindex_init(&idx);
+//   xmlindex_build(&idx, &xmlsrc);
+//
+//   xmliteratorstate st;
+//   xml_iter_state_init_from_index(&st, &xmlsrc, &idx);
+//   while (xml_iter_next_element(&params, &st, &elem) == 0)
+//       ...
+//
+//   xmlindex_destroy(&idx);
+//
+
+#include <stdlib.h>     // realloc, free
+
+#include "pcoredef.h"
+#include "bithacks.h"
+#include "cpufeat.h"
+#include "bspan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XMLINDEX_BLOCK_SIZE 64
+#define XMLINDEX_MAX_SIZE ((size_t)0xffffffffu)
+
+// The classification of a 64 byte block.  Bit 'i' of each mask
+// is set when byte 'i' of the block is one of those characters.
+struct xmlindex_masks_t {
+    uint64_t fOpen;         // '<'
+    uint64_t fClose;        // '>'
+};
+typedef struct xmlindex_masks_t xmlindex_masks;
+
+typedef void (*xmlindex_classify_fn)(const unsigned char *block, xmlindex_masks *m);
+
+struct xmlindex_t {
+    const unsigned char *fBase;     // start of the document that was indexed
+    size_t fLength;
+    uint32_t *fPositions;           // offsets of every '<' and '>'
+    size_t fCount;
+    size_t fCapacity;
+};
+typedef struct xmlindex_t xmlindex;
+
+static int xmlindex_init(xmlindex *x) PC_NOEXCEPT_C;
+static int xmlindex_destroy(xmlindex *x) PC_NOEXCEPT_C;
+static int xmlindex_build(xmlindex *x, const bspan *src) PC_NOEXCEPT_C;
+static size_t xmlindex_count(const xmlindex *x) PC_NOEXCEPT_C;
+static int xmlindex_classify(const unsigned char *data, size_t n, xmlindex_masks *m) PC_NOEXCEPT_C;
+static const unsigned char * xmlindex_find_next(const xmlindex *x, size_t *cursor, const unsigned char *from, unsigned char c) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+//
+// Kernels
+// Classify exactly 64 bytes
+//
+static void xmlindex_kern_classify_scalar(const unsigned char *block, xmlindex_masks *m) PC_NOEXCEPT_C
+{
+    memset(m, 0, sizeof(xmlindex_masks));
+
+    for (int i = 0; i < XMLINDEX_BLOCK_SIZE; i++)
+    {
+        uint64_t bit = (uint64_t)1 << i;
+        switch (block[i]) {
+            case '<': m->fOpen |= bit; break;
+            case '>': m->fClose |= bit; break;
+        }
+    }
+}
+
+#if defined(PC_ARCH_X86)
+// SSE2 - four 16 byte pieces
+PC_TARGET_SSE2
+static void xmlindex_kern_classify_sse2(const unsigned char *block, xmlindex_masks *m) PC_NOEXCEPT_C
+{
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+
+    memset(m, 0, sizeof(xmlindex_masks));
+
+    for (int i = 0; i < 4; i++)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + (16 * i)));
+        int shift = 16 * i;
+
+        m->fOpen |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, lt)) << shift;
+        m->fClose |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, gt)) << shift;
+    }
+}
+
+// AVX2 - two 32 byte halves
+PC_TARGET_AVX2
+static void xmlindex_kern_classify_avx2(const unsigned char *block, xmlindex_masks *m) PC_NOEXCEPT_C
+{
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+
+    __m256i lo = _mm256_loadu_si256((const __m256i *)block);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+
+#define XMLINDEX_MASK64(cmplo, cmphi) \
+    ((uint64_t)(uint32_t)_mm256_movemask_epi8(cmplo) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(cmphi) << 32))
+
+    m->fOpen = XMLINDEX_MASK64(_mm256_cmpeq_epi8(lo, lt), _mm256_cmpeq_epi8(hi, lt));
+    m->fClose = XMLINDEX_MASK64(_mm256_cmpeq_epi8(lo, gt), _mm256_cmpeq_epi8(hi, gt));
+
+#undef XMLINDEX_MASK64
+}
+
+// AVX-512 - the whole block at once, straight into mask registers
+PC_TARGET_AVX512BW
+static void xmlindex_kern_classify_avx512(const unsigned char *block, xmlindex_masks *m) PC_NOEXCEPT_C
+{
+    __m512i v = _mm512_loadu_si512((const void *)block);
+
+    m->fOpen = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('<'));
+    m->fClose = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('>'));
+}
+#endif  // PC_ARCH_X86
+
+static xmlindex_classify_fn xmlindex_select_kernel() PC_NOEXCEPT_C
+{
+#if defined(PC_ARCH_X86)
+    if (pc_cpu_has(PC_CPU_AVX512BW))
+        return xmlindex_kern_classify_avx512;
+    if (pc_cpu_has(PC_CPU_AVX2))
+        return xmlindex_kern_classify_avx2;
+    if (pc_cpu_has(PC_CPU_SSE2))
+        return xmlindex_kern_classify_sse2;
+#endif
+
+    return xmlindex_kern_classify_scalar;
+}
+
+static xmlindex_classify_fn xmlindex_get_kernel() PC_NOEXCEPT_C
+{
+    static const xmlindex_classify_fn kernel = xmlindex_select_kernel();
+
+    return kernel;
+}
+
+// xmlindex_classify()
+// Classify up to 64 bytes.  When there are fewer than 64, the
+// bits past the end are all zero.
+static int xmlindex_classify(const unsigned char *data, size_t n, xmlindex_masks *m) PC_NOEXCEPT_C
+{
+    if (n >= XMLINDEX_BLOCK_SIZE) {
+        xmlindex_get_kernel()(data, m);
+        return 0;
+    }
+
+    // Zero bytes are not in any of the classes
+    unsigned char block[XMLINDEX_BLOCK_SIZE] = { 0 };
+    memcpy(block, data, n);
+    xmlindex_get_kernel()(block, m);
+
+    return 0;
+}
+
+static int xmlindex_init(xmlindex *x) PC_NOEXCEPT_C
+{
+    memset(x, 0, sizeof(xmlindex));
+
+    return 0;
+}
+
+static int xmlindex_destroy(xmlindex *x) PC_NOEXCEPT_C
+{
+    free(x->fPositions);
+    memset(x, 0, sizeof(xmlindex));
+
+    return 0;
+}
+
+static size_t xmlindex_count(const xmlindex *x) PC_NOEXCEPT_C { return x->fCount; }
+
+// xmlindex_reserve()
+// Make sure there's room for another whole block of positions
+static int xmlindex_reserve(xmlindex *x, size_t n) PC_NOEXCEPT_C
+{
+    if (x->fCapacity - x->fCount >= n)
+        return 0;
+
+    size_t newCapacity = (x->fCapacity < 1024) ? 1024 : x->fCapacity * 2;
+    while (newCapacity - x->fCount < n)
+        newCapacity *= 2;
+
+    uint32_t *newPositions = (uint32_t *)realloc(x->fPositions, newCapacity * sizeof(uint32_t));
+    if (newPositions == nullptr)
+        return -1;
+
+    x->fPositions = newPositions;
+    x->fCapacity = newCapacity;
+
+    return 0;
+}
+
+// xmlindex_fail()
+// Leave the index empty, and attached to nothing, so it is never
+// taken for the index of a source it only partly covers
+static int xmlindex_fail(xmlindex *x) PC_NOEXCEPT_C
+{
+    x->fBase = nullptr;
+    x->fLength = 0;
+    x->fCount = 0;
+
+    return -1;
+}
+
+// xmlindex_build()
+// Index the '<' and '>' characters of the source.  The index refers
+// to the source memory, which must stay put for as long as it is used.
+// Return
+//    0 - success
+//   -1 - the source is too large, or out of memory, and the index is empty
+static int xmlindex_build(xmlindex *x, const bspan *src) PC_NOEXCEPT_C
+{
+    const unsigned char *base = bspan_begin(src);
+    size_t n = bspan_size(src);
+
+    // Only attached to the source once it is all indexed
+    x->fBase = nullptr;
+    x->fLength = 0;
+    x->fCount = 0;
+
+    if (n > XMLINDEX_MAX_SIZE)
+        return xmlindex_fail(x);
+
+    // Most documents have a '<' or '>' every 16 bytes or so
+    if (xmlindex_reserve(x, (n / 16) + XMLINDEX_BLOCK_SIZE) != 0)
+        return xmlindex_fail(x);
+
+    xmlindex_classify_fn classify = xmlindex_get_kernel();
+    xmlindex_masks m;
+
+    for (size_t offset = 0; offset < n; offset += XMLINDEX_BLOCK_SIZE)
+    {
+        if (n - offset >= XMLINDEX_BLOCK_SIZE)
+            classify(base + offset, &m);
+        else
+            xmlindex_classify(base + offset, n - offset, &m);
+
+        uint64_t bits = m.fOpen | m.fClose;
+        if (bits == 0)
+            continue;
+
+        if (xmlindex_reserve(x, XMLINDEX_BLOCK_SIZE) != 0)
+            return xmlindex_fail(x);
+
+        // Turn the bits into positions
+        uint32_t *out = x->fPositions + x->fCount;
+        uint32_t blockBase = (uint32_t)offset;
+        while (bits != 0) {
+            *out++ = blockBase + (uint32_t)bhak_ctz64(bits);
+            bits &= bits - 1;
+        }
+        x->fCount = (size_t)(out - x->fPositions);
+    }
+
+    x->fBase = base;
+    x->fLength = n;
+
+    return 0;
+}
+
+// xmlindex_find_next()
+// Find the next 'c' (which is either '<' or '>') at, or after, 'from'
+// 'cursor' is where the previous search left off, and is moved
+// forward to 'from', so searches must be made in increasing order of 'from'
+// Returns nullptr if there is no such character
+static const unsigned char * xmlindex_find_next(const xmlindex *x, size_t *cursor, const unsigned char *from, unsigned char c) PC_NOEXCEPT_C
+{
+    size_t fromOffset = (size_t)(from - x->fBase);
+    size_t i = *cursor;
+
+    // Skip what's been stepped over
+    while ((i < x->fCount) && (x->fPositions[i] < fromOffset))
+        i++;
+    *cursor = i;
+
+    // The cursor stays put while looking, so a '<' passed over
+    // while looking for a '>' is still there for the next search
+    while (i < x->fCount) {
+        if (x->fBase[x->fPositions[i]] == c)
+            return x->fBase + x->fPositions[i];
+        i++;
+    }
+
+    return nullptr;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // XMLINDEX_H_INCLUDED
@@ -0,0 +1,362 @@
+#ifndef XMLNS_H_INCLUDED
+#define XMLNS_H_INCLUDED
+
+//
+// xmlns
+// Namespace resolution for the elements and attributes the scanner produces.
+//
+// The scanner splits 'svg:rect' into 'svg' and 'rect', but a prefix means
+// nothing on its own.  What it means comes from the 'xmlns:svg="..."'
+// declarations on the element, or on the elements it's inside of.  Two
+// different prefixes can mean the same namespace, and the same prefix can
+// mean different namespaces in different parts of the document.
+//
+// The resolver is handed each element, in order.  It keeps a stack of the
+// prefixes that are declared, with a mark for each open element, so that
+// the declarations go away when their element ends.  Each element name, and
+// attribute name, is resolved to a pair of ids:
+//   fNamespace - the id of the namespace URI
+//   fLocalName - the id of the name, without the prefix
+// The ids come from tables where each distinct string is entered once,
+// so two names are the same exactly when their ids are the same.
+//
+// A few namespace ids are there from the start:
+//   XMLNS_NO_NAMESPACE  - names without a prefix, when there's no default
+//   XMLNS_XML           - the 'xml:' prefix, which is always declared
+//   XMLNS_XMLNS         - the 'xmlns' attributes themselves
+//
+// The tables hold on to spans of the document, so it has to stay put while
+// the resolver is in use.
+//
+// Typical usage:
+//   xmlnsresolver ns;
+//   xmlns_init(&ns);
+//   uint32_t svgNs = xmlns_intern_uri_cstr(&ns, "http://www.w3.org/2000/svg");
+//
+//   while (xml_iter_next_element(&params, &st, &elem) == 0) {
+//       xmlnsname name;
+//       if ((xmlns_element(&ns, &elem, &name) == 0) && (name.fNamespace == svgNs))
+//           ...
+//   }
+//   xmlns_destroy(&ns);
+//
+
+#include <stdlib.h>     // realloc, free
+
+#include "pcoredef.h"
+#include "bspan.h"
+#include "interntable.h"
+#include "xmlcore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XMLNS_NONE          INTERNTABLE_NONE
+#define XMLNS_NO_NAMESPACE  0
+#define XMLNS_XML           1
+#define XMLNS_XMLNS         2
+
+// A resolved name
+struct xmlnsname_t {
+    uint32_t fNamespace;        // XMLNS_NONE when the prefix isn't declared
+    uint32_t fLocalName;
+};
+typedef struct xmlnsname_t xmlnsname;
+
+// A prefix, and what it stands for, both as ids
+struct xmlnsbinding_t {
+    uint32_t fPrefix;
+    uint32_t fNamespace;
+};
+typedef struct xmlnsbinding_t xmlnsbinding;
+
+struct xmlnsresolver_t {
+    interntable fUris;
+    interntable fNames;         // local names, and prefixes
+
+    xmlnsbinding *fBindings;
+    size_t fBindingCount;
+    size_t fBindingCapacity;
+
+    xmlopenstack fOpen;         // how many bindings there were before each open element, a size_t
+    bool fPendingPop;           // the last element closed itself
+
+    uint32_t fEmptyName;
+    uint32_t fXmlnsName;
+};
+typedef struct xmlnsresolver_t xmlnsresolver;
+
+static int xmlns_init(xmlnsresolver *r) PC_NOEXCEPT_C;
+static int xmlns_destroy(xmlnsresolver *r) PC_NOEXCEPT_C;
+
+static int xmlns_element(xmlnsresolver *r, const xmlelement *e, xmlnsname *name) PC_NOEXCEPT_C;
+static int xmlns_attribute(xmlnsresolver *r, const xmlattr *attr, xmlnsname *name) PC_NOEXCEPT_C;
+static uint32_t xmlns_lookup_prefix(const xmlnsresolver *r, const bspan *prefix) PC_NOEXCEPT_C;
+
+static uint32_t xmlns_intern_uri_cstr(xmlnsresolver *r, const char *uri) PC_NOEXCEPT_C;
+static uint32_t xmlns_intern_name_cstr(xmlnsresolver *r, const char *name) PC_NOEXCEPT_C;
+static int xmlns_uri(const xmlnsresolver *r, uint32_t id, bspan *uri) PC_NOEXCEPT_C;
+static int xmlns_local_name(const xmlnsresolver *r, uint32_t id, bspan *name) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+//
+// Resolver
+//
+static int xmlns_init(xmlnsresolver *r) PC_NOEXCEPT_C
+{
+    memset(r, 0, sizeof(xmlnsresolver));
+    xml_open_stack_init(&r->fOpen, sizeof(size_t));
+    interntable_init(&r->fUris);
+    interntable_init(&r->fNames);
+
+    // The namespaces that are always there, in the order of their ids
+    xmlns_intern_uri_cstr(r, "");
+    xmlns_intern_uri_cstr(r, "http://www.w3.org/XML/1998/namespace");
+    if (xmlns_intern_uri_cstr(r, "http://www.w3.org/2000/xmlns/") != XMLNS_XMLNS)
+        return -1;
+
+    r->fEmptyName = xmlns_intern_name_cstr(r, "");
+    r->fXmlnsName = xmlns_intern_name_cstr(r, "xmlns");
+
+    // 'xml:' never has to be declared
+    r->fBindings = (xmlnsbinding *)malloc(16 * sizeof(xmlnsbinding));
+    if (r->fBindings == nullptr)
+        return -1;
+    r->fBindingCapacity = 16;
+    r->fBindings[0].fPrefix = xmlns_intern_name_cstr(r, "xml");
+    r->fBindings[0].fNamespace = XMLNS_XML;
+    r->fBindingCount = 1;
+
+    return 0;
+}
+
+static int xmlns_destroy(xmlnsresolver *r) PC_NOEXCEPT_C
+{
+    interntable_destroy(&r->fUris);
+    interntable_destroy(&r->fNames);
+    free(r->fBindings);
+    xml_open_stack_destroy(&r->fOpen);
+    memset(r, 0, sizeof(xmlnsresolver));
+
+    return 0;
+}
+
+static uint32_t xmlns_intern_uri_cstr(xmlnsresolver *r, const char *uri) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, uri);
+
+    return interntable_intern(&r->fUris, &s);
+}
+
+static uint32_t xmlns_intern_name_cstr(xmlnsresolver *r, const char *name) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, name);
+
+    return interntable_intern(&r->fNames, &s);
+}
+
+// xmlns_uri()
+// The text of a namespace id
+static int xmlns_uri(const xmlnsresolver *r, uint32_t id, bspan *uri) PC_NOEXCEPT_C
+{
+    return interntable_span(&r->fUris, id, uri);
+}
+
+// xmlns_local_name()
+// The text of a local name id
+static int xmlns_local_name(const xmlnsresolver *r, uint32_t id, bspan *name) PC_NOEXCEPT_C
+{
+    return interntable_span(&r->fNames, id, name);
+}
+
+// xmlns_split()
+// Split 'svg:rect' into 'svg' and 'rect'.  Without a ':', the prefix is empty.
+static void xmlns_split(const bspan *qname, bspan *prefix, bspan *local) PC_NOEXCEPT_C
+{
+    const unsigned char *start = bspan_begin(qname);
+    const unsigned char *colon = (const unsigned char *)memchr(start, ':', bspan_size(qname));
+
+    if (colon == nullptr) {
+        bspan_init_from_pointers(prefix, start, start);
+        bspan_weak_assign(local, qname);
+        return;
+    }
+
+    bspan_init_from_pointers(prefix, start, colon);
+    bspan_init_from_pointers(local, colon + 1, bspan_end(qname));
+}
+
+// xmlns_lookup_prefix()
+// The namespace a prefix stands for, where the resolver is now.  The empty
+// prefix is the default namespace.  XMLNS_NONE if the prefix isn't declared.
+static uint32_t xmlns_lookup_prefix(const xmlnsresolver *r, const bspan *prefix) PC_NOEXCEPT_C
+{
+    uint32_t id = interntable_find(&r->fNames, prefix);
+    if (id == XMLNS_NONE)
+        return XMLNS_NONE;
+
+    // The most recent declaration wins
+    for (size_t i = r->fBindingCount; i > 0; i--)
+        if (r->fBindings[i - 1].fPrefix == id)
+            return r->fBindings[i - 1].fNamespace;
+
+    return (id == r->fEmptyName) ? XMLNS_NO_NAMESPACE : XMLNS_NONE;
+}
+
+static int xmlns_bind(xmlnsresolver *r, const bspan *prefix, const bspan *uri) PC_NOEXCEPT_C
+{
+    if (r->fBindingCount == r->fBindingCapacity) {
+        size_t cap = r->fBindingCapacity * 2;
+        xmlnsbinding *bindings = (xmlnsbinding *)realloc(r->fBindings, cap * sizeof(xmlnsbinding));
+        if (bindings == nullptr)
+            return -1;
+        r->fBindings = bindings;
+        r->fBindingCapacity = cap;
+    }
+
+    uint32_t prefixId = interntable_intern(&r->fNames, prefix);
+    uint32_t uriId = interntable_intern(&r->fUris, uri);
+    if ((prefixId == XMLNS_NONE) || (uriId == XMLNS_NONE))
+        return -1;
+
+    r->fBindings[r->fBindingCount].fPrefix = prefixId;
+    r->fBindings[r->fBindingCount].fNamespace = uriId;
+    r->fBindingCount++;
+
+    return 0;
+}
+
+// xmlns_resolve()
+// Turn a qualified name into ids.  'useDefault' is for element names, as
+// attributes without a prefix are in no namespace at all.
+static int xmlns_resolve(xmlnsresolver *r, const bspan *qname, bool useDefault, xmlnsname *name) PC_NOEXCEPT_C
+{
+    bspan prefix;
+    bspan local;
+    xmlns_split(qname, &prefix, &local);
+
+    name->fLocalName = interntable_intern(&r->fNames, &local);
+    if (!useDefault && (bspan_size(&prefix) == 0))
+        name->fNamespace = XMLNS_NO_NAMESPACE;
+    else
+        name->fNamespace = xmlns_lookup_prefix(r, &prefix);
+
+    return ((name->fNamespace == XMLNS_NONE) || (name->fLocalName == XMLNS_NONE)) ? -1 : 0;
+}
+
+// xmlns_pop_to()
+// Close the elements from the given depth on, along with their declarations
+static void xmlns_pop_to(xmlnsresolver *r, size_t depth) PC_NOEXCEPT_C
+{
+    if (depth < r->fOpen.fDepth) {
+        r->fBindingCount = *(const size_t *)xml_open_stack_data(&r->fOpen, depth);
+        r->fOpen.fDepth = depth;
+    }
+}
+
+// xmlns_element()
+// Hand the resolver the next element from the scanner.  Start tags, and self
+// closing tags, add their declarations, and the name of the element is resolved.
+// End tags close the nearest open element with the same name, along with any
+// left open inside of it, as xmldom does.
+// Return
+//    0 - the name was resolved
+//   -1 - the prefix isn't declared, out of memory, or the element doesn't have a name
+static int xmlns_element(xmlnsresolver *r, const xmlelement *e, xmlnsname *name) PC_NOEXCEPT_C
+{
+    name->fNamespace = XMLNS_NONE;
+    name->fLocalName = XMLNS_NONE;
+
+    // A self closing element stays open until the next one, so
+    // its attributes can be resolved
+    if (r->fPendingPop) {
+        xmlns_pop_to(r, r->fOpen.fDepth - 1);
+        r->fPendingPop = false;
+    }
+
+    int kind = e->fElementKind;
+    if ((kind != XML_ELEMENT_TYPE_START_TAG) && (kind != XML_ELEMENT_TYPE_SELF_CLOSING) && (kind != XML_ELEMENT_TYPE_END_TAG))
+        return -1;
+
+    bspan qname;
+    bspan_weak_assign(&qname, &e->fNameSpan);
+
+    if (kind == XML_ELEMENT_TYPE_END_TAG)
+    {
+        int err = xmlns_resolve(r, &qname, true, name);
+        size_t depth;
+        if (xml_open_stack_find(&r->fOpen, &qname, &depth) == 0)
+            xmlns_pop_to(r, depth);
+
+        return err;
+    }
+
+    size_t *bindingCount = (size_t *)xml_open_stack_push(&r->fOpen, &qname);
+    if (bindingCount == nullptr)
+        return -1;
+    *bindingCount = r->fBindingCount;
+    r->fPendingPop = (kind == XML_ELEMENT_TYPE_SELF_CLOSING);
+
+    // The declarations are attributes, and apply to the element's own name
+    xmlattriter iter;
+    xmlattr attr;
+    xml_attr_iter_init(&iter, e);
+    while (xml_attr_iter_next(&iter, &attr) == 0)
+    {
+        if (!lex_begins_with_cstr(&attr.fName, "xmlns"))
+            continue;
+
+        bspan prefix;
+        bspan_weak_assign(&prefix, &attr.fName);
+        bspan_advance(&prefix, 5);
+        if (bspan_size(&prefix) > 0) {
+            if (bspan_front(&prefix) != ':')
+                continue;
+            bspan_advance(&prefix, 1);
+        }
+
+        if (xmlns_bind(r, &prefix, &attr.fValue) != 0)
+            return -1;
+    }
+
+    return xmlns_resolve(r, &qname, true, name);
+}
+
+// xmlns_attribute()
+// Resolve the name of an attribute of the last element.  Attributes without
+// a prefix are in no namespace, and the declarations themselves are in
+// the XMLNS_XMLNS namespace.
+// Return
+//    0 - the name was resolved
+//   -1 - the prefix isn't declared, or out of memory
+static int xmlns_attribute(xmlnsresolver *r, const xmlattr *attr, xmlnsname *name) PC_NOEXCEPT_C
+{
+    bspan prefix;
+    bspan local;
+    xmlns_split(&attr->fName, &prefix, &local);
+
+    if ((bspan_size(&prefix) == 5) && (memcmp(bspan_begin(&prefix), "xmlns", 5) == 0)) {
+        name->fNamespace = XMLNS_XMLNS;
+        name->fLocalName = interntable_intern(&r->fNames, &local);
+        return (name->fLocalName == XMLNS_NONE) ? -1 : 0;
+    }
+
+    if (xmlns_resolve(r, &attr->fName, false, name) != 0)
+        return -1;
+
+    if ((bspan_size(&prefix) == 0) && (name->fLocalName == r->fXmlnsName))
+        name->fNamespace = XMLNS_XMLNS;
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // XMLNS_H_INCLUDED
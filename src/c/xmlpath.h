@@ -0,0 +1,370 @@
+#ifndef XMLPATH_H_INCLUDED
+#define XMLPATH_H_INCLUDED
+
+//
+// xmlpath
+// Path queries that run right on the scanner's stream of elements, without
+// building a DOM first.
+//
+// The path language is a small piece of XPath:
+//   /svg/g/path           - child steps, from the top of the document
+//   //path                - a descendant step, at any depth below
+//   /svg//g/*             - '*' matches any element name
+//   //rect[@fill]         - elements that have the attribute
+//   //g[@id='layer1']     - elements where the attribute has that value
+//   /svg/g/path/@d        - the value of an attribute, as the last step
+//   //g[@id='a']//@x      - the 'x' attribute of any element below
+//
+// xmlpath_compile() turns the text of a path into a list of steps.  The
+// names in the steps refer to the text of the path, so it has to stay put
+// while the path is used.
+//
+// Running the path is a little automaton.  Its state is the set of steps
+// that have been matched so far, one bit per step, and there's a state for
+// each element that is open.  When an element starts, the next state comes
+// from the state of its parent: a step that matches moves its bit forward
+// by one, and a descendant step keeps its bit where it is, so it can match
+// further down.  When the last bit is set, the element matches.
+//
+// Once a state is empty, nothing below that element can ever match, so
+// the elements in that subtree are passed over without their names being
+// compared, or their attributes being looked at.
+//
+// Typical usage:
+//   xmlpath path;
+//   xmlpath_compile_cstr(&path, "/svg/g/path/@d");
+//
+//   xmlpathmatcher m;
+//   xmlpath_matcher_init(&m, &path);
+//   while (xmlpath_next_match(&params, &st, &m, &match) == 0)
+//       ... match.fValue is the 'd' of each path
+//   xmlpath_matcher_destroy(&m);
+//
+
+#include "pcoredef.h"
+#include "bithacks.h"
+#include "bspan.h"
+#include "xmlscan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One bit of state for each step, plus one for nothing matched yet
+#define XMLPATH_MAX_STEPS 63
+
+enum XMLPATH_AXIS {
+    XMLPATH_AXIS_CHILD = 0
+    , XMLPATH_AXIS_DESCENDANT
+};
+
+enum XMLPATH_PREDICATE {
+    XMLPATH_PREDICATE_NONE = 0
+    , XMLPATH_PREDICATE_EXISTS                      // [@name]
+    , XMLPATH_PREDICATE_EQUALS                      // [@name='value']
+};
+
+struct xmlpathstep_t {
+    int fAxis;
+    bspan fName;                // empty for '*'
+    int fPredicate;
+    bspan fPredicateName;
+    bspan fPredicateValue;
+};
+typedef struct xmlpathstep_t xmlpathstep;
+
+struct xmlpath_t {
+    xmlpathstep fSteps[XMLPATH_MAX_STEPS];
+    size_t fCount;
+    bspan fAttribute;           // the name in a final '@name' step
+    bool fHasAttribute;
+};
+typedef struct xmlpath_t xmlpath;
+
+struct xmlpathmatcher_t {
+    const xmlpath *fPath;
+    xmlopenstack fOpen;         // the state of each open element, a uint64_t
+};
+typedef struct xmlpathmatcher_t xmlpathmatcher;
+
+struct xmlpathmatch_t {
+    xmlelement fElement;        // the element that matched
+    bspan fValue;               // the value of the attribute, or the element's data
+};
+typedef struct xmlpathmatch_t xmlpathmatch;
+
+static int xmlpath_compile(xmlpath *p, const bspan *expr) PC_NOEXCEPT_C;
+static int xmlpath_compile_cstr(xmlpath *p, const char *expr) PC_NOEXCEPT_C;
+
+static int xmlpath_matcher_init(xmlpathmatcher *m, const xmlpath *p) PC_NOEXCEPT_C;
+static int xmlpath_matcher_destroy(xmlpathmatcher *m) PC_NOEXCEPT_C;
+static int xmlpath_next_match(const xmliterparams *params, xmliteratorstate *st, xmlpathmatcher *m, xmlpathmatch *match) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+// xmlpath_read_name()
+// Read a name, or '*', from the front of the expression
+static int xmlpath_read_name(bspan *expr, bspan *name) PC_NOEXCEPT_C
+{
+    const unsigned char *start = bspan_begin(expr);
+    const unsigned char *end = start;
+    while ((end < bspan_end(expr)) && (*end != '/') && (*end != '[') && (*end != ']') && (*end != '=') && (*end != '@'))
+        end++;
+
+    if (end == start)
+        return -1;
+
+    bspan_init_from_pointers(name, start, end);
+    bspan_set_begin(expr, end);
+
+    // '*' is any name, which is the empty name
+    if ((bspan_size(name) == 1) && (bspan_front(name) == '*'))
+        bspan_set_end(name, start);
+
+    return 0;
+}
+
+// xmlpath_read_predicate()
+// Read '[@name]' or '[@name='value']'
+static int xmlpath_read_predicate(bspan *expr, xmlpathstep *step) PC_NOEXCEPT_C
+{
+    if (!lex_begins_with_cstr(expr, "[@"))
+        return -1;
+    bspan_advance(expr, 2);
+
+    if ((xmlpath_read_name(expr, &step->fPredicateName) != 0) || (bspan_size(&step->fPredicateName) == 0))
+        return -1;
+    step->fPredicate = XMLPATH_PREDICATE_EXISTS;
+
+    if (bspan_is_valid(expr) && (bspan_front(expr) == '='))
+    {
+        bspan_advance(expr, 1);
+        if (!bspan_is_valid(expr) || ((bspan_front(expr) != '\'') && (bspan_front(expr) != '"')))
+            return -1;
+
+        const unsigned char *start = bspan_begin(expr);
+        const unsigned char *close = (const unsigned char *)memchr(start + 1, *start, (size_t)(bspan_end(expr) - start - 1));
+        if (close == nullptr)
+            return -1;
+
+        bspan_init_from_pointers(&step->fPredicateValue, start + 1, close);
+        bspan_set_begin(expr, close + 1);
+        step->fPredicate = XMLPATH_PREDICATE_EQUALS;
+    }
+
+    if (!bspan_is_valid(expr) || (bspan_front(expr) != ']'))
+        return -1;
+    bspan_advance(expr, 1);
+
+    return 0;
+}
+
+// xmlpath_compile()
+// Turn the text of a path into its steps
+// Return
+//    0 - success
+//   -1 - the path is not one that is understood
+static int xmlpath_compile(xmlpath *p, const bspan *expr) PC_NOEXCEPT_C
+{
+    memset(p, 0, sizeof(xmlpath));
+
+    bspan rest;
+    bspan_weak_assign(&rest, expr);
+
+    // Paths always start at the top of the document
+    if (!bspan_is_valid(&rest) || (bspan_front(&rest) != '/'))
+        return -1;
+
+    while (bspan_is_valid(&rest))
+    {
+        if (bspan_front(&rest) != '/')
+            return -1;
+        bspan_advance(&rest, 1);
+
+        int axis = XMLPATH_AXIS_CHILD;
+        if (bspan_is_valid(&rest) && (bspan_front(&rest) == '/')) {
+            axis = XMLPATH_AXIS_DESCENDANT;
+            bspan_advance(&rest, 1);
+        }
+
+        // An attribute can only be the last step.  '//@x' is
+        // the 'x' of any element below, as if it were '//*/@x'
+        if (bspan_is_valid(&rest) && (bspan_front(&rest) == '@'))
+        {
+            bspan_advance(&rest, 1);
+            if (axis == XMLPATH_AXIS_DESCENDANT) {
+                if (p->fCount == XMLPATH_MAX_STEPS)
+                    return -1;
+                p->fSteps[p->fCount].fAxis = XMLPATH_AXIS_DESCENDANT;
+                p->fCount++;
+            }
+
+            if ((p->fCount == 0) || (xmlpath_read_name(&rest, &p->fAttribute) != 0) ||
+                (bspan_size(&p->fAttribute) == 0) || bspan_is_valid(&rest))
+                return -1;
+
+            p->fHasAttribute = true;
+            break;
+        }
+
+        if (p->fCount == XMLPATH_MAX_STEPS)
+            return -1;
+
+        xmlpathstep *step = &p->fSteps[p->fCount];
+        step->fAxis = axis;
+        if (xmlpath_read_name(&rest, &step->fName) != 0)
+            return -1;
+
+        if (bspan_is_valid(&rest) && (bspan_front(&rest) == '[') && (xmlpath_read_predicate(&rest, step) != 0))
+            return -1;
+
+        p->fCount++;
+    }
+
+    return (p->fCount > 0) ? 0 : -1;
+}
+
+static int xmlpath_compile_cstr(xmlpath *p, const char *expr) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, expr);
+
+    return xmlpath_compile(p, &s);
+}
+
+static int xmlpath_matcher_init(xmlpathmatcher *m, const xmlpath *p) PC_NOEXCEPT_C
+{
+    memset(m, 0, sizeof(xmlpathmatcher));
+    m->fPath = p;
+
+    return xml_open_stack_init(&m->fOpen, sizeof(uint64_t));
+}
+
+static int xmlpath_matcher_destroy(xmlpathmatcher *m) PC_NOEXCEPT_C
+{
+    xml_open_stack_destroy(&m->fOpen);
+    memset(m, 0, sizeof(xmlpathmatcher));
+
+    return 0;
+}
+
+static bool xmlpath_same_name(const bspan *a, const bspan *b) PC_NOEXCEPT_C
+{
+    size_t n = bspan_size(a);
+
+    return (n == bspan_size(b)) && ((n == 0) || (memcmp(bspan_begin(a), bspan_begin(b), n) == 0));
+}
+
+// xmlpath_step_matches()
+// Whether an element, with the given name, passes the name test, and
+// the predicate, of a step
+static bool xmlpath_step_matches(const xmlpathstep *step, const xmlelement *e, const bspan *name) PC_NOEXCEPT_C
+{
+    if ((bspan_size(&step->fName) > 0) && !xmlpath_same_name(&step->fName, name))
+        return false;
+
+    if (step->fPredicate == XMLPATH_PREDICATE_NONE)
+        return true;
+
+    bspan value;
+    if (xml_element_find_attribute(e, &step->fPredicateName, &value) != 0)
+        return false;
+
+    return (step->fPredicate == XMLPATH_PREDICATE_EXISTS) || xmlpath_same_name(&step->fPredicateValue, &value);
+}
+
+// xmlpath_next_state()
+// The state of an element, from the state of its parent
+static uint64_t xmlpath_next_state(const xmlpath *p, uint64_t parent, const xmlelement *e, const bspan *name) PC_NOEXCEPT_C
+{
+    uint64_t state = 0;
+
+    while (parent != 0)
+    {
+        size_t k = (size_t)bhak_ctz64(parent);
+        parent &= parent - 1;
+
+        // When all the steps have been matched, there's nothing
+        // more to go on to
+        if (k == p->fCount)
+            continue;
+
+        const xmlpathstep *step = &p->fSteps[k];
+        if (step->fAxis == XMLPATH_AXIS_DESCENDANT)
+            state |= (uint64_t)1 << k;
+        if (xmlpath_step_matches(step, e, name))
+            state |= (uint64_t)1 << (k + 1);
+    }
+
+    return state;
+}
+
+// xmlpath_state()
+// The state of the innermost open element.  The document
+// itself is outside of them all, where nothing's been matched.
+static uint64_t xmlpath_state(const xmlpathmatcher *m) PC_NOEXCEPT_C
+{
+    if (m->fOpen.fDepth == 0)
+        return 1;
+
+    return *(const uint64_t *)xml_open_stack_data(&m->fOpen, m->fOpen.fDepth - 1);
+}
+
+// xmlpath_next_match()
+// Scan forward to the next element that matches the path
+// Return
+//    0 - there's a match
+//   -1 - the end of the elements, or out of memory
+static int xmlpath_next_match(const xmliterparams *params, xmliteratorstate *st, xmlpathmatcher *m, xmlpathmatch *match) PC_NOEXCEPT_C
+{
+    const xmlpath *p = m->fPath;
+    const uint64_t matched = (uint64_t)1 << p->fCount;
+
+    xmlelement elem;
+    while (xml_iter_next_element(params, st, &elem) == 0)
+    {
+        int kind = elem.fElementKind;
+        if ((kind != XML_ELEMENT_TYPE_START_TAG) && (kind != XML_ELEMENT_TYPE_SELF_CLOSING) && (kind != XML_ELEMENT_TYPE_END_TAG))
+            continue;
+
+        bspan name;
+        bspan_weak_assign(&name, &elem.fNameSpan);
+
+        if (kind == XML_ELEMENT_TYPE_END_TAG) {
+            xml_open_stack_close(&m->fOpen, &name);
+            continue;
+        }
+
+        // Below an element that can't lead anywhere, nothing is looked at
+        uint64_t parent = xmlpath_state(m);
+        uint64_t state = (parent == 0) ? 0 : xmlpath_next_state(p, parent, &elem, &name);
+
+        if (kind == XML_ELEMENT_TYPE_START_TAG) {
+            uint64_t *open = (uint64_t *)xml_open_stack_push(&m->fOpen, &name);
+            if (open == nullptr)
+                return -1;
+            *open = state & ~matched;
+        }
+
+        if ((state & matched) == 0)
+            continue;
+
+        match->fElement = elem;
+        if (!p->fHasAttribute) {
+            bspan_weak_assign(&match->fValue, &elem.fData);
+            return 0;
+        }
+
+        if (xml_element_find_attribute(&elem, &p->fAttribute, &match->fValue) == 0)
+            return 0;
+    }
+
+    return -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // XMLPATH_H_INCLUDED
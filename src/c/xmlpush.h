@@ -0,0 +1,369 @@
+#ifndef XMLPUSH_H_INCLUDED
+#define XMLPUSH_H_INCLUDED
+
+//
+// xmlpush
+// Scanning xml that arrives a piece at a time, from a socket, a
+// decompressor, or the like, without waiting for all of it.
+//
+// The data is fed in as it arrives, and the elements are pulled out, just
+// like with xml_iter_next_element().  When the end of what's been fed is
+// reached, in the middle of an element, xml_push_next_element() returns -1,
+// and the unfinished part (only that part) is copied into a buffer the
+// scanner keeps.  The next piece that's fed is scanned straight from the
+// caller's memory, except for the bytes needed to finish off that one
+// element, which are added to the buffer.
+//
+// An element is only returned once there's something after it, because
+// until then, it can't be known that it's complete.  When there's no more
+// data, xml_push_finish() says so, and whatever is left is scanned, the
+// same way it would have been if the whole document were in one piece.
+// The elements are exactly the same as scanning the whole document.
+//
+// The elements point either into the data that was fed, or into the
+// scanner's buffer.  They are good until xml_push_next_element() returns -1.
+// The data that was fed has to stay put until then as well.
+//
+// Typical usage:
+//   xmlpushscanner p;
+//   xml_push_init(&p);
+//   while ((n = read(fd, buf, sizeof(buf))) > 0) {
+//       xml_push_feed(&p, buf, n);
+//       while (xml_push_next_element(&params, &p, &elem) == 0)
+//           ...
+//   }
+//   xml_push_finish(&p);
+//   while (xml_push_next_element(&params, &p, &elem) == 0)
+//       ...
+//   xml_push_destroy(&p);
+//
+// When the data can be pulled, from a file descriptor or a callback,
+// rather than being pushed, a streamwin (streamwin.h) does the reading,
+// and xml_push_next_element_from() feeds the scanner each block it reads.
+// The window never grows past one block, as what's left of an unfinished
+// element is kept by the scanner, not the window.
+//
+//   streamwin win;
+//   streamwin_init_from_fd(&win, fd, 64*1024);
+//   while (xml_push_next_element_from(&params, &p, &win, &elem) == 0)
+//       ...
+//
+
+#include <stdlib.h>     // realloc, free
+
+#include "pcoredef.h"
+#include "bspan.h"
+#include "asciiset.h"
+#include "streamwin.h"
+#include "xmlscan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct xmlpushscanner_t {
+    xmliteratorstate fIter;         // scanning the window, which is the buffer, or the data
+    bool fInBuffer;                 // the window is the buffer
+    bool fFinished;                 // no more data is coming
+
+    unsigned char *fBuffer;         // an unfinished element, and what's been added to finish it
+    size_t fBufferSize;
+    size_t fBufferCapacity;
+
+    const unsigned char *fData;     // what was last fed
+    const unsigned char *fDataEnd;
+    size_t fDataCopied;             // how much of it has been added to the buffer
+};
+typedef struct xmlpushscanner_t xmlpushscanner;
+
+static int xml_push_init(xmlpushscanner *p) PC_NOEXCEPT_C;
+static int xml_push_destroy(xmlpushscanner *p) PC_NOEXCEPT_C;
+static int xml_push_feed(xmlpushscanner *p, const void *data, size_t n) PC_NOEXCEPT_C;
+static int xml_push_finish(xmlpushscanner *p) PC_NOEXCEPT_C;
+static int xml_push_next_element(const xmliterparams *params, xmlpushscanner *p, xmlelement *elem) PC_NOEXCEPT_C;
+static int xml_push_next_element_from(const xmliterparams *params, xmlpushscanner *p, streamwin *w, xmlelement *elem) PC_NOEXCEPT_C;
+static size_t xml_push_buffered(const xmlpushscanner *p) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+// The characters that end one piece of markup, or the content before it
+static asciiset * xmlpushdelims() PC_NOEXCEPT_C
+{
+    static asciiset chars;
+    static bool initialized=false;
+
+    if (!initialized){
+        asciiset_init_from_cstr(&chars, "<>");
+        initialized = true;
+    }
+
+    return &chars;
+}
+
+static int xml_push_init(xmlpushscanner *p) PC_NOEXCEPT_C
+{
+    memset(p, 0, sizeof(xmlpushscanner));
+    xml_iter_state_init(&p->fIter);
+    p->fInBuffer = true;
+
+    return 0;
+}
+
+static int xml_push_destroy(xmlpushscanner *p) PC_NOEXCEPT_C
+{
+    free(p->fBuffer);
+    memset(p, 0, sizeof(xmlpushscanner));
+
+    return 0;
+}
+
+// xml_push_buffered()
+// How many bytes are being held onto, waiting for the rest of an element
+static size_t xml_push_buffered(const xmlpushscanner *p) PC_NOEXCEPT_C
+{
+    return p->fInBuffer ? p->fBufferSize : 0;
+}
+
+// xml_push_window()
+// Where the bytes being scanned start and end
+static const unsigned char * xml_push_window(const xmlpushscanner *p, const unsigned char **end) PC_NOEXCEPT_C
+{
+    if (p->fInBuffer) {
+        *end = p->fBuffer + p->fBufferSize;
+        return p->fBuffer;
+    }
+
+    *end = p->fDataEnd;
+    return p->fData;
+}
+
+// xml_push_set_position()
+// Put the iterator at offsets in the window
+static void xml_push_set_position(xmlpushscanner *p, int state, size_t sourceAt, size_t markAt) PC_NOEXCEPT_C
+{
+    const unsigned char *end = nullptr;
+    const unsigned char *base = xml_push_window(p, &end);
+
+    p->fIter.fState = state;
+    bspan_init_from_pointers(&p->fIter.fSource, base + sourceAt, end);
+    bspan_init_from_pointers(&p->fIter.fMark, base + markAt, end);
+}
+
+// xml_push_reserve()
+// Make room in the buffer for 'n' more bytes
+static int xml_push_reserve(xmlpushscanner *p, size_t n) PC_NOEXCEPT_C
+{
+    if (p->fBufferCapacity - p->fBufferSize >= n)
+        return 0;
+
+    size_t newCapacity = (p->fBufferCapacity < 4096) ? 4096 : p->fBufferCapacity * 2;
+    while (newCapacity - p->fBufferSize < n)
+        newCapacity *= 2;
+
+    unsigned char *newBuffer = (unsigned char *)realloc(p->fBuffer, newCapacity);
+    if (newBuffer == nullptr)
+        return -1;
+
+    p->fBuffer = newBuffer;
+    p->fBufferCapacity = newCapacity;
+
+    return 0;
+}
+
+// xml_push_is_complete()
+// Whether an element, which the scan of the window starting at 'base' left
+// off just before 'after', would be the same no matter what comes after
+// 'end'.  Something has to come after it, and a tag that never found its
+// '>' stops short, rather than running to the end, so markup has to have
+// ended with a '>'.  A DOCTYPE that isn't understood stops wherever it
+// gives up, having looked no further than the 6 bytes of 'PUBLIC' ahead.
+static bool xml_push_is_complete(const xmlelement *elem, const unsigned char *base, const unsigned char *after, const unsigned char *end) PC_NOEXCEPT_C
+{
+    if ((after <= base) || (after >= end))
+        return false;
+
+    if (elem->fElementKind == XML_ELEMENT_TYPE_CONTENT)
+        return true;
+
+    if ((elem->fElementKind == XML_ELEMENT_TYPE_DOCTYPE) && (end - after >= 6))
+        return true;
+
+    return after[-1] == '>';
+}
+
+// xml_push_feed()
+// Hand the scanner the next piece of the document.  Everything fed
+// before must have been scanned, that is, xml_push_next_element()
+// returned -1.
+static int xml_push_feed(xmlpushscanner *p, const void *data, size_t n) PC_NOEXCEPT_C
+{
+    if (p->fFinished || !p->fInBuffer)
+        return -1;
+
+    p->fData = (const unsigned char *)data;
+    p->fDataEnd = p->fData + n;
+    p->fDataCopied = 0;
+
+    return 0;
+}
+
+// xml_push_finish()
+// There's no more data.  What's left is scanned as it is.
+static int xml_push_finish(xmlpushscanner *p) PC_NOEXCEPT_C
+{
+    p->fFinished = true;
+
+    // Data that was fed, but not yet scanned, goes after what's buffered
+    size_t dataLeft = (size_t)(p->fDataEnd - p->fData) - p->fDataCopied;
+    if (p->fInBuffer && (p->fBufferSize > 0) && (dataLeft > 0))
+    {
+        const unsigned char *end = nullptr;
+        const unsigned char *base = xml_push_window(p, &end);
+        int state = p->fIter.fState;
+        size_t sourceAt = (size_t)(bspan_begin(&p->fIter.fSource) - base);
+        size_t markAt = (size_t)(bspan_begin(&p->fIter.fMark) - base);
+
+        if (xml_push_reserve(p, dataLeft) != 0)
+            return -1;
+        memcpy(p->fBuffer + p->fBufferSize, p->fData + p->fDataCopied, dataLeft);
+        p->fBufferSize += dataLeft;
+        p->fDataCopied += dataLeft;
+        xml_push_set_position(p, state, sourceAt, markAt);
+    }
+
+    return 0;
+}
+
+// xml_push_next_element()
+// Get the next complete element
+// Return
+//    0 - there's an element
+//   -1 - more data is needed, or, once finished, there are no more elements
+static int xml_push_next_element(const xmliterparams *params, xmlpushscanner *p, xmlelement *elem) PC_NOEXCEPT_C
+{
+    while (true)
+    {
+        const unsigned char *end = nullptr;
+        const unsigned char *base = xml_push_window(p, &end);
+        int state = p->fIter.fState;
+        size_t sourceAt = (size_t)(bspan_begin(&p->fIter.fSource) - base);
+        size_t markAt = (size_t)(bspan_begin(&p->fIter.fMark) - base);
+
+        // Nothing left in the buffer, so go straight to the data
+        if (p->fInBuffer && (markAt == p->fBufferSize) && (sourceAt == p->fBufferSize) &&
+            (p->fDataCopied < (size_t)(p->fDataEnd - p->fData)))
+        {
+            p->fInBuffer = false;
+            p->fBufferSize = 0;
+            xml_push_set_position(p, state, p->fDataCopied, p->fDataCopied);
+            continue;
+        }
+
+        if (xml_iter_next_element(params, &p->fIter, elem) == 0)
+        {
+            const unsigned char *after = bspan_begin(&p->fIter.fSource);
+            if (p->fFinished || xml_push_is_complete(elem, base, after, end))
+            {
+                // Once the buffered element is finished, the rest is in the data
+                size_t afterAt = (size_t)(after - base);
+                size_t copiedFrom = p->fBufferSize - p->fDataCopied;
+                if (p->fInBuffer && !p->fFinished && (afterAt >= copiedFrom)) {
+                    p->fInBuffer = false;
+                    xml_push_set_position(p, p->fIter.fState, afterAt - copiedFrom, afterAt - copiedFrom);
+                }
+
+                return 0;
+            }
+        }
+        else if (p->fFinished) {
+            return -1;
+        }
+
+        // The element isn't complete, so back up to where it started
+        xml_push_set_position(p, state, sourceAt, markAt);
+
+        if (!p->fInBuffer)
+        {
+            // Keep what's left of the data
+            size_t keep = (size_t)(end - (base + markAt));
+            p->fBufferSize = 0;
+            if (xml_push_reserve(p, keep) != 0)
+                return -1;
+            memcpy(p->fBuffer, base + markAt, keep);
+            p->fBufferSize = keep;
+            p->fDataCopied = (size_t)(p->fDataEnd - p->fData);
+            p->fInBuffer = true;
+            xml_push_set_position(p, state, sourceAt - markAt, 0);
+
+            return -1;
+        }
+
+        size_t dataLeft = (size_t)(p->fDataEnd - p->fData) - p->fDataCopied;
+        if (dataLeft == 0)
+            return -1;
+
+        // Add up to just past the next '<' or '>', which might be what finishes
+        // the element.  At least as much as is already there is added, so a very
+        // long element isn't scanned over and over again.
+        const unsigned char *from = p->fData + p->fDataCopied;
+        size_t n = asciiset_find_first_in(xmlpushdelims(), from, dataLeft) + 2;
+        if (n < p->fBufferSize)
+            n = p->fBufferSize;
+        if (n > dataLeft)
+            n = dataLeft;
+
+        if (xml_push_reserve(p, n) != 0)
+            return -1;
+        memcpy(p->fBuffer + p->fBufferSize, from, n);
+        p->fBufferSize += n;
+        p->fDataCopied += n;
+        xml_push_set_position(p, state, sourceAt, markAt);
+    }
+}
+
+// xml_push_next_element_from()
+// Get the next complete element, reading the document from a stream
+// window as more of it is needed.  The elements are good until the next
+// call, which may refill the window.
+// Return
+//    0 - there's an element
+//   -1 - there are no more elements
+//   -2 - the stream failed, or the scanner ran out of memory
+static int xml_push_next_element_from(const xmliterparams *params, xmlpushscanner *p, streamwin *w, xmlelement *elem) PC_NOEXCEPT_C
+{
+    while (true)
+    {
+        if (xml_push_next_element(params, p, elem) == 0)
+            return 0;
+        if (p->fFinished)
+            return -1;
+
+        // Everything fed has been scanned, or kept in the scanner's
+        // buffer, unless the buffer couldn't grow
+        if (!p->fInBuffer || (p->fDataCopied != (size_t)(p->fDataEnd - p->fData)))
+            return -2;
+
+        streamwin_consume(w, streamwin_size(w));
+
+        ptrdiff_t n = streamwin_refill(w);
+        if (n < 0)
+            return -2;
+
+        if (n == 0) {
+            if (xml_push_finish(p) != 0)
+                return -2;
+            continue;
+        }
+
+        bspan s;
+        streamwin_span(w, &s);
+        xml_push_feed(p, bspan_begin(&s), bspan_size(&s));
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // XMLPUSH_H_INCLUDED
@@ -3,12 +3,81 @@
 
 
 #include "xmlcore.h"
+#include "lexmulti.h"
+#include "xmlindex.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
+// The closing sequences of the various constructs.  These
+// are searched for often enough that they are compiled once.
+static const lexsearch * xml_cdata_end_search() PC_NOEXCEPT_C
+{
+    static lexsearch srch;
+    static bool initialized = false;
+
+    if (!initialized) {
+        lexsearch_init_from_cstr(&srch, "]]>");
+        initialized = true;
+    }
+
+    return &srch;
+}
+
+static const lexsearch * xml_comment_end_search() PC_NOEXCEPT_C
+{
+    static lexsearch srch;
+    static bool initialized = false;
+
+    if (!initialized) {
+        lexsearch_init_from_cstr(&srch, "-->");
+        initialized = true;
+    }
+
+    return &srch;
+}
+
+static const lexsearch * xml_dtd_end_search() PC_NOEXCEPT_C
+{
+    static lexsearch srch;
+    static bool initialized = false;
+
+    if (!initialized) {
+        lexsearch_init_from_cstr(&srch, "]>");
+        initialized = true;
+    }
+
+    return &srch;
+}
+
+// The markup that can follow a '<', in the order they need
+// to be checked.  "?xml" has to come before "?".
+enum XML_MARKUP {
+    XML_MARKUP_XMLDECL = 0
+    , XML_MARKUP_PROCESSING_INSTRUCTION
+    , XML_MARKUP_DOCTYPE
+    , XML_MARKUP_COMMENT
+    , XML_MARKUP_CDATA
+    , XML_MARKUP_ENTITY
+    , XML_MARKUP_END_TAG
+};
+
+static const lexmulti * xml_markup_prefixes() PC_NOEXCEPT_C
+{
+    static const char *prefixes[] = { "?xml", "?", "!DOCTYPE", "!--", "![CDATA[", "!ENTITY", "/" };
+    static lexmulti matcher;
+    static bool initialized = false;
+
+    if (!initialized) {
+        lexmulti_init(&matcher, prefixes, sizeof(prefixes) / sizeof(prefixes[0]));
+        initialized = true;
+    }
+
+    return &matcher;
+}
+
 //============================================================
 // readCData()
 //============================================================
@@ -22,7 +91,7 @@ static int xml_scan_read_cdata(bspan *src, bspan * dataChunk) PC_NOEXCEPT_C
 
         // Extend the data chunk until we find the closing ]]>
         bspan endCData;
-        lex_find_cstr(src, "]]>", &endCData);
+        lexsearch_find_span(xml_cdata_end_search(), src, &endCData);
         dataChunk->fEnd = endCData.fStart;
 
         bspan_weak_assign(src, &endCData);
@@ -46,14 +115,12 @@ static int xml_scan_read_comment(bspan * src, bspan *dataChunk) PC_NOEXCEPT_C
 	dataChunk->fEnd = src->fStart;
 
 	// Extend the data chunk until we find the closing -->
-	//bspan endComment = chunk_find_cstr(src, "-->");
     bspan endComment;
-    lex_find_cstr(src, "-->", &endComment);
+    lexsearch_find_span(xml_comment_end_search(), src, &endComment);
 
 	dataChunk->fEnd = endComment.fStart;
 
-    src->fStart = endComment.fEnd++;
-    //bspan_weak_assign(src, &endComment);
+    bspan_weak_assign(src, &endComment);
 
 	// skip past the end of the comment  '-->'
     bspan_advance(src, 3);
@@ -72,7 +139,7 @@ static int xml_scan_read_entity_declaration(bspan *src, bspan *dataChunk) PC_NOE
     // Skip past the !ENTITY
     bspan_advance(src, 7);
 
-    dataChunk = src;
+    bspan_weak_assign(dataChunk, src);
 
 	// skip until we see the closing '>' character
 	lex_find_char(src, '>', src);
@@ -95,7 +162,7 @@ static int xml_scan_read_entity_declaration(bspan *src, bspan *dataChunk) PC_NOE
 static int xml_scan_read_doctype(bspan * src, bspan * dataChunk) PC_NOEXCEPT_C
 {
         // skip past the !DOCTYPE to the first whitespace character
-        src += 8;
+        bspan_advance(src, 8);
 
 
         // Skip past the whitespace
@@ -118,11 +185,12 @@ static int xml_scan_read_doctype(bspan * src, bspan * dataChunk) PC_NOEXCEPT_C
 
 			// Find the closing ']>'
 			bspan endDTD;
-            lex_find_cstr(src, "]>", &endDTD);
+            lexsearch_find_span(xml_dtd_end_search(), src, &endDTD);
 			bspan_init_from_pointers(dataChunk, src->fStart, endDTD.fStart);
 
 			// Skip past the closing ']>'
-			src->fStart = endDTD.fStart + 2;
+			bspan_weak_assign(src, &endDTD);
+			bspan_advance(src, 2);
 
             return 0;
 		}
@@ -166,13 +234,14 @@ static int xml_scan_read_doctype(bspan * src, bspan * dataChunk) PC_NOEXCEPT_C
 
 				// Find the closing ']>'
 				bspan endDTD;
-                lex_find_cstr(src, "]>", &endDTD);
+                lexsearch_find_span(xml_dtd_end_search(), src, &endDTD);
 				
                 bspan_init_from_pointers(dataChunk, bspan_begin(src), bspan_begin(&endDTD));
 
 
 				// Skip past the closing ']>'
-				src->fStart = endDTD.fStart + 2;
+				bspan_weak_assign(src, &endDTD);
+				bspan_advance(src, 2);
 				
                 return 0;
 			}
@@ -205,11 +274,12 @@ static int xml_scan_read_doctype(bspan * src, bspan * dataChunk) PC_NOEXCEPT_C
 
 				// Find the closing ']>'
 				bspan endDTD;
-                lex_find_cstr(src, "]>", &endDTD);
+                lexsearch_find_span(xml_dtd_end_search(), src, &endDTD);
                 bspan_init_from_pointers(dataChunk, bspan_begin(src), bspan_begin(&endDTD));
 
 				// Skip past the closing ']>'
-				src->fStart = endDTD.fStart + 2;
+				bspan_weak_assign(src, &endDTD);
+				bspan_advance(src, 2);
 				
                 return 0;
 			}
@@ -221,36 +291,37 @@ static int xml_scan_read_doctype(bspan * src, bspan * dataChunk) PC_NOEXCEPT_C
     
 //============================================================
 // readTag()
+// 'closePtr' is where the closing '>' is, or nullptr if there
+// isn't one.
 //============================================================
-static int xml_scan_read_tag(bspan * src, bspan * dataChunk) PC_NOEXCEPT_C
+static int xml_scan_read_tag_to(bspan * src, const unsigned char *closePtr, bspan * dataChunk) PC_NOEXCEPT_C
 {
-    const unsigned char* srcPtr = bspan_begin(src);
-	const unsigned char* endPtr = bspan_end(src);
-        
     bspan_init_from_pointers(dataChunk, bspan_begin(src), bspan_begin(src));
 
-    // BUGBUG - should be lex_find_char()
-	while ((srcPtr < endPtr) && (*srcPtr != '>'))
-		srcPtr++;
-        
 	// if we get to the end of the input, before seeing the closing '>'
     // the we return false, indicating we did not read
-    if (srcPtr == endPtr)
+    if (closePtr == nullptr)
 		return false;
         
     // we did see the closing, so capture the name into 
     // the data chunk, and trim whitespace off the end.
-    bspan_set_end(dataChunk, srcPtr);
+    bspan_set_end(dataChunk, closePtr);
     lex_rtrim(dataChunk, wspcharset());
 
     // move past the '>'
-    srcPtr++;
-    bspan_set_begin(src, srcPtr);
-
+    bspan_set_begin(src, closePtr + 1);
 
     return 0;
 }
 
+static int xml_scan_read_tag(bspan * src, bspan * dataChunk) PC_NOEXCEPT_C
+{
+    bspan rest;
+    lex_find_char(src, '>', &rest);
+
+    return xml_scan_read_tag_to(src, bspan_is_valid(&rest) ? bspan_begin(&rest) : nullptr, dataChunk);
+}
+
 
 // XML_ITERATOR_STATE
 // This enum represents the states the xml iterator
@@ -271,7 +342,8 @@ struct xmliterparams_t {
     bool fSkipProcessingInstructions;
     bool fSkipWhitespace;
     bool fSkipCData;
-    bool fAutoScanAttributes;
+    bool fAutoScanAttributes;      // unused, attributes are read on demand with an xmlattriter
+    const xmlvocab *fVocab;        // optional, tag names to turn into xmlelement.fNameId
 };
 typedef struct xmliterparams_t xmliterparams;
 
@@ -282,6 +354,8 @@ struct xmliteratorstate_t {
     int fState;
     bspan fSource;
     bspan fMark;
+    const xmlindex *fIndex;     // optional, where the '<' and '>' are
+    size_t fIndexPos;           // where in the index the last search left off
 };
 typedef struct xmliteratorstate_t xmliteratorstate;
 
@@ -290,6 +364,8 @@ static int xml_iter_state_init(xmliteratorstate *s) PC_NOEXCEPT_C
     s->fState = XML_ITERATOR_STATE_CONTENT;
     bspan_init(&s->fSource);
     bspan_init(&s->fMark);
+    s->fIndex = nullptr;
+    s->fIndexPos = 0;
 
     return 0;
 }
@@ -303,6 +379,39 @@ static int xml_iter_state_init_from_source(xmliteratorstate *s, bspan *src) PC_N
     return 0;
 }
 
+// xml_iter_state_init_from_index()
+// Iterate over a source that has been indexed with xmlindex_build().  The
+// source must be the same one (or part of the same one) that was indexed.
+// The elements are exactly the same as without the index.  An index that
+// did not build, or that is of some other source, is not used.
+static int xml_iter_state_init_from_index(xmliteratorstate *s, bspan *src, const xmlindex *idx) PC_NOEXCEPT_C
+{
+    xml_iter_state_init_from_source(s, src);
+
+    if ((idx != nullptr) && (idx->fBase != nullptr) &&
+        (bspan_begin(src) >= idx->fBase) && (bspan_end(src) <= idx->fBase + idx->fLength))
+        s->fIndex = idx;
+
+    return 0;
+}
+
+// xml_iter_find_char()
+// Where the next 'c' ('<' or '>') is in the source, or nullptr
+// With an index, that's a hop to the next position in the index,
+// otherwise, it's a scan of the bytes.
+static const unsigned char * xml_iter_find_char(xmliteratorstate *st, unsigned char c) PC_NOEXCEPT_C
+{
+    if (st->fIndex != nullptr) {
+        const unsigned char *p = xmlindex_find_next(st->fIndex, &st->fIndexPos, bspan_begin(&st->fSource), c);
+        return ((p != nullptr) && (p < bspan_end(&st->fSource))) ? p : nullptr;
+    }
+
+    bspan rest;
+    lex_find_char(&st->fSource, c, &rest);
+
+    return bspan_is_valid(&rest) ? bspan_begin(&rest) : nullptr;
+}
+
 static int xml_iter_is_valid(xmliteratorstate *s)
 {
     return bspan_is_valid(&s->fSource);
@@ -315,10 +424,22 @@ static int xml_iter_params_init(xmliterparams *p) PC_NOEXCEPT_C
     p->fSkipWhitespace = true;
     p->fSkipCData = false;
     p->fAutoScanAttributes = false;
+    p->fVocab = nullptr;
 
     return 0;
 }
 
+// xml_iter_lookup_name()
+// Set the id of a tag's name from the vocabulary
+static void xml_iter_lookup_name(const xmlvocab *vocab, xmlelement *elem) PC_NOEXCEPT_C
+{
+    int kind = elem->fElementKind;
+    if ((kind != XML_ELEMENT_TYPE_START_TAG) && (kind != XML_ELEMENT_TYPE_SELF_CLOSING) && (kind != XML_ELEMENT_TYPE_END_TAG))
+        return;
+
+    elem->fNameId = xmlvocab_lookup(vocab, &elem->fNameSpan);
+}
+
 // XmlElementGenerator
 // A function to get the next element in an iteration
 static int xml_iter_next_element(const xmliterparams * params, xmliteratorstate * st, xmlelement *elem) PC_NOEXCEPT_C
@@ -330,7 +451,15 @@ static int xml_iter_next_element(const xmliterparams * params, xmliteratorstate
         {
             case XML_ITERATOR_STATE_CONTENT: {
 
-                if (bspan_front(&st->fSource) == '<')
+                // Go straight to the next '<'.  If there isn't one, 
+                // whatever is left is not returned.
+                const unsigned char *openPtr = xml_iter_find_char(st, '<');
+                if (openPtr == nullptr) {
+                    bspan_set_begin(&st->fSource, bspan_end(&st->fSource));
+                    break;
+                }
+                bspan_set_begin(&st->fSource, openPtr);
+
                 {
                     // Change state to beginning of start tag
                     // for next turn through iteration
@@ -363,9 +492,6 @@ static int xml_iter_next_element(const xmliterparams * params, xmliteratorstate
                     bspan_advance(&st->fSource,1);
                     bspan_weak_assign(&st->fMark, &st->fSource);
                 }
-                else {
-                    bspan_advance(&st->fSource, 1);
-                }
             }
             break;
 
@@ -376,45 +502,49 @@ static int xml_iter_next_element(const xmliterparams * params, xmliteratorstate
                 bspan elementChunk;
                 bspan_init_from_pointers(&elementChunk, bspan_begin(&st->fSource), bspan_begin(&st->fSource));
 
-                if (lex_begins_with_cstr(&st->fSource,"?xml"))
+                bspan markup;
+                switch (lexmulti_match_prefix(xml_markup_prefixes(), &st->fSource, &markup))
                 {
-                    kind = XML_ELEMENT_TYPE_XMLDECL;
-                    xml_scan_read_tag(&st->fSource, &elementChunk);
-                }
-                else if (lex_begins_with_cstr(&st->fSource,"?"))
-                {
-                    kind = XML_ELEMENT_TYPE_PROCESSING_INSTRUCTION;
-                    xml_scan_read_tag(&st->fSource, &elementChunk);
-                }
-                else if (lex_begins_with_cstr(&st->fSource,"!DOCTYPE"))
-                {
-                    kind = XML_ELEMENT_TYPE_DOCTYPE;
-                    xml_scan_read_doctype(&st->fSource, &elementChunk);
-                }
-                else if (lex_begins_with_cstr(&st->fSource,"!--"))
-                {
-                    kind = XML_ELEMENT_TYPE_COMMENT;
-                    xml_scan_read_comment(&st->fSource, &elementChunk);
-                }
-                else if (lex_begins_with_cstr(&st->fSource,"![CDATA["))
-                {
-                    kind = XML_ELEMENT_TYPE_CDATA;
-                    xml_scan_read_cdata(&st->fSource, &elementChunk);
-                }
-                else if (lex_begins_with_cstr(&st->fSource,"!ENTITY"))
-                {
-                    kind = XML_ELEMENT_TYPE_ENTITY;
-                    xml_scan_read_entity_declaration(&st->fSource, &elementChunk);
-                }
-                else if (lex_begins_with_cstr(&st->fSource,"/"))
-                {
-                    kind = XML_ELEMENT_TYPE_END_TAG;
-                    xml_scan_read_tag(&st->fSource, &elementChunk);
-                }
-                else {
-                    xml_scan_read_tag(&st->fSource, &elementChunk);
-                    if (bspan_back(&elementChunk) == '/')
-                        kind = XML_ELEMENT_TYPE_SELF_CLOSING;
+                    case XML_MARKUP_XMLDECL:
+                        kind = XML_ELEMENT_TYPE_XMLDECL;
+                        xml_scan_read_tag_to(&st->fSource, xml_iter_find_char(st, '>'), &elementChunk);
+                    break;
+
+                    case XML_MARKUP_PROCESSING_INSTRUCTION:
+                        kind = XML_ELEMENT_TYPE_PROCESSING_INSTRUCTION;
+                        xml_scan_read_tag_to(&st->fSource, xml_iter_find_char(st, '>'), &elementChunk);
+                    break;
+
+                    case XML_MARKUP_DOCTYPE:
+                        kind = XML_ELEMENT_TYPE_DOCTYPE;
+                        xml_scan_read_doctype(&st->fSource, &elementChunk);
+                    break;
+
+                    case XML_MARKUP_COMMENT:
+                        kind = XML_ELEMENT_TYPE_COMMENT;
+                        xml_scan_read_comment(&st->fSource, &elementChunk);
+                    break;
+
+                    case XML_MARKUP_CDATA:
+                        kind = XML_ELEMENT_TYPE_CDATA;
+                        xml_scan_read_cdata(&st->fSource, &elementChunk);
+                    break;
+
+                    case XML_MARKUP_ENTITY:
+                        kind = XML_ELEMENT_TYPE_ENTITY;
+                        xml_scan_read_entity_declaration(&st->fSource, &elementChunk);
+                    break;
+
+                    case XML_MARKUP_END_TAG:
+                        kind = XML_ELEMENT_TYPE_END_TAG;
+                        xml_scan_read_tag_to(&st->fSource, xml_iter_find_char(st, '>'), &elementChunk);
+                    break;
+
+                    default:
+                        xml_scan_read_tag_to(&st->fSource, xml_iter_find_char(st, '>'), &elementChunk);
+                        if (bspan_back(&elementChunk) == '/')
+                            kind = XML_ELEMENT_TYPE_SELF_CLOSING;
+                    break;
                 }
 
                 st->fState = XML_ITERATOR_STATE_CONTENT;
@@ -422,6 +552,8 @@ static int xml_iter_next_element(const xmliterparams * params, xmliteratorstate
                 bspan_weak_assign(&st->fMark, &st->fSource);
 
                 xml_element_init_from_data(elem, kind, &elementChunk);
+                if (params->fVocab != nullptr)
+                    xml_iter_lookup_name(params->fVocab, elem);
 
                 return 0;
             }
@@ -0,0 +1,389 @@
+#ifndef XMLVOCAB_H_INCLUDED
+#define XMLVOCAB_H_INCLUDED
+
+//
+// xmlvocab
+// A vocabulary of tag names, known ahead of time, each with an integer id.
+//
+// Code that does something different for each kind of element ends up
+// comparing the name against one known name after another.  With a
+// vocabulary, the scanner looks the name up once, and the element carries
+// the id (xmlelement.fNameId), so the dispatch is a 'switch'.  A name that
+// isn't in the vocabulary gets XMLVOCAB_UNKNOWN.
+//
+// The lookup is a perfect hash, made when the vocabulary is built.  The
+// name is hashed once, 8 bytes at a time.  The hash picks a bucket, and
+// each bucket has a seed, found while building, that sends each of its
+// names to a slot no other name uses.  So a lookup is one hash, one
+// multiply, and one compare against the only name that could be there.
+//
+// The names are held as spans, so the strings they come from (usually
+// literals) have to stay put.
+//
+// Typical usage:
+//   enum { SVG_RECT, SVG_PATH, SVG_G };
+//
+//   xmlvocab vocab;
+//   xmlvocab_init(&vocab);
+//   xmlvocab_add_cstr(&vocab, "rect", SVG_RECT);
+//   xmlvocab_add_cstr(&vocab, "path", SVG_PATH);
+//   xmlvocab_add_cstr(&vocab, "g", SVG_G);
+//   xmlvocab_build(&vocab);
+//
+//   params.fVocab = &vocab;
+//   while (xml_iter_next_element(&params, &st, &elem) == 0) {
+//       switch (elem.fNameId) {
+//           case SVG_RECT: ...
+//       }
+//   }
+//   xmlvocab_destroy(&vocab);
+//
+
+#include <stdlib.h>     // malloc, realloc, free
+
+#include "pcoredef.h"
+#include "bspan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XMLVOCAB_UNKNOWN 0xffffffffu
+
+struct xmlvocabentry_t {
+    bspan fName;
+    uint32_t fId;
+};
+typedef struct xmlvocabentry_t xmlvocabentry;
+
+struct xmlvocab_t {
+    xmlvocabentry *fEntries;
+    size_t fCount;
+    size_t fCapacity;
+
+    // Filled in by xmlvocab_build()
+    uint32_t *fSlots;           // entry index + 1, 0 when empty
+    unsigned fSlotShift;        // 64 - log2 of the number of slots
+    uint32_t *fSeeds;           // one per bucket
+    uint32_t fBucketCount;
+    uint64_t fSeed;             // for the hash of the names
+};
+typedef struct xmlvocab_t xmlvocab;
+
+static int xmlvocab_init(xmlvocab *v) PC_NOEXCEPT_C;
+static int xmlvocab_destroy(xmlvocab *v) PC_NOEXCEPT_C;
+static int xmlvocab_add(xmlvocab *v, const bspan *name, uint32_t id) PC_NOEXCEPT_C;
+static int xmlvocab_add_cstr(xmlvocab *v, const char *name, uint32_t id) PC_NOEXCEPT_C;
+static int xmlvocab_build(xmlvocab *v) PC_NOEXCEPT_C;
+static uint32_t xmlvocab_lookup(const xmlvocab *v, const bspan *name) PC_NOEXCEPT_C;
+static size_t xmlvocab_count(const xmlvocab *v) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+static uint64_t xmlvocab_mix(uint64_t h) PC_NOEXCEPT_C
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+
+    return h;
+}
+
+// xmlvocab_bucket()
+// The bucket of a hash, from its high half, without a divide
+static uint32_t xmlvocab_bucket(uint64_t h, uint32_t bucketCount) PC_NOEXCEPT_C
+{
+    return (uint32_t)(((h >> 32) * bucketCount) >> 32);
+}
+
+// xmlvocab_slot()
+// The slot of a hash, with a bucket's seed, from the top bits of one multiply
+static size_t xmlvocab_slot(uint64_t h, uint32_t seed, unsigned shift) PC_NOEXCEPT_C
+{
+    return (size_t)(((h ^ ((uint64_t)seed * 0x9e3779b97f4a7c15ull)) * 0xbf58476d1ce4e5b9ull) >> shift);
+}
+
+// xmlvocab_hash()
+// A hash of every byte of the name, taken 8 at a time.  The
+// last word overlaps the one before it, rather than being padded.
+static uint64_t xmlvocab_hash(const unsigned char *s, size_t n, uint64_t seed) PC_NOEXCEPT_C
+{
+    uint64_t h = seed ^ ((uint64_t)n * 0x9e3779b97f4a7c15ull);
+    uint64_t w = 0;
+
+    if (n >= 8)
+    {
+        size_t i = 0;
+        for (; i + 8 < n; i += 8) {
+            memcpy(&w, s + i, 8);
+            h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+            h ^= h >> 29;
+        }
+        memcpy(&w, s + n - 8, 8);
+    }
+    else if (n >= 4)
+    {
+        uint32_t lo = 0;
+        uint32_t hi = 0;
+        memcpy(&lo, s, 4);
+        memcpy(&hi, s + n - 4, 4);
+        w = ((uint64_t)hi << 32) | lo;
+    }
+    else if (n > 0)
+    {
+        w = (uint64_t)s[0] | ((uint64_t)s[n / 2] << 8) | ((uint64_t)s[n - 1] << 16);
+    }
+
+    return xmlvocab_mix(h ^ w);
+}
+
+static int xmlvocab_init(xmlvocab *v) PC_NOEXCEPT_C
+{
+    memset(v, 0, sizeof(xmlvocab));
+
+    return 0;
+}
+
+static int xmlvocab_destroy(xmlvocab *v) PC_NOEXCEPT_C
+{
+    free(v->fEntries);
+    free(v->fSlots);
+    free(v->fSeeds);
+    memset(v, 0, sizeof(xmlvocab));
+
+    return 0;
+}
+
+static size_t xmlvocab_count(const xmlvocab *v) PC_NOEXCEPT_C { return v->fCount; }
+
+// xmlvocab_add()
+// Add a name, with its id, to the vocabulary.  The vocabulary has
+// to be built again before it's used.
+// Return
+//    0 - success
+//   -1 - the name is already there, or out of memory
+static int xmlvocab_add(xmlvocab *v, const bspan *name, uint32_t id) PC_NOEXCEPT_C
+{
+    size_t n = bspan_size(name);
+    for (size_t i = 0; i < v->fCount; i++) {
+        const bspan *s = &v->fEntries[i].fName;
+        if ((bspan_size(s) == n) && ((n == 0) || (memcmp(bspan_begin(s), bspan_begin(name), n) == 0)))
+            return -1;
+    }
+
+    if (v->fCount == v->fCapacity) {
+        size_t cap = (v->fCapacity < 32) ? 32 : v->fCapacity * 2;
+        xmlvocabentry *entries = (xmlvocabentry *)realloc(v->fEntries, cap * sizeof(xmlvocabentry));
+        if (entries == nullptr)
+            return -1;
+        v->fEntries = entries;
+        v->fCapacity = cap;
+    }
+
+    bspan_weak_assign(&v->fEntries[v->fCount].fName, name);
+    v->fEntries[v->fCount].fId = id;
+    v->fCount++;
+
+    // Whatever was built no longer has all the names
+    free(v->fSlots);
+    free(v->fSeeds);
+    v->fSlots = nullptr;
+    v->fSeeds = nullptr;
+
+    return 0;
+}
+
+static int xmlvocab_add_cstr(xmlvocab *v, const char *name, uint32_t id) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, name);
+
+    return xmlvocab_add(v, &s, id);
+}
+
+// xmlvocab_try_build()
+// Try to find a seed for every bucket, with the given number of slots
+// Return
+//    0 - success
+//   -1 - out of memory
+//   -2 - a bucket's names could not be placed, with any seed
+static int xmlvocab_try_build(xmlvocab *v, const uint64_t *hashes, unsigned slotBits, uint32_t bucketCount) PC_NOEXCEPT_C
+{
+    size_t n = v->fCount;
+    size_t slotCount = (size_t)1 << slotBits;
+    unsigned shift = 64 - slotBits;
+    int result = -1;
+
+    // The entries, in order of bucket, and where each bucket starts
+    uint32_t *order = (uint32_t *)malloc(n * sizeof(uint32_t));
+    uint32_t *starts = (uint32_t *)calloc(bucketCount + 1, sizeof(uint32_t));
+    uint32_t *buckets = (uint32_t *)malloc(bucketCount * sizeof(uint32_t));
+    uint32_t *slots = (uint32_t *)calloc(slotCount, sizeof(uint32_t));
+    uint32_t *seeds = (uint32_t *)calloc(bucketCount, sizeof(uint32_t));
+    if ((order == nullptr) || (starts == nullptr) || (buckets == nullptr) || (slots == nullptr) || (seeds == nullptr))
+        goto done;
+
+    for (size_t i = 0; i < n; i++)
+        starts[xmlvocab_bucket(hashes[i], bucketCount) + 1]++;
+    for (size_t b = 0; b < bucketCount; b++)
+        starts[b + 1] += starts[b];
+    {
+        uint32_t *fill = buckets;
+        memcpy(fill, starts, bucketCount * sizeof(uint32_t));
+        for (size_t i = 0; i < n; i++)
+            order[fill[xmlvocab_bucket(hashes[i], bucketCount)]++] = (uint32_t)i;
+    }
+
+    // The biggest buckets are the hardest to place, so they go first
+    for (size_t b = 0; b < bucketCount; b++)
+        buckets[b] = (uint32_t)b;
+    for (size_t i = 1; i < bucketCount; i++) {
+        uint32_t b = buckets[i];
+        uint32_t size = starts[b + 1] - starts[b];
+        size_t j = i;
+        while ((j > 0) && (starts[buckets[j - 1] + 1] - starts[buckets[j - 1]] < size)) {
+            buckets[j] = buckets[j - 1];
+            j--;
+        }
+        buckets[j] = b;
+    }
+
+    for (size_t k = 0; k < bucketCount; k++)
+    {
+        uint32_t b = buckets[k];
+        uint32_t first = starts[b];
+        uint32_t last = starts[b + 1];
+        if (first == last)
+            break;
+
+        bool placed = false;
+        for (uint32_t seed = 0; (seed < 65536) && !placed; seed++)
+        {
+            uint32_t i = first;
+            for (; i < last; i++) {
+                uint32_t *slot = &slots[xmlvocab_slot(hashes[order[i]], seed, shift)];
+                if (*slot != 0)
+                    break;
+                *slot = order[i] + 1;
+            }
+
+            if (i == last) {
+                seeds[b] = seed;
+                placed = true;
+                break;
+            }
+
+            // Take back what this seed had placed
+            for (uint32_t j = first; j < i; j++)
+                slots[xmlvocab_slot(hashes[order[j]], seed, shift)] = 0;
+        }
+
+        if (!placed) {
+            result = -2;
+            goto done;
+        }
+    }
+
+    free(v->fSlots);
+    free(v->fSeeds);
+    v->fSlots = slots;
+    v->fSeeds = seeds;
+    v->fSlotShift = shift;
+    v->fBucketCount = bucketCount;
+    slots = nullptr;
+    seeds = nullptr;
+    result = 0;
+
+done:
+    free(order);
+    free(starts);
+    free(buckets);
+    free(slots);
+    free(seeds);
+
+    return result;
+}
+
+// xmlvocab_build()
+// Make the perfect hash for the names that have been added.  Each try
+// hashes the names with a different seed, and every 8 tries, there are
+// twice as many slots.  With 64 tries, a vocabulary that can't be placed
+// isn't something that happens, but if it does, rather than have a
+// lookup that's wrong, there is no hash, and every name is unknown.
+// Return
+//    0 - success
+//   -1 - out of memory
+//   -2 - no perfect hash was found, in 64 tries
+static int xmlvocab_build(xmlvocab *v) PC_NOEXCEPT_C
+{
+    size_t n = v->fCount;
+    if (n == 0)
+        return 0;
+
+    uint64_t *hashes = (uint64_t *)malloc(n * sizeof(uint64_t));
+    if (hashes == nullptr)
+        return -1;
+
+    // A build that fails leaves no hash, rather than one made with another seed
+    free(v->fSlots);
+    free(v->fSeeds);
+    v->fSlots = nullptr;
+    v->fSeeds = nullptr;
+
+    // About 4 names to a bucket, and a quarter of the slots left empty
+    uint32_t bucketCount = (uint32_t)((n + 3) / 4);
+    unsigned slotBits = 4;
+    while (((size_t)1 << slotBits) < n + n / 4)
+        slotBits++;
+
+    int result = -2;
+    for (int attempt = 0; (attempt < 64) && (result == -2); attempt++)
+    {
+        // A different seed for the name hash, and, every so often, more room
+        v->fSeed = xmlvocab_mix((uint64_t)attempt + 1);
+        if ((attempt > 0) && ((attempt % 8) == 0))
+            slotBits++;
+
+        for (size_t i = 0; i < n; i++) {
+            const bspan *s = &v->fEntries[i].fName;
+            hashes[i] = xmlvocab_hash(bspan_begin(s), bspan_size(s), v->fSeed);
+        }
+
+        result = xmlvocab_try_build(v, hashes, slotBits, bucketCount);
+    }
+
+    free(hashes);
+
+    return result;
+}
+
+// xmlvocab_lookup()
+// The id of a name, or XMLVOCAB_UNKNOWN if it isn't in the vocabulary
+static uint32_t xmlvocab_lookup(const xmlvocab *v, const bspan *name) PC_NOEXCEPT_C
+{
+    if (v->fSlots == nullptr)
+        return XMLVOCAB_UNKNOWN;
+
+    const unsigned char *s = bspan_begin(name);
+    size_t n = bspan_size(name);
+    uint64_t h = xmlvocab_hash(s, n, v->fSeed);
+    uint32_t seed = v->fSeeds[xmlvocab_bucket(h, v->fBucketCount)];
+    uint32_t slot = v->fSlots[xmlvocab_slot(h, seed, v->fSlotShift)];
+    if (slot == 0)
+        return XMLVOCAB_UNKNOWN;
+
+    const xmlvocabentry *e = &v->fEntries[slot - 1];
+    if ((bspan_size(&e->fName) != n) || ((n > 0) && (memcmp(bspan_begin(&e->fName), s, n) != 0)))
+        return XMLVOCAB_UNKNOWN;
+
+    return e->fId;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // XMLVOCAB_H_INCLUDED
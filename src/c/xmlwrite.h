@@ -0,0 +1,468 @@
+#ifndef XMLWRITE_H_INCLUDED
+#define XMLWRITE_H_INCLUDED
+
+//
+// xmlwrite
+// Write xml into an obuff.
+//
+// The writer keeps no copy of anything, and allocates nothing.  Everything
+// goes straight into the obuff, which either grows to hold the whole
+// document, or hands it to a sink (a file, for instance) as it fills up.
+//
+// A start tag is left open after xmlwrite_start_tag(), so attributes can
+// be added to it.  Whatever is written next closes it.  If that is the
+// end tag, the element is written self closing, as '<name/>'.
+//
+// Text and attribute values are escaped.  The characters that need it are
+// found with an asciiset scan, which looks at 16 to 64 bytes at a time, and
+// everything between them is copied as is, so text with nothing to escape
+// is a single copy.
+//
+// Elements from the scanner can be written back out with xmlwrite_element().
+// Each one is written the way it was in the source, apart from whitespace
+// just before the closing '>' of a tag.  So a filter is a scanning loop
+// that writes out the elements it wants to keep.  DOCTYPEs are the
+// exception, the scanner doesn't keep enough of them to write them back.
+//
+// The writer does not check names, or that end tags match start tags.
+//
+// Typical usage:
+//   obuff out;
+//   obuff_init(&out, 0);
+//
+//   xmlwriter w;
+//   xmlwrite_init(&w, &out);
+//   xmlwrite_start_tag_cstr(&w, "svg");
+//   xmlwrite_attribute_cstr(&w, "width", "100");
+//   xmlwrite_start_tag_cstr(&w, "text");
+//   xmlwrite_text_cstr(&w, "1 < 2");
+//   xmlwrite_end_tag_cstr(&w, "text");
+//   xmlwrite_end_tag_cstr(&w, "svg");
+//
+//   // <svg width="100"><text>1 &lt; 2</text></svg>
+//   obuff_span(&out, &xml);
+//
+
+#include "pcoredef.h"
+#include "bspan.h"
+#include "asciiset.h"
+#include "obuff.h"
+#include "xmlcore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct xmlwriter_t {
+    obuff *fOut;
+    bool fTagOpen;      // a start tag is waiting for its '>'
+};
+typedef struct xmlwriter_t xmlwriter;
+
+static int xmlwrite_init(xmlwriter *w, obuff *out) PC_NOEXCEPT_C;
+static int xmlwrite_flush(xmlwriter *w) PC_NOEXCEPT_C;
+
+static int xmlwrite_declaration(xmlwriter *w) PC_NOEXCEPT_C;
+static int xmlwrite_start_tag(xmlwriter *w, const bspan *name) PC_NOEXCEPT_C;
+static int xmlwrite_start_tag_cstr(xmlwriter *w, const char *name) PC_NOEXCEPT_C;
+static int xmlwrite_attribute(xmlwriter *w, const bspan *name, const bspan *value) PC_NOEXCEPT_C;
+static int xmlwrite_attribute_cstr(xmlwriter *w, const char *name, const char *value) PC_NOEXCEPT_C;
+static int xmlwrite_end_tag(xmlwriter *w, const bspan *name) PC_NOEXCEPT_C;
+static int xmlwrite_end_tag_cstr(xmlwriter *w, const char *name) PC_NOEXCEPT_C;
+static int xmlwrite_text(xmlwriter *w, const bspan *text) PC_NOEXCEPT_C;
+static int xmlwrite_text_cstr(xmlwriter *w, const char *text) PC_NOEXCEPT_C;
+static int xmlwrite_cdata(xmlwriter *w, const bspan *data) PC_NOEXCEPT_C;
+static int xmlwrite_comment(xmlwriter *w, const bspan *comment) PC_NOEXCEPT_C;
+static int xmlwrite_comment_cstr(xmlwriter *w, const char *comment) PC_NOEXCEPT_C;
+static int xmlwrite_processing_instruction(xmlwriter *w, const bspan *target, const bspan *data) PC_NOEXCEPT_C;
+static int xmlwrite_raw(xmlwriter *w, const bspan *data) PC_NOEXCEPT_C;
+static int xmlwrite_element(xmlwriter *w, const xmlelement *elem) PC_NOEXCEPT_C;
+
+
+// Implementation
+
+// The characters escaped in text.  '>' is escaped so that
+// ']]>' never appears, and '\r' so it isn't turned into '\n'
+// when the document is read back.
+static asciiset * xmlwrite_text_specials() PC_NOEXCEPT_C
+{
+    static asciiset chars;
+    static bool initialized=false;
+
+    if (!initialized){
+        asciiset_init_from_cstr(&chars, "&<>\r");
+        initialized = true;
+    }
+
+    return &chars;
+}
+
+// The characters escaped in attribute values, which are written
+// in double quotes.  Whitespace other than ' ' is escaped, because
+// a reader turns it into ' ' otherwise.
+static asciiset * xmlwrite_attribute_specials() PC_NOEXCEPT_C
+{
+    static asciiset chars;
+    static bool initialized=false;
+
+    if (!initialized){
+        asciiset_init_from_cstr(&chars, "&<>\"\t\n\r");
+        initialized = true;
+    }
+
+    return &chars;
+}
+
+static const char * xmlwrite_entity(unsigned char c) PC_NOEXCEPT_C
+{
+    switch (c) {
+        case '&': return "&amp;";
+        case '<': return "&lt;";
+        case '>': return "&gt;";
+        case '"': return "&quot;";
+        case '\t': return "&#9;";
+        case '\n': return "&#10;";
+        case '\r': return "&#13;";
+    }
+
+    return "";
+}
+
+// xmlwrite_escaped()
+// Copy the runs of bytes that need nothing done, and
+// write a reference for each one that does
+static int xmlwrite_escaped(obuff *o, const asciiset *specials, const unsigned char *data, size_t n) PC_NOEXCEPT_C
+{
+    while (n > 0)
+    {
+        size_t run = asciiset_find_first_in(specials, data, n);
+        if (run > 0)
+            obuff_put_data(o, data, run);
+        if (run == n)
+            break;
+
+        obuff_put_cstr(o, xmlwrite_entity(data[run]));
+        data += run + 1;
+        n -= run + 1;
+    }
+
+    return obuff_has_error(o) ? -1 : 0;
+}
+
+// xmlwrite_close_tag()
+// Finish a start tag that is still open
+static void xmlwrite_close_tag(xmlwriter *w) PC_NOEXCEPT_C
+{
+    if (w->fTagOpen) {
+        obuff_put_byte(w->fOut, '>');
+        w->fTagOpen = false;
+    }
+}
+
+static int xmlwrite_result(const xmlwriter *w) PC_NOEXCEPT_C
+{
+    return obuff_has_error(w->fOut) ? -1 : 0;
+}
+
+static int xmlwrite_init(xmlwriter *w, obuff *out) PC_NOEXCEPT_C
+{
+    w->fOut = out;
+    w->fTagOpen = false;
+
+    return 0;
+}
+
+// xmlwrite_flush()
+// Close an open start tag, and flush the obuff to its sink
+static int xmlwrite_flush(xmlwriter *w) PC_NOEXCEPT_C
+{
+    xmlwrite_close_tag(w);
+
+    return obuff_flush(w->fOut);
+}
+
+static int xmlwrite_declaration(xmlwriter *w) PC_NOEXCEPT_C
+{
+    xmlwrite_close_tag(w);
+    obuff_put_cstr(w->fOut, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
+
+    return xmlwrite_result(w);
+}
+
+static int xmlwrite_start_tag(xmlwriter *w, const bspan *name) PC_NOEXCEPT_C
+{
+    xmlwrite_close_tag(w);
+    obuff_put_byte(w->fOut, '<');
+    obuff_put_span(w->fOut, name);
+    w->fTagOpen = true;
+
+    return xmlwrite_result(w);
+}
+
+static int xmlwrite_start_tag_cstr(xmlwriter *w, const char *name) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, name);
+
+    return xmlwrite_start_tag(w, &s);
+}
+
+// xmlwrite_attribute()
+// Add an attribute to the start tag that was just written
+// Return
+//    0 - success
+//   -1 - there is no open start tag, or the obuff failed
+static int xmlwrite_attribute(xmlwriter *w, const bspan *name, const bspan *value) PC_NOEXCEPT_C
+{
+    if (!w->fTagOpen)
+        return -1;
+
+    obuff_put_byte(w->fOut, ' ');
+    obuff_put_span(w->fOut, name);
+    obuff_put_data(w->fOut, "=\"", 2);
+    xmlwrite_escaped(w->fOut, xmlwrite_attribute_specials(), bspan_begin(value), bspan_size(value));
+    obuff_put_byte(w->fOut, '"');
+
+    return xmlwrite_result(w);
+}
+
+static int xmlwrite_attribute_cstr(xmlwriter *w, const char *name, const char *value) PC_NOEXCEPT_C
+{
+    bspan n;
+    bspan v;
+    bspan_init_from_cstr(&n, name);
+    bspan_init_from_cstr(&v, value);
+
+    return xmlwrite_attribute(w, &n, &v);
+}
+
+// xmlwrite_end_tag()
+// If the start tag is still open, the element has nothing
+// in it, and is written self closing instead.
+static int xmlwrite_end_tag(xmlwriter *w, const bspan *name) PC_NOEXCEPT_C
+{
+    if (w->fTagOpen) {
+        obuff_put_data(w->fOut, "/>", 2);
+        w->fTagOpen = false;
+    }
+    else {
+        obuff_put_data(w->fOut, "</", 2);
+        obuff_put_span(w->fOut, name);
+        obuff_put_byte(w->fOut, '>');
+    }
+
+    return xmlwrite_result(w);
+}
+
+static int xmlwrite_end_tag_cstr(xmlwriter *w, const char *name) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, name);
+
+    return xmlwrite_end_tag(w, &s);
+}
+
+// xmlwrite_text()
+// Escaped character data.  Writing empty text closes an open
+// start tag, so the element is not written self closing.
+static int xmlwrite_text(xmlwriter *w, const bspan *text) PC_NOEXCEPT_C
+{
+    xmlwrite_close_tag(w);
+    xmlwrite_escaped(w->fOut, xmlwrite_text_specials(), bspan_begin(text), bspan_size(text));
+
+    return xmlwrite_result(w);
+}
+
+static int xmlwrite_text_cstr(xmlwriter *w, const char *text) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, text);
+
+    return xmlwrite_text(w, &s);
+}
+
+// xmlwrite_cdata()
+// A CDATA section.  A ']]>' in the data would end the section,
+// so the section is ended between the ']]' and the '>', and
+// another one started.
+static int xmlwrite_cdata(xmlwriter *w, const bspan *data) PC_NOEXCEPT_C
+{
+    const unsigned char *p = bspan_begin(data);
+    const unsigned char *end = bspan_end(data);
+    const unsigned char *start = p;
+
+    xmlwrite_close_tag(w);
+    obuff_put_data(w->fOut, "<![CDATA[", 9);
+
+    while ((end - p) >= 3)
+    {
+        const unsigned char *gt = (const unsigned char *)memchr(p + 2, '>', (size_t)(end - p - 2));
+        if (gt == nullptr)
+            break;
+
+        if ((gt[-1] == ']') && (gt[-2] == ']')) {
+            obuff_put_data(w->fOut, start, (size_t)(gt - start));
+            obuff_put_data(w->fOut, "]]><![CDATA[", 12);
+            start = gt;
+        }
+        p = gt - 1;
+    }
+
+    obuff_put_data(w->fOut, start, (size_t)(end - start));
+    obuff_put_data(w->fOut, "]]>", 3);
+
+    return xmlwrite_result(w);
+}
+
+// xmlwrite_comment()
+// Return
+//    0 - success
+//   -1 - the comment has a '--' in it, or ends with '-',
+//        which xml does not allow, and nothing is written
+static int xmlwrite_comment(xmlwriter *w, const bspan *comment) PC_NOEXCEPT_C
+{
+    const unsigned char *p = bspan_begin(comment);
+    size_t n = bspan_size(comment);
+
+    if ((n > 0) && (p[n - 1] == '-'))
+        return -1;
+    for (size_t i = 0; i + 1 < n; i++)
+        if ((p[i] == '-') && (p[i + 1] == '-'))
+            return -1;
+
+    xmlwrite_close_tag(w);
+    obuff_put_data(w->fOut, "<!--", 4);
+    obuff_put_data(w->fOut, p, n);
+    obuff_put_data(w->fOut, "-->", 3);
+
+    return xmlwrite_result(w);
+}
+
+static int xmlwrite_comment_cstr(xmlwriter *w, const char *comment) PC_NOEXCEPT_C
+{
+    bspan s;
+    bspan_init_from_cstr(&s, comment);
+
+    return xmlwrite_comment(w, &s);
+}
+
+// xmlwrite_processing_instruction()
+// <?target data?>, the data is written as it is
+static int xmlwrite_processing_instruction(xmlwriter *w, const bspan *target, const bspan *data) PC_NOEXCEPT_C
+{
+    xmlwrite_close_tag(w);
+    obuff_put_data(w->fOut, "<?", 2);
+    obuff_put_span(w->fOut, target);
+    if (bspan_size(data) > 0) {
+        obuff_put_byte(w->fOut, ' ');
+        obuff_put_span(w->fOut, data);
+    }
+    obuff_put_data(w->fOut, "?>", 2);
+
+    return xmlwrite_result(w);
+}
+
+// xmlwrite_raw()
+// Bytes that are already xml, written as they are
+static int xmlwrite_raw(xmlwriter *w, const bspan *data) PC_NOEXCEPT_C
+{
+    xmlwrite_close_tag(w);
+    obuff_put_span(w->fOut, data);
+
+    return xmlwrite_result(w);
+}
+
+// xmlwrite_tag_body()
+// The name of a tag, and its attributes.  They are both
+// in the source, usually with the original whitespace
+// between them, so write it all at once.
+static void xmlwrite_tag_body(xmlwriter *w, const xmlelement *elem) PC_NOEXCEPT_C
+{
+    const bspan *name = &elem->fNameSpan;
+    const bspan *data = &elem->fData;
+
+    if (bspan_size(data) == 0) {
+        obuff_put_span(w->fOut, name);
+    }
+    else if ((bspan_size(name) > 0) && (bspan_begin(data) >= bspan_end(name))) {
+        obuff_put_data(w->fOut, bspan_begin(name), (size_t)(bspan_end(data) - bspan_begin(name)));
+    }
+    else {
+        obuff_put_span(w->fOut, name);
+        obuff_put_byte(w->fOut, ' ');
+        obuff_put_span(w->fOut, data);
+    }
+}
+
+// xmlwrite_element()
+// Write an element from the scanner back out.  Content is
+// written as it was in the source, references and all.
+// The scanner only keeps the internal subset of a DOCTYPE,
+// which is not enough to write it back, so it is refused.
+// Return
+//    0 - success
+//   -1 - the element is not valid, is a DOCTYPE, or the obuff failed
+static int xmlwrite_element(xmlwriter *w, const xmlelement *elem) PC_NOEXCEPT_C
+{
+    obuff *o = w->fOut;
+
+    xmlwrite_close_tag(w);
+
+    switch (elem->fElementKind)
+    {
+        case XML_ELEMENT_TYPE_START_TAG:
+        case XML_ELEMENT_TYPE_SELF_CLOSING:
+        case XML_ELEMENT_TYPE_EMPTY_TAG:
+            obuff_put_byte(o, '<');
+            xmlwrite_tag_body(w, elem);
+            obuff_put_byte(o, '>');
+        break;
+
+        case XML_ELEMENT_TYPE_END_TAG:
+            obuff_put_data(o, "</", 2);
+            xmlwrite_tag_body(w, elem);
+            obuff_put_byte(o, '>');
+        break;
+
+        case XML_ELEMENT_TYPE_CONTENT:
+            obuff_put_span(o, &elem->fData);
+        break;
+
+        // The data has the '?'s at either end
+        case XML_ELEMENT_TYPE_XMLDECL:
+        case XML_ELEMENT_TYPE_PROCESSING_INSTRUCTION:
+            obuff_put_byte(o, '<');
+            obuff_put_span(o, &elem->fData);
+            obuff_put_byte(o, '>');
+        break;
+
+        case XML_ELEMENT_TYPE_COMMENT:
+            obuff_put_data(o, "<!--", 4);
+            obuff_put_span(o, &elem->fData);
+            obuff_put_data(o, "-->", 3);
+        break;
+
+        case XML_ELEMENT_TYPE_CDATA:
+            obuff_put_data(o, "<![CDATA[", 9);
+            obuff_put_span(o, &elem->fData);
+            obuff_put_data(o, "]]>", 3);
+        break;
+
+        case XML_ELEMENT_TYPE_ENTITY:
+            obuff_put_data(o, "<!ENTITY", 8);
+            obuff_put_span(o, &elem->fData);
+            obuff_put_byte(o, '>');
+        break;
+
+        default:
+            return -1;
+    }
+
+    return xmlwrite_result(w);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // XMLWRITE_H_INCLUDED
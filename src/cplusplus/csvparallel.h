@@ -0,0 +1,258 @@
+#pragma once
+
+//
+// csvparallel
+// Indexing a single large CSV source with several threads.
+//
+// The source is cut into chunks, at least one per thread, and never more
+// than 1GB each, so the 32 bit offsets of a csvindex always fit.  The
+// trouble with cutting CSV at arbitrary places is quotes.  A worker can't
+// know whether its chunk starts inside of a quoted field without looking
+// at everything before it.  So each worker indexes its chunk both ways,
+// as if it starts outside of quotes and as if it starts inside.  Both
+// come out of one pass, since the inside-quotes mask for one is just the
+// inverse of the other (csvindex_build_part()).  The first chunk really
+// does start outside of quotes, so it is only indexed the one way.
+//
+// Once all the workers are done, the chunks are walked in order.  The
+// first chunk's end state says which of the second chunk's indexes is the
+// right one, that one's end state picks for the third, and so on.  The
+// wrong indexes are thrown away.
+//
+// The rows are then stitched into one numbering.  A row that crosses from
+// one chunk into the next (the "seam") is indexed again, on its own, from
+// where it really starts to its '\n'.  So is a last row that doesn't end
+// in a '\n'.  Everything else is used as the workers left it.
+//
+// Typical usage:
+//   pcore::CsvParallelIndex idx;
+//   pcore::csv_parallel_build(idx, &src, ',', 0);     // 0 == all cores
+//
+//   for (size_t row = 0; row < pcore::csv_parallel_row_count(idx); row++) {
+//       bspan value;
+//       pcore::csv_parallel_field(idx, row, 0, &value);
+//   }
+//
+
+#include <vector>
+#include <algorithm>
+
+#include "parallelrun.h"
+#include "csvscan.h"
+
+namespace pcore {
+
+	// Chunks smaller than this aren't worth a thread
+	static constexpr size_t CSV_PARALLEL_MIN_CHUNK = 256 * 1024;
+
+	// Chunks larger than this are cut again
+	static constexpr size_t CSV_PARALLEL_MAX_CHUNK = (size_t)1 << 30;
+
+	// A run of rows of one of the indexes, and where they are
+	// in the whole source
+	struct CsvRowRange
+	{
+		const csvindex *fIndex;
+		size_t fFirst;			// first row, in fIndex
+		size_t fCount;
+		size_t fRow;			// row number of fFirst, in the whole source
+	};
+
+	struct CsvParallelIndex
+	{
+		std::vector<csvindex> fParts;		// two per chunk, starting outside, and inside, of quotes
+		std::vector<csvindex> fSeams;		// rows that cross from one chunk into the next
+		std::vector<CsvRowRange> fRanges;
+		size_t fRowCount = 0;
+
+		CsvParallelIndex() = default;
+		CsvParallelIndex(const CsvParallelIndex &) = delete;
+		CsvParallelIndex &operator=(const CsvParallelIndex &) = delete;
+
+		~CsvParallelIndex() noexcept
+		{
+			clear();
+		}
+
+		void clear() noexcept
+		{
+			for (csvindex &part : fParts)
+				csvindex_destroy(&part);
+			for (csvindex &seam : fSeams)
+				csvindex_destroy(&seam);
+
+			fParts.clear();
+			fSeams.clear();
+			fRanges.clear();
+			fRowCount = 0;
+		}
+	};
+
+	// csv_parallel_seam()
+	// Index a single row, from 'begin' up to 'end', on its own
+	static int csv_parallel_seam(CsvParallelIndex &x, const unsigned char *begin, const unsigned char *end, unsigned char delim)
+	{
+		bspan row;
+		bspan_init_from_pointers(&row, begin, end);
+
+		x.fSeams.emplace_back();
+		csvindex *seam = &x.fSeams.back();
+		csvindex_init(seam);
+		if (csvindex_build(seam, &row, delim) != 0)
+			return -1;
+
+		x.fRanges.push_back(CsvRowRange{ seam, 0, csvindex_row_count(seam), x.fRowCount });
+		x.fRowCount += csvindex_row_count(seam);
+
+		return 0;
+	}
+
+	// csv_parallel_build()
+	// Index the rows and fields of the source, using 'nThreads' threads.
+	// The rows are the same as csvindex_build() would find.  The index
+	// refers to the source memory, which must stay put for as long as
+	// it is used.
+	// Return
+	//    0 - success
+	//   -1 - out of memory
+	static int csv_parallel_build(CsvParallelIndex &x, const bspan *src, unsigned char delim, size_t nThreads)
+	{
+		const unsigned char *base = bspan_begin(src);
+		size_t n = bspan_size(src);
+
+		x.clear();
+		nThreads = parallel_threads(nThreads, n, CSV_PARALLEL_MIN_CHUNK);
+
+		size_t nChunks = (n + CSV_PARALLEL_MAX_CHUNK - 1) / CSV_PARALLEL_MAX_CHUNK;
+		if (nChunks < nThreads)
+			nChunks = nThreads;
+		if (nThreads > nChunks)
+			nThreads = nChunks;
+
+		std::vector<size_t> starts(nChunks + 1);
+		for (size_t i = 0; i < nChunks; i++)
+			starts[i] = (n / nChunks) * i;
+		starts[nChunks] = n;
+
+		// The kernels are chosen before any of the workers need them
+		csvindex_get_kernels();
+
+		// Each worker takes every nThreads'th chunk
+		x.fParts.resize(nChunks * 2);
+		for (csvindex &part : x.fParts)
+			csvindex_init(&part);
+
+		std::vector<int> results(nChunks, 0);
+		parallel_run(nThreads, [&](size_t w) {
+			for (size_t i = w; i < nChunks; i += nThreads)
+			{
+				bspan chunk;
+				bspan_init_from_pointers(&chunk, base + starts[i], base + starts[i + 1]);
+				csvindex *alt = (i > 0) ? &x.fParts[(i * 2) + 1] : nullptr;
+				results[i] = csvindex_build_part(&x.fParts[i * 2], alt, &chunk, delim);
+			}
+		});
+
+		for (int result : results)
+			if (result != 0) {
+				x.clear();
+				return -1;
+			}
+
+		// Pick the right index of each chunk, and stitch the rows together.
+		// 'pending' is where the row that isn't finished yet started.
+		x.fSeams.reserve(nChunks + 1);
+		bool inQuote = false;
+		size_t pending = 0;
+		for (size_t i = 0; i < nChunks; i++)
+		{
+			csvindex *part = &x.fParts[(i * 2) + (inQuote ? 1 : 0)];
+			csvindex_destroy(&x.fParts[(i * 2) + (inQuote ? 0 : 1)]);
+			inQuote = part->fEndsInQuote;
+
+			size_t rows = csvindex_row_count(part);
+			if (rows == 0)
+				continue;
+
+			// The first row started in an earlier chunk
+			size_t first = 0;
+			if (pending < starts[i]) {
+				size_t newline = starts[i] + part->fFieldEnds[part->fRowEnds[0] - 1];
+				if (csv_parallel_seam(x, base + pending, base + newline + 1, delim) != 0) {
+					x.clear();
+					return -1;
+				}
+				first = 1;
+			}
+
+			if (rows > first) {
+				x.fRanges.push_back(CsvRowRange{ part, first, rows - first, x.fRowCount });
+				x.fRowCount += rows - first;
+			}
+			pending = starts[i] + part->fFieldEnds[part->fRowEnds[rows - 1] - 1] + 1;
+		}
+
+		// A last row without a '\n' at the end of it
+		if (pending < n) {
+			if (csv_parallel_seam(x, base + pending, base + n, delim) != 0) {
+				x.clear();
+				return -1;
+			}
+		}
+
+		return 0;
+	}
+
+	static size_t csv_parallel_row_count(const CsvParallelIndex &x) noexcept
+	{
+		return x.fRowCount;
+	}
+
+	// csv_parallel_locate()
+	// The index a row is in, and its row number in that index
+	static const csvindex * csv_parallel_locate(const CsvParallelIndex &x, size_t row, size_t *local) noexcept
+	{
+		if (row >= x.fRowCount)
+			return nullptr;
+
+		auto it = std::upper_bound(x.fRanges.begin(), x.fRanges.end(), row,
+			[](size_t r, const CsvRowRange &range) { return r < range.fRow; });
+		--it;
+		*local = it->fFirst + (row - it->fRow);
+
+		return it->fIndex;
+	}
+
+	// csv_parallel_field_count()
+	// The number of fields in a row
+	static size_t csv_parallel_field_count(const CsvParallelIndex &x, size_t row) noexcept
+	{
+		size_t local = 0;
+		const csvindex *idx = csv_parallel_locate(x, row, &local);
+
+		return (idx != nullptr) ? csvindex_field_count(idx, local) : 0;
+	}
+
+	// csv_parallel_field()
+	// A field of a row, as csvindex_field() gives it
+	// Return
+	//    0 - success
+	//   -1 - there is no such row, or field
+	static int csv_parallel_field(const CsvParallelIndex &x, size_t row, size_t col, bspan *value) noexcept
+	{
+		size_t local = 0;
+		const csvindex *idx = csv_parallel_locate(x, row, &local);
+
+		return (idx != nullptr) ? csvindex_field(idx, local, col, value) : -1;
+	}
+
+	// csv_parallel_row()
+	// The whole of a row, without its line ending
+	static int csv_parallel_row(const CsvParallelIndex &x, size_t row, bspan *line) noexcept
+	{
+		size_t local = 0;
+		const csvindex *idx = csv_parallel_locate(x, row, &local);
+
+		return (idx != nullptr) ? csvindex_row(idx, local, line) : -1;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+//
+// parallelrun
+// The little bit of threading the parallel scanners share.
+// Work is split into a handful of pieces, one per thread, and
+// each piece is run on a thread of its own.
+//
+
+#include <thread>
+#include <vector>
+#include <functional>
+
+namespace pcore {
+
+	// parallel_threads()
+	// How many threads to use on a source of the given size, where a
+	// piece smaller than 'minChunk' isn't worth a thread.
+	// 0 asks for as many as there are cores
+	static size_t parallel_threads(size_t requested, size_t size, size_t minChunk) noexcept
+	{
+		if (requested == 0)
+			requested = std::thread::hardware_concurrency();
+
+		size_t most = (size / minChunk) + 1;
+
+		return (requested == 0) ? 1 : ((requested < most) ? requested : most);
+	}
+
+	// parallel_run()
+	// Run work(0) .. work(n-1), each on its own thread, with work(0)
+	// on the calling thread.  If a thread can't be started, its work is
+	// done on the calling thread instead.
+	static void parallel_run(size_t n, const std::function<void(size_t)> &work)
+	{
+		std::vector<std::thread> threads;
+		std::vector<size_t> leftover;
+
+		for (size_t i = 1; i < n; i++) {
+			try {
+				threads.emplace_back(work, i);
+			} catch (...) {
+				leftover.push_back(i);
+			}
+		}
+
+		work(0);
+		for (size_t i : leftover)
+			work(i);
+		for (std::thread &t : threads)
+			t.join();
+	}
+}
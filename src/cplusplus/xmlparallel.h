@@ -0,0 +1,321 @@
+#pragma once
+
+//
+// xmlparallel
+// Scanning a single large xml document with several threads.
+//
+// The document is cut into one chunk per thread.  Each worker scans
+// its own chunk, and the results are stitched back together, in order,
+// so they are exactly what a single threaded scan would have produced.
+//
+// Building the index (xmlindex.h) is easy, because the index is just the
+// positions of every '<' and '>', no matter what they are inside of.  Each
+// worker indexes its chunk, and the pieces are copied end to end.
+//
+// Scanning elements is harder, because a worker can't know what its chunk
+// starts in the middle of.  It might be a comment, CDATA, or a quoted
+// attribute value.  So, each worker makes a guess.  It starts just past the
+// first '>' of its chunk, as if a tag had just ended there, and scans until
+// it is past the start of the next chunk.  Along the way, it remembers the
+// state of the iterator after every element.
+//
+// The iterator has no memory beyond its state and its position, so once
+// two scans are in the same state at the same place, everything after is
+// the same.  The fix-up pass walks the chunks in order, carrying the state
+// where the previous chunk really ended.  When that state is one the next
+// worker recorded, the worker's guess was good (or came good), and its
+// elements from there on are used as they are.  When it isn't, the chunk is
+// scanned again from the real state, which only happens when a comment,
+// CDATA, or such, runs right across the boundary.
+//
+// Typical usage:
+//   std::vector<xmlelement> elems;
+//   pcore::xml_parallel_scan(&params, &xmlsrc, elems, 0);   // 0 == all cores
+//
+//   xmlindex idx;
+//   xmlindex_init(&idx);
+//   pcore::xml_parallel_build_index(&idx, &xmlsrc, 0);
+//
+
+#include <vector>
+
+#include "parallelrun.h"
+#include "xmlscan.h"
+#include "xmlindex.h"
+
+namespace pcore {
+
+	// Chunks smaller than this aren't worth a thread
+	static constexpr size_t XML_PARALLEL_MIN_CHUNK = 64 * 1024;
+
+	// Where an iterator is, after returning an element
+	struct XmlScanPoint
+	{
+		int fState;
+		const unsigned char *fSource;
+		const unsigned char *fMark;
+
+		bool operator==(const XmlScanPoint &other) const noexcept
+		{
+			return (fState == other.fState) && (fSource == other.fSource) && (fMark == other.fMark);
+		}
+	};
+
+	// What one worker found in its chunk
+	struct XmlScanChunk
+	{
+		const unsigned char *fLimit = nullptr;		// stop once past here
+		std::vector<xmlelement> fElements;
+		std::vector<XmlScanPoint> fPoints;			// fPoints[i] is the state before fElements[i]
+	};
+
+	static XmlScanPoint xml_parallel_point(const xmliteratorstate &st) noexcept
+	{
+		return XmlScanPoint{ st.fState, bspan_begin(&st.fSource), bspan_begin(&st.fMark) };
+	}
+
+	// xml_parallel_threads()
+	// How many threads to use on a document of the given size
+	// 0 asks for as many as there are cores
+	static size_t xml_parallel_threads(size_t requested, size_t size) noexcept
+	{
+		return parallel_threads(requested, size, XML_PARALLEL_MIN_CHUNK);
+	}
+
+	// xml_parallel_warmup()
+	// The scanner's character sets and search tables are made the first time
+	// they're used, which is not safe to do from several threads at once.
+	// Scanning one of everything on this thread gets them all made.
+	static void xml_parallel_warmup(const xmliterparams *params) noexcept
+	{
+		static const char doc[] =
+			"<?xml version='1.0'?><!DOCTYPE a [ <!ELEMENT a (b)> ]><!ENTITY e 'x'>"
+			"<a:b c='d'><!-- c --><![CDATA[ x ]]><?pi x?>text<br/></a:b>";
+
+		bspan src;
+		bspan_init_from_data(&src, doc, sizeof(doc) - 1);
+
+		xmliteratorstate st;
+		xmlelement elem;
+		xml_iter_state_init_from_source(&st, &src);
+		while (xml_iter_next_element(params, &st, &elem) == 0)
+		{
+			xmlattriter iter;
+			xmlattr attr;
+			xml_attr_iter_init(&iter, &elem);
+			while (xml_attr_iter_next(&iter, &attr) == 0)
+				;
+		}
+		xmlindex_get_kernel();
+	}
+
+	// xml_parallel_build_index()
+	// Build the same index as xmlindex_build(), using 'nThreads' threads
+	// Return
+	//    0 - success
+	//   -1 - the source is too large, or out of memory, and the index is empty
+	static int xml_parallel_build_index(xmlindex *x, const bspan *src, size_t nThreads)
+	{
+		const unsigned char *base = bspan_begin(src);
+		size_t n = bspan_size(src);
+
+		nThreads = xml_parallel_threads(nThreads, n);
+		if (nThreads <= 1)
+			return xmlindex_build(x, src);
+
+		if (n > XMLINDEX_MAX_SIZE)
+			return xmlindex_fail(x);
+
+		xmlindex_get_kernel();
+
+		// Index each chunk on its own, relative to the start of the chunk
+		size_t chunkSize = n / nThreads;
+		std::vector<xmlindex> parts(nThreads);
+		std::vector<int> results(nThreads, 0);
+		parallel_run(nThreads, [&](size_t i) {
+			size_t begin = i * chunkSize;
+			size_t end = (i == nThreads - 1) ? n : begin + chunkSize;
+
+			bspan chunk;
+			bspan_init_from_data(&chunk, base + begin, end - begin);
+			xmlindex_init(&parts[i]);
+			results[i] = xmlindex_build(&parts[i], &chunk);
+		});
+
+		// Where each chunk's positions go in the whole index
+		int err = 0;
+		std::vector<size_t> starts(nThreads);
+		size_t total = 0;
+		for (size_t i = 0; i < nThreads; i++) {
+			starts[i] = total;
+			total += xmlindex_count(&parts[i]);
+			err |= results[i];
+		}
+
+		// Only attached to the source once it is all indexed
+		x->fBase = nullptr;
+		x->fLength = 0;
+		x->fCount = 0;
+		if ((err == 0) && (xmlindex_reserve(x, total) == 0)) {
+			parallel_run(nThreads, [&](size_t i) {
+				uint32_t offset = (uint32_t)(i * chunkSize);
+				const uint32_t *from = parts[i].fPositions;
+				uint32_t *to = x->fPositions + starts[i];
+				for (size_t j = 0; j < xmlindex_count(&parts[i]); j++)
+					to[j] = from[j] + offset;
+			});
+			x->fBase = base;
+			x->fLength = n;
+			x->fCount = total;
+		} else {
+			err = xmlindex_fail(x);
+		}
+
+		for (xmlindex &part : parts)
+			xmlindex_destroy(&part);
+
+		return err;
+	}
+
+	// xml_parallel_scan_chunk()
+	// Scan from wherever 'st' is, until the scan is past 'limit', or the
+	// source is used up.  What's seen is added to the chunk.
+	static void xml_parallel_scan_chunk(const xmliterparams *params, xmliteratorstate *st, const unsigned char *limit, XmlScanChunk *chunk)
+	{
+		xmlelement elem;
+		XmlScanPoint point = xml_parallel_point(*st);
+		while (point.fSource < limit)
+		{
+			if (xml_iter_next_element(params, st, &elem) != 0)
+				break;
+
+			chunk->fPoints.push_back(point);
+			chunk->fElements.push_back(elem);
+			point = xml_parallel_point(*st);
+		}
+		chunk->fPoints.push_back(xml_parallel_point(*st));
+	}
+
+	// xml_parallel_scan()
+	// Scan all the elements of the source, using 'nThreads' threads.  The
+	// elements are appended to 'elements', in document order, and are
+	// exactly the ones xml_iter_next_element() would return.
+	// Return
+	//    0 - success
+	static int xml_parallel_scan(const xmliterparams *params, const bspan *src, std::vector<xmlelement> &elements, size_t nThreads)
+	{
+		const unsigned char *begin = bspan_begin(src);
+		const unsigned char *end = bspan_end(src);
+		size_t n = bspan_size(src);
+
+		xml_parallel_warmup(params);
+
+		// Each chunk after the first starts, by guess, just past a '>'
+		nThreads = xml_parallel_threads(nThreads, n);
+		std::vector<XmlScanChunk> chunks(1);
+		std::vector<const unsigned char *> starts(1, begin);
+		for (size_t i = 1; i < nThreads; i++)
+		{
+			const unsigned char *from = begin + (n / nThreads) * i;
+			if (from <= starts.back())
+				continue;
+
+			const unsigned char *close = (const unsigned char *)memchr(from, '>', (size_t)(end - from));
+			if ((close == nullptr) || (close + 1 >= end))
+				break;
+
+			starts.push_back(close + 1);
+			chunks.emplace_back();
+		}
+		for (size_t i = 0; i < chunks.size(); i++)
+			chunks[i].fLimit = (i + 1 < chunks.size()) ? starts[i + 1] : end;
+
+		parallel_run(chunks.size(), [&](size_t i) {
+			bspan rest;
+			bspan_init_from_pointers(&rest, starts[i], end);
+
+			xmliteratorstate st;
+			xml_iter_state_init_from_source(&st, &rest);
+			xml_parallel_scan_chunk(params, &st, chunks[i].fLimit, &chunks[i]);
+		});
+
+		// The fix-up.  The first chunk started in the right place, so all of
+		// it is good.  For the rest, find where the real scan joins the guess.
+		std::vector<std::pair<size_t, size_t>> used(chunks.size());
+		std::vector<XmlScanChunk> rescans(chunks.size());
+		XmlScanPoint real = chunks[0].fPoints.back();
+		used[0] = { 0, chunks[0].fElements.size() };
+
+		xmliteratorstate st;
+		xml_iter_state_init(&st);
+		for (size_t i = 1; i < chunks.size(); i++)
+		{
+			XmlScanChunk &chunk = chunks[i];
+			const std::vector<XmlScanPoint> &points = chunk.fPoints;
+
+			// Scan for real, one element at a time, until landing on a
+			// point the worker also went through
+			st.fState = real.fState;
+			bspan_init_from_pointers(&st.fSource, real.fSource, end);
+			bspan_init_from_pointers(&st.fMark, real.fMark, end);
+
+			size_t p = 0;
+			bool joined = false;
+			XmlScanChunk &rescan = rescans[i];
+			while (true)
+			{
+				while ((p < points.size()) && (points[p].fSource < real.fSource))
+					p++;
+				while ((p < points.size()) && (points[p].fSource == real.fSource) && !(points[p] == real))
+					p++;
+				if ((p < points.size()) && (points[p] == real)) {
+					joined = true;
+					break;
+				}
+
+				// Past everything this worker did, so it was all wasted
+				if ((real.fSource >= chunk.fLimit) || (p == points.size()))
+					break;
+
+				xmlelement elem;
+				if (xml_iter_next_element(params, &st, &elem) != 0) {
+					real = xml_parallel_point(st);
+					break;
+				}
+				rescan.fElements.push_back(elem);
+				real = xml_parallel_point(st);
+			}
+
+			if (joined) {
+				used[i] = { p, chunk.fElements.size() };
+				real = points.back();
+			} else {
+				// Finish the chunk from the real state
+				if (real.fSource < chunk.fLimit)
+					xml_parallel_scan_chunk(params, &st, chunk.fLimit, &rescan);
+				if (!rescan.fPoints.empty())
+					real = rescan.fPoints.back();
+				used[i] = { 0, 0 };
+			}
+		}
+
+		// Copy all the good pieces out, in order
+		size_t total = elements.size();
+		std::vector<size_t> at(chunks.size());
+		for (size_t i = 0; i < chunks.size(); i++) {
+			at[i] = total;
+			total += rescans[i].fElements.size() + (used[i].second - used[i].first);
+		}
+
+		elements.resize(total);
+		parallel_run(chunks.size(), [&](size_t i) {
+			xmlelement *out = elements.data() + at[i];
+			for (const xmlelement &e : rescans[i].fElements)
+				*out++ = e;
+			for (size_t j = used[i].first; j < used[i].second; j++)
+				*out++ = chunks[i].fElements[j];
+		});
+
+		return 0;
+	}
+}
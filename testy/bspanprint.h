@@ -6,13 +6,8 @@
 
 static void writeSpan(const bspan &bs)
 {
-    bspan s = bs;
-
-    while (bspan_size(&s)>0)
-    {
-			printf("%c", *(bspan_data(&s)));
-            bspan_advance(&s,1);
-    }
+    if (bspan_size(&bs) > 0)
+        fwrite(bspan_data(&bs), 1, bspan_size(&bs), stdout);
 }
 
 static void printSpan(const bspan &bs)
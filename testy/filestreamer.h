@@ -10,28 +10,34 @@ namespace pcore {
 // It will retain the file handle until the object is destroyed
 struct FileStreamer
 {
-	std::shared_ptr<waavs::MappedFile> fFile;
-	waavs::BStream fStream;
+	std::shared_ptr<MappedFile> fFile;
+	BStream fStream;
 
-	FileStreamer(std::shared_ptr<waavs::MappedFile> afile)
+	FileStreamer(std::shared_ptr<MappedFile> afile)
 		: fFile(afile)
 	{
 		// create fStream from afile
-		fStream = waavs::BStream(fFile->data(), fFile->size());
+		fStream = BStream(fFile->data(), fFile->size());
 	}
 
-	const waavs::ByteSpan & span() const
+	const ByteSpan & span() const
 	{
 		return fStream.span();
 	}
 	
-	waavs::BStream& stream() { return fStream; }
+	BStream& stream() { return fStream; }
 
 	bool close() { return fFile->close(); }
 	
+	// The stream reads straight from the mapped pages, so the 
+	// file is mapped with a hint that it will be read front to back
 	static std::shared_ptr<FileStreamer> createFromFilename(const std::string& filename)
 	{
-		auto afile = waavs::MappedFile::create_shared(filename);
+#if defined(_WIN32)
+		auto afile = MappedFile::create_shared(filename);
+#else
+		auto afile = MappedFile::create_shared(filename, MAPPED_READONLY, MAPPED_HINT_SEQUENTIAL | MAPPED_HINT_WILLNEED);
+#endif
 		if (!afile)
 		{
 			printf("Failed to open file %s\n", filename.c_str());
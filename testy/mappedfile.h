@@ -10,18 +10,49 @@
 	local m = MappedFile::create_shared(filename)
 
 	local bs = binstream(m:getPointer(), #m)
-*/
-#include <SDKDDKVer.h>
 
-#define WIN32_LEAN_AND_MEAN
-#define NOMINMAX
-#include <windows.h>
+	On Linux (and other POSIX systems), the mapping can be given
+	hints about how it will be accessed, and opened for writing:
+
+	auto m = MappedFile::create_shared(filename, MAPPED_READONLY, 
+		MAPPED_HINT_SEQUENTIAL | MAPPED_HINT_POPULATE);
+	bspan s = m->span();
 
+	The span points straight at the page cache, so nothing is copied.
+	It is only valid for as long as the MappedFile is open.
+*/
 #include <cstdio>
 #include <string>
 #include <cstdint>
 #include <memory>
 
+#include "bspan.h"
+
+namespace pcore
+{
+	// Access hints, which are handed to madvise()
+	// They can be or'd together
+	enum MAPPED_HINT {
+		MAPPED_HINT_NONE = 0x00
+		, MAPPED_HINT_SEQUENTIAL = 0x01		// will be read front to back, read ahead aggressively
+		, MAPPED_HINT_RANDOM = 0x02			// no read ahead
+		, MAPPED_HINT_WILLNEED = 0x04		// start reading the whole thing in now
+		, MAPPED_HINT_HUGEPAGE = 0x08		// use huge pages, where the system allows
+		, MAPPED_HINT_POPULATE = 0x10		// fault all the pages in while mapping (MAP_POPULATE)
+	};
+
+	enum MAPPED_ACCESS {
+		MAPPED_READONLY = 0
+		, MAPPED_READWRITE = 1
+	};
+}
+
+#if defined(_WIN32)
+#include <SDKDDKVer.h>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
 
 namespace pcore
 {
@@ -59,6 +90,13 @@ namespace pcore
         void* data() { return fData; }
         size_t size() { return fSize; }
 
+        bspan span() const
+        {
+            bspan s;
+            bspan_init_from_data(&s, fData, fSize);
+            return s;
+        }
+
         bool close()
         {
             if (fData != nullptr) {
@@ -147,4 +185,170 @@ namespace pcore
             return std::make_shared<MappedFile>(filehandle, maphandle, data, size);
         }
     };
-}
\ No newline at end of file
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pcore
+{
+    struct MappedFile
+    {
+        void* fData{};
+        size_t fSize{};
+        bool fIsValid{};
+        bool fIsWritable{};
+
+        int fFileHandle{ -1 };
+
+    public:
+        MappedFile(int filehandle, void* data, size_t length, bool writable)
+            :fData(data)
+            , fSize(length)
+            , fIsWritable(writable)
+            , fFileHandle(filehandle)
+        {
+            fIsValid = true;
+        }
+
+        MappedFile() = default;
+
+        // The mapping is owned, so it can not be copied
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        virtual ~MappedFile() { close(); }
+
+        bool isValid() { return fIsValid; }
+        bool isWritable() { return fIsWritable; }
+        void* data() { return fData; }
+        size_t size() { return fSize; }
+
+        // The whole of the file as a span
+        bspan span() const
+        {
+            bspan s;
+            bspan_init_from_data(&s, fData, fSize);
+            return s;
+        }
+
+        // advise()
+        // Change the access hints after the file has been mapped.
+        // For example, MAPPED_HINT_RANDOM once a sequential scan
+        // has built an index.
+        bool advise(uint32_t hints)
+        {
+            if ((fData == nullptr) || (fSize == 0))
+                return false;
+
+            bool success = true;
+
+            if (hints & MAPPED_HINT_SEQUENTIAL)
+                success = (::madvise(fData, fSize, MADV_SEQUENTIAL) == 0) && success;
+            if (hints & MAPPED_HINT_RANDOM)
+                success = (::madvise(fData, fSize, MADV_RANDOM) == 0) && success;
+            if (hints & MAPPED_HINT_WILLNEED)
+                success = (::madvise(fData, fSize, MADV_WILLNEED) == 0) && success;
+#if defined(MADV_HUGEPAGE)
+            // Only a hint, not all systems (or file systems) support it
+            if (hints & MAPPED_HINT_HUGEPAGE)
+                ::madvise(fData, fSize, MADV_HUGEPAGE);
+#endif
+
+            return success;
+        }
+
+        // flush()
+        // Write any changes back to the file, for a writable mapping
+        bool flush()
+        {
+            if (!fIsWritable || (fData == nullptr))
+                return false;
+
+            return ::msync(fData, fSize, MS_SYNC) == 0;
+        }
+
+        bool close()
+        {
+            if (fData != nullptr) {
+                ::munmap(fData, fSize);
+                fData = nullptr;
+            }
+
+            if (fFileHandle >= 0) {
+                ::close(fFileHandle);
+                fFileHandle = -1;
+            }
+
+            fSize = 0;
+            fIsValid = false;
+
+            return true;
+        }
+
+
+        // factory method
+        // access - MAPPED_READONLY, MAPPED_READWRITE
+        // hints - a combination of MAPPED_HINT_xxx
+        // newSize - for MAPPED_READWRITE only.  If not zero, the file is created
+        //   if it does not exist, and made exactly this size.
+        static std::shared_ptr<MappedFile> create_shared(const std::string& filename,
+            int access = MAPPED_READONLY,
+            uint32_t hints = MAPPED_HINT_SEQUENTIAL,
+            size_t newSize = 0)
+        {
+            const char* fname = filename.c_str();
+            bool writable = (access == MAPPED_READWRITE);
+
+            int oflags = writable ? O_RDWR : O_RDONLY;
+            if (writable && newSize > 0)
+                oflags |= O_CREAT;
+
+            int filehandle = ::open(fname, oflags | O_CLOEXEC, 0644);
+            if (filehandle < 0) {
+                printf("Could not create/open file for mmap: %s\n", fname);
+                return {};
+            }
+
+            if (writable && newSize > 0) {
+                if (::ftruncate(filehandle, (off_t)newSize) != 0) {
+                    ::close(filehandle);
+                    return {};
+                }
+            }
+
+            struct stat st;
+            if (::fstat(filehandle, &st) != 0) {
+                ::close(filehandle);
+                return {};
+            }
+            size_t size = (size_t)st.st_size;
+
+            // An empty file can not be mapped, but it is still
+            // a perfectly good (empty) file
+            if (size == 0)
+                return std::make_shared<MappedFile>(filehandle, nullptr, 0, writable);
+
+            int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+            int mflags = MAP_SHARED;
+#if defined(MAP_POPULATE)
+            if (hints & MAPPED_HINT_POPULATE)
+                mflags |= MAP_POPULATE;
+#endif
+
+            void* data = ::mmap(nullptr, size, prot, mflags, filehandle, 0);
+            if (data == MAP_FAILED) {
+                ::close(filehandle);
+                return {};
+            }
+
+            auto mfile = std::make_shared<MappedFile>(filehandle, data, size, writable);
+            mfile->advise(hints);
+
+            return mfile;
+        }
+    };
+}
+#endif
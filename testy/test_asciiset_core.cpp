@@ -1,5 +1,6 @@
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include "asciiset.h"
 
@@ -24,7 +25,78 @@ void test_asciiset()
     printAsciiSet(aset);
 }
 
+// Check a pair of scanning kernels against the byte at a time 
+// versions, for every byte value, at every position
+static int check_kernels(const char *name, asciiset_scan_fn findIn, asciiset_scan_fn findNotIn)
+{
+    static unsigned char buf[300];
+    int failures = 0;
+
+    srand(1234);
+    for (int trial = 0; trial < 64; trial++)
+    {
+        // A random set, including characters above 0x7f
+        asciiset aset;
+        asciiset_reset(&aset);
+        for (int i = 0; i < trial * 4; i++)
+            asciiset_add_char(&aset, (unsigned char)(rand() & 0xff));
+
+        for (size_t i = 0; i < sizeof(buf); i++)
+            buf[i] = (unsigned char)(rand() & 0xff);
+
+        for (size_t n = 0; n < sizeof(buf); n += 7)
+        {
+            if (findIn(&aset, buf, n) != asciiset_kern_find_in_scalar(&aset, buf, n))
+                failures++;
+            if (findNotIn(&aset, buf, n) != asciiset_kern_find_not_in_scalar(&aset, buf, n))
+                failures++;
+        }
+    }
+
+    // Every byte value, found at every position of a run
+    for (int c = 0; c < 256; c++)
+    {
+        asciiset aset;
+        asciiset_init_from_char(&aset, (unsigned char)c);
+        unsigned char other = (unsigned char)(c + 1);
+
+        for (size_t pos = 0; pos < 130; pos++)
+        {
+            memset(buf, other, 130);
+            buf[pos] = (unsigned char)c;
+            if (findIn(&aset, buf, 130) != pos)
+                failures++;
+
+            memset(buf, c, 130);
+            buf[pos] = other;
+            if (findNotIn(&aset, buf, 130) != pos)
+                failures++;
+        }
+    }
+
+    printf("%-8s: %s\n", name, failures == 0 ? "PASS" : "FAIL");
+    return failures;
+}
+
+void test_kernels()
+{
+    printf("==== test_kernels ====\n");
+    check_kernels("scalar", asciiset_kern_find_in_scalar, asciiset_kern_find_not_in_scalar);
+
+#if defined(PC_ARCH_X86)
+    if (pc_cpu_has(PC_CPU_SSSE3))
+        check_kernels("ssse3", asciiset_kern_find_in_ssse3, asciiset_kern_find_not_in_ssse3);
+    if (pc_cpu_has(PC_CPU_AVX2))
+        check_kernels("avx2", asciiset_kern_find_in_avx2, asciiset_kern_find_not_in_avx2);
+    if (pc_cpu_has(PC_CPU_AVX512BW))
+        check_kernels("avx512", asciiset_kern_find_in_avx512, asciiset_kern_find_not_in_avx512);
+#endif
+
+    check_kernels("default", asciiset_find_first_in, asciiset_find_first_not_in);
+}
+
 int main(int argc, char* argv[])
 {
     test_asciiset();
+    test_kernels();
 }
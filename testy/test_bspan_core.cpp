@@ -76,9 +76,100 @@ void test_subspan()
     printSpan(span2);
 }
 
+// Run each of the kernels the processor supports against
+// the portable version, across sizes and alignments, making sure
+// they all agree.
+static int check_kernels(const char *name, const bspan_kernels &k)
+{
+    static unsigned char bufA[4096 + 64];
+    static unsigned char bufB[4096 + 64];
+    static unsigned char bufC[4096 + 64];
+    int failures = 0;
+
+    for (size_t n = 0; n < 1024; n = (n < 140) ? n + 1 : n * 2 + 3)
+    {
+        for (size_t off = 0; off < 3; off++)
+        {
+            for (size_t i = 0; i < sizeof(bufA); i++)
+                bufA[i] = bufB[i] = (unsigned char)(((i * 7) % 200) + 20);
+
+            const unsigned char *a = bufA + off;
+            unsigned char *b = bufB + off;
+
+            // equal
+            if (k.fCompare(a, b, n) != 0)
+                failures++;
+
+            // differ at the last byte, and at the first byte
+            if (n > 0) {
+                b[n - 1] = (unsigned char)(a[n - 1] + 1);
+                if (k.fCompare(a, b, n) != -1)
+                    failures++;
+                b[0] = (unsigned char)(a[0] - 1);
+                if (k.fCompare(a, b, n) != 1)
+                    failures++;
+            }
+
+            // copy and set should touch exactly 'n' bytes
+            memset(bufC, 0xAA, sizeof(bufC));
+            k.fCopy(bufC + 1 + off, bufA, n);
+            if ((memcmp(bufC + 1 + off, bufA, n) != 0) || (bufC[off] != 0xAA) || (bufC[1 + off + n] != 0xAA))
+                failures++;
+
+            memset(bufC, 0xAA, sizeof(bufC));
+            k.fSet(bufC + 1 + off, 0x55, n);
+            for (size_t i = 0; i < n; i++)
+                if (bufC[1 + off + i] != 0x55) { failures++; break; }
+            if ((bufC[off] != 0xAA) || (bufC[1 + off + n] != 0xAA))
+                failures++;
+        }
+    }
+
+    printf("%-8s: %s\n", name, failures == 0 ? "PASS" : "FAIL");
+
+    return failures;
+}
+
+void test_kernels()
+{
+    printf("== test_kernels ==\n");
+
+    bspan_kernels scalar = { bspan_kern_compare_scalar, bspan_kern_copy_scalar, bspan_kern_set_scalar };
+    check_kernels("scalar", scalar);
+
+#if defined(PC_ARCH_X86)
+    if (pc_cpu_has(PC_CPU_SSE2)) {
+        bspan_kernels k = { bspan_kern_compare_sse2, bspan_kern_copy_sse2, bspan_kern_set_sse2 };
+        check_kernels("sse2", k);
+    }
+    if (pc_cpu_has(PC_CPU_AVX2)) {
+        bspan_kernels k = { bspan_kern_compare_avx2, bspan_kern_copy_avx2, bspan_kern_set_avx2 };
+        check_kernels("avx2", k);
+    }
+    if (pc_cpu_has(PC_CPU_AVX512BW)) {
+        bspan_kernels k = { bspan_kern_compare_avx512, bspan_kern_copy_avx512, bspan_kern_set_avx512 };
+        check_kernels("avx512", k);
+    }
+#endif
+
+    // Large enough to go through the streaming stores
+    size_t bigSize = BSPAN_STREAM_THRESHOLD * 2 + 17;
+    unsigned char *big1 = new unsigned char[bigSize];
+    unsigned char *big2 = new unsigned char[bigSize];
+    bspan s1, s2;
+    bspan_init_from_data(&s1, big1, bigSize);
+    bspan_init_from_data(&s2, big2 + 1, bigSize - 1);
+    bspan_set_all(&s1, 'x');
+    bspan_copy_from_span(&s2, &s1);
+    printf("big copy: %s\n", (bspan_compare_span(&s1, &s2) == 1) ? "PASS" : "FAIL");
+    delete[] big1;
+    delete[] big2;
+}
+
 int main(int argc, char* argv[])
 {
     test_subspan();
-//    test_compare();
+    test_compare();
     test_advance();
+    test_kernels();
 }
@@ -1,5 +1,7 @@
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cerrno>
 
 #include "convspan.h"
 
@@ -28,8 +30,84 @@ void test_conv_double()
     printf("num1 = %f\n", num1);
 }
 
+// Check the integer parsers against strtoull/strtoll
+// including all the edges of the ranges
+static int check_int(const char *str)
+{
+    int failures = 0;
+    bspan s;
+    bspan rest;
+    bspan_init_from_cstr(&s, str);
+
+    // unsigned, which doesn't take a sign
+    if ((str[0] != '-') && (str[0] != '+'))
+    {
+        char *endp = nullptr;
+        errno = 0;
+        unsigned long long expected = strtoull(str, &endp, 10);
+        bool valid = (endp != str) && (errno == 0);
+
+        uint64_t v = 0;
+        int err = bspan_conv_to_u64(&s, &v, &rest);
+        if (valid != (err == 0))
+            failures++;
+        else if (valid && ((v != expected) || (bspan_begin(&rest) != (const unsigned char *)endp)))
+            failures++;
+    }
+
+    char *endp = nullptr;
+    errno = 0;
+    long long expected = strtoll(str, &endp, 10);
+    bool valid = (endp != str) && (errno == 0);
+
+    int64_t v = 0;
+    int err = bspan_conv_to_i64(&s, &v, &rest);
+    if (valid != (err == 0))
+        failures++;
+    else if (valid && ((v != expected) || (bspan_begin(&rest) != (const unsigned char *)endp)))
+        failures++;
+
+    if (failures)
+        printf("  FAILED: %s\n", str);
+
+    return failures;
+}
+
+void test_conv_int()
+{
+    printf("==== test_conv_int ====\n");
+    static const char *edges[] = { "0", "7", "00000000000000000000000000042", "12345678", "123456789", 
+        "1234567890123456", "12345678901234567", "9999999999999999999", "18446744073709551615", 
+        "18446744073709551616", "99999999999999999999", "100000000000000000000",
+        "9223372036854775807", "9223372036854775808", "-9223372036854775808", "-9223372036854775809",
+        "+42", "-0", "123abc", "12345678,9", "1234567812345678,", "-", "+", "abc", nullptr };
+
+    int failures = 0;
+    for (int i = 0; edges[i] != nullptr; i++)
+        failures += check_int(edges[i]);
+
+    // Random lengths, with something after the number
+    char buff[64];
+    srand(99);
+    for (int trial = 0; trial < 20000; trial++)
+    {
+        int len = 1 + (rand() % 22);
+        int pos = 0;
+        if (trial & 1)
+            buff[pos++] = '-';
+        for (int i = 0; i < len; i++)
+            buff[pos++] = (char)('0' + (rand() % 10));
+        strcpy(buff + pos, (trial & 2) ? ",next" : "");
+
+        failures += check_int(buff);
+    }
+
+    printf("int: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
 int main(int argc, char* argv[])
 {
+    test_conv_int();
     test_conv_double();
     test_conv_hex();
 }
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "convspan.h"
+
+
+// Parse the text both ways, and compare the bits
+static int check_one(const char *text)
+{
+    const unsigned char *start = (const unsigned char *)text;
+    const unsigned char *end = start + strlen(text);
+
+    char *strtodEnd = nullptr;
+    double expected = strtod(text, &strtodEnd);
+
+    double value = 0;
+    const unsigned char *endp = nullptr;
+    int err = conv_parse_double(start, end, &value, &endp);
+
+    if (err != 0) {
+        if (strtodEnd == text)
+            return 0;
+        printf("  not parsed: %s\n", text);
+        return 1;
+    }
+
+    uint64_t a, b;
+    memcpy(&a, &expected, 8);
+    memcpy(&b, &value, 8);
+
+    bool same = (a == b) || (std::isnan(expected) && std::isnan(value));
+    if (!same || ((const char *)endp != strtodEnd)) {
+        printf("  mismatch: %s  strtod: %.17g  conv: %.17g\n", text, expected, value);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Bit patterns printed back out, at a few precisions
+void test_random_bits()
+{
+    printf("==== test_random_bits ====\n");
+
+    std::mt19937_64 rng(12345);
+    static const char *formats[] = { "%.17g", "%.16g", "%.15g", "%.6g", "%.25e", "%.3e" };
+    char buff[64];
+
+    int failures = 0;
+    for (int i = 0; i < 200000; i++)
+    {
+        uint64_t bits = rng();
+        double d;
+        memcpy(&d, &bits, 8);
+        if (!std::isfinite(d))
+            continue;
+
+        snprintf(buff, sizeof(buff), formats[i % 6], d);
+        failures += check_one(buff);
+    }
+
+    printf("random bits: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Long runs of digits, so the exact comparison gets used
+void test_long_digits()
+{
+    printf("==== test_long_digits ====\n");
+
+    std::mt19937_64 rng(54321);
+    int failures = 0;
+
+    for (int i = 0; i < 50000; i++)
+    {
+        std::string s;
+        int nInt = (int)(rng() % 30);
+        int nFrac = (int)(rng() % 40);
+        for (int j = 0; j < nInt; j++)
+            s += (char)('0' + rng() % 10);
+        s += '.';
+        for (int j = 0; j < nFrac; j++)
+            s += (char)('0' + rng() % 10);
+        if (nInt + nFrac == 0)
+            s += '5';
+        s += 'e';
+        s += std::to_string((int)(rng() % 700) - 350);
+
+        failures += check_one(s.c_str());
+    }
+
+    printf("long digits: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Values exactly halfway between two doubles, and just either side of
+// halfway.  x86 long double holds the halfway point exactly, and
+// printing it with enough digits gives the exact decimal value.
+void test_halfway()
+{
+    printf("==== test_halfway ====\n");
+
+#if defined(__x86_64__) || defined(__i386__)
+    std::mt19937_64 rng(999);
+    static char buff[1200];
+    int failures = 0;
+
+    for (int i = 0; i < 3000; i++)
+    {
+        // Normal and subnormal values, across the whole range
+        uint64_t bits = rng() & 0x7fffffffffffffffULL;
+        if (i % 3 == 0)
+            bits &= 0x000fffffffffffffULL;
+        double d;
+        memcpy(&d, &bits, 8);
+        if (!std::isfinite(d) || d == 0)
+            continue;
+
+        long double mid = ((long double)d + (long double)nextafter(d, HUGE_VAL)) / 2;
+        snprintf(buff, sizeof(buff), "%.800Le", mid);
+        failures += check_one(buff);
+
+        // Nudge the last non-zero digit up and down
+        char *e = strchr(buff, 'e');
+        char *last = e - 1;
+        while (*last == '0')
+            last--;
+        if (*last != '.' && *last != '9') {
+            (*last)++;
+            failures += check_one(buff);
+            (*last)--;
+        }
+        if (*last != '.' && *last != '0') {
+            (*last)--;
+            failures += check_one(buff);
+        }
+    }
+
+    printf("halfway: %s\n", failures == 0 ? "PASS" : "FAIL");
+#else
+    printf("halfway: SKIPPED\n");
+#endif
+}
+
+// The edges of the range, and a few that are known to be tricky
+void test_edges()
+{
+    printf("==== test_edges ====\n");
+
+    static const char *cases[] = {
+        "0", "-0", "0.0", "0e0", ".5", "5.", "1e308", "1.7976931348623157e308", "1.7976931348623158e308",
+        "1.7976931348623159e308", "2e308", "1e309", "1e-307", "2.2250738585072011e-308", "2.2250738585072014e-308",
+        "4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324", "1e-324", "1e-400",
+        "9007199254740993", "9007199254740992.000000000000000000001", "9007199254740993.0000000000000000001",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "1.00000000000000011102230246251565404236316680908203126",
+        "7.2057594037927933e16", "123456789012345678901234567890", "0.000000000000000000000000000001234",
+        "00000000000000000000000000000000000001.5", "1e23", "8.98846567431158e307", "1e99999999999", "1e-99999999999",
+        "3.14159", "-2.5e-3", "+42", "1e", "1e+", "2em", "3ex", "1.5E+10x",
+        "inf", "-Infinity", "INF", "nan", "-nan", "nan(123)",
+        nullptr
+    };
+
+    int failures = 0;
+    for (int i = 0; cases[i] != nullptr; i++)
+        failures += check_one(cases[i]);
+
+    printf("edges: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// The bspan form, and where it leaves off
+void test_span()
+{
+    printf("==== test_span ====\n");
+
+    bspan s, rest;
+    double v = 0;
+    bspan_init_from_cstr(&s, "12.5em 3");
+    bool success = (bspan_conv_to_double(&s, &v, &rest) == 0) && (v == 12.5) && (bspan_size(&rest) == 4) && (*bspan_begin(&rest) == 'e');
+
+    bspan_init_from_cstr(&s, "-.25,");
+    success = success && (bspan_conv_to_double(&s, &v, &rest) == 0) && (v == -0.25) && (bspan_size(&rest) == 1);
+
+    bspan_init_from_cstr(&s, "abc");
+    success = success && (bspan_conv_to_double(&s, &v, &rest) == -1);
+
+    printf("span: %s\n", success ? "PASS" : "FAIL");
+}
+
+// Floats are rounded straight from the decimal, like strtof()
+void test_float()
+{
+    printf("==== test_float ====\n");
+
+    std::mt19937_64 rng(777);
+    static const char *formats[] = { "%.9g", "%.8g", "%.7g", "%.17g", "%.30e" };
+    static char buff[256];
+    int failures = 0;
+
+    for (int i = 0; i < 200000; i++)
+    {
+        uint32_t bits = (uint32_t)rng() & 0x7fffffff;
+        float f;
+        memcpy(&f, &bits, 4);
+        if (!std::isfinite(f))
+            continue;
+
+        // Every other one is the exact point halfway to the next float,
+        // which a double holds exactly
+        if (i & 1)
+            snprintf(buff, sizeof(buff), formats[i % 5], (double)f);
+        else
+            snprintf(buff, sizeof(buff), "%.160e", ((double)f + (double)nextafterf(f, HUGE_VALF)) / 2);
+
+        float expected = strtof(buff, nullptr);
+        float value = 0;
+        const unsigned char *endp = nullptr;
+        conv_parse_float((const unsigned char *)buff, (const unsigned char *)buff + strlen(buff), &value, &endp);
+        if (memcmp(&expected, &value, 4) != 0) {
+            printf("  mismatch: %s  strtof: %.9g  conv: %.9g\n", buff, expected, value);
+            failures++;
+        }
+    }
+
+    printf("float: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Lists of numbers, the way SVG writes them
+void test_lists()
+{
+    printf("==== test_lists ====\n");
+
+    bspan s, rest;
+    double values[16];
+    size_t count = 0;
+
+    bspan_init_from_cstr(&s, " 10,20 30.5\t-4e2,,7 1-2.5.5 L 3,4");
+    bspan_conv_to_doubles(&s, values, 16, &count, &rest);
+    bool success = (count == 8) && (values[0] == 10) && (values[3] == -400) && (values[4] == 7) &&
+        (values[6] == -2.5) && (values[7] == 0.5) && (*bspan_begin(&rest) == 'L');
+
+    // Stop when the array is full, ready to carry on
+    bspan_init_from_cstr(&s, "1 2 3 4 5");
+    bspan_conv_to_doubles(&s, values, 3, &count, &rest);
+    success = success && (count == 3) && (bspan_size(&rest) == 4);
+    bspan_conv_to_doubles(&rest, values, 16, &count, &rest);
+    success = success && (count == 2) && (values[1] == 5) && bspan_is_empty(&rest);
+
+    float fvalues[4];
+    bspan_init_from_cstr(&s, "0.1, 0.2, 0.3 , ");
+    bspan_conv_to_floats(&s, fvalues, 4, &count, &rest);
+    success = success && (count == 3) && (fvalues[1] == 0.2f) && bspan_is_empty(&rest);
+
+    // The constant table of separators is the one asciiset.h would build
+    asciiset seps;
+    asciiset_init_from_cstr(&seps, ",\t\n\f\r ");
+    success = success && (memcmp(&seps, conv_numlist_chars(), sizeof(asciiset)) == 0);
+
+    printf("lists: %s\n", success ? "PASS" : "FAIL");
+
+    // A long list, into an array that grows
+    std::string text;
+    std::mt19937_64 rng(31337);
+    std::vector<double> expected;
+    char buff[64];
+    for (int i = 0; i < 10000; i++) {
+        snprintf(buff, sizeof(buff), (i % 3) ? "%.17g," : "%.6g ", (double)(int64_t)rng() / 1e10);
+        expected.push_back(strtod(buff, nullptr));
+        text += buff;
+    }
+
+    double *grown = nullptr;
+    size_t capacity = 0;
+    count = 0;
+    bspan_init_from_data(&s, (const unsigned char *)text.data(), text.size());
+    success = (bspan_conv_to_doubles_grow(&s, &grown, &capacity, &count, &rest) == 0) && (count == expected.size()) && bspan_is_empty(&rest);
+    for (size_t i = 0; success && i < count; i++)
+        success = grown[i] == expected[i];
+    free(grown);
+
+    printf("grow: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_edges();
+    test_random_bits();
+    test_long_digits();
+    test_halfway();
+    test_span();
+    test_float();
+    test_lists();
+}
@@ -78,9 +78,10 @@ void testColumnNames(const ByteSpan &chunk)
 
 	auto columnLine = readCsvLine(s);
 	
-	auto gen = generateColumnValues(columnLine, ",");
+	std::vector<ByteSpan> names;
+	gatherColumnValues(columnLine, names);
 		
-	for (const auto &c : gen) {
+	for (const auto &c : names) {
 		printf("%.*s\n", (int)c.size(), c.data());
 	}
 }
@@ -109,7 +110,9 @@ void testSelectAll(const ByteSpan& src)
 			break;
 
 		// Print the values
-		for (auto& v : generateColumnValues(line, ",")) {
+		std::vector<ByteSpan> values;
+		gatherColumnValues(line, values);
+		for (auto& v : values) {
 			printf("%.*s, ", (int)v.size(), v.data());
 		}
 		printf("\n");
@@ -127,12 +130,8 @@ void testProjection(const ByteSpan &src, const ByteSpan && columnNames)
 	// Get the first line
 	auto columnLine = readCsvLine(s);
 
-	// Turn the first line into named columns
-	std::map<ByteSpan, CSVColumn> headings{};
-	gatherColumnHeadings(columnLine, headings);
-	
-	std::vector<ByteSpan> projNamesVec{};
-	gatherColumnValues(columnNames, projNamesVec);
+	// Compile the projection once, against the headings
+	CSVProjection proj(columnLine, columnNames);
 
 	
 	// Iterate the remaining rows of the data, gathering
@@ -149,7 +148,7 @@ void testProjection(const ByteSpan &src, const ByteSpan && columnNames)
 		//printf("CSV ==> %.*s ", (int)line.size(), line.data());
 		
 		// Get the projected, column values
-		gatherProjectedColumnValues(line, projNamesVec, headings, values);
+		gatherProjectedColumnValues(line, proj, values);
 
 		// Print the values
 		for (auto& v : values) {
@@ -0,0 +1,316 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "csvcolumns.h"
+#include "mappedfile.h"
+#include "testhelpers.h"
+
+using namespace pcore;
+
+static int64_t timestamp(const char *cstr)
+{
+    bspan s;
+    bspan_init_from_cstr(&s, cstr);
+    int64_t micros = -1;
+    if (csv_parse_timestamp(&s, &micros) != 0)
+        return -1;
+
+    return micros;
+}
+
+void test_timestamps()
+{
+    printf("==== test_timestamps ====\n");
+    int failures = 0;
+
+    struct { const char *text; int64_t micros; } good[] = {
+        { "1970-01-01", 0 },
+        { "1970-01-02", 86400LL * 1000000 },
+        { "2000-03-01", 951868800LL * 1000000 },
+        { "2023/05/10 02:00:00.000000 +00:00", 1683684000LL * 1000000 },
+        { "2023-05-10T02:00:00Z", 1683684000LL * 1000000 },
+        { "2023-05-10T04:30:00+02:30", 1683684000LL * 1000000 },
+        { "2023-05-10 02:00", 1683684000LL * 1000000 },
+        { "2023-05-09T21:00:00-0500", 1683684000LL * 1000000 },
+        { "2023-05-10T02:00:00.25", 1683684000LL * 1000000 + 250000 },
+        { "2023-05-10T02:00:00.1234567", 1683684000LL * 1000000 + 123456 },
+        { "1969-12-31T23:59:59", -1000000 },
+    };
+    for (auto &g : good) {
+        if (timestamp(g.text) != g.micros) {
+            printf("  %s: %lld\n", g.text, (long long)timestamp(g.text));
+            failures++;
+        }
+    }
+
+    static const char *bad[] = {
+        "", "2023", "2023-05", "2023-05/10", "2023-13-01", "2023-05-00", "2023-05-10T", "2023-05-10T25:00",
+        "2023-05-10T02:00:00.", "2023-05-10 02:00 +5", "2023-05-10x", "12.5", "23-05-10",
+    };
+    for (const char *b : bad) {
+        if (timestamp(b) != -1) {
+            printf("  should not parse: %s\n", b);
+            failures++;
+        }
+    }
+
+    printf("timestamps: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+static void load(const std::string &doc, csvindex *idx, csvcolumns *cols)
+{
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+    csvindex_init(idx);
+    csvindex_build(idx, &src, ',');
+    csvcolumns_init(cols);
+    csvcolumns_load(cols, idx, true);
+}
+
+void test_types()
+{
+    printf("==== test_types ====\n");
+    int failures = 0;
+
+    std::string doc =
+        "id, price , when, color, note, empty\n"
+        "1, 12.5, 2023-05-10, red, \"hello, there\",\n"
+        "2, 3, 2023-05-11, blue, \"\",\n"
+        "-3, , , red, x\n"
+        "4, -1e3, 2023-05-12T10:00:00Z, red, \"say \"\"hi\"\"\", \n"
+        "5, \"7\", 2023-05-13, blue\n"
+        "6, 0.5, 2023-05-14, red, y,\n";
+
+    csvindex idx;
+    csvcolumns cols;
+    load(doc, &idx, &cols);
+
+    static const int types[] = {
+        CSV_COLUMN_TYPE_INT64, CSV_COLUMN_TYPE_DOUBLE, CSV_COLUMN_TYPE_TIMESTAMP,
+        CSV_COLUMN_TYPE_CATEGORY, CSV_COLUMN_TYPE_STRING, CSV_COLUMN_TYPE_STRING,
+    };
+    if ((cols.fRowCount != 6) || (cols.fColumnCount != 6))
+        failures++;
+    for (size_t c = 0; (c < cols.fColumnCount) && (c < 6); c++)
+        if (cols.fColumns[c].fType != types[c]) {
+            printf("  column %zu: %d\n", c, cols.fColumns[c].fType);
+            failures++;
+        }
+
+    if ((csvcolumns_find_cstr(&cols, "price") != 1) || (csvcolumns_find_cstr(&cols, "missing") != -1))
+        failures++;
+
+    const csvcolumn *id = &cols.fColumns[0];
+    const csvcolumn *price = &cols.fColumns[1];
+    const csvcolumn *when = &cols.fColumns[2];
+    const csvcolumn *color = &cols.fColumns[3];
+    const csvcolumn *note = &cols.fColumns[4];
+    const csvcolumn *empty = &cols.fColumns[5];
+
+    if ((id->fInts[2] != -3) || (id->fNullCount != 0))
+        failures++;
+    if ((price->fDoubles[0] != 12.5) || (price->fDoubles[3] != -1000) || (price->fDoubles[4] != 7))
+        failures++;
+    if (!csvcolumn_is_null(price, 2) || (price->fDoubles[2] != 0) || (price->fNullCount != 1))
+        failures++;
+    if ((when->fInts[0] != timestamp("2023-05-10")) || !csvcolumn_is_null(when, 2) ||
+        (when->fInts[3] != timestamp("2023-05-12T10:00:00Z")))
+        failures++;
+    if ((interntable_count(&color->fCategories) != 2) || (color->fCodes[0] != color->fCodes[2]) || (color->fCodes[0] == color->fCodes[1]))
+        failures++;
+
+    bspan value;
+    csvcolumn_string(&cols, color, 1, &value);
+    if (str(value) != "blue")
+        failures++;
+    csvcolumn_string(&cols, note, 0, &value);
+    if (str(value) != "hello, there")
+        failures++;
+    csvcolumn_string(&cols, note, 3, &value);
+    if (str(value) != "say \"\"hi\"\"")
+        failures++;
+
+    // A quoted empty string is a value, a missing one is null
+    csvcolumn_string(&cols, note, 1, &value);
+    if ((bspan_size(&value) != 0) || csvcolumn_is_null(note, 1) || !csvcolumn_is_null(note, 4) || (note->fNullCount != 1))
+        failures++;
+    if (empty->fNullCount != 6)
+        failures++;
+    if (csvcolumn_string(&cols, price, 0, &value) == 0)
+        failures++;
+
+    csvcolumns_destroy(&cols);
+    csvindex_destroy(&idx);
+
+    printf("types: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Values that weren't sampled, that don't fit the guessed type
+void test_widen()
+{
+    printf("==== test_widen ====\n");
+    int failures = 0;
+
+    std::string doc = "a,b,c,d\n";
+    for (int i = 0; i < 10000; i++) {
+        std::string n = std::to_string(i);
+        doc += n + "," + n + "," + std::to_string(i % 3) + ",2023-05-10\n";
+    }
+    doc += "1.5,x,many,never\n";
+    for (int i = 0; i < 70000; i++)
+        doc += "1,1," + std::to_string(i) + ",2023-05-10\n";
+
+    csvindex idx;
+    csvcolumns cols;
+    load(doc, &idx, &cols);
+
+    // Most likely, the odd row isn't one of the ones sampled
+    static const int types[] = { CSV_COLUMN_TYPE_DOUBLE, CSV_COLUMN_TYPE_STRING, CSV_COLUMN_TYPE_STRING, CSV_COLUMN_TYPE_STRING };
+    for (size_t c = 0; c < 4; c++)
+        if (cols.fColumns[c].fType != types[c]) {
+            printf("  column %zu: %d\n", c, cols.fColumns[c].fType);
+            failures++;
+        }
+
+    bspan value;
+    if ((cols.fColumns[0].fDoubles[10000] != 1.5) || (cols.fColumns[0].fDoubles[9999] != 9999))
+        failures++;
+    csvcolumn_string(&cols, &cols.fColumns[1], 10000, &value);
+    if (str(value) != "x")
+        failures++;
+    csvcolumn_string(&cols, &cols.fColumns[2], 80000, &value);
+    if (str(value) != "69999")
+        failures++;
+
+    csvcolumns_destroy(&cols);
+    csvindex_destroy(&idx);
+
+    printf("widen: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Words the number parser would take, which are not numbers in a CSV
+void test_words()
+{
+    printf("==== test_words ====\n");
+    int failures = 0;
+
+    std::string doc =
+        "name, mixed, number\n"
+        "nan, 1.5, 1.5\n"
+        "inf, nan, -2e3\n"
+        "Infinity, 3, .25\n"
+        "NaN, -inf, +4.\n";
+
+    csvindex idx;
+    csvcolumns cols;
+    load(doc, &idx, &cols);
+
+    static const int types[] = { CSV_COLUMN_TYPE_STRING, CSV_COLUMN_TYPE_STRING, CSV_COLUMN_TYPE_DOUBLE };
+    for (size_t c = 0; c < 3; c++)
+        if (cols.fColumns[c].fType != types[c]) {
+            printf("  column %zu: %d\n", c, cols.fColumns[c].fType);
+            failures++;
+        }
+
+    bspan value;
+    if ((csvcolumn_string(&cols, &cols.fColumns[0], 1, &value) != 0) || (str(value) != "inf") || (cols.fColumns[2].fDoubles[1] != -2000) || (cols.fColumns[2].fDoubles[3] != 4))
+        failures++;
+
+    csvcolumns_destroy(&cols);
+    csvindex_destroy(&idx);
+
+    // Not even one digit
+    const char *words[] = { "nan", "inf", "-Infinity", ".", "e", "-", "+.e" };
+    for (const char *w : words) {
+        double d;
+        bspan_init_from_cstr(&value, w);
+        if (csvcolumns_is_double(&value, &d))
+            failures++;
+    }
+
+    printf("words: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_file(const char *filename)
+{
+    printf("==== test_file ====\n");
+
+    auto mfile = MappedFile::create_shared(filename);
+    if (!mfile) {
+        printf("could not map: %s\n", filename);
+        printf("file: FAIL\n");
+        return;
+    }
+
+    // The file, a thousand times over, without the headings after the first
+    std::string doc((const char *)mfile->data(), mfile->size());
+    std::string body = doc.substr(doc.find('\n') + 1);
+    std::string big = doc;
+    for (int i = 1; i < 1000; i++)
+        big += body;
+
+    auto t0 = std::chrono::steady_clock::now();
+    csvindex idx;
+    csvcolumns cols;
+    load(big, &idx, &cols);
+    auto t1 = std::chrono::steady_clock::now();
+
+    bool success = (cols.fColumnCount == 4) && (cols.fRowCount == csvindex_row_count(&idx) - 1);
+    static const int types[] = { CSV_COLUMN_TYPE_CATEGORY, CSV_COLUMN_TYPE_TIMESTAMP, CSV_COLUMN_TYPE_DOUBLE, CSV_COLUMN_TYPE_DOUBLE };
+    for (size_t c = 0; c < cols.fColumnCount; c++)
+        if (cols.fColumns[c].fType != types[c])
+            success = false;
+
+    int download = csvcolumns_find_cstr(&cols, "Download (b/s)");
+    if (download < 0) {
+        printf("file: FAIL\n");
+        return;
+    }
+
+    // Summing a column, from the doubles, and by parsing each field
+    const csvcolumn *c = &cols.fColumns[download];
+    auto t2 = std::chrono::steady_clock::now();
+    double fromColumn = 0;
+    for (size_t row = 0; row < cols.fRowCount; row++)
+        fromColumn += c->fDoubles[row];
+    auto t3 = std::chrono::steady_clock::now();
+    double fromFields = 0;
+    for (size_t row = 1; row < csvindex_row_count(&idx); row++) {
+        bspan value;
+        double d = 0;
+        csvindex_field(&idx, row, (size_t)download, &value);
+        bspan_conv_to_double(&value, &d, nullptr);
+        fromFields += d;
+    }
+    auto t4 = std::chrono::steady_clock::now();
+
+    auto ms = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+
+    printf("  %zu rows\n", cols.fRowCount);
+    printf("  index and load    : %8.2f ms\n", ms(t0, t1));
+    printf("  sum, from column  : %8.3f ms\n", ms(t2, t3));
+    printf("  sum, parsing each : %8.3f ms\n", ms(t3, t4));
+
+    if (fromColumn != fromFields)
+        success = false;
+
+    csvcolumns_destroy(&cols);
+    csvindex_destroy(&idx);
+
+    printf("file: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_timestamps();
+    test_types();
+    test_widen();
+    test_words();
+    test_file((argc > 1) ? argv[1] : "resources/UsageOverTime.csv");
+}
@@ -0,0 +1,180 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "csvcursor.h"
+#include "testhelpers.h"
+
+// Random CSV, made mostly of the characters that matter
+static const char *const csvPieces[] = {
+    "abc", "12.5", ",", ",", ",", "\n", "\r\n", "\"quoted, with comma\"", "\"two\nlines\"",
+    "\"say \"\"hi\"\"\"", "\"\"", " ", "x", "\r",
+};
+
+// The cursor finds the same rows and fields as the index
+void test_rows()
+{
+    printf("==== test_rows ====\n");
+    int failures = 0;
+
+    std::vector<std::string> docs = { "", "a", "\n", "a,b\n", "a,b", "a,\"b\nc\",d\r\n\r\n,", "\"unterminated,\nquote" };
+    for (size_t size = 1; size < 400; size += 3)
+        docs.push_back(make_csv(size, (unsigned)size, csvPieces).substr(0, size));
+
+    for (const std::string &doc : docs)
+    {
+        bspan src;
+        bspan_init_from_data(&src, doc.data(), doc.size());
+
+        csvindex idx;
+        csvindex_init(&idx);
+        csvindex_build(&idx, &src, ',');
+
+        csvcursor cur;
+        csvcursor_init(&cur, &src, ',');
+        size_t row = 0;
+        while (csvcursor_next(&cur) == 0)
+        {
+            if (csvcursor_field_count(&cur) != csvindex_field_count(&idx, row))
+                failures++;
+
+            for (size_t col = 0; col < csvcursor_field_count(&cur); col++) {
+                bspan a, b;
+                csvcursor_field(&cur, col, &a);
+                csvindex_field(&idx, row, col, &b);
+                if ((bspan_begin(&a) != bspan_begin(&b)) || (bspan_end(&a) != bspan_end(&b)))
+                    failures++;
+            }
+            row++;
+        }
+        if ((row != csvindex_row_count(&idx)) || (csvcursor_field_count(&cur) != 0))
+            failures++;
+
+        csvcursor_destroy(&cur);
+        csvindex_destroy(&idx);
+    }
+
+    printf("rows: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_headings()
+{
+    printf("==== test_headings ====\n");
+    int failures = 0;
+
+    std::string doc = "ID, \"Time, UTC\" ,Download (b/s),ID,\n1,2,3,4,5\n";
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    csvcursor cur;
+    csvcursor_init(&cur, &src, ',');
+    if (csvcursor_ordinal_cstr(&cur, "ID") != -1)
+        failures++;
+    csvcursor_read_headings(&cur);
+
+    if ((csvcursor_ordinal_cstr(&cur, "ID") != 0) || (csvcursor_ordinal_cstr(&cur, "Time, UTC") != 1) ||
+        (csvcursor_ordinal_cstr(&cur, " Download (b/s) ") != 2) || (csvcursor_ordinal_cstr(&cur, "") != 4) ||
+        (csvcursor_ordinal_cstr(&cur, "Time") != -1))
+        failures++;
+
+    bspan value;
+    csvcursor_next(&cur);
+    csvcursor_field(&cur, csvcursor_ordinal_cstr(&cur, "Download (b/s)"), &value);
+    if ((str(value) != "3") || (csvcursor_field(&cur, 5, &value) == 0))
+        failures++;
+    if (csvcursor_next(&cur) == 0)
+        failures++;
+    csvcursor_destroy(&cur);
+
+    // A lot of columns, for the hash to grow
+    std::string wide;
+    for (int i = 0; i < 500; i++)
+        wide += "col" + std::to_string(i) + ((i == 499) ? "\n" : ",");
+    bspan_init_from_data(&src, wide.data(), wide.size());
+    csvcursor_init(&cur, &src, ',');
+    csvcursor_read_headings(&cur);
+    for (int i = 0; i < 500; i++)
+        if (csvcursor_ordinal_cstr(&cur, ("col" + std::to_string(i)).c_str()) != i)
+            failures++;
+    csvcursor_destroy(&cur);
+
+    printf("headings: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Going through the rows, compared to a new vector for every row, and
+// a map lookup for every value, the way CSVRow does it
+void test_speed()
+{
+    printf("==== test_speed ====\n");
+
+    std::string doc = "ID,Time,Download (b/s),Total (b/s)\n";
+    for (int i = 0; i < 300000; i++)
+        doc += "Anne-Abramson-Te,2023/05/10 02:00:00.000000 +00:00," + std::to_string(i % 1000) + ".5,14.79111111\n";
+
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    // A new vector for each row
+    auto t0 = std::chrono::steady_clock::now();
+    size_t sizeVectors = 0;
+    {
+        bspan s = src;
+        bspan line;
+        csv_read_line(&s, &line);
+        while (csv_read_line(&s, &line) == 0) {
+            std::vector<bspan> values;
+            csvfielditer iter;
+            bspan field;
+            csv_field_iter_init(&iter, &line, ',');
+            while (csv_field_iter_next(&iter, &field) == 0)
+                values.push_back(field);
+            sizeVectors += bspan_size(&values[2]);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    // The cursor
+    csvcursor cur;
+    csvcursor_init(&cur, &src, ',');
+    csvcursor_read_headings(&cur);
+    int download = csvcursor_ordinal_cstr(&cur, "Download (b/s)");
+
+    size_t sizeCursor = 0;
+    size_t rows = 0;
+    const bspan *fields = nullptr;
+    bool reused = true;
+    while (csvcursor_next(&cur) == 0) {
+        bspan value;
+        csvcursor_field(&cur, download, &value);
+        sizeCursor += bspan_size(&value);
+
+        // The same array, every row
+        if ((fields != nullptr) && (fields != cur.fFields))
+            reused = false;
+        fields = cur.fFields;
+        rows++;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    auto ms = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+
+    printf("  vector per row : %8.2f ms\n", ms(t0, t1));
+    printf("  csvcursor      : %8.2f ms\n", ms(t1, t2));
+
+    bool success = reused && (rows == 300000) && (sizeCursor == sizeVectors) && (cur.fFieldCapacity == 16);
+    csvcursor_destroy(&cur);
+
+    printf("speed: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_rows();
+    test_headings();
+    test_speed();
+}
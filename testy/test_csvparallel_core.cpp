@@ -0,0 +1,158 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "csvparallel.h"
+#include "testhelpers.h"
+
+using namespace pcore;
+
+// Random CSV, with quoted fields that run over lines
+static const char *const csvPieces[] = {
+    "abc", "12.5", ",", ",", ",", "\n", "\r\n", "\"quoted, with comma\"", "\"two\nlines\"",
+    "\"say \"\"hi\"\"\"", "\"\"", " ", "x", "\"a long one,\nwith\n,newlines, and \"\"quotes\"\"\"",
+};
+
+// The parallel index has the same rows and fields as the plain one
+static bool same_as_build(const std::string &doc, size_t nThreads)
+{
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    csvindex idx;
+    csvindex_init(&idx);
+    csvindex_build(&idx, &src, ',');
+
+    CsvParallelIndex pidx;
+    bool same = (csv_parallel_build(pidx, &src, ',', nThreads) == 0);
+    same = same && (csv_parallel_row_count(pidx) == csvindex_row_count(&idx));
+
+    for (size_t r = 0; same && (r < csvindex_row_count(&idx)); r++)
+    {
+        size_t count = csvindex_field_count(&idx, r);
+        if (csv_parallel_field_count(pidx, r) != count) {
+            same = false;
+            break;
+        }
+
+        bspan a, b;
+        csvindex_row(&idx, r, &a);
+        csv_parallel_row(pidx, r, &b);
+        if ((bspan_begin(&a) != bspan_begin(&b)) || (bspan_end(&a) != bspan_end(&b)))
+            same = false;
+
+        for (size_t c = 0; c < count; c++) {
+            csvindex_field(&idx, r, c, &a);
+            csv_parallel_field(pidx, r, c, &b);
+            if ((bspan_begin(&a) != bspan_begin(&b)) || (bspan_end(&a) != bspan_end(&b)))
+                same = false;
+        }
+    }
+
+    bspan value;
+    if (csv_parallel_field(pidx, csv_parallel_row_count(pidx), 0, &value) == 0)
+        same = false;
+
+    csvindex_destroy(&idx);
+
+    return same;
+}
+
+void test_build()
+{
+    printf("==== test_build ====\n");
+    int failures = 0;
+
+    static const char *docs[] = {
+        "",
+        "a",
+        "a,b,c\n",
+        "a,b,c",
+        "\"unterminated,\nquote",
+    };
+    for (const char *doc : docs)
+        for (size_t t = 1; t <= 4; t++)
+            if (!same_as_build(doc, t))
+                failures++;
+
+    // Big enough for several chunks, so the chunks start all over:
+    // inside of quotes, just after a '\r', on a '\n', ...
+    for (unsigned seed = 0; seed < 6; seed++)
+    {
+        std::string doc = make_csv(1500000 + seed * 7919, seed, csvPieces);
+        for (size_t t = 1; t <= 7; t++) {
+            if (!same_as_build(doc, t)) {
+                printf("  differs: seed %u, %zu threads\n", seed, t);
+                failures++;
+            }
+        }
+    }
+
+    // A quoted field that runs across whole chunks, so some
+    // chunks have no rows of their own
+    std::string doc = "id,text,n\n1,\"";
+    for (int i = 0; i < 200000; i++)
+        doc += "line, of \"\"text\"\"\n";
+    doc += "\",2\n3,\"x\",4";
+    if (!same_as_build(doc, 8))
+        failures++;
+
+    CsvParallelIndex pidx;
+    bspan src, value;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+    csv_parallel_build(pidx, &src, ',', 8);
+    if ((csv_parallel_row_count(pidx) != 3) || (csv_parallel_field_count(pidx, 1) != 3))
+        failures++;
+    csv_parallel_field(pidx, 2, 1, &value);
+    if (str(value) != "\"x\"")
+        failures++;
+
+    printf("build: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_speed()
+{
+    printf("==== test_speed ====\n");
+
+    std::string doc = make_csv(64 * 1024 * 1024, 42, csvPieces);
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    auto mbs = [&](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return doc.size() / 1e6 / std::chrono::duration<double>(b - a).count();
+    };
+
+    csvindex idx;
+    csvindex_init(&idx);
+    auto t0 = std::chrono::steady_clock::now();
+    csvindex_build(&idx, &src, ',');
+    auto t1 = std::chrono::steady_clock::now();
+    printf("  csvindex_build    : %8.1f MB/s\n", mbs(t0, t1));
+
+    bool success = true;
+    size_t cores = std::thread::hardware_concurrency();
+    for (size_t t = 1; t <= ((cores > 4) ? cores : 4); t *= 2)
+    {
+        CsvParallelIndex pidx;
+        auto t2 = std::chrono::steady_clock::now();
+        csv_parallel_build(pidx, &src, ',', t);
+        auto t3 = std::chrono::steady_clock::now();
+        printf("  %2zu threads        : %8.1f MB/s\n", t, mbs(t2, t3));
+
+        if (csv_parallel_row_count(pidx) != csvindex_row_count(&idx))
+            success = false;
+    }
+    printf("  (%zu cores)\n", cores);
+    csvindex_destroy(&idx);
+
+    printf("speed: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_build();
+    test_speed();
+}
@@ -0,0 +1,193 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "csvprojection.h"
+#include "testhelpers.h"
+
+// All the fields of a line, by the field iterator
+static std::vector<std::string> split(const bspan &line, unsigned char delim)
+{
+    std::vector<std::string> fields;
+    csvfielditer iter;
+    bspan field;
+    csv_field_iter_init(&iter, &line, delim);
+    while (csv_field_iter_next(&iter, &field) == 0)
+        fields.push_back(str(field));
+
+    return fields;
+}
+
+// Random CSV, with long lines, so the fields run over several blocks
+static const char *const csvPieces[] = {
+    "abc", "12.5", ",", ",", ",", ",", "\n", "\r\n", "\"quoted, with comma\"", "\"two\nlines\"",
+    "\"say \"\"hi\"\", ok\"", "\"\"", " ", "a longer field, of some text, with some commas",
+};
+
+void test_apply()
+{
+    printf("==== test_apply ====\n");
+    int failures = 0;
+
+    for (unsigned seed = 0; seed < 20; seed++)
+    {
+        std::string doc = make_csv(20000, seed, csvPieces);
+        unsigned char delim = (seed & 1) ? ',' : ' ';
+
+        // A few columns, in any order, some twice, some past the end
+        std::vector<uint32_t> ordinals;
+        int count = 1 + (rand() % 6);
+        for (int i = 0; i < count; i++)
+            ordinals.push_back((uint32_t)(rand() % 24));
+
+        csvprojection proj;
+        csvprojection_init(&proj);
+        csvprojection_compile_ordinals(&proj, ordinals.data(), ordinals.size());
+
+        bspan src, line;
+        bspan_init_from_data(&src, doc.data(), doc.size());
+        std::vector<bspan> values(ordinals.size());
+        while (csv_read_line(&src, &line) == 0)
+        {
+            std::vector<std::string> fields = split(line, delim);
+            size_t found = csvprojection_apply(&proj, &line, delim, values.data());
+
+            size_t expectedFound = 0;
+            for (size_t i = 0; i < ordinals.size(); i++) {
+                std::string expected = (ordinals[i] < fields.size()) ? fields[ordinals[i]] : "";
+                if (ordinals[i] < fields.size())
+                    expectedFound++;
+                if (str(values[i]) != expected)
+                    failures++;
+            }
+            if (found != expectedFound)
+                failures++;
+        }
+
+        csvprojection_destroy(&proj);
+    }
+
+    printf("apply: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_compile()
+{
+    printf("==== test_compile ====\n");
+    int failures = 0;
+
+    bspan headings, line;
+    bspan_init_from_cstr(&headings, "ID, \"Time, UTC\" ,Download (b/s),Total (b/s)");
+    bspan_init_from_cstr(&line, "a,\"2023, May\",6.5,7.25");
+
+    csvprojection proj;
+    csvprojection_init(&proj);
+    csvprojection_compile_cstr(&proj, &headings, "Total (b/s), nothing, ID , \"Time, UTC\"", ',');
+
+    bspan values[3];
+    size_t found = csvprojection_apply(&proj, &line, ',', values);
+    if ((csvprojection_count(&proj) != 3) || (found != 3))
+        failures++;
+    if ((str(values[0]) != "7.25") || (str(values[1]) != "a") || (str(values[2]) != "\"2023, May\""))
+        failures++;
+
+    // Nothing wanted, nothing done
+    csvprojection_compile_cstr(&proj, &headings, "nothing", ',');
+    if ((csvprojection_count(&proj) != 0) || (csvprojection_apply(&proj, &line, ',', values) != 0))
+        failures++;
+
+    csvprojection_destroy(&proj);
+
+    printf("compile: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Taking 3 of 40 columns, compared to splitting every column, and
+// to splitting a source that only has the 3
+void test_speed()
+{
+    printf("==== test_speed ====\n");
+
+    std::string wide;
+    std::string narrow;
+    for (int row = 0; row < 100000; row++)
+    {
+        for (int col = 0; col < 40; col++) {
+            std::string value = (col % 7 == 3) ? "\"text, " + std::to_string(row) + "\"" : std::to_string(row * 40 + col);
+            wide += value + ((col == 39) ? "\n" : ",");
+            if ((col == 2) || (col == 5) || (col == 11))
+                narrow += value + ((col == 11) ? "\n" : ",");
+        }
+    }
+
+    auto ms = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+
+    uint32_t ordinals[] = { 11, 2, 5 };
+    csvprojection proj;
+    csvprojection_init(&proj);
+    csvprojection_compile_ordinals(&proj, ordinals, 3);
+
+    bspan src, line, values[3];
+    size_t sizeAll = 0, sizeProjected = 0, sizeNarrow = 0;
+
+    // Every field, then the ones wanted
+    auto t0 = std::chrono::steady_clock::now();
+    bspan_init_from_data(&src, wide.data(), wide.size());
+    std::vector<bspan> fields;
+    while (csv_read_line(&src, &line) == 0) {
+        fields.clear();
+        csvfielditer iter;
+        bspan field;
+        csv_field_iter_init(&iter, &line, ',');
+        while (csv_field_iter_next(&iter, &field) == 0)
+            fields.push_back(field);
+        sizeAll += bspan_size(&fields[11]) + bspan_size(&fields[2]) + bspan_size(&fields[5]);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    // The projection
+    bspan_init_from_data(&src, wide.data(), wide.size());
+    while (csv_read_line(&src, &line) == 0) {
+        csvprojection_apply(&proj, &line, ',', values);
+        sizeProjected += bspan_size(&values[0]) + bspan_size(&values[1]) + bspan_size(&values[2]);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    // Just the 3 columns, without the reading of the lines
+    bspan_init_from_data(&src, narrow.data(), narrow.size());
+    while (csv_read_line(&src, &line) == 0) {
+        csvfielditer iter;
+        bspan field;
+        csv_field_iter_init(&iter, &line, ',');
+        while (csv_field_iter_next(&iter, &field) == 0)
+            sizeNarrow += bspan_size(&field);
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    // The time to read the lines of the wide source, which both pay
+    bspan_init_from_data(&src, wide.data(), wide.size());
+    size_t lines = 0;
+    while (csv_read_line(&src, &line) == 0)
+        lines++;
+    auto t4 = std::chrono::steady_clock::now();
+
+    printf("  read lines only       : %8.2f ms\n", ms(t3, t4));
+    printf("  split all 40 columns  : %8.2f ms\n", ms(t0, t1) - ms(t3, t4));
+    printf("  projection of 3       : %8.2f ms\n", ms(t1, t2) - ms(t3, t4));
+    printf("  3 column source       : %8.2f ms (with its lines)\n", ms(t2, t3));
+
+    bool success = (sizeAll == sizeProjected) && (sizeAll == sizeNarrow) && (lines == 100000);
+    csvprojection_destroy(&proj);
+
+    printf("speed: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_apply();
+    test_compile();
+    test_speed();
+}
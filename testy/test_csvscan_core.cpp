@@ -0,0 +1,353 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "csvscan.h"
+#include "mappedfile.h"
+#include "testhelpers.h"
+
+using namespace pcore;
+
+typedef std::vector<std::vector<std::string>> csvrows;
+
+// Split a byte at a time, the obvious way
+static csvrows split_bytes(const std::string &src, char delim)
+{
+    csvrows rows;
+    std::vector<std::string> row;
+    std::string field;
+    bool inQuote = false;
+
+    for (char c : src)
+    {
+        if (c == '"')
+            inQuote = !inQuote;
+
+        if (!inQuote && (c == delim)) {
+            row.push_back(field);
+            field.clear();
+        }
+        else if (!inQuote && (c == '\n')) {
+            if (!field.empty() && (field.back() == '\r'))
+                field.pop_back();
+            row.push_back(field);
+            rows.push_back(row);
+            row.clear();
+            field.clear();
+        }
+        else
+            field += c;
+    }
+
+    if (!field.empty() || !row.empty()) {
+        row.push_back(field);
+        rows.push_back(row);
+    }
+
+    return rows;
+}
+
+static csvrows split_index(const csvindex &idx)
+{
+    csvrows rows;
+    for (size_t r = 0; r < csvindex_row_count(&idx); r++) {
+        std::vector<std::string> row;
+        for (size_t c = 0; c < csvindex_field_count(&idx, r); c++) {
+            bspan value;
+            csvindex_field(&idx, r, c, &value);
+            row.push_back(str(value));
+        }
+        rows.push_back(row);
+    }
+
+    return rows;
+}
+
+static csvrows split_lines(const std::string &src, unsigned char delim)
+{
+    csvrows rows;
+    bspan s;
+    bspan_init_from_data(&s, src.data(), src.size());
+
+    bspan line;
+    while (csv_read_line(&s, &line) == 0) {
+        std::vector<std::string> row;
+        csvfielditer iter;
+        bspan field;
+        csv_field_iter_init(&iter, &line, delim);
+        while (csv_field_iter_next(&iter, &field) == 0)
+            row.push_back(str(field));
+        rows.push_back(row);
+    }
+
+    return rows;
+}
+
+// Random CSV, made mostly of the characters that matter
+static const char *const csvPieces[] = {
+    "abc", "12.5", ",", ",", ",", "\n", "\r\n", "\"quoted, with comma\"", "\"two\nlines\"",
+    "\"say \"\"hi\"\"\"", "\"\"", " ", "x",
+};
+
+void test_kernels()
+{
+    printf("==== test_kernels ====\n");
+    int failures = 0;
+
+    static const char interesting[] = "\",\n\r;a \x80\xff";
+    unsigned char block[CSVINDEX_BLOCK_SIZE];
+    srand(1234);
+    for (int trial = 0; trial < 100000; trial++)
+    {
+        for (int i = 0; i < CSVINDEX_BLOCK_SIZE; i++)
+            block[i] = (trial & 1) ? (unsigned char)(rand() & 0xff) : (unsigned char)interesting[rand() % (sizeof(interesting) - 1)];
+        unsigned char delim = (trial & 2) ? ';' : ',';
+
+        csvindex_masks expected, got;
+        csvindex_kern_classify_scalar(block, delim, &expected);
+        csvindex_classify(block, CSVINDEX_BLOCK_SIZE, delim, &got);
+        if (memcmp(&expected, &got, sizeof(csvindex_masks)) != 0)
+            failures++;
+
+        uint64_t bits = ((uint64_t)rand() << 40) ^ ((uint64_t)rand() << 20) ^ (uint64_t)rand();
+        if (csvindex_prefix_xor(bits) != csvindex_kern_prefix_xor_scalar(bits))
+            failures++;
+    }
+
+    // Every scan kernel makes the same index
+    struct { const char *name; csvindex_scan_fn scan; bool available; } kernels[] = {
+        { "scalar", csvindex_kern_scan_scalar, true },
+#if defined(PC_ARCH_X86)
+        { "sse2", csvindex_kern_scan_sse2, pc_cpu_has(PC_CPU_SSE2) },
+        { "pclmul", csvindex_kern_scan_pclmul, pc_cpu_has(PC_CPU_PCLMUL | PC_CPU_SSE41) },
+        { "avx2", csvindex_kern_scan_avx2, pc_cpu_has(PC_CPU_AVX2 | PC_CPU_PCLMUL) },
+        { "avx512", csvindex_kern_scan_avx512, pc_cpu_has(PC_CPU_AVX512BW | PC_CPU_PCLMUL) },
+#endif
+    };
+
+    std::string doc = make_csv(100000, 99, csvPieces);
+    doc.resize(doc.size() - (doc.size() % CSVINDEX_BLOCK_SIZE));
+
+    std::vector<uint32_t> expectedEnds;
+    std::vector<uint32_t> expectedRows;
+    for (auto &k : kernels)
+    {
+        if (!k.available)
+            continue;
+
+        csvindex idx, alt, inside;
+        csvindex_init(&idx);
+        csvindex_init(&alt);
+        csvindex_init(&inside);
+        idx.fBase = alt.fBase = inside.fBase = (const unsigned char *)doc.data();
+        idx.fLength = alt.fLength = inside.fLength = doc.size();
+        uint64_t carry = 0;
+        k.scan(&idx, nullptr, 0, doc.size(), &carry);
+
+        std::vector<uint32_t> ends(idx.fFieldEnds, idx.fFieldEnds + idx.fFieldCount);
+        std::vector<uint32_t> rows(idx.fRowEnds, idx.fRowEnds + idx.fRowCount);
+        if (expectedEnds.empty()) {
+            expectedEnds = ends;
+            expectedRows = rows;
+        }
+        bool same = (ends == expectedEnds) && (rows == expectedRows);
+
+        // Both starting states at once, against starting inside of quotes
+        uint64_t both = 0;
+        uint64_t insideCarry = ~(uint64_t)0;
+        idx.fFieldCount = idx.fRowCount = 0;
+        k.scan(&idx, &alt, 0, doc.size(), &both);
+        k.scan(&inside, nullptr, 0, doc.size(), &insideCarry);
+        same = same && (std::vector<uint32_t>(idx.fFieldEnds, idx.fFieldEnds + idx.fFieldCount) == expectedEnds);
+        same = same && (alt.fFieldCount == inside.fFieldCount) && (alt.fRowCount == inside.fRowCount);
+        same = same && (memcmp(alt.fFieldEnds, inside.fFieldEnds, alt.fFieldCount * sizeof(uint32_t)) == 0);
+        same = same && (memcmp(alt.fRowEnds, inside.fRowEnds, alt.fRowCount * sizeof(uint32_t)) == 0);
+        same = same && (both == ~insideCarry);
+
+        printf("%-8s: %s\n", k.name, same ? "PASS" : "FAIL");
+        if (!same)
+            failures++;
+        csvindex_destroy(&idx);
+        csvindex_destroy(&alt);
+        csvindex_destroy(&inside);
+    }
+
+    printf("kernels: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_fields()
+{
+    printf("==== test_fields ====\n");
+    int failures = 0;
+
+    static const char *docs[] = {
+        "",
+        "a",
+        "a,b,c\n",
+        "a,b,c",
+        "a,,c\r\n,\r\n\n",
+        "\"a,b\",c,d,e\n",
+        "id,note\n1,\"line one\nline two\"\n2,\"say \"\"hi\"\", ok\"\n",
+        "\"unterminated,\nquote",
+        "x,y,\n",
+    };
+
+    for (const char *doc : docs)
+    {
+        bspan src;
+        bspan_init_from_cstr(&src, doc);
+        csvindex idx;
+        csvindex_init(&idx);
+        csvindex_build(&idx, &src, ',');
+
+        csvrows expected = split_bytes(doc, ',');
+        if ((split_index(idx) != expected) || (split_lines(doc, ',') != expected)) {
+            printf("  differs: %s\n", doc);
+            failures++;
+        }
+        csvindex_destroy(&idx);
+    }
+
+    // Random documents, of every length around the block size
+    for (size_t size = 1; size < 300; size++)
+    {
+        for (unsigned seed = 0; seed < 8; seed++)
+        {
+            std::string doc = make_csv(size, seed, csvPieces);
+            doc.resize(size);
+
+            bspan src;
+            bspan_init_from_data(&src, doc.data(), doc.size());
+            csvindex idx;
+            csvindex_init(&idx);
+            csvindex_build(&idx, &src, ',');
+
+            csvrows expected = split_bytes(doc, ',');
+            if ((split_index(idx) != expected) || (split_lines(doc, ',') != expected))
+                failures++;
+            if (idx.fEndsInQuote != ((std::count(doc.begin(), doc.end(), '"') & 1) == 1))
+                failures++;
+            csvindex_destroy(&idx);
+        }
+    }
+
+    // Other delimiters
+    std::string semi = "a;\"b;c\";d\n1;2;3\n";
+    bspan src;
+    bspan_init_from_data(&src, semi.data(), semi.size());
+    csvindex idx;
+    csvindex_init(&idx);
+    csvindex_build(&idx, &src, ';');
+    if ((split_index(idx) != split_bytes(semi, ';')) || (csvindex_field_count(&idx, 0) != 3))
+        failures++;
+
+    // Rows, and unquoting
+    bspan value;
+    csvindex_row(&idx, 0, &value);
+    if (str(value) != "a;\"b;c\";d")
+        failures++;
+    csvindex_field(&idx, 0, 1, &value);
+    if ((csv_field_unquote(&value) != 1) || (str(value) != "b;c") || (csv_field_unquote(&value) != 0))
+        failures++;
+    if (csvindex_field(&idx, 0, 3, &value) == 0 || csvindex_field(&idx, 2, 0, &value) == 0)
+        failures++;
+    csvindex_destroy(&idx);
+
+    // Trimming, then unquoting
+    bspan_init_from_cstr(&value, " \t\" x, y \"\r\n");
+    if ((csv_field_trim(&value) != 1) || (str(value) != " x, y "))
+        failures++;
+    bspan_init_from_cstr(&value, "\tplain\r");
+    if ((csv_field_trim(&value) != 0) || (str(value) != "plain"))
+        failures++;
+    bspan_init_from_cstr(&value, " \r\n ");
+    if ((csv_field_trim(&value) != 0) || (bspan_size(&value) != 0))
+        failures++;
+
+    // The Byte Order Mark
+    bspan_init_from_cstr(&src, "\xEF\xBB\xBF" "a,b");
+    if ((csv_skip_bom(&src) != 1) || (csv_skip_bom(&src) != 0) || (bspan_size(&src) != 3))
+        failures++;
+
+    printf("fields: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_file(const char *filename)
+{
+    printf("==== test_file ====\n");
+
+    auto mfile = MappedFile::create_shared(filename);
+    if (!mfile) {
+        printf("could not map: %s\n", filename);
+        printf("file: FAIL\n");
+        return;
+    }
+
+    std::string doc((const char *)mfile->data(), mfile->size());
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+    csv_skip_bom(&src);
+
+    csvindex idx;
+    csvindex_init(&idx);
+    csvindex_build(&idx, &src, ',');
+
+    csvrows expected = split_bytes(doc, ',');
+    size_t lines = std::count(doc.begin(), doc.end(), '\n');
+    bool success = (split_index(idx) == expected) && (csvindex_row_count(&idx) >= lines);
+    for (size_t r = 0; r < csvindex_row_count(&idx); r++)
+        if (csvindex_field_count(&idx, r) != 4)
+            success = false;
+
+    bspan heading;
+    csvindex_field(&idx, 0, 2, &heading);
+    if (str(heading) != "Download (b/s)")
+        success = false;
+
+    printf("  %zu rows\n", csvindex_row_count(&idx));
+    csvindex_destroy(&idx);
+
+    // The same file, a thousand times over, for timing
+    std::string big;
+    for (int i = 0; i < 1000; i++)
+        big += doc;
+    bspan_init_from_data(&src, big.data(), big.size());
+
+    auto t0 = std::chrono::steady_clock::now();
+    csvrows bytes = split_bytes(big.substr(0, big.size() / 10), ',');
+    auto t1 = std::chrono::steady_clock::now();
+    csvindex_init(&idx);
+    csvindex_build(&idx, &src, ',');
+    auto t2 = std::chrono::steady_clock::now();
+    size_t lineCount = 0;
+    bspan s = src;
+    bspan line;
+    while (csv_read_line(&s, &line) == 0)
+        lineCount++;
+    auto t3 = std::chrono::steady_clock::now();
+
+    auto mbs = [](size_t n, std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return n / 1e6 / std::chrono::duration<double>(b - a).count();
+    };
+
+    printf("  byte at a time: %8.1f MB/s\n", mbs(big.size() / 10, t0, t1));
+    printf("  csvindex_build: %8.1f MB/s\n", mbs(big.size(), t1, t2));
+    printf("  csv_read_line : %8.1f MB/s\n", mbs(big.size(), t2, t3));
+
+    if ((csvindex_row_count(&idx) != lineCount) || (lineCount != lines * 1000))
+        success = false;
+    csvindex_destroy(&idx);
+
+    printf("file: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_kernels();
+    test_fields();
+    test_file((argc > 1) ? argv[1] : "resources/UsageOverTime.csv");
+}
@@ -0,0 +1,259 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <cinttypes>
+#include <charconv>
+#include <random>
+
+#include "fmtspan.h"
+
+
+// Integers, against snprintf
+void test_integers()
+{
+    printf("==== test_integers ====\n");
+
+    std::mt19937_64 rng(42);
+    char buff[32];
+    char expected[32];
+    int failures = 0;
+
+    for (int i = 0; i < 1000000; i++)
+    {
+        // Spread the values over all the lengths
+        uint64_t v = rng() >> (rng() % 64);
+        if (i < 100)
+            v = (i < 50) ? (uint64_t)i : UINT64_MAX - (uint64_t)(i - 50);
+
+        int len = fmt_u64(buff, v);
+        int elen = snprintf(expected, sizeof(expected), "%" PRIu64, v);
+        if ((len != elen) || (memcmp(buff, expected, (size_t)len) != 0))
+            failures++;
+
+        int64_t sv = (int64_t)v;
+        len = fmt_i64(buff, sv);
+        elen = snprintf(expected, sizeof(expected), "%" PRId64, sv);
+        if ((len != elen) || (memcmp(buff, expected, (size_t)len) != 0))
+            failures++;
+    }
+
+    int len = fmt_i64(buff, INT64_MIN);
+    if ((len != 20) || (memcmp(buff, "-9223372036854775808", 20) != 0))
+        failures++;
+
+    printf("integers: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Hex and binary, against snprintf, and a bit at a time
+void test_hex_bin()
+{
+    printf("==== test_hex_bin ====\n");
+
+    std::mt19937_64 rng(7);
+    char buff[64];
+    char expected[64];
+    int failures = 0;
+
+    for (int i = 0; i < 100000; i++)
+    {
+        uint64_t v = rng();
+        if (i == 0)
+            v = 0;
+        else if (i == 1)
+            v = UINT64_MAX;
+
+        fmt_hex32(buff, (uint32_t)v);
+        snprintf(expected, sizeof(expected), "%08x", (uint32_t)v);
+        if (memcmp(buff, expected, 8) != 0)
+            failures++;
+
+        fmt_hex64(buff, v);
+        snprintf(expected, sizeof(expected), "%016" PRIx64, v);
+        if (memcmp(buff, expected, 16) != 0)
+            failures++;
+
+        fmt_bin32(buff, (uint32_t)v);
+        for (int b = 0; b < 32; b++)
+            expected[b] = ((v >> (31 - b)) & 1) ? '1' : '0';
+        if (memcmp(buff, expected, 32) != 0)
+            failures++;
+    }
+
+    printf("hex/bin: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// The shortest digits, against std::to_chars, which is also shortest,
+// and also picks the closest when there's a choice
+static int check_shortest(double d)
+{
+    char expected[64];
+    auto res = std::to_chars(expected, expected + sizeof(expected), fabs(d), std::chars_format::scientific);
+    *res.ptr = 0;
+
+    uint64_t digits = 0;
+    int32_t exponent = 0;
+    if (fmt_shortest_decimal(d, &digits, &exponent) != 0)
+        return 1;
+
+    // The same, in the layout to_chars uses: d.ddde+xx
+    char dbuff[32];
+    char buff[64];
+    int olength = fmt_u64(dbuff, digits);
+    char *p = buff;
+    *p++ = dbuff[0];
+    if (olength > 1) {
+        *p++ = '.';
+        memcpy(p, dbuff + 1, (size_t)(olength - 1));
+        p += olength - 1;
+    }
+    int e = exponent + olength - 1;
+    p += snprintf(p, 16, "e%c%02d", (e < 0) ? '-' : '+', abs(e));
+
+    if (strcmp(buff, expected) != 0) {
+        printf("  mismatch: %s  expected: %s\n", buff, expected);
+        return 1;
+    }
+
+    return 0;
+}
+
+// The text has to read back as exactly the same double
+static int check_roundtrip(double d)
+{
+    char buff[FMT_DOUBLE_MAX_CHARS + 1];
+    int len = fmt_double(buff, d);
+    buff[len] = 0;
+
+    double back = strtod(buff, nullptr);
+    if (memcmp(&back, &d, sizeof(double)) != 0) {
+        printf("  no roundtrip: %.17g  wrote: %s\n", d, buff);
+        return 1;
+    }
+
+    return 0;
+}
+
+void test_doubles()
+{
+    printf("==== test_doubles ====\n");
+
+    std::mt19937_64 rng(1234);
+    int failures = 0;
+
+    for (int i = 0; i < 1000000; i++)
+    {
+        uint64_t bits = rng();
+        // Some with few significant bits, which print with few digits
+        if (i % 4 == 0)
+            bits &= ~((1ULL << (rng() % 52)) - 1);
+        // Some subnormals
+        if (i % 16 == 1)
+            bits &= 0x800fffffffffffffULL;
+
+        double d;
+        memcpy(&d, &bits, 8);
+        if (!std::isfinite(d))
+            continue;
+
+        failures += check_shortest(d);
+        failures += check_roundtrip(d);
+    }
+
+    // Powers of two have a lopsided interval
+    for (int e = -1074; e <= 1023; e++) {
+        failures += check_shortest(ldexp(1.0, e));
+        failures += check_roundtrip(ldexp(1.0, e));
+    }
+
+    // Integers, and small decimals
+    for (int i = 0; i < 100000; i++) {
+        failures += check_roundtrip((double)i);
+        failures += check_roundtrip(i / 1000.0);
+        failures += check_shortest(i / 1000.0 + 1);
+    }
+
+    printf("doubles: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// The layout of the text
+void test_layout()
+{
+    printf("==== test_layout ====\n");
+
+    struct { double v; const char *text; } cases[] = {
+        { 0.0, "0" }, { -0.0, "-0" }, { 1.0, "1" }, { -2.5, "-2.5" }, { 0.1, "0.1" }, { 100.0, "100" },
+        { 123456.789, "123456.789" }, { 1e21, "1e+21" }, { 1e20, "100000000000000000000" },
+        { 1.5e-7, "1.5e-7" }, { 1e-6, "0.000001" }, { 0.3, "0.3" }, { 5e-324, "5e-324" },
+        { 1.7976931348623157e308, "1.7976931348623157e+308" }, { HUGE_VAL, "inf" }, { -HUGE_VAL, "-inf" },
+    };
+
+    char buff[FMT_DOUBLE_MAX_CHARS + 1];
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        int len = fmt_double(buff, cases[i].v);
+        buff[len] = 0;
+        if (strcmp(buff, cases[i].text) != 0) {
+            printf("  got: %s  expected: %s\n", buff, cases[i].text);
+            failures++;
+        }
+    }
+
+    printf("layout: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Writing through an obuff, both growing and flushing to a sink
+static ptrdiff_t collect(void *ctx, const unsigned char *data, size_t sz)
+{
+    obuff *all = (obuff *)ctx;
+    obuff_put_data(all, data, sz);
+    return (ptrdiff_t)sz;
+}
+
+void test_obuff()
+{
+    printf("==== test_obuff ====\n");
+
+    obuff grown;
+    obuff all;
+    obuff sunk;
+    obuff_init(&grown, 0);
+    obuff_init(&all, 0);
+    obuff_init_with_sink(&sunk, collect, &all, 64);
+
+    for (int i = 0; i < 10000; i++)
+    {
+        obuff *outs[2] = { &grown, &sunk };
+        for (int j = 0; j < 2; j++) {
+            fmt_put_i64(outs[j], i - 5000);
+            obuff_put_byte(outs[j], ',');
+            fmt_put_double(outs[j], i / 7.0);
+            obuff_put_byte(outs[j], ',');
+            fmt_put_hex32(outs[j], (uint32_t)i);
+            obuff_put_cstr(outs[j], "\n");
+        }
+    }
+    obuff_flush(&sunk);
+
+    bspan a, b;
+    obuff_span(&grown, &a);
+    obuff_span(&all, &b);
+    bool success = (bspan_size(&a) > 0) && (bspan_compare_span(&a, &b) == 0) && (obuff_total(&sunk) == bspan_size(&a)) && (obuff_size(&sunk) == 0);
+
+    obuff_destroy(&grown);
+    obuff_destroy(&all);
+    obuff_destroy(&sunk);
+
+    printf("obuff: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_integers();
+    test_hex_bin();
+    test_layout();
+    test_doubles();
+    test_obuff();
+}
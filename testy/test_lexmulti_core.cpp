@@ -0,0 +1,122 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "lexmulti.h"
+
+
+// The obvious, slow, leftmost-first search to check against
+static int naive_find(const char * const *pats, int count, const unsigned char *y, size_t n, size_t *matchAt)
+{
+    for (size_t j = 0; j < n; j++)
+    {
+        for (int p = 0; p < count; p++)
+        {
+            size_t len = strlen(pats[p]);
+            if ((j + len <= n) && (memcmp(y + j, pats[p], len) == 0)) {
+                *matchAt = j;
+                return p;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static int check_set(lexmulti_teddy_fn teddyFn, const char * const *pats, int count, const unsigned char *y, size_t n)
+{
+    lexmulti m;
+    lexmulti_init(&m, pats, count);
+
+    size_t expectedAt = 0;
+    int expected = naive_find(pats, count, y, n, &expectedAt);
+
+    int failures = 0;
+    size_t at = 0;
+    int id = (teddyFn != nullptr && m.fUseTeddy) ? teddyFn(&m, y, n, &at) : lexmulti_find_at(&m, y, n, &at);
+    if ((id != expected) || ((id >= 0) && (at != expectedAt)))
+        failures++;
+
+    // and the same thing with the automaton
+    id = lexmulti_aho_corasick(&m, y, n, &at);
+    if ((id != expected) || ((id >= 0) && (at != expectedAt)))
+        failures++;
+
+    lexmulti_destroy(&m);
+
+    return failures;
+}
+
+static int check_kernel(const char *name, lexmulti_teddy_fn teddyFn)
+{
+    static const char *small[] = { "?xml", "?", "!DOCTYPE", "!--", "![CDATA[", "!ENTITY", "/" };
+    static const char *overlap[] = { "abcd", "bc", "abc", "b", "cdab" };
+    static const char *large[] = { "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta",
+        "iota", "kappa", "lambda", "mu", "nu", "xi", "omicron", "pi", "rho", "sigma", "tau", "ta" };
+    static unsigned char buf[1500];
+    int failures = 0;
+
+    srand(7);
+    for (int trial = 0; trial < 300; trial++)
+    {
+        const char *alphabet = (trial % 3 == 0) ? "?xml!-/DOCTYPE[]" : ((trial % 3 == 1) ? "abcd" : "abeilmnoprstuxz");
+        size_t alen = strlen(alphabet);
+        size_t n = (size_t)(rand() % sizeof(buf));
+        for (size_t i = 0; i < n; i++)
+            buf[i] = (unsigned char)alphabet[rand() % alen];
+
+        failures += check_set(teddyFn, small, 7, buf, n);
+        failures += check_set(teddyFn, overlap, 5, buf, n);
+        failures += check_set(teddyFn, large, 20, buf, n);
+    }
+
+    printf("%-8s: %s\n", name, failures == 0 ? "PASS" : "FAIL");
+    return failures;
+}
+
+void test_kernels()
+{
+    printf("==== test_kernels ====\n");
+    check_kernel("scalar", lexmulti_teddy_scalar);
+
+#if defined(PC_ARCH_X86)
+    if (pc_cpu_has(PC_CPU_SSSE3))
+        check_kernel("ssse3", lexmulti_teddy_ssse3);
+    if (pc_cpu_has(PC_CPU_AVX2))
+        check_kernel("avx2", lexmulti_teddy_avx2);
+#endif
+
+    check_kernel("default", nullptr);
+}
+
+void test_match_prefix()
+{
+    printf("==== test_match_prefix ====\n");
+    static const char *prefixes[] = { "?xml", "?", "!DOCTYPE", "!--", "![CDATA[", "!ENTITY", "/" };
+    static const char *inputs[] = { "?xml version='1.0'?>", "?pi data?>", "!DOCTYPE html>", "!-- c -->",
+        "![CDATA[x]]>", "!ENTITY e 'v'>", "/tag>", "tag>", "!-", "?", nullptr };
+    static const int expected[] = { 0, 1, 2, 3, 4, 5, 6, -1, -1, 1 };
+
+    lexmulti m;
+    lexmulti_init(&m, prefixes, 7);
+
+    int failures = 0;
+    for (int i = 0; inputs[i] != nullptr; i++)
+    {
+        bspan src;
+        bspan match;
+        bspan_init_from_cstr(&src, inputs[i]);
+        int id = lexmulti_match_prefix(&m, &src, &match);
+        if ((id != expected[i]) || ((id >= 0) && (bspan_size(&match) != strlen(prefixes[id]))))
+            failures++;
+    }
+
+    lexmulti_destroy(&m);
+    printf("match_prefix: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_kernels();
+    test_match_prefix();
+}
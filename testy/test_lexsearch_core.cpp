@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "lexsearch.h"
+#include "lexutil.h"
+
+
+// The obvious, slow, search to check against
+static size_t naive_find(const unsigned char *x, size_t m, const unsigned char *y, size_t n)
+{
+    if (m == 0)
+        return 0;
+
+    for (size_t j = 0; j + m <= n; j++)
+        if (memcmp(y + j, x, m) == 0)
+            return j;
+
+    return n;
+}
+
+static int check_find(lexsearch_find_fn findFn, const char *needle, const unsigned char *y, size_t n)
+{
+    lexsearch srch;
+    lexsearch_init_from_cstr(&srch, needle);
+    size_t m = strlen(needle);
+    size_t expected = naive_find((const unsigned char *)needle, m, y, n);
+
+    size_t found = (findFn != nullptr) ? findFn(&srch, y, n) : lexsearch_find(&srch, y, n);
+    size_t twoWay = lexsearch_two_way(&srch, y, n);
+    if ((m < 2) || (m > n))
+        return found != expected;
+
+    return (found != expected) || (twoWay != expected);
+}
+
+static int check_kernel(const char *name, lexsearch_find_fn findFn)
+{
+    static unsigned char buf[2048];
+    static const char *needles[] = { "-->", "]]>", "]>", "a", "ab", "aab", "abab", "aaaab", "abcabcabd",
+        "baaaaaaaaaa", "zyxzyxzyw", "abacabad", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", nullptr };
+    int failures = 0;
+
+    srand(42);
+    for (int trial = 0; trial < 200; trial++)
+    {
+        // small alphabets give lots of partial matches
+        int alphabet = 1 + (trial % 4);
+        size_t n = (size_t)(rand() % sizeof(buf));
+        for (size_t i = 0; i < n; i++)
+            buf[i] = (unsigned char)('a' + (rand() % alphabet));
+
+        for (int i = 0; needles[i] != nullptr; i++)
+        {
+            // plant the needle somewhere, some of the time
+            size_t m = strlen(needles[i]);
+            if (((trial & 1) == 0) && (m < n))
+                memcpy(buf + (rand() % (n - m + 1)), needles[i], m);
+
+            failures += check_find(findFn, needles[i], buf, n);
+        }
+    }
+
+    // The worst case for the filter
+    memset(buf, 'a', sizeof(buf));
+    failures += check_find(findFn, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", buf, sizeof(buf));
+    buf[sizeof(buf) - 1] = 'b';
+    failures += check_find(findFn, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", buf, sizeof(buf));
+
+    printf("%-8s: %s\n", name, failures == 0 ? "PASS" : "FAIL");
+    return failures;
+}
+
+void test_kernels()
+{
+    printf("==== test_kernels ====\n");
+    check_kernel("scalar", lexsearch_kern_find_scalar);
+
+#if defined(PC_ARCH_X86)
+    if (pc_cpu_has(PC_CPU_SSE2))
+        check_kernel("sse2", lexsearch_kern_find_sse2);
+    if (pc_cpu_has(PC_CPU_AVX2))
+        check_kernel("avx2", lexsearch_kern_find_avx2);
+#endif
+
+    check_kernel("default", nullptr);
+}
+
+void test_find_cstr()
+{
+    printf("==== test_find_cstr ====\n");
+    bspan src;
+    bspan rest;
+    bspan_init_from_cstr(&src, "<!-- a comment -- with dashes --> after");
+
+    int ret = lex_find_cstr(&src, "-->", &rest);
+    printf("found : %s\n", ((ret == 0) && lex_begins_with_cstr(&rest, "--> after")) ? "PASS" : "FAIL");
+
+    ret = lex_find_cstr(&src, "]]>", &rest);
+    printf("missing: %s\n", ((ret == -1) && bspan_is_empty(&rest) && (bspan_begin(&rest) == bspan_end(&src))) ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_kernels();
+    test_find_cstr();
+}
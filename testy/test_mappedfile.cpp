@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "mappedfile.h"
+
+using namespace pcore;
+
+
+// Map a file read only, and compare it against reading it
+// the ordinary way
+void test_readonly(const char *filename)
+{
+    printf("==== test_readonly ====\n");
+
+    auto mfile = MappedFile::create_shared(filename, MAPPED_READONLY, MAPPED_HINT_SEQUENTIAL | MAPPED_HINT_POPULATE);
+    if (!mfile) {
+        printf("could not map: %s\n", filename);
+        return;
+    }
+
+    FILE *fp = fopen(filename, "rb");
+    if (fp == nullptr)
+        return;
+
+    fseek(fp, 0, SEEK_END);
+    size_t fsize = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    unsigned char *contents = new unsigned char[fsize + 1];
+    size_t nRead = fread(contents, 1, fsize, fp);
+    fclose(fp);
+
+    bspan s = mfile->span();
+    bspan expected;
+    bspan_init_from_data(&expected, contents, nRead);
+
+    printf("size: %s\n", (bspan_size(&s) == fsize) ? "PASS" : "FAIL");
+    printf("data: %s\n", (bspan_compare_span(&s, &expected) == 0) ? "PASS" : "FAIL");
+
+    delete[] contents;
+}
+
+// Create a file through a writable mapping, then read it back
+void test_readwrite()
+{
+    printf("==== test_readwrite ====\n");
+
+    const char *filename = "mappedfile_test.tmp";
+    {
+        auto mfile = MappedFile::create_shared(filename, MAPPED_READWRITE, MAPPED_HINT_NONE, 4096);
+        if (!mfile) {
+            printf("could not create: %s\n", filename);
+            return;
+        }
+
+        bspan s = mfile->span();
+        bspan_set_all(&s, 'z');
+        mfile->flush();
+    }
+
+    auto mfile = MappedFile::create_shared(filename);
+    bool success = mfile && (mfile->size() == 4096);
+    for (size_t i = 0; success && i < mfile->size(); i++)
+        success = ((const unsigned char *)mfile->data())[i] == 'z';
+
+    printf("write: %s\n", success ? "PASS" : "FAIL");
+
+    if (mfile)
+        mfile->close();
+    remove(filename);
+}
+
+int main(int argc, char* argv[])
+{
+    test_readonly((argc > 1) ? argv[1] : "resources/place_78.csv");
+    test_readwrite();
+}
@@ -0,0 +1,178 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+
+#include "streamwin.h"
+
+
+// A stream source that hands out a string in
+// small, uneven pieces
+struct stringsource {
+    const char *fData;
+    size_t fSize;
+    size_t fPos;
+    size_t fMaxRead;
+};
+
+static ptrdiff_t string_read(void *ctx, unsigned char *buff, size_t sz)
+{
+    stringsource *src = (stringsource *)ctx;
+    size_t avail = src->fSize - src->fPos;
+    size_t n = (sz < avail) ? sz : avail;
+    if (n > src->fMaxRead)
+        n = src->fMaxRead;
+
+    memcpy(buff, src->fData + src->fPos, n);
+    src->fPos += n;
+
+    return (ptrdiff_t)n;
+}
+
+// Tokens that straddle the blocks should come out whole
+void test_tokens()
+{
+    printf("==== test_tokens ====\n");
+
+    const char *text = "alpha\nbeta\n\ngamma-delta-epsilon-zeta-eta-theta\niota\nkappa";
+    const char *expected[] = { "alpha", "beta", "", "gamma-delta-epsilon-zeta-eta-theta", "iota", "kappa", nullptr };
+
+    asciiset linechars;
+    asciiset_init_from_char(&linechars, '\n');
+
+    int failures = 0;
+    for (size_t blockSize = 1; blockSize < 20; blockSize++)
+    {
+        stringsource src = { text, strlen(text), 0, (blockSize % 3) + 1 };
+        streamwin win;
+        streamwin_init_from_callback(&win, string_read, &src, blockSize);
+
+        bspan tok;
+        int i = 0;
+        while (streamwin_next_token(&win, &linechars, &tok) == 0)
+        {
+            bspan exp;
+            bspan_init_from_cstr(&exp, expected[i] != nullptr ? expected[i] : "");
+            if ((expected[i] == nullptr) || (bspan_compare_span(&tok, &exp) != 0))
+                failures++;
+            if (expected[i] != nullptr)
+                i++;
+        }
+
+        if ((expected[i] != nullptr) || !streamwin_is_done(&win) || (streamwin_offset(&win) != strlen(text)))
+            failures++;
+
+        streamwin_destroy(&win);
+    }
+
+    printf("tokens: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// A token that is larger than the limit on the window
+void test_limit()
+{
+    printf("==== test_limit ====\n");
+
+    static char text[200];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = 0;
+
+    stringsource src = { text, strlen(text), 0, 1000 };
+    streamwin win;
+    streamwin_init_from_callback(&win, string_read, &src, 16);
+    streamwin_set_max_size(&win, 64);
+
+    bool tooBig = (streamwin_require(&win, 100) == -1) && (streamwin_size(&win) <= 64);
+    streamwin_destroy(&win);
+
+    // A token that is too big is not handed out as the last token
+    asciiset linechars;
+    asciiset_init_from_char(&linechars, '\n');
+    src.fPos = 0;
+    streamwin_init_from_callback(&win, string_read, &src, 16);
+    streamwin_set_max_size(&win, 64);
+
+    bspan tok;
+    if ((streamwin_next_token(&win, &linechars, &tok) != -2) || !bspan_is_empty(&tok) || (streamwin_offset(&win) != 0))
+        tooBig = false;
+    streamwin_destroy(&win);
+
+    printf("limit: %s\n", tooBig ? "PASS" : "FAIL");
+}
+
+// A stream that fails part way through a token
+static ptrdiff_t failing_read(void *ctx, unsigned char *buff, size_t sz)
+{
+    stringsource *src = (stringsource *)ctx;
+    if (src->fPos >= src->fSize)
+        return -1;
+
+    return string_read(ctx, buff, sz);
+}
+
+void test_error()
+{
+    printf("==== test_error ====\n");
+
+    const char *text = "one\ntwo\nthr";
+    stringsource src = { text, strlen(text), 0, 5 };
+    streamwin win;
+    streamwin_init_from_callback(&win, failing_read, &src, 8);
+
+    asciiset linechars;
+    asciiset_init_from_char(&linechars, '\n');
+
+    bspan tok;
+    int tokens = 0;
+    int result;
+    while ((result = streamwin_next_token(&win, &linechars, &tok)) == 0)
+        tokens++;
+
+    printf("error: %s\n", ((tokens == 2) && (result == -2) && (streamwin_size(&win) == 3)) ? "PASS" : "FAIL");
+
+    streamwin_destroy(&win);
+}
+
+// Count the lines of a file, reading through a file descriptor
+void test_fd(const char *filename)
+{
+    printf("==== test_fd ====\n");
+
+    FILE *fp = fopen(filename, "rb");
+    if (fp == nullptr) {
+        printf("could not open: %s\n", filename);
+        return;
+    }
+    size_t expected = 0;
+    int c;
+    while ((c = fgetc(fp)) != EOF)
+        if (c == '\n')
+            expected++;
+    fclose(fp);
+
+    int fd = open(filename, O_RDONLY);
+    streamwin win;
+    streamwin_init_from_fd(&win, fd, 4096);
+
+    asciiset linechars;
+    asciiset_init_from_char(&linechars, '\n');
+
+    size_t lines = 0;
+    bspan tok;
+    while (streamwin_next_token(&win, &linechars, &tok) == 0)
+        lines++;
+
+    // The last line may not have a line ending
+    printf("lines: %s\n", ((lines == expected) || (lines == expected + 1)) ? "PASS" : "FAIL");
+
+    streamwin_destroy(&win);
+    close(fd);
+}
+
+int main(int argc, char* argv[])
+{
+    test_tokens();
+    test_limit();
+    test_error();
+    test_fd((argc > 1) ? argv[1] : "resources/place_78.csv");
+}
@@ -0,0 +1,156 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "bspanprint.h"
+#include "xmlscan.h"
+#include "testhelpers.h"
+
+// Scan the first element of the source, which should be a tag
+static int first_tag(const char *cstr, bspan *src, xmlelement *elem)
+{
+    bspan_init_from_cstr(src, cstr);
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, src);
+
+    return xml_iter_next_element(&params, &st, elem);
+}
+
+void test_iterate()
+{
+    printf("==== test_iterate ====\n");
+
+    bspan src;
+    xmlelement elem;
+    first_tag("<svg width='100' height = \"200\"\n  xlink:href=\"#a'b\" viewBox='0 0 10 10'>text</svg>", &src, &elem);
+
+    xmlattriter iter;
+    xmlattr attr;
+    xml_attr_iter_init(&iter, &elem);
+    while (xml_attr_iter_next(&iter, &attr) == 0)
+    {
+        writeSpan(attr.fName);
+        printf(" = [");
+        writeSpan(attr.fValue);
+        printf("]\n");
+    }
+}
+
+// Each case is a tag, and the name/value pairs expected from it
+struct attrcase {
+    const char *tag;
+    const char *pairs[9];
+};
+
+void test_cases()
+{
+    printf("==== test_cases ====\n");
+
+    static const attrcase cases[] = {
+        { "<a>", { nullptr } },
+        { "<a   >", { nullptr } },
+        { "<a/>", { nullptr } },
+        { "<a x='1'/>", { "x", "1", nullptr } },
+        { "<a x='1' />", { "x", "1", nullptr } },
+        { "<a x=\"\" y=''>", { "x", "", "y", "", nullptr } },
+        { "<a x = '1'\ty\r\n=\n\"2\">", { "x", "1", "y", "2", nullptr } },
+        { "<a x='has \"double\" quotes' y=\"has 'single'\">", { "x", "has \"double\" quotes", "y", "has 'single'", nullptr } },
+        { "<option selected value='3'>", { "selected", "", "value", "3", nullptr } },
+        { "<a x=1 y=two>", { "x", "1", "y", "two", nullptr } },
+        { "<a xmlns:svg='urn:svg' svg:x='9'>", { "xmlns:svg", "urn:svg", "svg:x", "9", nullptr } },
+        { "<a x='unterminated>", { "x", "unterminated", nullptr } },
+    };
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        bspan src;
+        xmlelement elem;
+        if (first_tag(cases[i].tag, &src, &elem) != 0) {
+            printf("  no element: %s\n", cases[i].tag);
+            failures++;
+            continue;
+        }
+
+        xmlattriter iter;
+        xmlattr attr;
+        xml_attr_iter_init(&iter, &elem);
+
+        int p = 0;
+        while (xml_attr_iter_next(&iter, &attr) == 0)
+        {
+            if ((cases[i].pairs[p] == nullptr) || !span_is(attr.fName, cases[i].pairs[p]) || !span_is(attr.fValue, cases[i].pairs[p + 1])) {
+                printf("  mismatch: %s\n", cases[i].tag);
+                failures++;
+                break;
+            }
+            p += 2;
+        }
+
+        if (cases[i].pairs[p] != nullptr) {
+            printf("  missing: %s\n", cases[i].tag);
+            failures++;
+        }
+    }
+
+    printf("cases: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_find()
+{
+    printf("==== test_find ====\n");
+
+    bspan src;
+    xmlelement elem;
+    first_tag("<rect x='1' y='2' width='30' height='40' x='again' fill:x='red'/>", &src, &elem);
+
+    bspan value;
+    int failures = 0;
+
+    if ((xml_element_find_attribute_cstr(&elem, "x", &value) != 0) || !span_is(value, "1"))
+        failures++;
+    if ((xml_element_find_attribute_cstr(&elem, "height", &value) != 0) || !span_is(value, "40"))
+        failures++;
+    if ((xml_element_find_attribute_cstr(&elem, "fill:x", &value) != 0) || !span_is(value, "red"))
+        failures++;
+    if ((xml_element_find_attribute_cstr(&elem, "w", &value) == 0) || bspan_is_valid(&value))
+        failures++;
+    if (xml_element_find_attribute_cstr(&elem, "widths", &value) == 0)
+        failures++;
+
+    // The value points into the source, it's not a copy
+    xml_element_find_attribute_cstr(&elem, "width", &value);
+    if ((bspan_begin(&value) < bspan_begin(&src)) || (bspan_end(&value) > bspan_end(&src)))
+        failures++;
+
+    printf("find: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// The name of a self closing tag never has the '/' on it
+void test_names()
+{
+    printf("==== test_names ====\n");
+
+    static const char *tags[] = { "<br/>", "<br />", "<br x='1'/>", "<br>", "</br>", "<svg:br/>" };
+    int failures = 0;
+    for (const char *tag : tags)
+    {
+        bspan src;
+        xmlelement elem;
+        if ((first_tag(tag, &src, &elem) != 0) || !span_is(elem.fXmlName.fName, "br"))
+            failures++;
+    }
+
+    printf("names: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_iterate();
+    test_cases();
+    test_find();
+    test_names();
+}
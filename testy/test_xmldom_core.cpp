@@ -0,0 +1,274 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "bspanprint.h"
+#include "xmldom.h"
+#include "testhelpers.h"
+
+static void printTree(const xmldom *dom, uint32_t node, int depth)
+{
+    for (uint32_t n = xmldom_first_child(dom, node); n != XMLDOM_NONE; n = xmldom_next_sibling(dom, n))
+    {
+        bspan s;
+        printf("%*s%d ", depth * 2, "", xmldom_kind(dom, n));
+        if (xmldom_name(dom, n, &s) == 0)
+            writeSpan(s);
+        else {
+            xmldom_data(dom, n, &s);
+            printf("[");
+            writeSpan(s);
+            printf("]");
+        }
+        printf("\n");
+        printTree(dom, n, depth + 1);
+    }
+}
+
+void test_structure()
+{
+    printf("==== test_structure ====\n");
+
+    bspan src;
+    bspan_init_from_cstr(&src,
+        "<?xml version='1.0'?>"
+        "<svg width='100'>"
+        "<g id='a'><rect x='1'/><rect x='2'/><circle r='3'></circle></g>"
+        "<g id='b'>text<br/><!-- comment --></g>"
+        "<rect x='3'/>"
+        "</svg>");
+
+    xmldom dom;
+    xmldom_init(&dom);
+    xmldom_build_from_source(&dom, &src);
+    printTree(&dom, XMLDOM_ROOT, 0);
+
+    int failures = 0;
+    uint32_t svgName = xmldom_find_name_cstr(&dom, "svg");
+    uint32_t gName = xmldom_find_name_cstr(&dom, "g");
+    uint32_t rectName = xmldom_find_name_cstr(&dom, "rect");
+    uint32_t brName = xmldom_find_name_cstr(&dom, "br");
+
+    if ((xmldom_find_name_cstr(&dom, "path") != XMLDOM_NONE) || (brName == XMLDOM_NONE))
+        failures++;
+
+    uint32_t svg = xmldom_first_child_named(&dom, XMLDOM_ROOT, svgName);
+    if ((svg == XMLDOM_NONE) || (xmldom_parent(&dom, svg) != XMLDOM_ROOT))
+        failures++;
+
+    // Two g's, then a rect, directly under the svg
+    uint32_t g1 = xmldom_first_child_named(&dom, svg, gName);
+    uint32_t g2 = xmldom_next_sibling_named(&dom, g1, gName);
+    if ((g1 == XMLDOM_NONE) || (g2 == XMLDOM_NONE) || (xmldom_next_sibling_named(&dom, g2, gName) != XMLDOM_NONE))
+        failures++;
+
+    uint32_t rect = xmldom_first_child_named(&dom, svg, rectName);
+    bspan value;
+    xmlattriter iter;
+    xmlattr attr;
+    xmldom_attr_iter_init(&dom, rect, &iter);
+    if ((xml_attr_iter_next(&iter, &attr) != 0) || !span_is(attr.fValue, "3"))
+        failures++;
+
+    // The rects in the first g
+    int rects = 0;
+    for (uint32_t n = xmldom_first_child_named(&dom, g1, rectName); n != XMLDOM_NONE; n = xmldom_next_sibling_named(&dom, n, rectName)) {
+        if (xmldom_parent(&dom, n) != g1)
+            failures++;
+        rects++;
+    }
+    if (rects != 2)
+        failures++;
+
+    // Content and comment in the second g
+    uint32_t text = xmldom_first_child(&dom, g2);
+    xmldom_data(&dom, text, &value);
+    if ((xmldom_kind(&dom, text) != XML_ELEMENT_TYPE_CONTENT) || !span_is(value, "text"))
+        failures++;
+
+    xmldom_destroy(&dom);
+
+    printf("structure: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Badly nested documents still make a tree
+void test_mismatched()
+{
+    printf("==== test_mismatched ====\n");
+
+    bspan src;
+    bspan_init_from_cstr(&src, "<a><b><c></b>after</x><d></a><e>");
+
+    xmldom dom;
+    xmldom_init(&dom);
+    xmldom_build_from_source(&dom, &src);
+    printTree(&dom, XMLDOM_ROOT, 0);
+
+    // </b> closes c and b, </x> is ignored, </a> closes d and a, e is left open
+    int failures = 0;
+    uint32_t a = xmldom_first_child(&dom, XMLDOM_ROOT);
+    uint32_t e = xmldom_next_sibling(&dom, a);
+    uint32_t b = xmldom_first_child(&dom, a);
+    uint32_t after = xmldom_next_sibling(&dom, b);
+    uint32_t d = xmldom_next_sibling(&dom, after);
+    if ((xmldom_count(&dom) != 7) || (e == XMLDOM_NONE) || (d == XMLDOM_NONE) || (xmldom_parent(&dom, d) != a) ||
+        (xmldom_kind(&dom, after) != XML_ELEMENT_TYPE_CONTENT))
+        failures++;
+
+    xmldom_destroy(&dom);
+
+    printf("mismatched: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// A node per element on the heap, with its children in a vector, which
+// is what consumers have been building for themselves
+struct PointerNode {
+    int fKind;
+    std::string fName;
+    bspan fData;
+    PointerNode *fParent;
+    std::vector<PointerNode *> fChildren;
+};
+
+static size_t pointerTreeBytes = 0;
+
+// What the heap really uses for an allocation, with its header, and
+// rounded up, as the usual 64-bit malloc() does
+static size_t heapBytes(size_t sz)
+{
+    size_t chunk = (sz + 8 + 15) & ~(size_t)15;
+    return (chunk < 32) ? 32 : chunk;
+}
+
+static PointerNode *newNode(int kind, const bspan &name, const bspan &data, PointerNode *parent)
+{
+    PointerNode *n = new PointerNode{ kind, std::string((const char *)bspan_begin(&name), bspan_size(&name)), data, parent, {} };
+    pointerTreeBytes += heapBytes(sizeof(PointerNode)) + (n->fName.size() > 15 ? heapBytes(n->fName.size() + 1) : 0);
+    if (parent != nullptr) {
+        size_t oldCapacity = parent->fChildren.capacity();
+        parent->fChildren.push_back(n);
+        if (parent->fChildren.capacity() != oldCapacity) {
+            if (oldCapacity > 0)
+                pointerTreeBytes -= heapBytes(oldCapacity * sizeof(PointerNode *));
+            pointerTreeBytes += heapBytes(parent->fChildren.capacity() * sizeof(PointerNode *));
+        }
+    }
+    return n;
+}
+
+static PointerNode *buildPointerTree(bspan *src)
+{
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, src);
+
+    bspan empty;
+    bspan_init(&empty);
+    PointerNode *root = newNode(0, empty, empty, nullptr);
+    PointerNode *current = root;
+    while (xml_iter_next_element(&params, &st, &elem) == 0)
+    {
+        if (elem.fElementKind == XML_ELEMENT_TYPE_END_TAG) {
+            if (current->fParent != nullptr)
+                current = current->fParent;
+            continue;
+        }
+
+        PointerNode *n = newNode(elem.fElementKind, elem.fNameSpan, elem.fData, current);
+        if (elem.fElementKind == XML_ELEMENT_TYPE_START_TAG)
+            current = n;
+    }
+
+    return root;
+}
+
+static void freePointerTree(PointerNode *n)
+{
+    for (PointerNode *c : n->fChildren)
+        freePointerTree(c);
+    delete n;
+}
+
+static size_t walkPointerTree(const PointerNode *n)
+{
+    size_t count = 1;
+    for (const PointerNode *c : n->fChildren)
+        count += walkPointerTree(c);
+    return count;
+}
+
+void test_large()
+{
+    printf("==== test_large ====\n");
+
+    std::string doc = "<svg width='100' height='100'>\n";
+    for (int i = 0; i < 200000; i++)
+        doc += "<g transform='translate(1,2)'><path d='M 10,20 L 30 40'/><rect x='1' y='2' width='3' height='4'/></g>\n";
+    doc += "</svg>\n";
+
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    auto t0 = std::chrono::steady_clock::now();
+    xmldom dom;
+    xmldom_init(&dom);
+    xmldom_build_from_source(&dom, &src);
+    auto t1 = std::chrono::steady_clock::now();
+
+    // Depth first is front to back
+    size_t rects = 0;
+    uint32_t rectName = xmldom_find_name_cstr(&dom, "rect");
+    for (uint32_t n = 0; n < xmldom_count(&dom); n++)
+        if (xmldom_name_id(&dom, n) == rectName)
+            rects++;
+    auto t2 = std::chrono::steady_clock::now();
+
+    PointerNode *root = buildPointerTree(&src);
+    auto t3 = std::chrono::steady_clock::now();
+    size_t pointerCount = walkPointerTree(root);
+    auto t4 = std::chrono::steady_clock::now();
+    freePointerTree(root);
+
+    auto ms = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+
+    printf("  %zu nodes\n", xmldom_count(&dom));
+    printf("  xmldom  : %10zu bytes, build %7.2f ms, walk %6.2f ms\n", xmldom_memory(&dom), ms(t0, t1), ms(t1, t2));
+    printf("  pointers: %10zu bytes, build %7.2f ms, walk %6.2f ms\n", pointerTreeBytes, ms(t2, t3), ms(t3, t4));
+
+    // The same, with the scanner using an index
+    xmlindex idx;
+    xmlindex_init(&idx);
+    xmlindex_build(&idx, &src);
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_index(&st, &src, &idx);
+
+    xmldom indexed;
+    xmldom_init(&indexed);
+    xmldom_build(&indexed, &params, &st);
+
+    bool success = (rects == 200000) && (pointerCount == xmldom_count(&dom)) && (xmldom_memory(&dom) * 4 < pointerTreeBytes) &&
+        (xmldom_count(&indexed) == xmldom_count(&dom)) && (memcmp(indexed.fNextSibling, dom.fNextSibling, xmldom_count(&dom) * 4) == 0);
+
+    xmldom_destroy(&indexed);
+    xmlindex_destroy(&idx);
+    xmldom_destroy(&dom);
+
+    printf("large: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_structure();
+    test_mismatched();
+    test_large();
+}
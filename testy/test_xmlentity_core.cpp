@@ -0,0 +1,173 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "xmlentity.h"
+#include "testhelpers.h"
+
+void test_arena()
+{
+    printf("==== test_arena ====\n");
+
+    arena a;
+    arena_init(&a, 256);
+    int failures = 0;
+
+    // Small and oversized allocations, all aligned, none overlapping
+    unsigned char *ptrs[100];
+    size_t sizes[100];
+    for (int i = 0; i < 100; i++) {
+        sizes[i] = (i % 10 == 9) ? 1000 : (size_t)(i + 1);
+        ptrs[i] = (unsigned char *)arena_alloc(&a, sizes[i]);
+        if ((ptrs[i] == nullptr) || (((uintptr_t)ptrs[i] % ARENA_ALIGNMENT) != 0))
+            failures++;
+        memset(ptrs[i], i, sizes[i]);
+    }
+    for (int i = 0; i < 100; i++) {
+        for (size_t j = 0; j < sizes[i]; j++)
+            if (ptrs[i][j] != (unsigned char)i)
+                failures++;
+    }
+
+    arena_reset(&a);
+    if (arena_total(&a) != 0)
+        failures++;
+    if (arena_alloc(&a, 10) == nullptr)
+        failures++;
+
+    arena_destroy(&a);
+
+    printf("arena: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_predefined()
+{
+    printf("==== test_predefined ====\n");
+
+    struct { const char *text; const char *decoded; } cases[] = {
+        { "", "" },
+        { "no references", "no references" },
+        { "&lt;&gt;&amp;&apos;&quot;", "<>&'\"" },
+        { "a &lt; b &amp;&amp; c &gt; d", "a < b && c > d" },
+        { "&#65;&#x42;&#x63;", "ABc" },
+        { "&#xe9; &#233;", "\xc3\xa9 \xc3\xa9" },
+        { "&#x20AC;", "\xe2\x82\xac" },
+        { "&#x1F600;", "\xf0\x9f\x98\x80" },
+        { "AT&T", "AT&T" },
+        { "&unknown; &", "&unknown; &" },
+        { "&#0; &#xD800; &#x110000; &#xZZ; &#; &;", "&#0; &#xD800; &#x110000; &#xZZ; &#; &;" },
+        { "trailing &amp", "trailing &amp" },
+        { "&amp;lt;", "&lt;" },
+    };
+
+    arena a;
+    arena_init(&a, 0);
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        bspan src;
+        bspan out;
+        bspan_init_from_cstr(&src, cases[i].text);
+        xml_decode_span(&src, nullptr, &a, &out);
+
+        if (!span_is(out, cases[i].decoded)) {
+            printf("  got: %.*s  expected: %s\n", (int)bspan_size(&out), (const char *)bspan_begin(&out), cases[i].decoded);
+            failures++;
+        }
+
+        // Text without a '&' is not copied
+        bool hasRef = strchr(cases[i].text, '&') != nullptr;
+        if ((xml_decode_has_references(&src) != 0) != hasRef)
+            failures++;
+        if (!hasRef && !bspan_shallow_equal(&out, &src))
+            failures++;
+    }
+
+    arena_destroy(&a);
+
+    printf("predefined: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_declared()
+{
+    printf("==== test_declared ====\n");
+
+    const char *doc =
+        "<?xml version='1.0'?>\n"
+        "<!DOCTYPE note [\n"
+        "  <!ELEMENT note (#PCDATA)>\n"
+        "  <!ENTITY company \"Acme &amp; Sons\">\n"
+        "  <!ENTITY empty ''>\n"
+        "  <!ENTITY % param 'not used'>\n"
+        "  <!ENTITY logo SYSTEM 'logo.gif'>\n"
+        "  <!ENTITY company 'declared twice'>\n"
+        "]>\n"
+        "<!ENTITY greeting 'Hello'>\n"
+        "<note>&greeting;, from &company;&empty;!  &logo; &param;</note>";
+
+    bspan src;
+    bspan_init_from_cstr(&src, doc);
+
+    xmlentitytable entities;
+    xml_entity_table_init(&entities);
+
+    arena a;
+    arena_init(&a, 0);
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, &src);
+
+    int failures = 0;
+    bool sawContent = false;
+    while (xml_iter_next_element(&params, &st, &elem) == 0)
+    {
+        xml_entity_table_add_element(&entities, &elem);
+
+        // The only content with references is in the <note>
+        if ((elem.fElementKind == XML_ELEMENT_TYPE_CONTENT) && xml_decode_has_references(&elem.fData)) {
+            bspan text;
+            xml_decode_span(&elem.fData, &entities, &a, &text);
+            printf("  %.*s\n", (int)bspan_size(&text), (const char *)bspan_begin(&text));
+
+            // The replacement text is not decoded again
+            if (!span_is(text, "Hello, from Acme &amp; Sons!  &logo; &param;"))
+                failures++;
+            sawContent = true;
+        }
+    }
+
+    if (!sawContent || (xml_entity_table_count(&entities) != 3))
+        failures++;
+
+    // Enough to make the table grow
+    std::string names[100];
+    for (int i = 0; i < 100; i++) {
+        names[i] = "e" + std::to_string(i);
+        bspan name;
+        bspan_init_from_cstr(&name, names[i].c_str());
+        xml_entity_table_add(&entities, &name, &name);
+    }
+    for (int i = 0; i < 100; i++) {
+        bspan name, value;
+        bspan_init_from_cstr(&name, names[i].c_str());
+        if ((xml_entity_table_find(&entities, &name, &value) != 0) || !span_is(value, names[i].c_str()))
+            failures++;
+    }
+
+    xml_entity_table_destroy(&entities);
+    arena_destroy(&a);
+
+    printf("declared: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_arena();
+    test_predefined();
+    test_declared();
+}
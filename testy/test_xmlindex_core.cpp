@@ -0,0 +1,282 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+
+#include "xmlscan.h"
+
+// Classify a block a byte at a time
+static void classify_bytes(const unsigned char *block, xmlindex_masks *m)
+{
+    memset(m, 0, sizeof(xmlindex_masks));
+    for (int i = 0; i < XMLINDEX_BLOCK_SIZE; i++)
+    {
+        uint64_t bit = 1ULL << i;
+        unsigned char c = block[i];
+        if (c == '<') m->fOpen |= bit;
+        if (c == '>') m->fClose |= bit;
+    }
+}
+
+// Check a classify kernel against the byte at a time version, both
+// with random bytes, and with bytes drawn from the interesting ones
+static int check_kernel(const char *name, xmlindex_classify_fn classify)
+{
+    static const char interesting[] = "<>\"' \t\r\n=/?!-a\x80\xff";
+    unsigned char block[XMLINDEX_BLOCK_SIZE];
+    int failures = 0;
+
+    srand(1234);
+    for (int trial = 0; trial < 100000; trial++)
+    {
+        for (int i = 0; i < XMLINDEX_BLOCK_SIZE; i++) {
+            if (trial & 1)
+                block[i] = (unsigned char)(rand() & 0xff);
+            else
+                block[i] = (unsigned char)interesting[rand() % (sizeof(interesting) - 1)];
+        }
+
+        xmlindex_masks expected, got;
+        classify_bytes(block, &expected);
+        classify(block, &got);
+        if (memcmp(&expected, &got, sizeof(xmlindex_masks)) != 0)
+            failures++;
+    }
+
+    printf("%-8s: %s\n", name, failures == 0 ? "PASS" : "FAIL");
+    return failures;
+}
+
+void test_kernels()
+{
+    printf("==== test_kernels ====\n");
+    check_kernel("scalar", xmlindex_kern_classify_scalar);
+
+#if defined(PC_ARCH_X86)
+    check_kernel("sse2", xmlindex_kern_classify_sse2);
+    if (pc_cpu_has(PC_CPU_AVX2))
+        check_kernel("avx2", xmlindex_kern_classify_avx2);
+    if (pc_cpu_has(PC_CPU_AVX512BW))
+        check_kernel("avx512", xmlindex_kern_classify_avx512);
+#endif
+}
+
+// A document made of random pieces of markup, with the odd
+// stray character thrown in, when it's not well formed
+static std::string make_xml(int pieces, bool wellFormed)
+{
+    static const char *markup[] = {
+        "<svg width='10' height=\"20\">", "</svg>", "<g transform='translate(1,2)'>", "</g>",
+        "<path d=\"M 10,20 L 30 40\"/>", "<rect x='1' y = '2' />", "<!-- a comment > with < stuff -->",
+        "<![CDATA[ <not> a tag ]]>", "<?pi target data?>", "<?xml version='1.0' encoding='UTF-8'?>",
+        "<!DOCTYPE svg [ <!ELEMENT svg (g)> ]>", "<!ENTITY hello 'Hello'>", "some text", "   \n\t  ",
+        "a > b", "<br>", "<a:b xmlns:a='urn:x'>", "</a:b>", "<t attr=\"x>y\">", "\r\n", "</empty >",
+    };
+    const int nmarkup = sizeof(markup) / sizeof(markup[0]);
+
+    std::string s;
+    for (int i = 0; i < pieces; i++) {
+        s += markup[rand() % nmarkup];
+        if (!wellFormed && (rand() % 20 == 0))
+            s += "<>'\" x"[rand() % 6];
+    }
+
+    return s;
+}
+
+// The positions in the index have to be exactly the '<' and '>'
+// characters, at every length, so every partial block is covered
+void test_positions()
+{
+    printf("==== test_positions ====\n");
+    int failures = 0;
+
+    srand(42);
+    std::string doc = make_xml(100, false);
+    for (size_t n = 0; n <= doc.size(); n++)
+    {
+        bspan src;
+        bspan_init_from_data(&src, doc.data(), n);
+
+        xmlindex idx;
+        xmlindex_init(&idx);
+        xmlindex_build(&idx, &src);
+
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++) {
+            if ((doc[i] != '<') && (doc[i] != '>'))
+                continue;
+            if ((count >= xmlindex_count(&idx)) || (idx.fPositions[count] != i))
+                failures++;
+            count++;
+        }
+        if (count != xmlindex_count(&idx))
+            failures++;
+
+        xmlindex_destroy(&idx);
+    }
+
+    printf("positions: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+static bool same_span(const bspan &a, const bspan &b)
+{
+    return (a.fStart == b.fStart) && (a.fEnd == b.fEnd);
+}
+
+// Scanning with the index has to produce exactly the same elements
+// as scanning without it
+void test_same_elements()
+{
+    printf("==== test_same_elements ====\n");
+    int failures = 0;
+
+    srand(7);
+    for (int trial = 0; trial < 500; trial++)
+    {
+        std::string doc = make_xml(200, (trial & 1) != 0);
+        bspan src;
+        bspan_init_from_data(&src, doc.data(), doc.size() - (size_t)(rand() % 8));
+
+        xmliterparams params;
+        xml_iter_params_init(&params);
+        params.fSkipWhitespace = (trial % 3) != 0;
+
+        xmlindex idx;
+        xmlindex_init(&idx);
+        xmlindex_build(&idx, &src);
+
+        xmliteratorstate plain, indexed;
+        xml_iter_state_init_from_source(&plain, &src);
+        xml_iter_state_init_from_index(&indexed, &src, &idx);
+
+        while (true)
+        {
+            xmlelement a, b;
+            int reta = xml_iter_next_element(&params, &plain, &a);
+            int retb = xml_iter_next_element(&params, &indexed, &b);
+            if (reta != retb) {
+                failures++;
+                break;
+            }
+            if (reta != 0)
+                break;
+
+            if ((a.fElementKind != b.fElementKind) || !same_span(a.fData, b.fData) ||
+                !same_span(a.fXmlName.fName, b.fXmlName.fName) || !same_span(a.fXmlName.fNamespace, b.fXmlName.fNamespace))
+                failures++;
+        }
+
+        xmlindex_destroy(&idx);
+    }
+
+    printf("same elements: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// An index that did not build is empty, and is not used
+void test_failed_index()
+{
+    printf("==== test_failed_index ====\n");
+    int failures = 0;
+
+    srand(11);
+    std::string doc = make_xml(200, true);
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    xmlindex idx;
+    xmlindex_init(&idx);
+    if ((xmlindex_build(&idx, &src) != 0) || (idx.fBase == nullptr))
+        failures++;
+
+    // As a build that ran out of memory part way through leaves it
+    idx.fCount /= 2;
+    xmlindex_fail(&idx);
+    if ((idx.fBase != nullptr) || (idx.fLength != 0) || (xmlindex_count(&idx) != 0))
+        failures++;
+
+    xmliterparams params;
+    xml_iter_params_init(&params);
+    xmliteratorstate plain, indexed;
+    xml_iter_state_init_from_source(&plain, &src);
+    xml_iter_state_init_from_index(&indexed, &src, &idx);
+    if (indexed.fIndex != nullptr)
+        failures++;
+
+    xmlelement a, b;
+    size_t plainCount = 0, indexedCount = 0;
+    while (xml_iter_next_element(&params, &plain, &a) == 0)
+        plainCount++;
+    while (xml_iter_next_element(&params, &indexed, &b) == 0)
+        indexedCount++;
+    if ((plainCount == 0) || (plainCount != indexedCount))
+        failures++;
+
+    xmlindex_destroy(&idx);
+
+    printf("failed index: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// How long it takes to walk a large document, with and without the index
+static double time_scan(bspan *src, const xmlindex *idx, size_t *elements)
+{
+    xmliterparams params;
+    xml_iter_params_init(&params);
+
+    xmliteratorstate st;
+    if (idx != nullptr)
+        xml_iter_state_init_from_index(&st, src, idx);
+    else
+        xml_iter_state_init_from_source(&st, src);
+
+    auto start = std::chrono::steady_clock::now();
+    xmlelement elem;
+    *elements = 0;
+    while (xml_iter_next_element(&params, &st, &elem) == 0)
+        (*elements)++;
+    auto stop = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+void test_timing()
+{
+    printf("==== test_timing ====\n");
+
+    // Plain svg, which the scanner walks all the way through
+    std::string doc = "<svg width='100' height='100'>\n";
+    for (int i = 0; i < 100000; i++)
+        doc += "  <g transform='translate(1,2)'>\n    <path d=\"M 10,20 L 30 40\"/>\n    <rect x='1' y='2' width='3' height='4'/>\n  </g>\n";
+    doc += "</svg>\n";
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    size_t plainCount = 0;
+    size_t indexedCount = 0;
+    double plainMs = time_scan(&src, nullptr, &plainCount);
+
+    auto start = std::chrono::steady_clock::now();
+    xmlindex idx;
+    xmlindex_init(&idx);
+    xmlindex_build(&idx, &src);
+    auto stop = std::chrono::steady_clock::now();
+    double buildMs = std::chrono::duration<double, std::milli>(stop - start).count();
+
+    double indexedMs = time_scan(&src, &idx, &indexedCount);
+    xmlindex_destroy(&idx);
+
+    printf("  %zu bytes, %zu elements\n", doc.size(), plainCount);
+    printf("  plain   : %8.2f ms\n", plainMs);
+    printf("  indexed : %8.2f ms (+ %.2f ms to build)\n", indexedMs, buildMs);
+    printf("timing: %s\n", plainCount == indexedCount ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_kernels();
+    test_positions();
+    test_same_elements();
+    test_failed_index();
+    test_timing();
+}
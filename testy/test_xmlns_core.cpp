@@ -0,0 +1,169 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "xmlscan.h"
+#include "xmlns.h"
+#include "testhelpers.h"
+
+static std::string uri_of(const xmlnsresolver &ns, uint32_t id)
+{
+    bspan s;
+    if (xmlns_uri(&ns, id, &s) != 0)
+        return "?";
+
+    return str(s);
+}
+
+static std::string name_of(const xmlnsresolver &ns, uint32_t id)
+{
+    bspan s;
+    if (xmlns_local_name(&ns, id, &s) != 0)
+        return "?";
+
+    return str(s);
+}
+
+// Each element, and attribute, as {uri}name, one per line
+static std::string resolve_all(const char *doc)
+{
+    bspan src;
+    bspan_init_from_cstr(&src, doc);
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, &src);
+
+    xmlnsresolver ns;
+    xmlns_init(&ns);
+
+    std::string out;
+    while (xml_iter_next_element(&params, &st, &elem) == 0)
+    {
+        xmlnsname name;
+        int kind = elem.fElementKind;
+        if ((kind != XML_ELEMENT_TYPE_START_TAG) && (kind != XML_ELEMENT_TYPE_SELF_CLOSING) && (kind != XML_ELEMENT_TYPE_END_TAG))
+            continue;
+
+        int err = xmlns_element(&ns, &elem, &name);
+        out += (kind == XML_ELEMENT_TYPE_END_TAG) ? "/" : "";
+        out += err == 0 ? "{" + uri_of(ns, name.fNamespace) + "}" : "{!}";
+        out += name_of(ns, name.fLocalName);
+
+        if (kind != XML_ELEMENT_TYPE_END_TAG) {
+            xmlattriter iter;
+            xmlattr attr;
+            xml_attr_iter_init(&iter, &elem);
+            while (xml_attr_iter_next(&iter, &attr) == 0) {
+                err = xmlns_attribute(&ns, &attr, &name);
+                out += " @";
+                out += err == 0 ? "{" + uri_of(ns, name.fNamespace) + "}" : "{!}";
+                out += name_of(ns, name.fLocalName);
+            }
+        }
+        out += "\n";
+    }
+
+    xmlns_destroy(&ns);
+
+    return out;
+}
+
+void test_resolve()
+{
+    printf("==== test_resolve ====\n");
+    int failures = 0;
+
+    struct { const char *doc; const char *expected; } cases[] = {
+        // No namespaces at all
+        { "<a x='1'><b/></a>",
+          "{}a @{}x\n{}b\n/{}a\n" },
+
+        // A default namespace, which attributes don't get
+        { "<svg xmlns='urn:svg' width='1'><rect/></svg>",
+          "{urn:svg}svg @{http://www.w3.org/2000/xmlns/}xmlns @{}width\n{urn:svg}rect\n/{urn:svg}svg\n" },
+
+        // Prefixes, on elements and attributes, and the declaration
+        // applies to the element it's on
+        { "<s:svg xmlns:s='urn:svg' xmlns:xl='urn:xlink'><s:use xl:href='#a' xml:lang='en'/></s:svg>",
+          "{urn:svg}svg @{http://www.w3.org/2000/xmlns/}s @{http://www.w3.org/2000/xmlns/}xl\n"
+          "{urn:svg}use @{urn:xlink}href @{http://www.w3.org/XML/1998/namespace}lang\n/{urn:svg}svg\n" },
+
+        // Declarations go away when their element ends, self closing or not
+        { "<a><b xmlns:p='urn:1'><p:c/></b><p:d/><e xmlns:p='urn:2'/><p:f/></a>",
+          "{}a\n{}b @{http://www.w3.org/2000/xmlns/}p\n{urn:1}c\n/{}b\n{!}d\n{}e @{http://www.w3.org/2000/xmlns/}p\n{!}f\n/{}a\n" },
+
+        // Redeclared inside, and the default undeclared
+        { "<a xmlns='urn:1' xmlns:p='urn:1'><p:b xmlns:p='urn:2'><p:c/></p:b><p:d/><e xmlns=''/></a>",
+          "{urn:1}a @{http://www.w3.org/2000/xmlns/}xmlns @{http://www.w3.org/2000/xmlns/}p\n"
+          "{urn:2}b @{http://www.w3.org/2000/xmlns/}p\n{urn:2}c\n/{urn:2}b\n{urn:1}d\n{}e @{http://www.w3.org/2000/xmlns/}xmlns\n/{urn:1}a\n" },
+
+        // An attribute that only starts with 'xmlns' is an ordinary one
+        { "<a xmlnsfoo='1'/>",
+          "{}a @{}xmlnsfoo\n" },
+    };
+
+    for (auto &c : cases) {
+        std::string got = resolve_all(c.doc);
+        if (got != c.expected) {
+            printf("  %s\n  got:\n%s  expected:\n%s", c.doc, got.c_str(), c.expected);
+            failures++;
+        }
+    }
+
+    printf("resolve: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// The same namespace, through different prefixes, is the same id,
+// and the same local name is the same id, whatever the prefix
+void test_ids()
+{
+    printf("==== test_ids ====\n");
+    int failures = 0;
+
+    const char *doc = "<r xmlns:a='urn:x' xmlns:b='urn:x' xmlns:c='urn:y'><a:n/><b:n/><c:n/></r>";
+    bspan src;
+    bspan_init_from_cstr(&src, doc);
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, &src);
+
+    xmlnsresolver ns;
+    xmlns_init(&ns);
+    uint32_t x = xmlns_intern_uri_cstr(&ns, "urn:x");
+    uint32_t n = xmlns_intern_name_cstr(&ns, "n");
+
+    xmlnsname names[4];
+    int count = 0;
+    while ((xml_iter_next_element(&params, &st, &elem) == 0) && (count < 4)) {
+        if (elem.fElementKind == XML_ELEMENT_TYPE_END_TAG)
+            continue;
+        if (xmlns_element(&ns, &elem, &names[count++]) != 0)
+            failures++;
+    }
+
+    if ((count != 4) || (names[1].fNamespace != x) || (names[2].fNamespace != x) || (names[3].fNamespace == x) ||
+        (names[1].fLocalName != n) || (names[2].fLocalName != n) || (names[3].fLocalName != n))
+        failures++;
+
+    bspan prefix;
+    bspan_init_from_cstr(&prefix, "xml");
+    if (xmlns_lookup_prefix(&ns, &prefix) != XMLNS_XML)
+        failures++;
+
+    xmlns_destroy(&ns);
+
+    printf("ids: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_resolve();
+    test_ids();
+}
@@ -0,0 +1,214 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "xmlparallel.h"
+
+// A document made of random pieces of markup, including the ones
+// that hide '<' and '>' from the scanner
+static std::string make_xml(size_t size)
+{
+    static const char *markup[] = {
+        "<svg width='10' height=\"20\">", "</svg>", "<g transform='translate(1,2)'>", "</g>",
+        "<path d=\"M 10,20 L 30 40\"/>", "<rect x='1' y = '2' />", "<!-- a comment > with < stuff -->",
+        "<![CDATA[ <not> a tag ]]>", "<?pi target data?>", "<!DOCTYPE svg [ <!ELEMENT svg (g)> ]>",
+        "<!ENTITY hello 'Hello'>", "some text", "   \n\t  ", "a > b", "<br>", "<t attr=\"x>y\">",
+        "<!-- > > > -->", "<![CDATA[ >>> ]]>",
+    };
+    const int nmarkup = sizeof(markup) / sizeof(markup[0]);
+
+    std::string s;
+    while (s.size() < size)
+        s += markup[rand() % nmarkup];
+
+    return s;
+}
+
+static std::vector<xmlelement> scan_all(bspan *src)
+{
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, src);
+
+    std::vector<xmlelement> elems;
+    while (xml_iter_next_element(&params, &st, &elem) == 0)
+        elems.push_back(elem);
+
+    return elems;
+}
+
+static bool same_span(const bspan &a, const bspan &b)
+{
+    return (a.fStart == b.fStart) && (a.fEnd == b.fEnd);
+}
+
+static int check_elements(const char *title, const std::string &doc)
+{
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+    std::vector<xmlelement> expected = scan_all(&src);
+
+    xmliterparams params;
+    xml_iter_params_init(&params);
+
+    int failures = 0;
+    static const size_t threads[] = { 1, 2, 3, 7, 16 };
+    for (size_t nThreads : threads)
+    {
+        std::vector<xmlelement> elems;
+        pcore::xml_parallel_scan(&params, &src, elems, nThreads);
+
+        bool same = elems.size() == expected.size();
+        for (size_t i = 0; same && (i < elems.size()); i++)
+            same = (elems[i].fElementKind == expected[i].fElementKind) && same_span(elems[i].fData, expected[i].fData) &&
+                same_span(elems[i].fNameSpan, expected[i].fNameSpan);
+
+        if (!same) {
+            printf("  %s, %zu threads: %zu elements, expected %zu\n", title, nThreads, elems.size(), expected.size());
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+// The parallel index is the same as the one built on one thread
+void test_index()
+{
+    printf("==== test_index ====\n");
+    int failures = 0;
+
+    srand(11);
+    std::string doc = make_xml(2 * 1024 * 1024 + 13);
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    xmlindex expected;
+    xmlindex_init(&expected);
+    xmlindex_build(&expected, &src);
+
+    static const size_t threads[] = { 1, 2, 3, 7, 16 };
+    for (size_t nThreads : threads)
+    {
+        xmlindex idx;
+        xmlindex_init(&idx);
+        if ((pcore::xml_parallel_build_index(&idx, &src, nThreads) != 0) || (xmlindex_count(&idx) != xmlindex_count(&expected)) ||
+            (memcmp(idx.fPositions, expected.fPositions, xmlindex_count(&idx) * sizeof(uint32_t)) != 0))
+            failures++;
+        xmlindex_destroy(&idx);
+    }
+
+    xmlindex_destroy(&expected);
+
+    printf("index: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Random documents, where the chunks start wherever they happen to
+void test_elements()
+{
+    printf("==== test_elements ====\n");
+    int failures = 0;
+
+    srand(12);
+    for (int i = 0; i < 10; i++)
+        failures += check_elements("random", make_xml(1024 * 1024 + rand() % 1000));
+
+    printf("elements: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Markup that runs right across the chunk boundaries, so the
+// guesses are wrong, and have to be fixed up
+void test_boundaries()
+{
+    printf("==== test_boundaries ====\n");
+    int failures = 0;
+
+    // One comment that covers most of the document
+    std::string doc = "<a>";
+    doc += "<!--";
+    for (int i = 0; i < 100000; i++)
+        doc += "<b x='1'>t</b>";
+    doc += "-->";
+    for (int i = 0; i < 10000; i++)
+        doc += "<c/>";
+    doc += "</a>";
+    failures += check_elements("comment", doc);
+
+    // CDATA full of tags, every so often
+    doc = "<a>";
+    for (int i = 0; i < 200; i++) {
+        doc += "<![CDATA[";
+        for (int j = 0; j < 1000; j++)
+            doc += "<b>t</b>";
+        doc += "]]><d y='2'>text</d>";
+    }
+    doc += "</a>";
+    failures += check_elements("cdata", doc);
+
+    // Long attribute values, with a '>' in them
+    doc = "<a>";
+    for (int i = 0; i < 500; i++) {
+        doc += "<e v='";
+        for (int j = 0; j < 500; j++)
+            doc += "x>y ";
+        doc += "'/>";
+    }
+    doc += "</a>";
+    failures += check_elements("attributes", doc);
+
+    // No '>' at all after the first chunk, and nothing at all
+    failures += check_elements("tail", "<a>" + std::string(1024 * 1024, 'z'));
+    failures += check_elements("empty", "");
+
+    printf("boundaries: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_timing()
+{
+    printf("==== test_timing ====\n");
+
+    srand(13);
+    std::string doc = make_xml(64 * 1024 * 1024);
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    xmliterparams params;
+    xml_iter_params_init(&params);
+
+    size_t cores = std::thread::hardware_concurrency();
+    for (size_t nThreads = 1; ; nThreads *= 2)
+    {
+        if (nThreads > cores)
+            nThreads = cores;
+
+        auto t0 = std::chrono::steady_clock::now();
+        xmlindex idx;
+        xmlindex_init(&idx);
+        pcore::xml_parallel_build_index(&idx, &src, nThreads);
+        auto t1 = std::chrono::steady_clock::now();
+        std::vector<xmlelement> elems;
+        pcore::xml_parallel_scan(&params, &src, elems, nThreads);
+        auto t2 = std::chrono::steady_clock::now();
+        xmlindex_destroy(&idx);
+
+        printf("  %2zu threads: index %8.2f ms, elements %8.2f ms (%zu)\n", nThreads,
+            std::chrono::duration<double, std::milli>(t1 - t0).count(),
+            std::chrono::duration<double, std::milli>(t2 - t1).count(), elems.size());
+
+        if (nThreads >= cores)
+            break;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    test_index();
+    test_elements();
+    test_boundaries();
+    test_timing();
+}
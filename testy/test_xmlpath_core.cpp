@@ -0,0 +1,202 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+
+#include "xmlpath.h"
+#include "xmldom.h"
+
+// All the values a path finds, joined with '|'
+static std::string run_path(const char *expr, const char *doc)
+{
+    xmlpath path;
+    if (xmlpath_compile_cstr(&path, expr) != 0)
+        return "error";
+
+    bspan src;
+    bspan_init_from_cstr(&src, doc);
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, &src);
+
+    xmlpathmatcher m;
+    xmlpathmatch match;
+    xmlpath_matcher_init(&m, &path);
+
+    std::string found;
+    while (xmlpath_next_match(&params, &st, &m, &match) == 0) {
+        if (!found.empty())
+            found += "|";
+        found.append((const char *)bspan_begin(&match.fValue), bspan_size(&match.fValue));
+    }
+    xmlpath_matcher_destroy(&m);
+
+    return found;
+}
+
+void test_compile()
+{
+    printf("==== test_compile ====\n");
+    int failures = 0;
+
+    static const char *good[] = {
+        "/svg", "//path", "/svg/g/path/@d", "/svg//g/*", "//rect[@fill]", "//g[@id='layer1']/rect",
+        "//g[@id=\"a b\"]//@x", "/*/*/@id", "//a:b",
+    };
+    static const char *bad[] = {
+        "", "svg", "/", "//", "/svg/", "/@d", "//@", "/svg/@d/g", "/svg[", "/svg[@]", "/svg[id]",
+        "/svg[@id=x]", "/svg[@id='x]", "/svg[@id='x'", "/svg]",
+    };
+
+    xmlpath path;
+    for (const char *expr : good) {
+        if (xmlpath_compile_cstr(&path, expr) != 0) {
+            printf("  should compile: %s\n", expr);
+            failures++;
+        }
+    }
+    for (const char *expr : bad) {
+        if (xmlpath_compile_cstr(&path, expr) == 0) {
+            printf("  should not compile: %s\n", expr);
+            failures++;
+        }
+    }
+
+    printf("compile: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_queries()
+{
+    printf("==== test_queries ====\n");
+    int failures = 0;
+
+    static const char *doc =
+        "<?xml version='1.0'?>"
+        "<svg id='root'>"
+        "<g id='layer1'><path d='M1'/><g id='inner'><path d='M2'/><rect x='1' fill='red'/></g></g>"
+        "<g id='layer2'><path d='M3'></path><rect x='2'/><a:b id='ns'/></g>"
+        "<path d='M4'/>"
+        "<!-- <path d='not'/> -->"
+        "<rect x='3' fill='blue'><rect x='4'/></rect>"
+        "</svg>";
+
+    struct { const char *expr; const char *expected; } cases[] = {
+        { "/svg/@id", "root" },
+        { "/svg/g/@id", "layer1|layer2" },
+        { "/svg/g/path/@d", "M1|M3" },
+        { "/svg//path/@d", "M1|M2|M3|M4" },
+        { "//path/@d", "M1|M2|M3|M4" },
+        { "//g//path/@d", "M1|M2|M3" },
+        { "//g/g/path/@d", "M2" },
+        { "/svg/*/@id", "layer1|layer2" },
+        { "/svg/*/*/@id", "inner|ns" },
+        { "//rect[@fill]/@x", "1|3" },
+        { "//rect[@fill='blue']/@x", "3" },
+        { "//g[@id='layer2']/rect/@x", "2" },
+        { "//g[@id='layer2']//@id", "ns" },
+        { "//rect//rect/@x", "4" },
+        { "//a:b/@id", "ns" },
+        { "//path/@missing", "" },
+        { "/g", "" },
+        { "//g[@id='inner']", "id='inner'" },
+        { "//g[@id='layer1']//@x", "1" },
+        { "//@fill", "red|blue" },
+    };
+
+    for (auto &c : cases) {
+        std::string found = run_path(c.expr, doc);
+        if (found != c.expected) {
+            printf("  %s: got '%s', expected '%s'\n", c.expr, found.c_str(), c.expected);
+            failures++;
+        }
+    }
+
+    // Badly nested, end tags close the nearest open element with
+    // that name, the same as the DOM
+    if (run_path("/a/b/@x", "<a><b x='1'><c></b><b x='2'/></x></a><b x='3'/>") != "1|2")
+        failures++;
+
+    printf("queries: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+void test_large()
+{
+    printf("==== test_large ====\n");
+
+    std::string doc = "<svg width='100' height='100'>\n";
+    for (int i = 0; i < 100000; i++) {
+        doc += "<g transform='translate(1,2)'><path d='M 10,20 L 30 40'/><rect x='1' y='2' width='3' height='4'/></g>\n";
+        doc += "<defs><g><path d='unused'/></g></defs>\n";
+    }
+    doc += "</svg>\n";
+
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    xmliterparams params;
+    xml_iter_params_init(&params);
+
+    // With the path
+    auto t0 = std::chrono::steady_clock::now();
+    xmlpath path;
+    xmlpath_compile_cstr(&path, "/svg/g/path/@d");
+
+    xmliteratorstate st;
+    xml_iter_state_init_from_source(&st, &src);
+    xmlpathmatcher m;
+    xmlpathmatch match;
+    xmlpath_matcher_init(&m, &path);
+
+    size_t found = 0;
+    size_t bytes = 0;
+    while (xmlpath_next_match(&params, &st, &m, &match) == 0) {
+        found++;
+        bytes += bspan_size(&match.fValue);
+    }
+    size_t pathMemory = m.fOpen.fCapacity * m.fOpen.fEntrySize;
+    xmlpath_matcher_destroy(&m);
+    auto t1 = std::chrono::steady_clock::now();
+
+    // Build a DOM, and then walk it
+    xmldom dom;
+    xmldom_init(&dom);
+    xmldom_build_from_source(&dom, &src);
+
+    size_t domFound = 0;
+    uint32_t svgName = xmldom_find_name_cstr(&dom, "svg");
+    uint32_t gName = xmldom_find_name_cstr(&dom, "g");
+    uint32_t pathName = xmldom_find_name_cstr(&dom, "path");
+    for (uint32_t svg = xmldom_first_child_named(&dom, XMLDOM_ROOT, svgName); svg != XMLDOM_NONE; svg = xmldom_next_sibling_named(&dom, svg, svgName))
+        for (uint32_t g = xmldom_first_child_named(&dom, svg, gName); g != XMLDOM_NONE; g = xmldom_next_sibling_named(&dom, g, gName))
+            for (uint32_t p = xmldom_first_child_named(&dom, g, pathName); p != XMLDOM_NONE; p = xmldom_next_sibling_named(&dom, p, pathName))
+            {
+                xmlattriter iter;
+                xmlattr attr;
+                xmldom_attr_iter_init(&dom, p, &iter);
+                if (xml_attr_iter_next(&iter, &attr) == 0)
+                    domFound++;
+            }
+    size_t domMemory = xmldom_memory(&dom);
+    xmldom_destroy(&dom);
+    auto t2 = std::chrono::steady_clock::now();
+
+    auto ms = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+
+    printf("  xmlpath: %zu found, %8.2f ms, %10zu bytes\n", found, ms(t0, t1), pathMemory);
+    printf("  xmldom : %zu found, %8.2f ms, %10zu bytes\n", domFound, ms(t1, t2), domMemory);
+
+    bool success = (found == 100000) && (domFound == found) && (bytes == found * strlen("M 10,20 L 30 40"));
+    printf("large: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_compile();
+    test_queries();
+    test_large();
+}
@@ -0,0 +1,235 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "xmlpush.h"
+
+// What an element was, copied out, so it can be compared after
+// the memory it pointed to is gone
+struct ElementText {
+    int fKind;
+    std::string fData;
+    std::string fName;
+
+    bool operator==(const ElementText &other) const
+    {
+        return (fKind == other.fKind) && (fData == other.fData) && (fName == other.fName);
+    }
+};
+
+static ElementText element_text(const xmlelement &elem)
+{
+    return ElementText{ elem.fElementKind,
+        std::string((const char *)bspan_begin(&elem.fData), bspan_size(&elem.fData)),
+        std::string((const char *)bspan_begin(&elem.fNameSpan), bspan_size(&elem.fNameSpan)) };
+}
+
+static std::vector<ElementText> scan_whole(const std::string &doc)
+{
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, &src);
+
+    std::vector<ElementText> elems;
+    while (xml_iter_next_element(&params, &st, &elem) == 0)
+        elems.push_back(element_text(elem));
+
+    return elems;
+}
+
+// Feed the document in pieces, through a buffer that is overwritten
+// each time, the way a read() loop would do it
+static std::vector<ElementText> scan_pushed(const std::string &doc, const std::vector<size_t> &cuts, bool drainLast, size_t *mostBuffered)
+{
+    xmliterparams params;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+
+    xmlpushscanner p;
+    xml_push_init(&p);
+
+    std::vector<ElementText> elems;
+    std::string buf;
+    size_t from = 0;
+    for (size_t i = 0; i <= cuts.size(); i++)
+    {
+        size_t to = (i < cuts.size()) ? cuts[i] : doc.size();
+        buf.assign(doc, from, to - from);
+        from = to;
+
+        xml_push_feed(&p, buf.data(), buf.size());
+        if ((i == cuts.size()) && !drainLast)
+            break;
+
+        while (xml_push_next_element(&params, &p, &elem) == 0)
+            elems.push_back(element_text(elem));
+        if ((mostBuffered != nullptr) && (xml_push_buffered(&p) > *mostBuffered))
+            *mostBuffered = xml_push_buffered(&p);
+
+        for (char &c : buf)
+            c = '#';
+    }
+
+    xml_push_finish(&p);
+    while (xml_push_next_element(&params, &p, &elem) == 0)
+        elems.push_back(element_text(elem));
+
+    xml_push_destroy(&p);
+
+    return elems;
+}
+
+static const char *sampleDoc =
+    "<?xml version='1.0' encoding='UTF-8'?>\n"
+    "<!DOCTYPE svg [ <!ELEMENT svg (g)> <!ENTITY e 'x'> ]>\n"
+    "<svg width='10' height=\"20\">\n"
+    "  <g transform='translate(1,2)'>text &amp; more<br/></g>\n"
+    "  <!-- a comment > with < stuff -- in it -->\n"
+    "  <![CDATA[ <not> a tag ]] ]]>\n"
+    "  <?pi target data?>\n"
+    "  <t attr=\"x>y\">a > b</t>\n"
+    "  <a:b xmlns:a='urn:x'/>\n"
+    "</svg>\n"
+    "trailing text <unfinished";
+
+// Every way of cutting the document in two, and then in even pieces
+void test_cuts()
+{
+    printf("==== test_cuts ====\n");
+    int failures = 0;
+
+    std::string doc = sampleDoc;
+    std::vector<ElementText> expected = scan_whole(doc);
+
+    for (size_t cut = 0; cut <= doc.size(); cut++) {
+        if (scan_pushed(doc, { cut }, true, nullptr) != expected)
+            failures++;
+        if (scan_pushed(doc, { cut }, false, nullptr) != expected)
+            failures++;
+    }
+
+    for (size_t size = 1; size <= doc.size(); size++) {
+        std::vector<size_t> cuts;
+        for (size_t at = size; at < doc.size(); at += size)
+            cuts.push_back(at);
+        if (scan_pushed(doc, cuts, true, nullptr) != expected) {
+            printf("  pieces of %zu are different\n", size);
+            failures++;
+        }
+    }
+
+    printf("cuts: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// A long document, fed a little at a time, only ever holds on to a piece
+// of one element.  A long comment has to be held onto whole.
+void test_bounded()
+{
+    printf("==== test_bounded ====\n");
+    int failures = 0;
+
+    std::string doc = "<svg>";
+    for (int i = 0; i < 20000; i++)
+        doc += "<g transform='translate(1,2)'><path d=\"M 10,20 L 30 40\"/>text</g>\n";
+    doc += "<!--";
+    doc += std::string(100000, '>');
+    doc += "--></svg>";
+
+    std::vector<size_t> cuts;
+    for (size_t at = 1000; at < doc.size(); at += 1000 + (at % 7))
+        cuts.push_back(at);
+
+    size_t mostBuffered = 0;
+    std::vector<ElementText> elems = scan_pushed(doc, cuts, true, &mostBuffered);
+    if (elems != scan_whole(doc))
+        failures++;
+
+    // Before the comment, a piece of a tag, then most of the comment
+    printf("  %zu bytes, %zu elements, at most %zu buffered\n", doc.size(), elems.size(), mostBuffered);
+    if ((mostBuffered < 90000) || (mostBuffered > 102000))
+        failures++;
+
+    doc.resize(doc.size() - 100000 - 13);
+    doc += "</svg>";
+    cuts.resize(0);
+    for (size_t at = 1000; at < doc.size(); at += 1000 + (at % 7))
+        cuts.push_back(at);
+    mostBuffered = 0;
+    if ((scan_pushed(doc, cuts, true, &mostBuffered) != scan_whole(doc)) || (mostBuffered > 100))
+        failures++;
+
+    printf("bounded: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// A stream source that hands out a string a few bytes at a time
+struct stringsource {
+    const std::string *fDoc;
+    size_t fPos;
+    size_t fMaxRead;
+};
+
+static ptrdiff_t string_read(void *ctx, unsigned char *buff, size_t sz)
+{
+    stringsource *src = (stringsource *)ctx;
+    size_t n = src->fDoc->size() - src->fPos;
+    if (n > sz)
+        n = sz;
+    if (n > src->fMaxRead)
+        n = src->fMaxRead;
+
+    memcpy(buff, src->fDoc->data() + src->fPos, n);
+    src->fPos += n;
+
+    return (ptrdiff_t)n;
+}
+
+// Pulling the document through a stream window, in blocks of every size
+void test_stream()
+{
+    printf("==== test_stream ====\n");
+    int failures = 0;
+
+    std::string doc = sampleDoc;
+    std::vector<ElementText> expected = scan_whole(doc);
+
+    xmliterparams params;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+
+    for (size_t blockSize = 1; blockSize <= doc.size(); blockSize++)
+    {
+        stringsource src = { &doc, 0, (blockSize % 5) + 1 };
+        streamwin win;
+        streamwin_init_from_callback(&win, string_read, &src, blockSize);
+
+        xmlpushscanner p;
+        xml_push_init(&p);
+
+        std::vector<ElementText> elems;
+        int result;
+        while ((result = xml_push_next_element_from(&params, &p, &win, &elem)) == 0)
+            elems.push_back(element_text(elem));
+
+        if ((result != -1) || (elems != expected) || (win.fCapacity > blockSize))
+            failures++;
+
+        xml_push_destroy(&p);
+        streamwin_destroy(&win);
+    }
+
+    printf("stream: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_cuts();
+    test_bounded();
+    test_stream();
+}
@@ -0,0 +1,243 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "xmlscan.h"
+#include "xmlvocab.h"
+#include "testhelpers.h"
+
+// The SVG elements, in the order of their ids
+static const char *svgNames[] = {
+    "a", "animate", "animateMotion", "animateTransform", "circle", "clipPath", "defs", "desc",
+    "ellipse", "feBlend", "feColorMatrix", "feComponentTransfer", "feComposite", "feConvolveMatrix",
+    "feDiffuseLighting", "feDisplacementMap", "feDistantLight", "feDropShadow", "feFlood", "feFuncA",
+    "feFuncB", "feFuncG", "feFuncR", "feGaussianBlur", "feImage", "feMerge", "feMergeNode",
+    "feMorphology", "feOffset", "fePointLight", "feSpecularLighting", "feSpotLight", "feTile",
+    "feTurbulence", "filter", "foreignObject", "g", "image", "line", "linearGradient", "marker",
+    "mask", "metadata", "mpath", "path", "pattern", "polygon", "polyline", "radialGradient", "rect",
+    "script", "set", "stop", "style", "svg", "switch", "symbol", "text", "textPath", "title",
+    "tspan", "use", "view",
+};
+static const uint32_t svgCount = sizeof(svgNames) / sizeof(svgNames[0]);
+
+enum { SVG_CIRCLE = 4, SVG_G = 36, SVG_LINE = 38, SVG_PATH = 44, SVG_RECT = 49, SVG_SVG = 54 };
+
+static void svg_vocab(xmlvocab *vocab)
+{
+    xmlvocab_init(vocab);
+    for (uint32_t i = 0; i < svgCount; i++)
+        xmlvocab_add_cstr(vocab, svgNames[i], i);
+    xmlvocab_build(vocab);
+}
+
+static uint32_t lookup(const xmlvocab *vocab, const char *name)
+{
+    bspan s;
+    bspan_init_from_cstr(&s, name);
+
+    return xmlvocab_lookup(vocab, &s);
+}
+
+void test_lookup()
+{
+    printf("==== test_lookup ====\n");
+    int failures = 0;
+
+    xmlvocab vocab;
+    svg_vocab(&vocab);
+
+    for (uint32_t i = 0; i < svgCount; i++) {
+        if (lookup(&vocab, svgNames[i]) != i) {
+            printf("  %s: %u\n", svgNames[i], lookup(&vocab, svgNames[i]));
+            failures++;
+        }
+    }
+
+    // Close to a name, but not one
+    static const char *unknown[] = {
+        "", "G", "re", "rec", "rectt", "Rect", "feFuncX", "feSpotLigh", "feSpotLightt", "linearGradien",
+        "foreignObjecu", "animateTransfor", "svg:rect", "xyzzy",
+    };
+    for (const char *name : unknown) {
+        if (lookup(&vocab, name) != XMLVOCAB_UNKNOWN) {
+            printf("  should be unknown: '%s'\n", name);
+            failures++;
+        }
+    }
+
+    // Names are unique
+    if (xmlvocab_add_cstr(&vocab, "rect", 100) == 0)
+        failures++;
+
+    xmlvocab_destroy(&vocab);
+
+    // Nothing built, nothing found
+    xmlvocab_init(&vocab);
+    if (lookup(&vocab, "rect") != XMLVOCAB_UNKNOWN)
+        failures++;
+    xmlvocab_build(&vocab);
+    if (lookup(&vocab, "rect") != XMLVOCAB_UNKNOWN)
+        failures++;
+    xmlvocab_destroy(&vocab);
+
+    printf("lookup: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Vocabularies of all sizes build, and find what's in them
+void test_sizes()
+{
+    printf("==== test_sizes ====\n");
+    int failures = 0;
+
+    std::string names[2000];
+    for (int i = 0; i < 2000; i++)
+        names[i] = "name" + std::to_string(i * 7919);
+
+    for (int n = 1; n <= 2000; n = n < 40 ? n + 1 : n * 3 / 2)
+    {
+        xmlvocab vocab;
+        xmlvocab_init(&vocab);
+        for (int i = 0; i < n; i++)
+            xmlvocab_add_cstr(&vocab, names[i].c_str(), i * 2);
+        if (xmlvocab_build(&vocab) != 0) {
+            printf("  %d: did not build\n", n);
+            failures++;
+        }
+
+        for (int i = 0; i < n; i++)
+            if (lookup(&vocab, names[i].c_str()) != (uint32_t)(i * 2))
+                failures++;
+        for (int i = n; i < 2000; i += 17)
+            if (lookup(&vocab, names[i].c_str()) != XMLVOCAB_UNKNOWN)
+                failures++;
+
+        xmlvocab_destroy(&vocab);
+    }
+
+    printf("sizes: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// The scanner gives each tag the id of its name
+void test_scan()
+{
+    printf("==== test_scan ====\n");
+    int failures = 0;
+
+    xmlvocab vocab;
+    svg_vocab(&vocab);
+
+    bspan src;
+    bspan_init_from_cstr(&src,
+        "<svg width='10'><g><rect x='1'/><circle/><foo/>text<line></line></g></svg>");
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+    params.fVocab = &vocab;
+    xml_iter_state_init_from_source(&st, &src);
+
+    static const uint32_t expected[] = {
+        SVG_SVG, SVG_G, SVG_RECT, SVG_CIRCLE, XMLVOCAB_UNKNOWN, XMLVOCAB_UNKNOWN, SVG_LINE, SVG_LINE, SVG_G, SVG_SVG,
+    };
+    size_t count = 0;
+    while (xml_iter_next_element(&params, &st, &elem) == 0) {
+        if ((count >= sizeof(expected) / sizeof(expected[0])) || (elem.fNameId != expected[count])) {
+            printf("  element %zu: %u\n", count, elem.fNameId);
+            failures++;
+        }
+        count++;
+    }
+    if (count != sizeof(expected) / sizeof(expected[0]))
+        failures++;
+
+    // Without a vocabulary, every id is unknown
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, &src);
+    while (xml_iter_next_element(&params, &st, &elem) == 0)
+        if (elem.fNameId != XMLVOCAB_UNKNOWN)
+            failures++;
+
+    xmlvocab_destroy(&vocab);
+
+    printf("scan: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Finding the id by the vocabulary, compared to comparing the
+// name against each known name in turn
+void test_dispatch()
+{
+    printf("==== test_dispatch ====\n");
+
+    std::string doc = "<svg width='100' height='100'>\n";
+    for (int i = 0; i < 100000; i++)
+        doc += "<g><path d='M 1 2'/><rect x='1'/><use href='#a'/><tspan>t</tspan><feGaussianBlur/></g>\n";
+    doc += "</svg>\n";
+
+    xmlvocab vocab;
+    svg_vocab(&vocab);
+
+    // The names of the tags, as the scanner finds them
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, &src);
+
+    std::vector<bspan> names;
+    while (xml_iter_next_element(&params, &st, &elem) == 0) {
+        if (elem.fElementKind != XML_ELEMENT_TYPE_START_TAG && elem.fElementKind != XML_ELEMENT_TYPE_SELF_CLOSING)
+            continue;
+        bspan name = elem.fNameSpan;
+        if (bspan_size(&name) > 0 && bspan_back(&name) == '/')
+            name.fEnd--;
+        names.push_back(name);
+    }
+
+    // By comparing names
+    uint64_t byName = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (const bspan &name : names) {
+        uint32_t id = XMLVOCAB_UNKNOWN;
+        for (uint32_t i = 0; i < svgCount; i++)
+            if (span_is(name, svgNames[i])) {
+                id = i;
+                break;
+            }
+        byName += id;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    // By the vocabulary
+    uint64_t byId = 0;
+    for (const bspan &name : names)
+        byId += xmlvocab_lookup(&vocab, &name);
+    auto t2 = std::chrono::steady_clock::now();
+
+    auto ms = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+
+    printf("  %zu names\n", names.size());
+    printf("  by name : %8.2f ms\n", ms(t0, t1));
+    printf("  by vocab: %8.2f ms\n", ms(t1, t2));
+
+    bool success = (byName == byId) && (names.size() == 600001);
+    xmlvocab_destroy(&vocab);
+
+    printf("dispatch: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_lookup();
+    test_sizes();
+    test_scan();
+    test_dispatch();
+}
@@ -0,0 +1,327 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+
+#include "xmlscan.h"
+#include "xmlwrite.h"
+#include "testhelpers.h"
+
+static std::string out_string(const obuff &out)
+{
+    bspan s;
+    obuff_span(&out, &s);
+
+    return str(s);
+}
+
+void test_write()
+{
+    printf("==== test_write ====\n");
+    int failures = 0;
+
+    obuff out;
+    obuff_init(&out, 0);
+    xmlwriter w;
+    xmlwrite_init(&w, &out);
+
+    xmlwrite_declaration(&w);
+    xmlwrite_start_tag_cstr(&w, "svg");
+    xmlwrite_attribute_cstr(&w, "width", "100");
+    xmlwrite_attribute_cstr(&w, "title", "\"a\" & <b>\tc\nd");
+    xmlwrite_comment_cstr(&w, " shapes ");
+    xmlwrite_start_tag_cstr(&w, "rect");
+    xmlwrite_attribute_cstr(&w, "x", "1");
+    xmlwrite_end_tag_cstr(&w, "rect");
+    xmlwrite_start_tag_cstr(&w, "g");
+    xmlwrite_text_cstr(&w, "");
+    xmlwrite_end_tag_cstr(&w, "g");
+    xmlwrite_start_tag_cstr(&w, "text");
+    xmlwrite_text_cstr(&w, "1 < 2 && 3 > 2\r\n");
+    xmlwrite_end_tag_cstr(&w, "text");
+    bspan cdata;
+    bspan_init_from_cstr(&cdata, "a]]>b]]]>c");
+    xmlwrite_cdata(&w, &cdata);
+    bspan target, data;
+    bspan_init_from_cstr(&target, "pi");
+    bspan_init_from_cstr(&data, "some data");
+    xmlwrite_processing_instruction(&w, &target, &data);
+    xmlwrite_end_tag_cstr(&w, "svg");
+
+    const char *expected =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<svg width=\"100\" title=\"&quot;a&quot; &amp; &lt;b&gt;&#9;c&#10;d\">"
+        "<!-- shapes -->"
+        "<rect x=\"1\"/>"
+        "<g></g>"
+        "<text>1 &lt; 2 &amp;&amp; 3 &gt; 2&#13;\n</text>"
+        "<![CDATA[a]]]]><![CDATA[>b]]]]]><![CDATA[>c]]>"
+        "<?pi some data?>"
+        "</svg>";
+
+    std::string got = out_string(out);
+    if (got != expected) {
+        printf("  got     : %s\n  expected: %s\n", got.c_str(), expected);
+        failures++;
+    }
+
+    // Misuse
+    if (xmlwrite_attribute_cstr(&w, "x", "1") == 0)
+        failures++;
+    if ((xmlwrite_comment_cstr(&w, "a--b") == 0) || (xmlwrite_comment_cstr(&w, "a-") == 0))
+        failures++;
+    if (out_string(out) != got)
+        failures++;
+
+    obuff_destroy(&out);
+
+    printf("write: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Escaping, with the characters to escape everywhere in
+// strings long enough for every size of the scan
+void test_escape()
+{
+    printf("==== test_escape ====\n");
+    int failures = 0;
+
+    for (size_t len = 0; len < 200; len++)
+    {
+        for (size_t at = 0; at <= len; at += (len < 20) ? 1 : 7)
+        {
+            std::string text(len, 'x');
+            std::string expected(len, 'x');
+            if (at < len) {
+                text[at] = '&';
+                expected = std::string(at, 'x') + "&amp;" + std::string(len - at - 1, 'x');
+            }
+
+            obuff out;
+            obuff_init(&out, 0);
+            xmlwriter w;
+            xmlwrite_init(&w, &out);
+            xmlwrite_text_cstr(&w, text.c_str());
+            if (out_string(out) != expected)
+                failures++;
+            obuff_destroy(&out);
+        }
+    }
+
+    // Every byte value, in text and attributes
+    std::string all;
+    for (int c = 1; c < 256; c++)
+        all += (char)c;
+
+    std::string expectedText;
+    std::string expectedAttr;
+    for (unsigned char c : all) {
+        const char *e = xmlwrite_entity(c);
+        bool inText = (c == '&') || (c == '<') || (c == '>') || (c == '\r');
+        bool inAttr = inText || (c == '"') || (c == '\t') || (c == '\n');
+        expectedText += inText ? std::string(e) : std::string(1, (char)c);
+        expectedAttr += inAttr ? std::string(e) : std::string(1, (char)c);
+    }
+
+    obuff out;
+    obuff_init(&out, 0);
+    xmlwriter w;
+    xmlwrite_init(&w, &out);
+    xmlwrite_text_cstr(&w, all.c_str());
+    if (out_string(out) != expectedText)
+        failures++;
+
+    obuff_reset(&out);
+    xmlwrite_start_tag_cstr(&w, "a");
+    xmlwrite_attribute_cstr(&w, "v", all.c_str());
+    xmlwrite_end_tag_cstr(&w, "a");
+    if (out_string(out) != "<a v=\"" + expectedAttr + "\"/>")
+        failures++;
+    obuff_destroy(&out);
+
+    printf("escape: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// Scan a document, and write every element back out
+static std::string rewrite(const std::string &doc, obuff *out)
+{
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+    params.fSkipComments = false;
+    params.fSkipWhitespace = false;
+    xml_iter_state_init_from_source(&st, &src);
+
+    xmlwriter w;
+    xmlwrite_init(&w, out);
+    while (xml_iter_next_element(&params, &st, &elem) == 0)
+        xmlwrite_element(&w, &elem);
+    xmlwrite_flush(&w);
+
+    return out_string(*out);
+}
+
+void test_roundtrip()
+{
+    printf("==== test_roundtrip ====\n");
+    int failures = 0;
+
+    static const char *docs[] = {
+        "<a/>",
+        "<?xml version='1.0' encoding='UTF-8'?>\n<svg width='100'  height=\"20\">\n  <g id='a'><rect x='1'/><br/></g>\n</svg>",
+        "<!ENTITY e 'x'><?pi data?><a>text &amp; &lt;more&gt;<!-- c --><![CDATA[ <x> ]]></a>",
+        "<a:b xmlns:a='urn:a'\n  a:c='1'\n  d='2'>\n\t<e/>\n</a:b>",
+    };
+
+    for (const char *doc : docs) {
+        obuff out;
+        obuff_init(&out, 0);
+        std::string got = rewrite(doc, &out);
+        if (got != doc) {
+            printf("  got     : %s\n  expected: %s\n", got.c_str(), doc);
+            failures++;
+        }
+        obuff_destroy(&out);
+    }
+
+    // Whitespace before the '>' is the one thing that isn't kept
+    obuff out;
+    obuff_init(&out, 0);
+    if (rewrite("<a x='1' ><b ></b ></a>", &out) != "<a x='1'><b></b></a>")
+        failures++;
+
+    // A DOCTYPE can't be written back
+    xmlelement elem;
+    bspan empty;
+    bspan_init(&empty);
+    xml_element_init_from_data(&elem, XML_ELEMENT_TYPE_DOCTYPE, &empty);
+    xmlwriter w;
+    xmlwrite_init(&w, &out);
+    if (xmlwrite_element(&w, &elem) == 0)
+        failures++;
+    obuff_destroy(&out);
+
+    printf("roundtrip: %s\n", failures == 0 ? "PASS" : "FAIL");
+}
+
+// A filter that drops every <desc> element, into a small
+// buffer that flushes to a sink
+static ptrdiff_t string_sink(void *ctx, const unsigned char *data, size_t sz)
+{
+    ((std::string *)ctx)->append((const char *)data, sz);
+
+    return (ptrdiff_t)sz;
+}
+
+void test_filter()
+{
+    printf("==== test_filter ====\n");
+
+    std::string doc = "<svg>";
+    std::string expected = "<svg>";
+    for (int i = 0; i < 1000; i++) {
+        doc += "<g><desc>about <b>this</b></desc><path d='M 1 2'/></g>";
+        expected += "<g><path d='M 1 2'/></g>";
+    }
+    doc += "</svg>";
+    expected += "</svg>";
+
+    bspan src;
+    bspan_init_from_data(&src, doc.data(), doc.size());
+
+    xmliterparams params;
+    xmliteratorstate st;
+    xmlelement elem;
+    xml_iter_params_init(&params);
+    xml_iter_state_init_from_source(&st, &src);
+
+    std::string sunk;
+    obuff out;
+    obuff_init_with_sink(&out, string_sink, &sunk, 256);
+    xmlwriter w;
+    xmlwrite_init(&w, &out);
+
+    int inDesc = 0;
+    while (xml_iter_next_element(&params, &st, &elem) == 0)
+    {
+        bool isDesc = (bspan_size(&elem.fNameSpan) == 4) && (memcmp(bspan_begin(&elem.fNameSpan), "desc", 4) == 0);
+        if (isDesc && (elem.fElementKind == XML_ELEMENT_TYPE_START_TAG))
+            inDesc++;
+        if (inDesc == 0)
+            xmlwrite_element(&w, &elem);
+        if (isDesc && (elem.fElementKind == XML_ELEMENT_TYPE_END_TAG))
+            inDesc--;
+    }
+    xmlwrite_flush(&w);
+
+    bool success = (sunk == expected) && (obuff_total(&out) == expected.size()) && (out.fCapacity == 256);
+    obuff_destroy(&out);
+
+    printf("filter: %s\n", success ? "PASS" : "FAIL");
+}
+
+// Escaping a byte at a time, to compare against
+static void escape_bytes(obuff *o, const std::string &text)
+{
+    for (unsigned char c : text) {
+        switch (c) {
+            case '&': obuff_put_data(o, "&amp;", 5); break;
+            case '<': obuff_put_data(o, "&lt;", 4); break;
+            case '>': obuff_put_data(o, "&gt;", 4); break;
+            case '\r': obuff_put_data(o, "&#13;", 5); break;
+            default: obuff_put_byte(o, c); break;
+        }
+    }
+}
+
+void test_speed()
+{
+    printf("==== test_speed ====\n");
+
+    // Mostly plain text, with something to escape now and then
+    std::string text;
+    for (int i = 0; i < 200000; i++)
+        text += (i % 10 == 9) ? "Fish & chips, <served> hot. " : "The quick brown fox jumps over the lazy dog. ";
+
+    obuff a;
+    obuff b;
+    obuff_init(&a, text.size() * 2);
+    obuff_init(&b, text.size() * 2);
+
+    auto t0 = std::chrono::steady_clock::now();
+    escape_bytes(&a, text);
+    auto t1 = std::chrono::steady_clock::now();
+    xmlwriter w;
+    xmlwrite_init(&w, &b);
+    xmlwrite_text_cstr(&w, text.c_str());
+    auto t2 = std::chrono::steady_clock::now();
+
+    auto ms = [](std::chrono::steady_clock::time_point x, std::chrono::steady_clock::time_point y) {
+        return std::chrono::duration<double, std::milli>(y - x).count();
+    };
+    auto mbs = [&](std::chrono::steady_clock::time_point x, std::chrono::steady_clock::time_point y) {
+        return text.size() / 1e6 / (ms(x, y) / 1000.0);
+    };
+
+    printf("  byte at a time: %8.2f ms  %8.1f MB/s\n", ms(t0, t1), mbs(t0, t1));
+    printf("  xmlwrite_text : %8.2f ms  %8.1f MB/s\n", ms(t1, t2), mbs(t1, t2));
+
+    bool success = out_string(a) == out_string(b);
+    obuff_destroy(&a);
+    obuff_destroy(&b);
+
+    printf("speed: %s\n", success ? "PASS" : "FAIL");
+}
+
+int main(int argc, char* argv[])
+{
+    test_write();
+    test_escape();
+    test_roundtrip();
+    test_filter();
+    test_speed();
+}
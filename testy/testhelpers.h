@@ -0,0 +1,36 @@
+#pragma once
+
+//
+// Helpers shared by the core tests
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "bspan.h"
+
+// A copy of the span, to compare, or print
+static std::string str(const bspan &s)
+{
+    return std::string((const char *)bspan_begin(&s), bspan_size(&s));
+}
+
+static bool span_is(const bspan &s, const char *cstr)
+{
+    size_t len = strlen(cstr);
+    return (bspan_size(&s) == len) && (memcmp(bspan_begin(&s), cstr, len) == 0);
+}
+
+// Random CSV, at least 'size' bytes, made of the given pieces, so
+// each test can weight the characters that matter to it
+template <size_t N>
+static std::string make_csv(size_t size, unsigned seed, const char *const (&pieces)[N])
+{
+    srand(seed);
+    std::string s;
+    while (s.size() < size)
+        s += pieces[rand() % N];
+
+    return s;
+}